@@ -6,7 +6,7 @@
  * REPL (Read-Eval-Print Loop), parses commands (RUN, DEBUG, EXIT),
  * and manages the system execution modes.
  *
- * @version 1.5
+ * @version 2.1
  */
 
 #ifndef CONSOLE_H
@@ -110,6 +110,78 @@ CommandStatus_t handleRunCommand(char** args, int argCount);
  */
 CommandStatus_t handleDebugCommand(char* argument);
 
+/**
+ * @brief Handles the 'LOGLEVEL' command logic.
+ *
+ * Without arguments prints the current threshold of each log category.
+ * With a category and a level, changes the minimum level recorded at runtime.
+ * With "trace" and a format, switches hardware tracing between text and binary.
+ *
+ * @param args Category ("hardware", "kernel" or "trace") and level ("info", "warning", "error" or "off")
+ *             or trace format ("text" or "binary").
+ * @param argCount Number of arguments (0 or 2).
+ * @return CommandStatus_t CMD_SUCCESS, or CMD_MISSING_ARGS on invalid input.
+ */
+CommandStatus_t handleLogLevelCommand(char** args, int argCount);
+
+/**
+ * @brief Handles the 'CLOCK' command logic.
+ *
+ * Without arguments prints the current clock rate. With a number sets the
+ * rate in instructions per second; "turbo" removes the throttling.
+ *
+ * @param args Rate ("turbo" or a positive number of instructions per second).
+ * @param argCount Number of arguments (0 or 1).
+ * @return CommandStatus_t CMD_SUCCESS, or CMD_MISSING_ARGS on invalid input.
+ */
+CommandStatus_t handleClockCommand(char** args, int argCount);
+
+/**
+ * @brief Handles the 'IOSCHED' command logic.
+ *
+ * Without arguments prints the active disk scheduling policy, the head
+ * position and the mean and tail service times recorded for each policy.
+ * With a policy name switches to it; "reset" clears the statistics.
+ *
+ * @param args Policy ("fifo", "sstf", "scan", "clook") or "reset".
+ * @param argCount Number of arguments (0 or 1).
+ * @return CommandStatus_t CMD_SUCCESS, or CMD_MISSING_ARGS on invalid input.
+ */
+CommandStatus_t handleIoSchedCommand(char** args, int argCount);
+
+/**
+ * @brief Handles the 'DELETE' command logic.
+ *
+ * Removes each named program from the disk catalog and frees its sectors.
+ *
+ * @param args Paths or program names of the files to delete.
+ * @param argCount Number of arguments (at least 1).
+ * @return CommandStatus_t CMD_SUCCESS, or CMD_MISSING_ARGS without arguments.
+ */
+CommandStatus_t handleDeleteCommand(char** args, int argCount);
+
+/**
+ * @brief Handles the 'DEFRAG' command logic.
+ *
+ * Compacts the virtual disk so every program is stored in one contiguous,
+ * track-aligned run, and prints the fragmentation before and after.
+ * Refused while osIsIdle() is false: the files would move under running
+ * processes and DMA transfers.
+ *
+ * @return CommandStatus_t CMD_SUCCESS.
+ */
+CommandStatus_t handleDefragCommand(void);
+
+/**
+ * @brief Handles the 'FORMAT' command logic.
+ *
+ * Erases the catalog of the virtual disk and writes an empty one. This is
+ * the only way to reuse a disk image whose damaged catalog was not mounted.
+ *
+ * @return CommandStatus_t CMD_SUCCESS.
+ */
+CommandStatus_t handleFormatCommand(void);
+
 /**
  * @brief Starts the main Console loop (REPL).
  *
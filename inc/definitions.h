@@ -5,7 +5,7 @@
  * Contains all shared data structures between the CPU, Memory, DMA,
  * and other subsystems, based on the 8-digit decimal architecture.
  *
- * @version 1.6
+ * @version 2.4
  */
 
 #ifndef DEFINITIONS_H
@@ -26,6 +26,12 @@
 #define MIN_STACK_SIZE     50       /** Minimum stack size for user programs. */
 #define LOG_BUFFER_SIZE    512      /** Log buffer size for debug output. */
 #define MAX_PROCESSES      20       /** Maximum number of concurrent processes supported by the OS. */
+#ifndef DMA_QUEUE_DEPTH
+#define DMA_QUEUE_DEPTH    8        /** DMA descriptors that can be queued or in flight at once (-DDMA_QUEUE_DEPTH=N). */
+#endif
+#ifndef DMA_MAX_SEGMENTS
+#define DMA_MAX_SEGMENTS   4        /** Scatter-gather extents a single DMA descriptor can carry (-DDMA_MAX_SEGMENTS=N). */
+#endif
 
 typedef int32_t word;               /** Represents an 8-decimal digit machine word. (SMMMMMMM S=Sign, M=Magnitude). */
 typedef int32_t address;            /** Represents a memory address (index 0-1999). */
@@ -107,7 +113,8 @@ typedef enum {
 	OP_SDMAS    = 30,  /**< DMA: Set Sector */
 	OP_SDMAIO   = 31,  /**< DMA: Set I/O Mode (Read/Write) */
 	OP_SDMAM    = 32,  /**< DMA: Set Memory Address */
-	OP_SDMAON   = 33   /**< DMA: Start Transfer */
+	OP_SDMAON   = 33,  /**< DMA: Start Transfer */
+	OP_SDMAL    = 34   /**< DMA: Set Transfer Length (words) */
 } OpCode_t;
 
 /**
@@ -135,6 +142,7 @@ typedef enum {
     EXECUTING,          /**< Process is currently running on the CPU. */
     BLOCKED,            /**< Process is sleeping (SVC 4) or waiting for an event. */
     BLOCKED_IO,         /**< Process is waiting for the user to open the monitor for I/O. */
+    BLOCKED_DMA,        /**< Process issued SDMAON and is waiting for the DMA controller. */
     FINISHED            /**< Process has terminated or was aborted due to an error. */
 } ProcessState;
 
@@ -168,6 +176,8 @@ typedef struct {
 	word IR;                 /**< Instruction Register */
 	word RB;                 /**< Base Register (Protection) */
 	word RL;                 /**< Limit Register (Protection) */
+	word TB;                 /**< Text Base: physical start of the shared read-only code */
+	word TL;                 /**< Text Length: logical [0, TL) maps to TB, read-only in User Mode (0: no shared text) */
 	word RX;                 /**< Index/Auxiliary Register */
 	word SP;                 /**< Stack Pointer */
 	PSW_t PSW;               /**< Program Status Word */
@@ -182,6 +192,39 @@ typedef struct {
 	uint32_t value;              /**< Operand (Address or Immediate Value) */
 } Instruction_t;
 
+/** @brief Lifecycle of a DMA queue descriptor. */
+typedef enum {
+	DMA_REQ_FREE   = 0,  /**< Slot available for SDMAON */
+	DMA_REQ_QUEUED = 1,  /**< Submitted, waiting for the controller */
+	DMA_REQ_ACTIVE = 2,  /**< Being transferred */
+	DMA_REQ_DONE   = 3   /**< Finished, waiting for the kernel to reap the completion */
+} DMARequestState_t;
+
+/**
+ * @brief One scatter-gather extent: a run of consecutive sectors and the RAM range it maps to.
+ * Sectors advance as sector, then cylinder, then track (the order programs are laid out on disk).
+ */
+typedef struct {
+	uint8_t track;            /**< First Track */
+	uint8_t cylinder;         /**< First Cylinder */
+	uint8_t sector;           /**< First Sector */
+	address memAddr;          /**< First physical RAM address */
+	uint16_t length;          /**< Words in the extent */
+} DMASegment_t;
+
+/** @brief DMA transfer descriptor: one burst over its extents, completed by a single interrupt. */
+typedef struct {
+	uint8_t ioDirection;      /**< 0: Read from Disk, 1: Write to Disk */
+	uint8_t segmentCount;     /**< Extents used in segments[] */
+	DMASegment_t segments[DMA_MAX_SEGMENTS];  /**< Scatter-gather list, served in order */
+	int ownerPid;             /**< PID that issued the request (Completion tag) */
+	uint8_t status;           /**< Result once DONE: 0=Success, 1=Error */
+	DMARequestState_t state;  /**< Position in the descriptor lifecycle */
+	uint64_t sequence;        /**< Submission order (FIFO service) */
+	uint64_t submitCycle;     /**< Virtual cycle of submission */
+	uint64_t completeCycle;   /**< Virtual cycle at which the disk finishes the burst (Set when it becomes ACTIVE) */
+} DMARequest_t;
+
 /** @brief DMA Controller Definition (Direct Memory Access). */
 typedef struct {
 	uint8_t track;        /**< Target Track */
@@ -189,9 +232,15 @@ typedef struct {
 	uint8_t sector;       /**< Target Sector */
 	uint8_t ioDirection;  /**< 0: Read from Disk, 1: Write to Disk */
 	address memAddr;      /**< Target physical RAM address */
-	uint8_t status;       /**< Result: 0=Success, 1=Error */
+	uint16_t length;      /**< Words per transfer set by SDMAL (0 counts as 1) */
+	uint8_t status;       /**< Result of the last completed transfer: 0=Success, 1=Error */
 	bool active;          /**< Status flag: true if transfer is in progress */
-	bool pending;         /**< Flag indicating a pending DMA request */
+	bool pending;         /**< Flag indicating that requests are queued or in flight */
+	int requesterPid;     /**< PID stamped on the next submitted descriptor (Loaded by the kernel on dispatch) */
+	int outstanding;      /**< Descriptors QUEUED or ACTIVE */
+	uint64_t nextSequence;                   /**< Sequence number of the next submission */
+	uint64_t busyUntil;                      /**< Virtual cycle at which the disk finishes its current (or last) burst */
+	DMARequest_t queue[DMA_QUEUE_DEPTH];     /**< Descriptor slots */
 } DMA_t;
 
 /**
@@ -213,9 +262,11 @@ typedef struct {
     ProcessState state;         /**< Current state of the process. */
     CPU_t context;              /**< Snapshot of the CPU registers (PC, AC, SP, etc.). */
     char programName[256];      /**< Name of the executable file (e.g., "calc.txt"). */
-    int startBlock;             /**< Starting RAM block index assigned to this process. */
-    int blockCount;             /**< Number of contiguous RAM blocks assigned. */
+    int memoryBase;             /**< Physical base of the RAM block assigned to this process (see mmu.h). */
+    int memorySize;             /**< Words in that block. */
+    int textSegment;            /**< Shared text segment mapped at logical 0 (see mmu.h), -1 if none. */
     int sleepTics;              /**< Remaining CPU cycles to sleep (used by SVC 4). */
+    DMARequest_t dmaRegisters;  /**< DMA programming registers (SDMAP..SDMAM, SDMAL) saved on context switch as segments[0]. */
 } PCB_t;
 
 #define GET_INSTRUCTION_OPCODE(w) ((w) / 1000000)                      /**< @brief Extracts the first 2 digits for OpCode. */
@@ -226,16 +277,15 @@ typedef struct {
 #define GET_MAGNITUDE(w)          ((w) % SIGN_BIT)                     /**< @brief Gets only the magnitude (the lower 7 digits). */
 #define MAX_WORD_VALUE            (SIGN_BIT + MAX_MAGNITUDE)           /**< @brief Maximum valid word value (19999999). */
 #define IS_VALID_WORD(w)          ((w) >= 0 && (w) <= MAX_WORD_VALUE)  /**< @brief Validates if a word is within the allowed range. */
-#define IS_VALID_INSTRUCTION(w)   ((GET_INSTRUCTION_OPCODE(w) >= 0) && (GET_INSTRUCTION_OPCODE(w) <= OP_SDMAON)) /**< @brief Validates if an instruction OpCode is valid. */
+#define IS_VALID_INSTRUCTION(w)   ((GET_INSTRUCTION_OPCODE(w) >= 0) && (GET_INSTRUCTION_OPCODE(w) <= OP_SDMAL)) /**< @brief Validates if an instruction OpCode is valid. */
 
 extern word RAM[RAM_SIZE];                                        /**< @brief Shared Main Memory (RAM). */
 extern CPU_t CPU;                                                 /**< @brief Global Processor Instance. */
 extern DMA_t DMA;                                                 /**< @brief Global DMA Instance. */
-extern Sector_t DISK[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];  /**< @brief Virtual Hard Disk. */
+extern Sector_t (*DISK)[DISK_CYLINDERS][DISK_SECTORS];            /**< @brief Virtual Hard Disk (In memory, or mapped from an image file). */
 extern pthread_mutex_t BUS_LOCK;                                  /**< @brief Mutex for Memory Bus Arbitration. */
 extern pthread_cond_t DMA_COND;                                   /**< @brief Condition variable to synchronize DMA start. */
 extern bool OS_MONITOR_ACTIVE;                                    /**< @brief Flag to indicate if the OS Monitor is active. */
-extern bool FREE_PARTITIONS[MAX_PROCESSES];                       /**< @brief Array to track free RAM partitions for process allocation. */
 extern PCB_t PROCESS_TABLE[MAX_PROCESSES];                        /**< @brief The System Process Table. */
 
 #endif // DEFINITIONS_H
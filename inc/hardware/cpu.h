@@ -6,7 +6,7 @@
  * instruction cycle (Fetch-Decode-Execute), ALU operations, and internal
  * data format conversions (Sign-Magnitude <-> Two's Complement).
  *
- * @version 1.4
+ * @version 1.9
  */
 
 #ifndef CPU_H
@@ -36,6 +36,17 @@ typedef enum {
 	INSTR_EXEC_FAIL    = 1    /**< Instruction execution failed due to error. */
 } InstructionStatus_t;
 
+/**
+ * @brief Interpreter core used by the Execute phase.
+ *
+ * The switch core is the reference implementation. The threaded core dispatches
+ * through a handler table indexed by OpCode and addressing mode.
+ */
+typedef enum {
+	CPU_DISPATCH_SWITCH   = 0,  /**< execute(): switch on OpCode plus per-family helpers. */
+	CPU_DISPATCH_THREADED = 1   /**< executeThreaded(): one handler per OpCode and addressing mode. */
+} CPUDispatchMode_t;
+
 /**
  * @brief Triggers a hardware interrupt or exception.
  *
@@ -185,6 +196,10 @@ InstructionStatus_t executeComparison(Instruction_t instr);
 /**
  * @brief Handles DMA-related instructions (SDMAP, SDMAC, SDMAON, etc.).
  * Updates DMA controller state and initiates transfers as needed.
+ * SDMAON does not wait for the transfer: it sets osDMAWait and osYield so the
+ * kernel blocks the caller. The programming registers are copied into a queue
+ * descriptor tagged with DMA.requesterPid; if every descriptor is in use, the PC
+ * is rewound and the instruction is issued again once the caller wakes up.
  * Covers OpCodes: 28-33.
  */
 InstructionStatus_t executeDMAInstruction(Instruction_t instr);
@@ -250,6 +265,94 @@ Instruction_t decode(void);
  */
 CPUStatus_t execute(Instruction_t instruction);
 
+/**
+ * @brief Executes the Execute phase through the threaded dispatch core.
+ *
+ * Jumps straight to the handler of the instruction's OpCode and addressing mode
+ * (computed goto on GCC) instead of switching twice. It has the same architectural
+ * effects as execute(), which remains the reference implementation. Compilers
+ * without label addresses fall back to execute().
+ *
+ * @param instruction The decoded instruction to be executed.
+ * @return CPUStatus_t The status of the CPU after execution (e.g., CPU_STOP).
+ */
+CPUStatus_t executeThreaded(Instruction_t instruction);
+
+/**
+ * @brief Selects the interpreter core used by cpuStep().
+ *
+ * The default is CPU_DISPATCH_SWITCH, or CPU_DISPATCH_THREADED when the project
+ * is compiled with THREADED_DISPATCH defined (make threaded).
+ *
+ * @param mode The dispatch core to use from now on.
+ */
+void cpuSetDispatchMode(CPUDispatchMode_t mode);
+
+/**
+ * @brief Returns the interpreter core currently used by cpuStep().
+ */
+CPUDispatchMode_t cpuGetDispatchMode(void);
+
+/**
+ * @brief Enables or disables superinstruction fusion in cpuStep().
+ *
+ * When enabled, the common sequences LOAD;PSH, LOAD;SUM|RES;STR and COMP;JMPxx
+ * are matched at decode time and executed as one host operation with a single
+ * BUS_LOCK acquisition. Every component keeps its architectural effects; the
+ * sequence stops early as soon as a component faults or raises an interrupt
+ * (including the timer), so the next instruction runs through the normal path.
+ * Enabled by default when compiled with -DSUPERINSTRUCTIONS.
+ *
+ * @param enabled True to fuse matching sequences.
+ */
+void cpuSetFusion(bool enabled);
+
+/**
+ * @brief Returns whether superinstruction fusion is enabled.
+ */
+bool cpuGetFusion(void);
+
+/**
+ * @brief Returns the machine virtual clock: cycles elapsed since boot.
+ *
+ * Every retired instruction is one cycle, whatever process runs it and
+ * whatever the host speed. Devices (the disk) charge their latency in these
+ * cycles, so timings are reproducible across runs and clock rates.
+ */
+uint64_t cpuGetVirtualCycles(void);
+
+/**
+ * @brief Moves the virtual clock forward to a target cycle (never backwards).
+ *
+ * Used while no process can run, so the clock jumps to the next device event
+ * instead of waiting for instructions that will not come.
+ */
+void cpuAdvanceVirtualCycles(uint64_t target);
+
+/**
+ * @brief Reason why cpuRunSlice() returned control to the kernel.
+ */
+typedef enum {
+	CPU_SLICE_EXHAUSTED = 0,  /**< The instruction budget was used up, the process can keep running. */
+	CPU_SLICE_YIELD     = 1,  /**< The process must leave the CPU (timer expired or process blocked). */
+	CPU_SLICE_HALT      = 2   /**< The process finished or faulted, the CPU cannot continue. */
+} CPUSliceStatus_t;
+
+/**
+ * @brief Executes a burst of instructions for the current process.
+ *
+ * Runs fetch-decode-execute in a tight loop without the per-step bookkeeping of
+ * cpuStep(). The interrupt controller is only entered when an interrupt bit was
+ * raised, so a compute-bound process runs until the budget is exhausted, the
+ * timer expires, the process blocks (both set osYield) or it halts.
+ * Architectural effects are the same as calling cpuStep() the same number of times.
+ *
+ * @param maxInstructions Maximum number of guest instructions to retire.
+ * @param outExecuted Optional, receives the number of instructions retired.
+ * @return CPUSliceStatus_t Why the slice ended.
+ */
+CPUSliceStatus_t cpuRunSlice(int maxInstructions, int* outExecuted);
+
 /**
  * @brief Main execution loop.
  *
@@ -3,22 +3,73 @@
  * @brief Disk simulation interface.
  *
  * This file declares the functions for reading from and writing to
- * a simulated disk.
+ * a simulated disk, and the timing model that prices every access in
+ * virtual cycles: a seek that depends on the track and cylinder distance,
+ * a rotational delay until the first sector passes under the head, and a
+ * transfer time per sector.
  *
- * @version 2.1
+ * The sectors live in memory by default. A host file can be attached as a
+ * disk image instead: it is mapped with mmap() and DISK points into the
+ * mapping, so reads and writes go straight to the file and its contents
+ * survive restarts. Runs of consecutive sectors can be copied in one call
+ * with readSectors()/writeSectors().
+ *
+ * @version 2.5
  */
 
 #ifndef DISK_H
 #define DISK_H
+#include <stdbool.h>
 #include "../../inc/definitions.h"
 
+#ifndef DISK_SETTLE_CYCLES
+#define DISK_SETTLE_CYCLES    2   /** Head settle time paid by every seek that moves the head. */
+#endif
+#ifndef DISK_TRACK_CYCLES
+#define DISK_TRACK_CYCLES     5   /** Seek time per track crossed (Also paid when a transfer runs onto the next track). */
+#endif
+#ifndef DISK_CYLINDER_CYCLES
+#define DISK_CYLINDER_CYCLES  1   /** Seek time per cylinder crossed (Also paid when a transfer runs onto the next cylinder). */
+#endif
+#ifndef DISK_SECTOR_CYCLES
+#define DISK_SECTOR_CYCLES    1   /** Rotation: time for one sector to pass under the head (A revolution is DISK_SECTORS of them). */
+#endif
+#ifndef DISK_TRANSFER_CYCLES
+#define DISK_TRANSFER_CYCLES  1   /** Time to transfer one sector once it is under the head. */
+#endif
+
+#define DISK_IMAGE_MAGIC        "LUCDISK"                                          /** First bytes of a disk image file. */
+#define DISK_IMAGE_VERSION      1                                                  /** Layout version of the disk image. */
+#define DISK_IMAGE_HEADER_SIZE  4096                                               /** Bytes reserved for the header, so the sectors start page aligned. */
+#define DISK_IMAGE_SIZE         (DISK_IMAGE_HEADER_SIZE + sizeof(Sector_t) * DISK_TRACKS * DISK_CYLINDERS * DISK_SECTORS)  /** Bytes of a disk image file. */
+
+/** @brief Header at the start of a disk image file; the sectors follow at DISK_IMAGE_HEADER_SIZE. */
+typedef struct {
+	char magic[8];        /**< DISK_IMAGE_MAGIC */
+	uint32_t version;     /**< DISK_IMAGE_VERSION */
+	uint32_t tracks;      /**< DISK_TRACKS */
+	uint32_t cylinders;   /**< DISK_CYLINDERS */
+	uint32_t sectors;     /**< DISK_SECTORS */
+	uint32_t sectorSize;  /**< sizeof(Sector_t) */
+} DiskImageHeader_t;
+
+/** @brief Disk timing parameters, all in virtual cycles. */
+typedef struct {
+	uint32_t settleCycles;    /**< Paid by every seek that moves the head */
+	uint32_t trackCycles;     /**< Per track crossed */
+	uint32_t cylinderCycles;  /**< Per cylinder crossed */
+	uint32_t sectorCycles;    /**< Rotation time per sector */
+	uint32_t transferCycles;  /**< Transfer time per sector */
+} DiskTiming_t;
+
 /**
  * @brief Status codes for disk operations.
  * Replaces generic integers for better type safety and readability.
  */
 typedef enum {
 	DISK_SUCCESS           = 0,  /**< Operation completed successfully. */
-	DISK_ERR_OUT_OF_BOUNDS = 1   /**< Disk Error: Track/Cylinder/Sector out of bounds. */
+	DISK_ERR_OUT_OF_BOUNDS = 1,  /**< Disk Error: Track/Cylinder/Sector out of bounds. */
+	DISK_ERR_IMAGE         = 2   /**< Disk Error: Image file cannot be created, mapped or has another geometry. */
 } DiskStatus_t;
 
 /**
@@ -42,4 +93,93 @@ DiskStatus_t readSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_
  */
 DiskStatus_t writeSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_t data);
 
+/**
+ * @brief Reads a run of consecutive sectors (Sector, then cylinder, then track) into a word buffer.
+ * The sectors are contiguous in DISK, so the run is copied in one pass without per-sector logging.
+ *
+ * @param track Track of the first sector.
+ * @param cylinder Cylinder of the first sector.
+ * @param sector First sector.
+ * @param buffer Receives count words.
+ * @param count Sectors to read.
+ * @return DISK_SUCCESS, or DISK_ERR_OUT_OF_BOUNDS (Nothing read) if the run leaves the disk.
+ */
+DiskStatus_t readSectors(uint8_t track, uint8_t cylinder, uint8_t sector, word* buffer, int count);
+
+/**
+ * @brief Writes a word buffer to a run of consecutive sectors, in one pass.
+ *
+ * @param track Track of the first sector.
+ * @param cylinder Cylinder of the first sector.
+ * @param sector First sector.
+ * @param data Words to store.
+ * @param count Sectors to write.
+ * @return DISK_SUCCESS, or DISK_ERR_OUT_OF_BOUNDS (Nothing written) if the run leaves the disk.
+ */
+DiskStatus_t writeSectors(uint8_t track, uint8_t cylinder, uint8_t sector, const word* data, int count);
+
+/**
+ * @brief Replaces the timing parameters (The defaults come from the DISK_*_CYCLES macros).
+ * A sectorCycles of 0 is raised to 1 so the platter keeps turning.
+ */
+void diskSetTiming(const DiskTiming_t* timing);
+
+/**
+ * @brief Copies the timing parameters in use.
+ */
+void diskGetTiming(DiskTiming_t* outTiming);
+
+/**
+ * @brief Cycles to move the head between two positions.
+ * Free when the head does not move; otherwise the settle time plus the track and cylinder distances.
+ */
+uint64_t diskSeekCycles(uint8_t fromTrack, uint8_t fromCylinder, uint8_t toTrack, uint8_t toCylinder);
+
+/**
+ * @brief Cycles to wait from a virtual time until a sector starts passing under the head.
+ * The platter angle is a function of the virtual clock, so the wait is deterministic.
+ */
+uint64_t diskRotationCycles(uint64_t now, uint8_t sector);
+
+/**
+ * @brief Cycles to serve an extent: seek from the head, rotational delay, then the transfer.
+ * Running onto the next cylinder mid-transfer costs one cylinder step, and running
+ * onto the next track costs one track step plus the DISK_CYLINDERS - 1 cylinder steps
+ * back to cylinder 0 (no settle time). The next cylinder starts at sector 0, which
+ * follows sector DISK_SECTORS - 1 without a rotational wait.
+ *
+ * @param headTrack Track under the head before the access.
+ * @param headCylinder Cylinder under the head before the access.
+ * @param extent First sector and number of sectors (length) to transfer.
+ * @param now Virtual cycle at which the access starts.
+ * @return Total cycles until the last sector is transferred.
+ */
+uint64_t diskExtentCycles(uint8_t headTrack, uint8_t headCylinder, const DMASegment_t* extent, uint64_t now);
+
+/**
+ * @brief Backs the disk with an image file (Call while the DMA is idle).
+ * A missing or empty file is created with a fresh header and zeroed sectors;
+ * an existing one must carry the same version and geometry. The contents of
+ * the image replace the ones in use.
+ *
+ * @param path Host path of the image.
+ * @return DISK_SUCCESS, or DISK_ERR_IMAGE leaving the current backing in place.
+ */
+DiskStatus_t diskAttachImage(const char* path);
+
+/**
+ * @brief Flushes the attached image to the host file (No-op without an image).
+ */
+void diskSync(void);
+
+/**
+ * @brief Flushes and unmaps the image; its contents stay in use in memory.
+ */
+void diskDetachImage(void);
+
+/**
+ * @brief Returns true while an image file backs the disk.
+ */
+bool diskIsPersistent(void);
+
 #endif // DISK_H
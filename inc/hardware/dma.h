@@ -2,14 +2,32 @@
  * @file dma.h
  * @brief Direct Memory Access (DMA) controller simulation.
  *
- * Handles high-speed data transfers between memory and I/O devices
+ * Handles high-speed data transfers between memory and I/O devices.
+ * Requests are descriptors in a queue of DMA_QUEUE_DEPTH slots: SDMAON
+ * submits one, the worker thread serves them in submission order, and the
+ * kernel reaps the completions tagged with the owner PID.
  *
- * @version 1.2
+ * A descriptor is a burst: a scatter-gather list of (disk extent, RAM range)
+ * pairs that pays one seek per extent plus a streaming cost per word, and
+ * completes once when the whole list is done. The I/O scheduler
+ * (iosched.h) picks which queued descriptor is served next, and the disk
+ * timing model (disk.h) prices it in virtual cycles: the completion is
+ * posted once the CPU virtual clock reaches the end of the access. No
+ * interrupt is raised in the running process, which is not the owner.
+ *
+ * @version 1.9
  */
 #ifndef DMA_H
 #define DMA_H
 
+#include <stdbool.h>
+#include <pthread.h>
+
 #include "../../inc/definitions.h"
+#include "../../inc/hardware/cpu.h"
+
+#define DMA_CLOCK_POLL_US   100     /** Host wait between checks of the virtual clock while a burst is in flight. */
+#define DISK_TOTAL_SECTORS  (DISK_TRACKS * DISK_CYLINDERS * DISK_SECTORS)  /** Sectors addressable by an extent. */
 
 /** @brief Status codes for DMA operations
  * Indicates success or cause of failure of DMA operations.
@@ -17,8 +35,59 @@
 typedef enum {
 	DMA_SUCCESS = 0,           /**< DMA operation completed successfully. */
 	DMA_ERR_INVALID_GEOM = 1,  /**< Invalid memory disk geometry specified. */
+	DMA_ERR_QUEUE_FULL = 2,    /**< Every descriptor slot is in use. */
 } DMAStatus_t;
 
+/**
+ * @brief Linear sector index of the first sector of an extent.
+ * Consecutive indexes follow sector, then cylinder, then track.
+ */
+static inline int dmaSegmentStart(const DMASegment_t* segment) {
+	return (segment->track * DISK_CYLINDERS + segment->cylinder) * DISK_SECTORS + segment->sector;
+}
+
+/**
+ * @brief Checks that an extent is not empty and fits in the disk and in physical RAM.
+ * Protection against the RB/RL window is the caller's job.
+ */
+static inline bool dmaSegmentIsValid(const DMASegment_t* segment) {
+	if (segment->length == 0) return false;
+	if (segment->track >= DISK_TRACKS || segment->cylinder >= DISK_CYLINDERS || segment->sector >= DISK_SECTORS) return false;
+	if (dmaSegmentStart(segment) + segment->length > DISK_TOTAL_SECTORS) return false;
+	return segment->memAddr >= 0 && segment->memAddr + segment->length <= RAM_SIZE;
+}
+
+/** @brief Total words moved by a descriptor across all its extents. */
+static inline int dmaBurstWords(const DMARequest_t* request) {
+	int words = 0;
+	for (int i = 0; i < request->segmentCount; i++) words += request->segments[i].length;
+	return words;
+}
+
+/**
+ * @brief Places a filled descriptor in a free queue slot (BUS_LOCK held).
+ * Stamps the state and sequence number and wakes the worker.
+ *
+ * @param request Descriptor with the direction, extents and owner already set.
+ * @return The slot index, or -1 if the queue is full.
+ */
+static inline int dmaEnqueueLocked(const DMARequest_t* request) {
+	for (int i = 0; i < DMA_QUEUE_DEPTH; i++) {
+		if (DMA.queue[i].state != DMA_REQ_FREE) continue;
+
+		DMA.queue[i] = *request;
+		DMA.queue[i].status = 0;
+		DMA.queue[i].state = DMA_REQ_QUEUED;
+		DMA.queue[i].sequence = DMA.nextSequence++;
+		DMA.queue[i].submitCycle = cpuGetVirtualCycles();
+		DMA.outstanding++;
+		DMA.pending = true;
+		pthread_cond_signal(&DMA_COND);
+		return i;
+	}
+	return -1;
+}
+
 /**
  * @brief Initializes the DMA controller.
  * Once initialized, DMA sleeps at cond var pthread_cond_wait until a transfer is requested.
@@ -27,7 +96,66 @@ void *dmaInit(void*);
 
 /**
  * @brief Resets the DMA controller to its initial state.
+ * Clears the programming registers and drops every queued descriptor.
  */
 void dmaReset(void);
 
+/**
+ * @brief Kernel-side submission of a scatter-gather burst.
+ * The extents are served in order and complete once; the owner is reported by
+ * dmaReapCompletion().
+ *
+ * @param segments Extents to transfer (physical RAM addresses).
+ * @param count Number of extents, 1 to DMA_MAX_SEGMENTS.
+ * @param ioDirection 0: Read from Disk, 1: Write to Disk.
+ * @param ownerPid PID the completion is reported to.
+ * @param outSlot Receives the descriptor index on success (may be NULL).
+ * @return DMA_SUCCESS, DMA_ERR_INVALID_GEOM for a bad list, or DMA_ERR_QUEUE_FULL.
+ */
+DMAStatus_t dmaSubmitBurst(const DMASegment_t* segments, int count, uint8_t ioDirection, int ownerPid, int* outSlot);
+
+/**
+ * @brief Virtual cycle at which the disk becomes idle.
+ * The kernel jumps the clock there when no process can run.
+ */
+uint64_t dmaBusyUntil(void);
+
+/**
+ * @brief Takes the oldest finished transfer out of the queue.
+ * The descriptor slot becomes free for a new SDMAON.
+ *
+ * @param outRequest Receives the finished descriptor (ownerPid and status tag the completion).
+ * @return true if a completion was reaped, false if none is waiting.
+ */
+bool dmaReapCompletion(DMARequest_t* outRequest);
+
+/**
+ * @brief Checks whether a process has a descriptor queued, in flight or not yet reaped.
+ *
+ * @param pid The owner PID.
+ * @return true if any descriptor in the queue belongs to the process.
+ */
+bool dmaHasRequest(int pid);
+
+/**
+ * @brief Copies the programming registers (SDMAP..SDMAM, SDMAL) for a context switch.
+ *
+ * @param outRegisters Receives the direction and, in segments[0], the disk position, memory address and length.
+ */
+void dmaSaveRegisters(DMARequest_t* outRegisters);
+
+/**
+ * @brief Restores the programming registers of the process being dispatched.
+ *
+ * @param registers Registers previously saved with dmaSaveRegisters.
+ * @param pid PID that will own the descriptors submitted from now on.
+ */
+void dmaLoadRegisters(const DMARequest_t* registers, int pid);
+
+/**
+ * @brief Words written to a disk track by DMA transfers since boot.
+ * Lets the kernel tell whether a program file may have changed under a cached copy.
+ */
+uint64_t dmaDiskWrites(uint8_t track);
+
 #endif // DMA_H
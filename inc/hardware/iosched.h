@@ -0,0 +1,145 @@
+/**
+ * @file iosched.h
+ * @brief Disk I/O scheduler in front of the DMA worker.
+ *
+ * Tracks the disk head position and decides which queued DMA descriptor is
+ * served next under a selectable policy (FIFO, SSTF, SCAN or C-LOOK). The
+ * head moves along a single axis of cylinder positions, ordered like the
+ * disk layout (cylinder, then track). Service times, in virtual cycles, are
+ * recorded per policy so runs under different policies can be compared.
+ *
+ * @version 1.1
+ */
+
+#ifndef IOSCHED_H
+#define IOSCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../../inc/definitions.h"
+
+#define IOSCHED_POSITIONS      (DISK_TRACKS * DISK_CYLINDERS)  /** Head positions along the seek axis. */
+#define IOSCHED_SAMPLE_WINDOW  1024                            /** Most recent service times kept per policy for the percentiles. */
+
+/** @brief Order in which queued descriptors are served. */
+typedef enum {
+	IOSCHED_FIFO  = 0,  /**< Submission order */
+	IOSCHED_SSTF  = 1,  /**< Shortest seek from the current head position first */
+	IOSCHED_SCAN  = 2,  /**< Elevator: sweeps to the edge of the disk, then reverses */
+	IOSCHED_CLOOK = 3,  /**< Sweeps upwards only, jumping back to the lowest request */
+	IOSCHED_POLICY_COUNT
+} IOSchedPolicy_t;
+
+/** @brief Disk head state used by the policies. */
+typedef struct {
+	int position;       /**< Current head position (0 to IOSCHED_POSITIONS - 1) */
+	int direction;      /**< Sweep direction for SCAN: 1 upwards, -1 downwards */
+	int pendingTravel;  /**< Positions crossed by a SCAN sweep to the edge, charged on the next seek */
+} DiskHead_t;
+
+/** @brief Service time summary of one policy. */
+typedef struct {
+	unsigned long completed;  /**< Descriptors served */
+	uint64_t meanCycles;      /**< Mean virtual cycles from submission to completion */
+	uint64_t p95Cycles;       /**< 95th percentile over the sample window */
+	uint64_t p99Cycles;       /**< 99th percentile over the sample window */
+	uint64_t maxCycles;       /**< Slowest descriptor */
+	uint64_t headTravel;      /**< Head positions crossed while serving */
+} IOSchedReport_t;
+
+/**
+ * @brief Head position of a disk address on the seek axis.
+ */
+static inline int ioschedPosition(uint8_t track, uint8_t cylinder) {
+	return track * DISK_CYLINDERS + cylinder;
+}
+
+/**
+ * @brief Picks the next descriptor for a policy and head state.
+ * Only QUEUED descriptors are considered; ties are broken by submission order.
+ * SCAN may reverse the head and record the sweep to the edge in pendingTravel.
+ *
+ * @param queue Descriptor slots.
+ * @param depth Number of slots.
+ * @param policy Scheduling policy.
+ * @param head Head state, updated by SCAN when it reverses.
+ * @return The slot index, or -1 if nothing is queued.
+ */
+int ioschedPick(const DMARequest_t* queue, int depth, IOSchedPolicy_t policy, DiskHead_t* head);
+
+/**
+ * @brief Picks the next descriptor with the active policy and the controller head (BUS_LOCK held).
+ *
+ * @param queue Descriptor slots.
+ * @param depth Number of slots.
+ * @param outPolicy Receives the policy that made the choice, for ioschedRecordService.
+ * @return The slot index, or -1 if nothing is queued.
+ */
+int ioschedNextRequest(const DMARequest_t* queue, int depth, IOSchedPolicy_t* outPolicy);
+
+/**
+ * @brief Moves the controller head to a position.
+ * @return Positions crossed, including a pending SCAN sweep to the edge.
+ */
+int ioschedSeek(int position);
+
+/**
+ * @brief Puts the head back at position 0, sweeping upwards.
+ */
+void ioschedResetHead(void);
+
+/**
+ * @brief Returns the current head position.
+ */
+int ioschedGetHead(void);
+
+/**
+ * @brief Copies the controller head, including a SCAN sweep to the edge not yet charged.
+ */
+void ioschedGetHeadState(DiskHead_t* outHead);
+
+/**
+ * @brief Selects the policy for the descriptors picked from now on.
+ */
+void ioschedSetPolicy(IOSchedPolicy_t policy);
+
+/**
+ * @brief Returns the active policy.
+ */
+IOSchedPolicy_t ioschedGetPolicy(void);
+
+/**
+ * @brief Returns the lowercase name of a policy ("fifo", "sstf", "scan", "clook").
+ */
+const char* ioschedPolicyName(IOSchedPolicy_t policy);
+
+/**
+ * @brief Looks up a policy by its name.
+ *
+ * @param name Policy name as printed by ioschedPolicyName.
+ * @param outPolicy Receives the policy.
+ * @return true if the name is known.
+ */
+bool ioschedParsePolicy(const char* name, IOSchedPolicy_t* outPolicy);
+
+/**
+ * @brief Records a served descriptor under the policy that picked it.
+ *
+ * @param policy Policy active when the descriptor was picked.
+ * @param serviceCycles Virtual cycles from submission to completion.
+ * @param travel Head positions crossed to serve it.
+ */
+void ioschedRecordService(IOSchedPolicy_t policy, uint64_t serviceCycles, int travel);
+
+/**
+ * @brief Summarises the service times recorded for a policy.
+ */
+void ioschedGetReport(IOSchedPolicy_t policy, IOSchedReport_t* outReport);
+
+/**
+ * @brief Clears the service time statistics of every policy.
+ */
+void ioschedResetStats(void);
+
+#endif // IOSCHED_H
@@ -5,7 +5,11 @@
  * Handles secure access to the shared memory array, including address translation
  * (Logical -> Physical), protection (Base/Limit registers), and thread safety.
  *
- * @version 2.0
+ * In User Mode, logical [0, TL) is the shared text segment at TB, which can be
+ * read and executed but not written; logical TL onwards is the private
+ * partition starting at RB. With TL = 0 the whole space is the partition.
+ *
+ * @version 2.4
  */
 
 #ifndef MEMORY_H
@@ -20,10 +24,20 @@
 typedef enum {
     MEM_SUCCESS           = 0, /**< Operation completed successfully. */
     MEM_ERR_OUT_OF_BOUNDS = 1, /**< Bus Error: Physical address > RAM_SIZE. */
-    MEM_ERR_PROTECTION    = 2, /**< SegFault: User tried to access outside RB/RL. */
+    MEM_ERR_PROTECTION    = 2, /**< SegFault: User tried to access outside RB/RL or to write its shared text. */
     MEM_ERR_INVALID_DATA  = 3  /**< Data corruption: Value exceeds 8-digit limit. */
 } MemoryStatus_t;
 
+/**
+ * @brief Hit/Miss counters of the predecoded instruction cache.
+ * Used to verify that hot code is being served without a bus round-trip.
+ */
+typedef struct {
+    uint64_t hits;           /**< Fetches served directly from a predecoded entry. */
+    uint64_t misses;         /**< Fetches that had to read RAM and decode the word. */
+    uint64_t invalidations;  /**< Predecoded entries discarded because their word was written. */
+} DecodeCacheStats_t;
+
 /**
  * @brief Initializes the memory subsystem.
  * Creates the mutex for bus arbitration.
@@ -48,6 +62,58 @@ MemoryStatus_t readMemory(address logicalAddr, word* outData);
  */
 MemoryStatus_t writeMemory(address logicalAddr, word data);
 
+/**
+ * @brief Memory read for callers that already hold the BUS_LOCK.
+ *
+ * Same translation, protection and logging as readMemory(). Lets a multi-word
+ * operation (e.g. a fused instruction sequence) arbitrate the bus only once.
+ */
+MemoryStatus_t readMemoryLocked(address logicalAddr, word* outData);
+
+/**
+ * @brief Memory write for callers that already hold the BUS_LOCK.
+ * Same validation, translation and protection as writeMemory().
+ */
+MemoryStatus_t writeMemoryLocked(address logicalAddr, word data);
+
+/**
+ * @brief Instruction fetch through the predecoded instruction cache.
+ *
+ * Translates and validates the address exactly like readMemory(). If the physical
+ * word was already decoded (and not written since), it is returned without taking
+ * the BUS_LOCK. Otherwise the word is read from RAM, decoded and cached.
+ *
+ * @param logicalAddr Address requested by the CPU (Relative to process).
+ * @param outData Pointer where the raw instruction word will be stored.
+ * @param outInstruction Pointer where the decoded instruction will be stored.
+ * @return MemoryStatus_t result code.
+ */
+MemoryStatus_t fetchInstruction(address logicalAddr, word* outData, Instruction_t* outInstruction);
+
+/**
+ * @brief Silent lookahead through the predecoded instruction cache.
+ *
+ * Returns the word at a logical address (and its decoded form) without logging
+ * faults or updating the cache counters. Used by the CPU to match instruction
+ * sequences ahead of the PC; a failed peek simply means "no match".
+ *
+ * @param logicalAddr Address requested by the CPU (Relative to process).
+ * @param outData Pointer where the raw instruction word will be stored.
+ * @param outInstruction Pointer where the decoded instruction will be stored.
+ * @return MemoryStatus_t result code.
+ */
+MemoryStatus_t peekInstruction(address logicalAddr, word* outData, Instruction_t* outInstruction);
+
+/**
+ * @brief Discards every predecoded entry and clears the cache counters.
+ */
+void decodeCacheFlush(void);
+
+/**
+ * @brief Returns a snapshot of the predecoded instruction cache counters.
+ */
+DecodeCacheStats_t decodeCacheGetStats(void);
+
 /**
  * @brief Direct Physical Memory Read (Bypasses MMU protection).
  * Used exclusively by DMA to access pre-validated physical addresses.
@@ -60,6 +126,18 @@ MemoryStatus_t dmaReadMemory(address physAddr, word* outData);
  */
 MemoryStatus_t dmaWriteMemory(address physAddr, word data);
 
+/**
+ * @brief Direct Physical Memory Block Write (Bypasses MMU protection).
+ * Copies a run of words in one bus transaction and logs it once, for the
+ * kernel program loader. The whole range must lie inside RAM.
+ *
+ * @param physAddr First physical address written.
+ * @param data Words to copy.
+ * @param count Number of words.
+ * @return MEM_SUCCESS, or MEM_ERR_OUT_OF_BOUNDS (nothing is written).
+ */
+MemoryStatus_t dmaWriteBlock(address physAddr, const word* data, int count);
+
 /**
  * @brief Resets the entire memory to its initial state (all zeros).
  * Used during system restart to ensure a clean slate.
@@ -6,7 +6,7 @@
  * and the main functions to initialize, start, and manage the operating
  * system's lifecycle and background execution thread.
  *
- * @version 1.1
+ * @version 1.7
  */
 
 #ifndef CORE_H
@@ -14,6 +14,18 @@
 
 #include "../definitions.h"
 
+#define CPU_SLICE_MAX_INSTRUCTIONS 64      /** Instructions a process may run per slice when its timer does not expire first. */
+#define CPU_DEFAULT_CLOCK_IPS      4       /** Default clock rate in instructions per second (Visible demo speed). */
+#define CPU_CLOCK_TURBO            0       /** Clock rate value that disables throttling. */
+#define CPU_PACING_TICKS_PER_SEC   100     /** Pacing granularity: the worker sleeps at most this often per second. */
+#define CPU_MAX_CLOCK_LAG_NS       100000000L  /** Lag after which the paced clock stops catching up (avoids bursts). */
+#define CPU_IDLE_POLL_US           1000    /** Wait between scheduler polls while no process is ready. */
+#define CPU_IDLE_TICK_NS           100000000L  /** Clock tick while no process is ready: SVC 4 sleepers age once per interval, not per poll. */
+
+#ifndef OS_LOAD_WORKERS
+#define OS_LOAD_WORKERS            4       /** Threads (the caller included) that read host files for createProcesses. */
+#endif
+
 /**
  * @brief Initializes the core components of the Operating System.
  *
@@ -42,6 +54,23 @@ OSStatus_t osStart(void);
  */
 OSStatus_t osStop(void);
 
+/**
+ * @brief Sets the speed of the simulated clock.
+ *
+ * The CPU thread runs instructions in batches and sleeps until the absolute
+ * deadline of each batch, so the average rate stays exact regardless of the
+ * host speed. Batches are sized to CPU_PACING_TICKS_PER_SEC, which keeps
+ * slow rates stepping one instruction at a time.
+ *
+ * @param instructionsPerSecond Target rate, or CPU_CLOCK_TURBO to run at full host speed.
+ */
+void osSetClockRate(unsigned long instructionsPerSecond);
+
+/**
+ * @brief Returns the current clock rate (CPU_CLOCK_TURBO when unthrottled).
+ */
+unsigned long osGetClockRate(void);
+
 /**
  * @brief Finds the first available index in the Process Table.
  *
@@ -52,6 +81,16 @@ OSStatus_t osStop(void);
  */
 int getFreePCBIndex(void);
 
+/**
+ * @brief Tells whether the kernel leaves the disk alone.
+ *
+ * True when every PCB is FINISHED and no DMA descriptor is queued or in
+ * flight, so the console may rewrite the disk in place (e.g. to defragment it).
+ *
+ * @return bool true if no process is alive and the DMA queue is empty.
+ */
+bool osIsIdle(void);
+
 /**
  * @brief Creates a new process from an executable file.
  *
@@ -64,7 +103,23 @@ int getFreePCBIndex(void);
  */
 OSStatus_t createProcess(char* progName);
 
+/**
+ * @brief Creates one process per file, reading the host files in parallel.
+ *
+ * Files not yet in the VFS are parsed concurrently by up to OS_LOAD_WORKERS
+ * threads, which only touch the host filesystem. Disk placement, PCBs and
+ * RAM are then committed on the calling thread in argument order, so the
+ * catalog, the PIDs and the RAM blocks match a loop of createProcess calls.
+ *
+ * @param progNames The filenames of the programs, in queue order.
+ * @param count Number of files.
+ * @param results Receives the status of each file.
+ * @return OSStatus_t OS_SUCCESS when every process was created, otherwise the first error.
+ */
+OSStatus_t createProcesses(char** progNames, int count, OSStatus_t* results);
+
 extern int currentActiveProcess;  /**< @brief Index of the currently active process in the Process Table. */
 extern bool osYield;              /**< @brief Flag to request a context switch from the CPU to the OS. */
+extern bool osDMAWait;            /**< @brief Set with osYield by SDMAON: the running process must block until the DMA is idle. */
 
 #endif /* CORE_H */
@@ -0,0 +1,105 @@
+/**
+ * @file imagecache.h
+ * @brief Cache of executable images for relaunching programs without the disk.
+ *
+ * Each entry belongs to one catalog entry (FileMeta_t.fileId) and holds the
+ * words of the program, ready for a single block copy into RAM, together with
+ * the initial CPU context relative to a RAM block and a shared text at 0. A
+ * hit only needs a block and that copy: no sector is read and no context is
+ * rebuilt.
+ *
+ * An entry is only served while the file keeps the same extents and the
+ * caller's write stamp (words written by DMA to its tracks) is unchanged, so
+ * a defragmented or overwritten file is read again. Entries are evicted least
+ * recently used first to stay within a budget of cached words.
+ *
+ * Used from the kernel (console) thread only.
+ *
+ * @version 1.2
+ */
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../../inc/definitions.h"
+#include "../../inc/kernel/vfs.h"
+
+#ifndef IMAGE_CACHE_BUDGET_WORDS
+#define IMAGE_CACHE_BUDGET_WORDS  (4 * (RAM_SIZE - OS_RESERVED_SIZE))  /** Default words of program images kept on the host. */
+#endif
+#define IMAGE_CACHE_MAX_ENTRIES   VFS_MAX_FILES                         /** Images kept at most, one per catalog entry. */
+
+/**
+ * @brief A cached program, ready to be placed in a RAM block.
+ */
+typedef struct {
+	uint32_t fileId;                       /**< Catalog entry the image was read from */
+	int extentCount;                       /**< Extents of the file when it was read */
+	VFSExtent_t extents[VFS_MAX_EXTENTS];
+	uint64_t writeStamp;                   /**< Caller's write stamp of the file when it was read */
+	char programName[256];                 /**< Internal name of the program */
+	int wordCount;                         /**< Words in the image */
+	int requiredWords;                     /**< Words of the private block the process needs */
+	CPU_t context;                         /**< Initial context for RB = TB = 0: add the bases to RB and TB, set RL and SP from the block */
+	word* words;                           /**< The image */
+	uint64_t lastUse;                      /**< Lookup clock of the last hit or insert, for LRU */
+} CachedImage_t;
+
+/**
+ * @brief Counters of the image cache.
+ */
+typedef struct {
+	uint64_t hits;         /**< Launches served from the cache */
+	uint64_t misses;       /**< Launches that had to read the disk */
+	uint64_t evictions;    /**< Images dropped to stay within the budget */
+	uint64_t stale;        /**< Images dropped because their file moved or was written */
+	int entries;           /**< Images currently cached */
+	int usedWords;         /**< Words currently cached */
+	int budgetWords;       /**< Words allowed */
+} ImageCacheStats_t;
+
+/**
+ * @brief Looks up the image of a catalog entry.
+ *
+ * A cached image whose extents or write stamp no longer match the file is
+ * dropped and reported as a miss.
+ *
+ * @param meta Current metadata of the file.
+ * @param writeStamp Current write stamp of the file.
+ * @return The image (valid until the next call into the cache), or NULL on a miss.
+ */
+const CachedImage_t* imageCacheLookup(const FileMeta_t* meta, uint64_t writeStamp);
+
+/**
+ * @brief Caches the image of a catalog entry, evicting the least recently used ones to make room.
+ *
+ * An image larger than the whole budget is not cached.
+ *
+ * @param meta Metadata of the file the words were read from.
+ * @param writeStamp Write stamp of the file when the words were read.
+ * @param words The program words (meta->wordCount of them); they are copied.
+ * @param requiredWords Words of the private block the process needs.
+ * @param context Initial context for RB = TB = 0 (TL is the shared text length).
+ * @return true if the image was cached.
+ */
+bool imageCacheInsert(const FileMeta_t* meta, uint64_t writeStamp, const word* words, int requiredWords, const CPU_t* context);
+
+/**
+ * @brief Changes the budget, evicting least recently used images until the cache fits.
+ */
+void imageCacheSetBudget(int budgetWords);
+
+/**
+ * @brief Drops every image and clears the counters.
+ */
+void imageCacheClear(void);
+
+/**
+ * @brief Returns a snapshot of the cache counters.
+ */
+ImageCacheStats_t imageCacheGetStats(void);
+
+#endif // IMAGECACHE_H
@@ -2,62 +2,188 @@
  * @file: mmu.h
  * @brief: Memory Management Unit (MMU) definitions and function prototypes.
  *
- * This header defines the interface for the MMU subsystem, including functions 
- * for initializing the MMU, calculating required memory blocks, allocating and 
- * freeing memory, and macros for calculating base and limit register values.
+ * This header defines the interface for the MMU subsystem: a buddy allocator
+ * over the user region of RAM. Each request is rounded up to a power-of-two
+ * block of at least MMU_MIN_BLOCK_SIZE words, taken by splitting the smallest
+ * free block that fits; a freed block is merged with its buddy for as long as
+ * the buddy is free too. The region is laid out as the largest aligned blocks
+ * that fit (1024 + 512 + 128 + 32 for the 1700 user words and 16-word blocks),
+ * so a tail smaller than the minimum block is never handed out. A request no
+ * single free block holds takes a span of adjacent, whole, free top-level
+ * blocks instead, so the largest allocation is the whole region (1696 words,
+ * a program of 1646 with the stack), not just the largest block.
  *
- * @version 1.1
+ * It also keeps the shared text segments: read-only copies of a program's
+ * code, placed once in their own block and mapped at logical 0 (TB/TL) by
+ * every process running that program, which then only needs a private block
+ * for its data and stack.
+ *
+ * @version 1.5
  */
 
 #ifndef MMU_H
 #define MMU_H
 
+#include <stdint.h>
+
 #include "../../inc/definitions.h"
 
-#define PARTITION_SIZE ((RAM_SIZE - OS_RESERVED_SIZE) / MAX_PROCESSES)                    /**< @brief Size of each partition in words. */
-#define GET_BASE_REGISTER(startBlock) (OS_RESERVED_SIZE + (startBlock * PARTITION_SIZE))  /**< @brief Calculates the base register value for a given block index. */
-#define GET_LIMIT_REGISTER(rb, blockCount) (rb + (blockCount * PARTITION_SIZE) - 1)       /**< @brief Returns the limit register value for a given block index. */
+#define MMU_USER_WORDS (RAM_SIZE - OS_RESERVED_SIZE)  /**< @brief Words of the user region managed by the allocator. */
+#ifndef MMU_MIN_BLOCK_SIZE
+#define MMU_MIN_BLOCK_SIZE 16                         /**< @brief Default smallest block in words, a power of two (-DMMU_MIN_BLOCK_SIZE=N). */
+#endif
+#define MMU_MAX_ORDERS 16                             /**< @brief Block sizes the allocator can track, from the minimum block up. */
+
+/**
+ * @brief A block of the user region, as listed by mmuListBlocks().
+ */
+typedef struct {
+	int base;            /**< Physical address of the first word */
+	int size;            /**< Words in the block */
+	bool used;           /**< Allocated to a process or a shared text */
+	int requestedWords;  /**< Words asked for when it was allocated (0 if free) */
+} MMUBlock_t;
+
+/**
+ * @brief Occupation of the user region.
+ */
+typedef struct {
+	int minBlockSize;     /**< Smallest block handed out */
+	int totalWords;       /**< Words the allocator can hand out */
+	int freeWords;        /**< Words in free blocks */
+	int usedWords;        /**< Words in allocated blocks */
+	int requestedWords;   /**< Words asked for by the allocated blocks: usedWords minus this is the internal fragmentation */
+	int largestFree;      /**< Largest single allocation that would succeed */
+	int usedBlocks;       /**< Allocated blocks */
+	int freeBlocks;       /**< Free blocks */
+} MMUStats_t;
 
 /**
  * @brief Initializes the MMU subsystem.
  *
- * Initializes all the partition management bitmap entries to indicate they're all free.
+ * Frees the whole user region and drops every shared text segment.
  */
 void mmuInit(void);
 
 /**
- * @brief Calculates the number of memory blocks required for a given program's word count.
+ * @brief Changes the smallest block the allocator hands out.
+ *
+ * Only allowed while nothing is allocated; the region is laid out again.
+ *
+ * @param words New minimum block size, a power of two no larger than the user region.
+ * @return OS_SUCCESS, or OS_ERR_MEMORY if the size is invalid or memory is in use.
+ */
+OSStatus_t mmuSetMinBlockSize(int words);
+
+/**
+ * @brief Calculates the words a process needs for a program of the given size.
  *
- * Calculates the total memory needed by adding the program's word count to the
- * minimum stack size, then determines how many partitions (blocks) are required
- * to accommodate that total. If the total exceeds the maximum memory available,
- * it returns 0.
+ * Adds the minimum stack size to the program's word count. If the program is
+ * empty or the total could never be allocated, it returns 0.
  *
  * @param wordCount The program's number of words.
- * @return The number of memory blocks (partitions) required to accommodate the request.
+ * @return The words to request from allocateMemory(), or 0.
+ */
+int calculateRequiredWords(int wordCount);
+
+/**
+ * @brief Returns the size of the block an allocation of the given words would take.
+ *
+ * @param requiredWords Words to allocate.
+ * @return The block size (a power of two, at least the minimum block), the size of the
+ *         smallest span of top-level blocks for a request larger than any block, or 0
+ *         if not even the whole region is large enough.
  */
-int calculateRequiredBlocks(int wordCount);
+int buddyBlockSize(int requiredWords);
 
 /**
- * @brief Allocates memory blocks for a program.
+ * @brief Allocates a block for a program.
  *
- * Searches for the first range of required number of contiguous free blocks in
- * the partition bitmap and marks them as occupied.
+ * Takes the lowest addressed free block of the smallest size that fits,
+ * splitting a larger one in halves when none of that size is free. If no
+ * free block is large enough, the smallest run of adjacent top-level blocks
+ * that are free and unsplit is taken as one span, freed as a whole.
  *
- * @param requiredBlocks The number of contiguous blocks needed for the program.
- * @return The index of the first allocated block, or -1 if allocation fails.
+ * @param requiredWords Words needed by the program.
+ * @return The physical base of the block (its RB), or -1 if allocation fails.
  */
-int allocateMemory(int requiredBlocks);
+int allocateMemory(int requiredWords);
 
 /**
- * @brief Frees previously allocated memory blocks.
+ * @brief Returns the size of an allocated block.
  *
- * Marks the specified blocks as free in the partition bitmap.
+ * @param base Physical base returned by allocateMemory().
+ * @return Words in the block (RL = base + size - 1), or 0 if no block is allocated there.
+ */
+int allocatedSize(int base);
+
+/**
+ * @brief Frees a previously allocated block, merging it with its free buddies.
  *
- * @param startBlock The index of the first block to free.
- * @param blockCount The number of contiguous blocks to free.
+ * @param base Physical base returned by allocateMemory().
  * @return OSStatus_t indicating success or failure of the operation.
  */
-OSStatus_t freeMemory(int startBlock, int blockCount);
+OSStatus_t freeMemory(int base);
+
+/**
+ * @brief Returns the occupation of the user region.
+ */
+MMUStats_t mmuGetStats(void);
+
+/**
+ * @brief Lists the free and allocated blocks in address order.
+ *
+ * @param blocks Array receiving the blocks.
+ * @param maxBlocks Capacity of the array.
+ * @return The number of blocks written.
+ */
+int mmuListBlocks(MMUBlock_t* blocks, int maxBlocks);
+
+/**
+ * @brief A program's code placed once in RAM and shared by its processes.
+ */
+typedef struct {
+	bool used;            /**< Slot holds a segment */
+	uint32_t fileId;      /**< Catalog entry the code was read from */
+	uint64_t writeStamp;  /**< Write stamp of the file when it was read (see core.c) */
+	int length;           /**< Words of code (the TL of its processes) */
+	int base;             /**< Physical base of the block holding the code (the TB of its processes) */
+	int size;             /**< Words in that block */
+	int refCount;         /**< Processes mapping the segment */
+} SharedText_t;
+
+extern SharedText_t SHARED_TEXTS[MAX_PROCESSES];  /**< @brief Shared text segments, indexed by PCB_t.textSegment. */
+
+/**
+ * @brief Words at the start of a program that it never writes, so they can be shared read-only.
+ *
+ * The text ends at the lowest direct STR operand and immediate SDMAM target.
+ * An indexed STR or a direct or indexed SDMAM can reach any address, so any
+ * of them disables sharing. Data words are scanned too: one that decodes as
+ * a store only shortens the text, or disables sharing.
+ *
+ * @param words The program.
+ * @param wordCount Words in the program.
+ * @return The text length, 0 if the program cannot share its code.
+ */
+int sharedTextLength(const word* words, int wordCount);
+
+/**
+ * @brief Maps the shared text of a file, placing it in RAM if no process has it yet.
+ *
+ * @param fileId Catalog entry of the program.
+ * @param writeStamp Write stamp of the file; a segment read before a later write is not reused.
+ * @param length Words of code.
+ * @param outCreated Set to true when a new segment was allocated: the caller must copy the code to it.
+ * @return The segment index (its reference count already includes the caller), or -1 without a free block.
+ */
+int acquireSharedText(uint32_t fileId, uint64_t writeStamp, int length, bool* outCreated);
+
+/**
+ * @brief Drops one reference to a shared text segment, freeing its block with the last one.
+ *
+ * @param index Segment index returned by acquireSharedText.
+ */
+void releaseSharedText(int index);
 
 #endif // MMU_H
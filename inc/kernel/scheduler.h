@@ -8,7 +8,14 @@
 /**
  * @brief Handles the timer interrupt (Quantum expiration).
  * Will be responsible for context switching between READY processes.
+ * Each call is one clock tick for the processes sleeping with SVC 4.
  */
 void schedulerTick(void);
 
+/**
+ * @brief Reaps DMA completions and dispatches a READY process, without a clock tick.
+ * Used by the idle loop between ticks: sleeping processes do not age.
+ */
+void schedulerPoll(void);
+
 #endif // SCHEDULER_H
@@ -5,7 +5,24 @@
  * Declares data structures and functions to manage the Virtual File System (VFS),
  * read program metadata, and store them in the Virtual Hardware.
  *
- * @version 1.3
+ * The catalog and the free-space pointer are kept in the first sectors of
+ * the virtual disk, in two copies of a superblock and one record per file.
+ * Every change is written whole to the copy not in use, its superblock last
+ * with the next generation number, and vfsMount() reads back the valid copy
+ * of the highest generation: a change cut short leaves the previous catalog
+ * in place. Lookups by path or
+ * program name go through an in-memory hash index over both keys. Free
+ * space is tracked per sector in a bitmap rebuilt from the catalog; files
+ * are placed best-fit in one contiguous run when possible, otherwise split
+ * into up to VFS_MAX_EXTENTS runs, and vfsDeleteFile() gives their sectors back.
+ * vfsDefragment() moves every file back into one contiguous, track-aligned run.
+ *
+ * Programs are read either from the text format (A header of three
+ * "key value" lines, then one decimal word per line with optional "//"
+ * comments) or from the pre-assembled binary format: a ProgramImageHeader_t
+ * followed by the raw words, mapped with mmap() and copied in one pass.
+ *
+ * @version 2.6
  */
 
 #ifndef VFS_H
@@ -16,16 +33,86 @@
 #include <stdint.h>
 #include "../../inc/definitions.h"
 
+#ifndef VFS_MAX_FILES
+#define VFS_MAX_FILES  64  /** Catalog capacity (Independent of MAX_PROCESSES). */
+#endif
+
+#ifndef VFS_MAX_EXTENTS
+#define VFS_MAX_EXTENTS  4  /** Runs of sectors a file may be split into when no single free run fits it. */
+#endif
+
+#define VFS_TOTAL_SECTORS  (DISK_TRACKS * DISK_CYLINDERS * DISK_SECTORS)  /** Sectors on the virtual disk. */
+#define VFS_TRACK_SECTORS  (DISK_CYLINDERS * DISK_SECTORS)                /** Sectors per track: a transfer crossing this boundary pays a track step. */
+#define VFS_INDEX_SLOTS  (4 * VFS_MAX_FILES)  /** Hash index slots: two keys per file, so the table stays at most half full. */
+
+#define VFS_PATH_SIZE        256  /** Bytes for a file path or program name in the catalog, terminator included. */
+#define VFS_DISK_PATH_SIZE   40   /** Bytes of a file path stored on disk, terminator included; longer paths keep a prefix and their hash. */
+#define VFS_DISK_NAME_SIZE   16   /** Bytes of a program name stored on disk, terminator included; longer names keep a prefix and their hash. */
+#define VFS_CATALOG_MAGIC    0x4C554346  /** "LUCF": marks a formatted superblock. */
+#define VFS_CATALOG_VERSION  4           /** Layout version of the superblock and the catalog records. */
+
+#define VFS_SUPERBLOCK_SECTORS  5   /** Sectors of the superblock (20 bytes). */
+#define VFS_RECORD_SECTORS      (19 + VFS_MAX_EXTENTS)  /** Sectors of one catalog record (76 bytes plus 4 per extent). */
+#define VFS_CATALOG_SECTORS     (VFS_SUPERBLOCK_SECTORS + VFS_MAX_FILES * VFS_RECORD_SECTORS)  /** Sectors of one copy of the catalog: its superblock, then the records. */
+#define VFS_CATALOG_COPIES      2   /** Copies of the catalog: a change is written to the one not in use. */
+#define VFS_RESERVED_SECTORS    ((VFS_CATALOG_COPIES * VFS_CATALOG_SECTORS + DISK_SECTORS - 1) / DISK_SECTORS * DISK_SECTORS)  /** Sectors kept for the catalog, rounded up to whole cylinders; files start after them. */
+
+#define VFS_IMAGE_MAGIC      "LUCPROG"  /** First bytes of a binary program image. */
+#define VFS_IMAGE_VERSION    1          /** Layout version of ProgramImageHeader_t. */
+#define VFS_IMAGE_NAME_SIZE  32         /** Bytes for the program name in a binary image, terminator included. */
+#define VFS_IMAGE_EXTENSION  ".lbin"    /** Extension given to binary images by the converter. */
+
+/**
+ * @brief Header of a binary program image; wordCount words (int32, host order) follow it.
+ */
+typedef struct {
+	char magic[8];                           /**< VFS_IMAGE_MAGIC */
+	uint32_t version;                        /**< VFS_IMAGE_VERSION */
+	int32_t startPC;                         /**< Starting Program Counter, as in the text "_start" line */
+	int32_t wordCount;                       /**< Words after the header */
+	char programName[VFS_IMAGE_NAME_SIZE];   /**< Internal name of the program, NUL terminated */
+	uint32_t checksum;                       /**< vfsImageChecksum() of the words */
+} ProgramImageHeader_t;
+
 /**
  * @brief VFS Status Codes.
  * Indicates the result of virtual file system operations.
  */
 typedef enum {
-	VFS_SUCCESS       = 0, /**< Operation completed successfully */
-	VFS_ERR_NOT_FOUND = 1, /**< File not found in the catalog */
-	VFS_ERR_DISK_FULL = 2  /**< Maximum capacity of the catalog reached */
+	VFS_SUCCESS           = 0, /**< Operation completed successfully */
+	VFS_ERR_NOT_FOUND     = 1, /**< File not found in the catalog */
+	VFS_ERR_DISK_FULL     = 2, /**< Maximum capacity of the catalog reached */
+	VFS_ERR_NAME_TOO_LONG = 3, /**< Path or program name of VFS_PATH_SIZE characters or more */
+	VFS_ERR_BAD_IMAGE     = 4, /**< Binary program image is truncated, of another version, or fails its checksum */
+	VFS_ERR_NOT_MOUNTED   = 5  /**< The catalog on the disk image is damaged: nothing is written until it is formatted */
 } VFSStatus_t;
 
+/**
+ * @brief How scattered the files and the free space are.
+ */
+typedef struct {
+	int files;           /**< Files in the catalog */
+	int extents;         /**< Extents over all files */
+	int splitFiles;      /**< Files stored in more than one extent */
+	int crossingFiles;   /**< Files small enough for one track that still cross a track boundary */
+	int freeSectors;     /**< Free sectors outside the catalog area */
+	int freeRuns;        /**< Separate runs of free sectors */
+	int largestFreeRun;  /**< Sectors in the largest free run */
+	int fileRatio;       /**< Percent of files that are split or cross a track they could fit in */
+	int freeRatio;       /**< Percent of the free space outside the largest free run */
+} VFSFragmentation_t;
+
+/**
+ * @brief Outcome of a defragmentation pass.
+ */
+typedef struct {
+	VFSFragmentation_t before;  /**< Layout before the pass */
+	VFSFragmentation_t after;   /**< Layout after the pass */
+	int filesMoved;             /**< Files whose sectors changed */
+	int sectorsMoved;           /**< Words copied to a new sector */
+	bool trackAligned;          /**< false if the files only fit packed end to end, ignoring track boundaries */
+} VFSDefragReport_t;
+
 /**
  * @brief Loader Status Codes. (Legacy/Transition)
  */
@@ -45,24 +132,61 @@ typedef struct {
 	LoadStatus_t status;
 } ProgramInfo_t;
 
+/**
+ * @brief Run of consecutive sectors (Sector, then cylinder, then track) holding part of a file.
+ */
+typedef struct {
+	uint8_t track;     /**< Track of the first sector */
+	uint8_t cylinder;  /**< Cylinder of the first sector */
+	uint8_t sector;    /**< First sector */
+	int length;        /**< Sectors (words) in the run */
+} VFSExtent_t;
+
 /**
  * @brief File Metadata for the Disk Catalog.
  */
 typedef struct {
-	char filePath[256];     /**< Path of the program file (e.g., "test/calc.txt") */
-	char programName[256];  /**< Internal name of the program (e.g., "CalcInteractiva") */
-	uint8_t startTrack;     /**< Track where the program starts in the virtual disk */
+	char filePath[VFS_PATH_SIZE];     /**< Path of the program file (e.g., "test/calc.txt"); shortened to its disk prefix after a remount */
+	char programName[VFS_PATH_SIZE];  /**< Internal name of the program (e.g., "CalcInteractiva"); shortened likewise */
+	uint32_t pathHash;                /**< FNV-1a of the full path, kept on disk so a shortened path still matches */
+	uint32_t nameHash;                /**< FNV-1a of the full program name */
+	uint8_t startTrack;     /**< Track where the program starts in the virtual disk (First extent) */
 	uint8_t startCylinder;  /**< Cylinder where the program starts */
 	uint8_t startSector;    /**< Sector where the program starts */
 	int wordCount;          /**< Total number of words the program occupies */
 	int startPC;            /**< Starting Program Counter (PC) value for execution */
+	int extentCount;        /**< Runs of contiguous sectors holding the words, in file order */
+	VFSExtent_t extents[VFS_MAX_EXTENTS];
+	uint32_t fileId;        /**< Unique to this catalog entry for the session; a file deleted and loaded again gets a new one */
 } FileMeta_t;
 
+/**
+ * @brief A program read from the host OS but not yet placed on the disk.
+ *
+ * Text programs are parsed into a heap buffer; binary images keep their
+ * mapping so the words go from the page cache to the disk in one copy.
+ */
+typedef struct {
+	char programName[256];   /**< Name from the header */
+	int startPC;             /**< 1-based start PC from the header */
+	int wordCount;           /**< Number of words */
+	const word* words;       /**< The words, in the buffer or the mapping */
+	void* mapping;           /**< mmap() of a binary image, NULL for text */
+	size_t mappingSize;      /**< Bytes mapped */
+	word* buffer;            /**< Heap copy of a text program, NULL for images */
+} VFSProgram_t;
+
 /**
  * @brief Retrieves the current number of files registered in the catalog.
  */
 int vfsGetCatalogCount(void);
 
+/**
+ * @brief Tells whether the catalog is mounted and the disk can be written.
+ * False after vfsMount() refused a damaged catalog on a disk image, until vfsClearCatalog().
+ */
+bool vfsIsMounted(void);
+
 /**
  * @brief Retrieves the metadata of a specific catalog entry by its index.
  */
@@ -84,23 +208,145 @@ bool vfsFileExists(const char* fileName);
 VFSStatus_t vfsGetMetadata(const char* fileName, FileMeta_t* outMeta);
 
 /**
- * @brief Registers a new file in the VFS catalog.
- * @return VFSStatus_t VFS_SUCCESS or VFS_ERR_DISK_FULL.
+ * @brief Checksum of the words of a binary program image (FNV-1a over their bytes).
+ */
+static inline uint32_t vfsImageChecksum(const word* words, int count) {
+	const uint8_t* bytes = (const uint8_t*)words;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < (size_t)count * sizeof(word); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * @brief Linear index of a disk address (Sector, then cylinder, then track).
+ */
+static inline int vfsLinearSector(uint8_t track, uint8_t cylinder, uint8_t sector) {
+	return (track * DISK_CYLINDERS + cylinder) * DISK_SECTORS + sector;
+}
+
+/**
+ * @brief Disk address of a linear sector index.
+ */
+static inline void vfsSectorAddress(int linear, uint8_t* track, uint8_t* cylinder, uint8_t* sector) {
+	*track = linear / (DISK_CYLINDERS * DISK_SECTORS);
+	*cylinder = (linear / DISK_SECTORS) % DISK_CYLINDERS;
+	*sector = linear % DISK_SECTORS;
+}
+
+/**
+ * @brief Disk address of a word of a file, walking its extents.
+ *
+ * @param meta Catalog entry of the file.
+ * @param wordIndex Word offset in the file (0 to wordCount - 1).
+ * @return false if the offset is outside the file.
+ */
+bool vfsWordAddress(const FileMeta_t* meta, int wordIndex, uint8_t* track, uint8_t* cylinder, uint8_t* sector);
+
+/**
+ * @brief Reads every word of a file, one readSectors() run per extent.
+ *
+ * @param meta Catalog entry of the file.
+ * @param buffer Receives meta->wordCount words.
+ * @return VFS_SUCCESS, or VFS_ERR_NOT_FOUND if an extent is outside the disk.
+ */
+VFSStatus_t vfsReadFile(const FileMeta_t* meta, word* buffer);
+
+/**
+ * @brief Registers a new file stored in one contiguous run and writes its record to disk.
+ * @return VFSStatus_t VFS_SUCCESS, VFS_ERR_DISK_FULL, VFS_ERR_NAME_TOO_LONG or VFS_ERR_NOT_MOUNTED.
  */
 VFSStatus_t vfsRegisterFile(const char* filePath, const char* programName, uint8_t track, uint8_t cyl, uint8_t sec, int words, int startPC);
 
 /**
- * @brief Clears the VFS catalog (Useful for tests and system restarts).
+ * @brief Removes a file from the catalog and frees its sectors.
+ * The catalog without it is committed to the copy not in use, so a deletion
+ * cut short leaves the file and the records after it as they were.
+ * Processes already created from it keep running: their words were copied to RAM.
+ *
+ * @param identifier Path or program name of the file.
+ * @return VFS_SUCCESS, VFS_ERR_NOT_FOUND or VFS_ERR_NOT_MOUNTED.
+ */
+VFSStatus_t vfsDeleteFile(const char* identifier);
+
+/**
+ * @brief Returns the number of free sectors outside the catalog area.
+ */
+int vfsGetFreeSectors(void);
+
+/**
+ * @brief Measures the fragmentation of the files and of the free space.
+ */
+void vfsGetFragmentation(VFSFragmentation_t* outStats);
+
+/**
+ * @brief Moves every file into one contiguous run and rewrites the catalog (On demand).
+ * Files are placed largest first into the first track with room, so none that
+ * fits in a track crosses a track boundary and the free space ends up in whole
+ * runs. If that packing does not fit, files are packed end to end instead.
+ * A file is copied to its new run once that run is free and the catalog is
+ * committed after each move, so an interruption leaves every file whole. When
+ * the files left hold each other's runs, one is parked in the free space to
+ * break the cycle; only if there is no room for that are the rest rewritten
+ * over each other and committed together, which an interruption can damage.
+ * The caller makes sure no process or DMA transfer uses the disk meanwhile.
+ *
+ * @param outReport Receives the fragmentation before and after, and what moved (May be NULL).
+ * @return VFS_SUCCESS, or VFS_ERR_NOT_MOUNTED.
+ */
+VFSStatus_t vfsDefragment(VFSDefragReport_t* outReport);
+
+/**
+ * @brief Clears the VFS catalog and formats the superblock (Useful for tests and system restarts).
+ * Also the explicit way to mount a disk whose catalog vfsMount() refused.
  */
 void vfsClearCatalog(void);
 
+/**
+ * @brief Restores the catalog and free-space pointer stored on the virtual disk (At boot).
+ * Of the two copies, the valid one with the highest generation is mounted, so a
+ * commit cut short falls back to the catalog before it.
+ * A blank disk is formatted with an empty catalog. A catalog of another version,
+ * with a checksum mismatch or with overlapping files is formatted only on the
+ * in-memory disk: on a disk image nothing is written, and the VFS stays unmounted
+ * (every write fails with VFS_ERR_NOT_MOUNTED) until vfsClearCatalog() formats it.
+ * The free-space bitmap is rebuilt from the extents of the restored files.
+ *
+ * @return The number of files restored, or -1 if a damaged catalog was left unmounted.
+ */
+int vfsMount(void);
+
 /**
  * @brief Reads a program from the host OS and injects it into the Virtual Disk.
- * @param filePath Path to the .txt program.
+ * The smallest free run that holds it is used; without one, it is split over the largest runs.
+ * @param filePath Path to the program, in text or binary image format.
  * @return VFSStatus_t Success or specific error.
  */
 VFSStatus_t vfsLoadToDisk(const char* filePath);
 
+/**
+ * @brief Reads a program from the host OS without touching the disk or the catalog.
+ * Safe to call from several threads at once; vfsLoadToDisk is this plus vfsStoreProgram.
+ * @param filePath Path to the program, in text or binary image format.
+ * @param outProgram Receives the program; release it with vfsReleaseProgram on success.
+ * @return VFSStatus_t Success, VFS_ERR_NOT_FOUND or VFS_ERR_DISK_FULL (too large or out of memory).
+ */
+VFSStatus_t vfsParseProgram(const char* filePath, VFSProgram_t* outProgram);
+
+/**
+ * @brief Places a parsed program on the Virtual Disk and registers it under filePath.
+ * Must be called from the kernel thread, in the order the programs should appear.
+ * @return VFSStatus_t Success (also when filePath is already stored) or specific error.
+ */
+VFSStatus_t vfsStoreProgram(const char* filePath, const VFSProgram_t* program);
+
+/**
+ * @brief Frees the buffer or unmaps the image of a parsed program.
+ */
+void vfsReleaseProgram(VFSProgram_t* program);
+
 // --- Legacy / Transition Functions ---
 word readProgramWord(FILE* file);
 ProgramInfo_t loadProgram(char* filePath);
@@ -4,14 +4,24 @@
  *
  * Handles writing execution logs to a file and standard output,
  * supporting thread safety and specific formats for debug/interrupts.
+ * Callers only enqueue records in a lock-free ring; a background writer
+ * thread formats them and writes to the log files in batches.
+ * Hot-path hardware events can alternatively be recorded as fixed-size
+ * binary records (See tools/tracedump.c for the offline decoder).
  *
- * @version 1.2
+ * @version 1.7
  */
 
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
 #include "../inc/definitions.h"
+#include "../inc/hardware/cpu.h"
 
 /**
  * @brief Logging Severity Levels.
@@ -21,6 +31,7 @@ typedef enum {
 	LOG_INFO    = 0, /**< Standard informational message */
 	LOG_WARNING = 1, /**< Warning conditions */
 	LOG_ERROR   = 2, /**< Critical errors */
+	LOG_OFF     = 3, /**< Threshold only: filters out every message */
 } LogLevel_t;
 
 /**
@@ -32,22 +43,204 @@ typedef enum {
 	KERNEL_LOG    = 1, /**< Standard informational message */
 } LogType_t;
 
+#define LOG_TYPE_COUNT 2  /** Number of log categories (LogType_t values). */
+
+#define LOGGER_RING_SIZE         2048       /** Pending records between producers and the writer (power of two). */
+#define LOGGER_FILE_BUFFER_SIZE  65536      /** stdio buffer of each log file, flushed once per batch. */
+#define LOGGER_IDLE_SLEEP_NS     1000000    /** Writer thread poll interval when the ring is empty. */
+
+/**
+ * @brief Lowest hardware level compiled into the binary.
+ * Building with -DNO_HARDWARE_TRACE removes every INFO-level LOG_HARDWARE() call
+ * (per instruction and per memory access tracing), warnings and errors are kept.
+ */
+#ifdef NO_HARDWARE_TRACE
+#define LOG_HARDWARE_COMPILED_LEVEL LOG_WARNING
+#else
+#define LOG_HARDWARE_COMPILED_LEVEL LOG_INFO
+#endif
+
+#define TRACE_FILE_MAGIC    "LUCTRACE"  /** First bytes of the binary trace file. */
+#define TRACE_FILE_VERSION  1           /** Layout version of TraceRecord_t. */
+
+/**
+ * @brief Hardware events recorded in binary trace mode.
+ * The operand meaning of each event is documented next to it.
+ */
+typedef enum {
+	TRACE_FETCH           = 0, /**< [0] fetched word, [1] address */
+	TRACE_MEM_READ        = 1, /**< [0] logical address, [1] physical address, [2] value */
+	TRACE_MEM_WRITE       = 2, /**< [0] logical address, [1] physical address, [2] value */
+	TRACE_DMA_READ        = 3, /**< [0] physical address, [1] value */
+	TRACE_DMA_WRITE       = 4, /**< [0] physical address, [1] value */
+	TRACE_BRANCH          = 5, /**< [0] target address */
+	TRACE_CONTEXT_SAVE    = 6, /**< [0] SP, [1] AC */
+	TRACE_CONTEXT_RESTORE = 7, /**< [0] SP */
+	TRACE_INTERRUPT       = 8, /**< [0] interrupt code, [1] related value */
+	TRACE_EVENT_COUNT
+} TraceEvent_t;
+
+/**
+ * @brief Fixed-size binary trace record (32 bytes, host byte order).
+ */
+typedef struct {
+	uint16_t event;       /**< TraceEvent_t */
+	int16_t pid;          /**< PID running on the CPU (0 when idle), or the owner of a DMA transfer */
+	uint32_t pc;          /**< Program counter when the event happened (0 for DMA transfers) */
+	uint64_t cycle;       /**< Machine virtual clock (See cpuGetVirtualCycles) */
+	int32_t operands[3];  /**< Event specific values */
+	uint32_t reserved;    /**< Padding, always 0 */
+} TraceRecord_t;
+
+/**
+ * @brief Header written once at the start of the binary trace file.
+ */
+typedef struct {
+	char magic[8];        /**< TRACE_FILE_MAGIC */
+	uint32_t version;     /**< TRACE_FILE_VERSION */
+	uint32_t recordSize;  /**< sizeof(TraceRecord_t) */
+} TraceFileHeader_t;
+
+extern LogLevel_t loggerMinLevel[LOG_TYPE_COUNT];  /**< @brief Runtime threshold of each category (See loggerSetLevel). */
+extern atomic_bool loggerTraceBinary;              /**< @brief True while hot-path events are recorded in binary (See loggerSetTraceBinary). */
+
+/**
+ * @brief Checks whether a message would be recorded, before paying for its formatting.
+ *
+ * @param type The log category.
+ * @param level The severity of the message.
+ * @return true if the category threshold lets the message through.
+ */
+static inline bool loggerIsEnabled(LogType_t type, LogLevel_t level) {
+	return level >= loggerMinLevel[type];
+}
+
+/**
+ * @brief Formats and records a hardware message only if it passes both filters.
+ * The arguments are not evaluated when the message is filtered out. In binary
+ * trace mode INFO lines are skipped, since the trace records replace them.
+ */
+#define LOG_HARDWARE(level, ...) do { \
+	if ((level) >= LOG_HARDWARE_COMPILED_LEVEL && loggerIsEnabled(HARDWARE_LOG, (level)) && \
+	    ((level) > LOG_INFO || !loggerTraceBinary)) { \
+		char logLine[LOG_BUFFER_SIZE]; \
+		snprintf(logLine, LOG_BUFFER_SIZE, __VA_ARGS__); \
+		loggerLogHardware((level), logLine); \
+	} \
+} while (0)
+
+/**
+ * @brief Records a hot-path hardware event of the CPU thread.
+ * In binary trace mode the operands are stored as a TraceRecord_t with no formatting;
+ * otherwise the text message in the trailing arguments goes through LOG_HARDWARE.
+ * Binary tracing is not affected by NO_HARDWARE_TRACE.
+ */
+#define LOG_TRACE(event, op0, op1, op2, ...) do { \
+	if (loggerTraceBinary) loggerTraceEvent((event), cpuGetVirtualCycles(), CPU.PSW.pc, (op0), (op1), (op2)); \
+	else LOG_HARDWARE(LOG_INFO, __VA_ARGS__); \
+} while (0)
+
+/**
+ * @brief Records a hot-path hardware event from another thread (the DMA engine).
+ * Same as LOG_TRACE, but the PID and PC are given instead of read from the CPU.
+ */
+#define LOG_TRACE_AS(event, pid, pc, op0, op1, op2, ...) do { \
+	if (loggerTraceBinary) loggerTraceEventAs((event), cpuGetVirtualCycles(), (pid), (pc), (op0), (op1), (op2)); \
+	else LOG_HARDWARE(LOG_INFO, __VA_ARGS__); \
+} while (0)
+
+/**
+ * @brief Formats and records a kernel message only if it passes the runtime filter.
+ */
+#define LOG_KERNEL(level, ...) do { \
+	if (loggerIsEnabled(KERNEL_LOG, (level))) { \
+		char logLine[LOG_BUFFER_SIZE]; \
+		snprintf(logLine, LOG_BUFFER_SIZE, __VA_ARGS__); \
+		loggerLogKernel((level), logLine); \
+	} \
+} while (0)
+
 /**
  * @brief Initializes the logging system.
- * Opens the log file (creating it if it doesn't exist) and initializes
- * the mutex for thread safety.
+ * Opens the log files (creating them if they don't exist) and starts
+ * the writer thread. Messages logged before this call are discarded.
  */
 void loggerInit(void);
 
 /**
  * @brief Closes the logging system.
- * Flushes any pending writes, closes the file handle, and destroys the mutex.
+ * Stops the writer thread after it drains every pending record, then
+ * flushes and closes the file handles.
  */
 void loggerClose(void);
 
+/**
+ * @brief Returns how many records were discarded because the ring was full.
+ * Producers never wait for the writer, so a burst larger than
+ * LOGGER_RING_SIZE loses messages instead of stalling the CPU or DMA thread.
+ */
+unsigned long loggerGetDroppedCount(void);
+
+/**
+ * @brief Sets the minimum level recorded for a log category.
+ * Messages below the threshold are dropped before any formatting or I/O.
+ * LOG_OFF silences the category.
+ *
+ * @param type The log category.
+ * @param minLevel The lowest level that will be recorded.
+ */
+void loggerSetLevel(LogType_t type, LogLevel_t minLevel);
+
+/**
+ * @brief Returns the minimum level recorded for a log category.
+ */
+LogLevel_t loggerGetLevel(LogType_t type);
+
+/**
+ * @brief Switches hot-path hardware tracing between text lines and binary records.
+ * Enabling it opens (or appends to) the binary trace file, writing its header
+ * when the file is new.
+ *
+ * @param enabled True for binary records, false for text lines.
+ */
+void loggerSetTraceBinary(bool enabled);
+
+/**
+ * @brief Sets the PID stamped on the following trace records.
+ * Called by the scheduler on every dispatch (0 when the CPU goes idle).
+ */
+void loggerSetTracePid(int pid);
+
+/**
+ * @brief Enqueues one binary trace record of the CPU thread (See LOG_TRACE).
+ * The record is stamped with the PID set by loggerSetTracePid().
+ *
+ * @param event The TraceEvent_t being recorded.
+ * @param cycle Machine virtual clock at the time of the event.
+ * @param pc Program counter at the time of the event.
+ * @param op0 First event operand.
+ * @param op1 Second event operand.
+ * @param op2 Third event operand.
+ */
+void loggerTraceEvent(TraceEvent_t event, uint64_t cycle, uint32_t pc, int32_t op0, int32_t op1, int32_t op2);
+
+/**
+ * @brief Enqueues one binary trace record with an explicit PID (See LOG_TRACE_AS).
+ *
+ * @param event The TraceEvent_t being recorded.
+ * @param cycle Machine virtual clock at the time of the event.
+ * @param pid PID the event belongs to.
+ * @param pc Program counter to record.
+ * @param op0 First event operand.
+ * @param op1 Second event operand.
+ * @param op2 Third event operand.
+ */
+void loggerTraceEventAs(TraceEvent_t event, uint64_t cycle, int pid, uint32_t pc, int32_t op0, int32_t op1, int32_t op2);
+
 /**
  * @brief Writes a generic message to the log (Hardware Source).
- * This function is thread-safe.
+ * This function is thread-safe and never blocks: the message is copied
+ * into the ring and written later by the writer thread.
  *
  * @param level The severity level (LOG_INFO, LOG_ERROR, etc.).
  * @param message The string message to record.
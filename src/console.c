@@ -13,9 +13,13 @@
 #include "../inc/logger.h"
 #include "../inc/hardware/cpu.h"
 #include "../inc/hardware/memory.h"
+#include "../inc/hardware/dma.h"
+#include "../inc/hardware/iosched.h"
+#include "../inc/hardware/disk.h"
 #include "../inc/kernel/vfs.h"
 #include "../inc/kernel/mmu.h"
 #include "../inc/kernel/core.h"
+#include "../inc/kernel/imagecache.h"
 
 static char logBuffer[LOG_BUFFER_SIZE];
 static char monitorHistory[MAX_HISTORY_LINES][MAX_LINE_LENGTH];
@@ -64,6 +68,7 @@ static const char* stateToString(ProcessState state) {
 		case EXECUTING: return "EXECUTING";
 		case BLOCKED: return "BLOCKED";
 		case BLOCKED_IO: return "BLOCKED_IO";
+		case BLOCKED_DMA: return "BLOCKED_DMA";
 		case FINISHED: return "FINISHED";
 		default: return "UNKNOWN";
 	}
@@ -77,6 +82,10 @@ static void printReplInit(void) {
 	printf("  █     █  █  █     █  █  █  █   █   █  █     █  █ █     █      █   \n");
 	printf("  ▀▀▀▀  ▀▀▀▀  ▀▀▀▀  ▀  ▀  ▀  ▀  ▀▀▀  ▀▀▀▀     ▀  ▀ ▀▀▀▀  ▀      ▀▀▀▀\n");
 	printf("\n  Use \x1b[1mhelp\x1b[0m for the full command list.\n\n");
+	if (!vfsIsMounted()) {
+		printf("  \x1b[1;33mWARNING:\x1b[0m The catalog on the disk image is damaged and was not mounted.\n");
+		printf("  Nothing is written to the disk until you run \x1b[1mformat\x1b[0m, which erases it.\n\n");
+	}
 }
 
 
@@ -91,6 +100,7 @@ static void printFullRegisters(void) {
 	printf(" MDR: %08d | MAR: %05d\n", CPU.MDR, CPU.MAR);
 	printf("---------------------------------------------\n");
 	printf(" RB:  %08d | RL:  %08d\n", CPU.RB, CPU.RL);
+	printf(" TB:  %08d | TL:  %08d\n", CPU.TB, CPU.TL);
 	printf(" SP:  %08d | RX:  %08d\n", CPU.SP, CPU.RX);
 	printf(" Int: %s      | CC:  %d | PSW Mode: %s\n",
 	       (CPU.PSW.interruptEnable) ? "ON " : "OFF",
@@ -114,6 +124,20 @@ static CommandStatus_t printHelpList(void) {
 	printf("  Shows physical disk content and current programs saved.\n\n");
 	printf("  \x1b[1mmonitor\x1b[0m\n");
 	printf("  Opens a secondary terminal for program Input/Output.\n\n");
+	printf("  \x1b[1mloglevel [hardware|kernel] [info|warning|error|off]\x1b[0m\n");
+	printf("  Shows or changes the minimum level recorded in each log file.\n");
+	printf("  'loglevel trace <text|binary>' switches hardware tracing to compact binary records.\n\n");
+	printf("  \x1b[1mclock [ips|turbo]\x1b[0m\n");
+	printf("  Shows or changes the simulated clock rate (instructions per second).\n\n");
+	printf("  \x1b[1miosched [fifo|sstf|scan|clook|reset]\x1b[0m\n");
+	printf("  Shows disk service times per scheduling policy, or changes the policy.\n\n");
+	printf("  \x1b[1mdelete <file1> [file2]...\x1b[0m\n");
+	printf("  Removes programs from the virtual disk and frees their sectors.\n\n");
+	printf("  \x1b[1mdefrag\x1b[0m\n");
+	printf("  Moves every program into one contiguous, track-aligned run and reports the fragmentation.\n");
+	printf("  Only while no process is alive and no DMA transfer is pending.\n\n");
+	printf("  \x1b[1mformat\x1b[0m\n");
+	printf("  Erases the catalog of the virtual disk, also when it is damaged and was not mounted.\n\n");
 	printf("  \x1b[1mlist\x1b[0m\n");
 	printf("  Lists all files available in the current directory.\n\n");
 	printf("  \x1b[1mrestart\x1b[0m\n");
@@ -176,7 +200,7 @@ static CommandStatus_t printProcessStatus(void) {
 	for (int i = 0; i < MAX_PROCESSES; i++) {
 		if (PROCESS_TABLE[i].state == FINISHED) continue;
 		activeProcesses = true;
-		int memPercentage = (PROCESS_TABLE[i].blockCount * PARTITION_SIZE * 100) / RAM_SIZE;
+		int memPercentage = (PROCESS_TABLE[i].memorySize * 100) / RAM_SIZE;
 		printf(" %-4d | %-10s | %-10d | %s\n", PROCESS_TABLE[i].pid, stateToString(PROCESS_TABLE[i].state), memPercentage, PROCESS_TABLE[i].programName);
 	}
 	
@@ -190,24 +214,36 @@ static CommandStatus_t printProcessStatus(void) {
 
 
 static CommandStatus_t printMemoryStatus(void) {
-	printf("\n\x1b[34m----- MEMORY STATUS (memstat) -----\x1b[0m\n\n");
-	printf(" BLOCK  | RANGE (RB-RL) |  STATUS\n");
-	printf("-----------------------------------\n");
+	printf("\n\x1b[34m------------ MEMORY STATUS (memstat) ------------\x1b[0m\n\n");
+	printf(" BLOCK  | RANGE (RB-RL) | WORDS |  STATUS\n");
+	printf("-------------------------------------------------\n");
 	
-	int occupiedBlocks = 0;
+	static MMUBlock_t blocks[MMU_USER_WORDS];
+	int blockCount = mmuListBlocks(blocks, MMU_USER_WORDS);
 	
-	for (int i = 0; i < MAX_PROCESSES; i++) {
-		int rb = GET_BASE_REGISTER(i);
-		int rl = GET_LIMIT_REGISTER(rb, 1);
-		
-		bool isFree = FREE_PARTITIONS[i];
-		if (!isFree) occupiedBlocks++;
-		
-		printf(" BLK %02d | [%04d - %04d] | %s\n", i, rb, rl, isFree ? "  \x1b[32mFREE\x1b[0m" : "\x1b[31mOCCUPIED\x1b[0m");
+	for (int i = 0; i < blockCount; i++) {
+		int rl = blocks[i].base + blocks[i].size - 1;
+		if (blocks[i].used) {
+			printf(" BLK %02d | [%04d - %04d] | %5d | \x1b[31mOCCUPIED\x1b[0m (%d used)\n", i, blocks[i].base, rl, blocks[i].size, blocks[i].requestedWords);
+		} else {
+			printf(" BLK %02d | [%04d - %04d] | %5d |   \x1b[32mFREE\x1b[0m\n", i, blocks[i].base, rl, blocks[i].size);
+		}
 	}
 	
-	printf("-----------------------------------\n");
-	printf("       Total RAM Usage: %d%%\n\n", (occupiedBlocks * 100) / MAX_PROCESSES);
+	MMUStats_t memStats = mmuGetStats();
+	printf("-------------------------------------------------\n");
+	printf("       Total RAM Usage: %d%%\n", (memStats.totalWords > 0) ? (memStats.usedWords * 100) / memStats.totalWords : 0);
+	printf(" Buddy Allocator: %d-word minimum blocks | %d words free | largest free block %d\n", memStats.minBlockSize, memStats.freeWords, memStats.largestFree);
+	printf(" Internal Fragmentation: %d of %d allocated words unused\n\n", memStats.usedWords - memStats.requestedWords, memStats.usedWords);
+
+	DecodeCacheStats_t cacheStats = decodeCacheGetStats();
+	uint64_t cacheLookups = cacheStats.hits + cacheStats.misses;
+	printf(" Decode Cache: %lu hits | %lu misses | %lu invalidations\n", cacheStats.hits, cacheStats.misses, cacheStats.invalidations);
+	printf(" Decode Cache Hit Rate: %lu%%\n\n", (cacheLookups > 0) ? (cacheStats.hits * 100) / cacheLookups : 0);
+
+	ImageCacheStats_t imageStats = imageCacheGetStats();
+	printf(" Image Cache: %d programs | %d of %d words | %lu hits | %lu misses | %lu evictions\n\n", imageStats.entries,
+	       imageStats.usedWords, imageStats.budgetWords, imageStats.hits, imageStats.misses, imageStats.evictions);
 	
 	loggerLogKernel(LOG_INFO, "User executed 'memstat' command");
 	return CMD_SUCCESS;
@@ -221,7 +257,8 @@ static CommandStatus_t printDiskStatus(void) {
 	for (int t = 0; t < DISK_TRACKS; t++) {
 		for (int c = 0; c < DISK_CYLINDERS; c++) {
 			for (int s = 0; s < DISK_SECTORS; s++) {
-				diskMap[t][c][s] = -1;
+				int linear = (t * DISK_CYLINDERS + c) * DISK_SECTORS + s;
+				diskMap[t][c][s] = (linear < VFS_RESERVED_SECTORS) ? -2 : -1; // -2: catalog area
 			}
 		}
 	}
@@ -233,24 +270,12 @@ static CommandStatus_t printDiskStatus(void) {
 		FileMeta_t meta;
 		vfsGetCatalogEntry(i, &meta);
 		
-		int t = meta.startTrack;
-		int c = meta.startCylinder;
-		int s = meta.startSector;
-		
 		for (int w = 0; w < meta.wordCount; w++) {
-			if (t < DISK_TRACKS && c < DISK_CYLINDERS && s < DISK_SECTORS) {
+			uint8_t t, c, s;
+			if (vfsWordAddress(&meta, w, &t, &c, &s) && t < DISK_TRACKS) {
 				diskMap[t][c][s] = i;
 				occupiedSectors++;
 			}
-			s++;
-			if (s >= DISK_SECTORS) {
-				s = 0;
-				c++;
-				if (c >= DISK_CYLINDERS) {
-					c = 0;
-					t++;
-				}
-			}
 		}
 	}
 
@@ -272,7 +297,9 @@ static CommandStatus_t printDiskStatus(void) {
 				else if (fileId2 != -1) displayId = fileId2;
 
 				globalSector += 10;
-				if (displayId == -1) {
+				if (displayId == -2) {
+					printf("\x1b[90m#\x1b[0m");
+				} else if (displayId == -1) {
 					printf("\x1b[90m.\x1b[0m");
 				} else {
 					char sym = symbols[displayId % numSymbols];
@@ -289,6 +316,7 @@ static CommandStatus_t printDiskStatus(void) {
 	printf("--------------------------------------------------------------------------\n");
 	int usagePercent = (totalSectors > 0) ? (occupiedSectors * 100) / totalSectors : 0;
 	printf("                 Total Disk Usage: %d%% (%d / %d sectors)\n", usagePercent, occupiedSectors, totalSectors);
+	printf("                 Catalog: %d / %d files (%d sectors reserved, #)\n", catCount, VFS_MAX_FILES, VFS_RESERVED_SECTORS);
 	
 	if (catCount > 0) {
 		printf("\n \x1b[33mLoaded Programs:\x1b[0m\n");
@@ -296,7 +324,7 @@ static CommandStatus_t printDiskStatus(void) {
 			FileMeta_t meta;
 			vfsGetCatalogEntry(i, &meta);
 			char sym = symbols[i % numSymbols];
-			printf("  [\x1b[32m%c\x1b[0m] -> %-20s (Size: %d words)\n", sym, meta.programName, meta.wordCount);
+			printf("  [\x1b[32m%c\x1b[0m] -> %-20s (Size: %d words, %d extent%s)\n", sym, meta.programName, meta.wordCount, meta.extentCount, (meta.extentCount == 1) ? "" : "s");
 		}
 	} else {
 		printf("\n  No programs currently loaded on virtual disk.\n");
@@ -476,8 +504,11 @@ CommandStatus_t handleRunCommand(char** args, int argCount) {
 
 	printf("Loading processes into OS...\n");
 
+	OSStatus_t results[argCount];
+	createProcesses(args, argCount, results);
+
 	for (int i = 0; i < argCount; i++) {
-		OSStatus_t status = createProcess(args[i]);
+		OSStatus_t status = results[i];
 		
 		if (status == OS_SUCCESS) {
 			printf(" -> \x1b[32m[QUEUED]\x1b[0m Process '%s' created successfully.\n", args[i]);
@@ -526,6 +557,18 @@ CommandStatus_t handleDebugCommand(char* argument) {
 			int currentPC = CPU.PSW.pc;
 			bool active = cpuStep();
 
+			// No other process to switch to: the debugger itself waits for the transfer
+			if (osDMAWait) {
+				DMARequest_t completion;
+				while (DMA.pending) {
+					cpuAdvanceVirtualCycles(dmaBusyUntil());
+					usleep(1000);
+				}
+				while (dmaReapCompletion(&completion));
+				osDMAWait = false;
+				osYield = false;
+			}
+
 			printf(" -> Executed Addr: \x1b[33m%03d\x1b[0m | Instr: \x1b[33m%08d\x1b[0m | Result AC: \x1b[33m%08d\x1b[0m\n", currentPC, CPU.IR, CPU.AC);
 
 			if (!active) {
@@ -548,6 +591,191 @@ CommandStatus_t handleDebugCommand(char* argument) {
 }
 
 
+CommandStatus_t handleLogLevelCommand(char** args, int argCount) {
+	static const char* levelNames[] = { "info", "warning", "error", "off" };
+
+	if (argCount == 0) {
+		printf("Hardware log level: \x1b[33m%s\x1b[0m\n", levelNames[loggerGetLevel(HARDWARE_LOG)]);
+		printf("Kernel log level:   \x1b[33m%s\x1b[0m\n", levelNames[loggerGetLevel(KERNEL_LOG)]);
+		printf("Hardware trace:     \x1b[33m%s\x1b[0m\n", loggerTraceBinary ? "binary" : "text");
+		printf("Dropped records:    \x1b[33m%lu\x1b[0m\n", loggerGetDroppedCount());
+		return CMD_SUCCESS;
+	}
+
+	if (argCount != 2) {
+		printf("\x1b[1;31mError: Usage is 'loglevel <hardware|kernel> <info|warning|error|off>' or 'loglevel trace <text|binary>'\x1b[0m\n");
+		return CMD_MISSING_ARGS;
+	}
+
+	if (strcmp(args[0], "trace") == 0) {
+		if (strcmp(args[1], "text") != 0 && strcmp(args[1], "binary") != 0) {
+			printf("\x1b[1;31mError: Unknown trace format '%s'\x1b[0m\n", args[1]);
+			return CMD_MISSING_ARGS;
+		}
+		loggerSetTraceBinary(strcmp(args[1], "binary") == 0);
+		LOG_KERNEL(LOG_WARNING, "Hardware trace format set to %s via CLI", args[1]);
+		printf("Hardware trace format set to \x1b[33m%s\x1b[0m\n", args[1]);
+		return CMD_SUCCESS;
+	}
+
+	LogType_t type;
+	if (strcmp(args[0], "hardware") == 0) type = HARDWARE_LOG;
+	else if (strcmp(args[0], "kernel") == 0) type = KERNEL_LOG;
+	else {
+		printf("\x1b[1;31mError: Unknown log category '%s'\x1b[0m\n", args[0]);
+		return CMD_MISSING_ARGS;
+	}
+
+	for (int level = LOG_INFO; level <= LOG_OFF; level++) {
+		if (strcmp(args[1], levelNames[level]) == 0) {
+			loggerSetLevel(type, (LogLevel_t)level);
+			snprintf(logBuffer, LOG_BUFFER_SIZE, "Log level of %s set to %s via CLI", args[0], levelNames[level]);
+			loggerLogKernel(LOG_WARNING, logBuffer);
+			printf("Log level of %s set to \x1b[33m%s\x1b[0m\n", args[0], levelNames[level]);
+			return CMD_SUCCESS;
+		}
+	}
+
+	printf("\x1b[1;31mError: Unknown log level '%s'\x1b[0m\n", args[1]);
+	return CMD_MISSING_ARGS;
+}
+
+
+CommandStatus_t handleClockCommand(char** args, int argCount) {
+	if (argCount == 0) {
+		unsigned long rate = osGetClockRate();
+		if (rate == CPU_CLOCK_TURBO) printf("Clock rate: \x1b[33mturbo\x1b[0m (no throttling)\n");
+		else printf("Clock rate: \x1b[33m%lu\x1b[0m instructions per second\n", rate);
+		return CMD_SUCCESS;
+	}
+
+	if (argCount != 1) {
+		printf("\x1b[1;31mError: Usage is 'clock [ips|turbo]'\x1b[0m\n");
+		return CMD_MISSING_ARGS;
+	}
+
+	if (strcmp(args[0], "turbo") == 0) {
+		osSetClockRate(CPU_CLOCK_TURBO);
+		printf("Clock set to \x1b[33mturbo\x1b[0m\n");
+		return CMD_SUCCESS;
+	}
+
+	char* end;
+	unsigned long rate = strtoul(args[0], &end, 10);
+	if (*end != '\0' || rate == 0 || args[0][0] == '-') {
+		printf("\x1b[1;31mError: Invalid clock rate '%s'\x1b[0m\n", args[0]);
+		return CMD_MISSING_ARGS;
+	}
+
+	osSetClockRate(rate);
+	printf("Clock set to \x1b[33m%lu\x1b[0m instructions per second\n", rate);
+	return CMD_SUCCESS;
+}
+
+
+CommandStatus_t handleIoSchedCommand(char** args, int argCount) {
+	if (argCount == 0) {
+		IOSchedPolicy_t active = ioschedGetPolicy();
+		printf("\nDisk scheduling policy: \x1b[33m%s\x1b[0m | Head position: \x1b[33m%d\x1b[0m\n\n", ioschedPolicyName(active), ioschedGetHead());
+		printf(" %-7s %10s %12s %12s %12s %12s %12s\n", "Policy", "Requests", "Mean", "P95", "P99", "Max", "Head travel");
+		for (int i = 0; i < IOSCHED_POLICY_COUNT; i++) {
+			IOSchedReport_t report;
+			ioschedGetReport((IOSchedPolicy_t)i, &report);
+			printf(" %-7s %10lu %12llu %12llu %12llu %12llu %12llu\n", ioschedPolicyName((IOSchedPolicy_t)i), report.completed,
+			       (unsigned long long)report.meanCycles, (unsigned long long)report.p95Cycles, (unsigned long long)report.p99Cycles,
+			       (unsigned long long)report.maxCycles, (unsigned long long)report.headTravel);
+		}
+		printf(" Service times in virtual cycles, from submission to completion.\n\n");
+		return CMD_SUCCESS;
+	}
+
+	if (argCount != 1) {
+		printf("\x1b[1;31mError: Usage is 'iosched [fifo|sstf|scan|clook|reset]'\x1b[0m\n");
+		return CMD_MISSING_ARGS;
+	}
+
+	if (strcmp(args[0], "reset") == 0) {
+		ioschedResetStats();
+		printf("Disk service statistics cleared\n");
+		return CMD_SUCCESS;
+	}
+
+	IOSchedPolicy_t policy;
+	if (!ioschedParsePolicy(args[0], &policy)) {
+		printf("\x1b[1;31mError: Unknown policy '%s'\x1b[0m\n", args[0]);
+		return CMD_MISSING_ARGS;
+	}
+
+	ioschedSetPolicy(policy);
+	printf("Disk scheduling policy set to \x1b[33m%s\x1b[0m\n", ioschedPolicyName(policy));
+	loggerLogKernel(LOG_INFO, "Disk scheduling policy changed via CLI (iosched command)");
+	return CMD_SUCCESS;
+}
+
+
+CommandStatus_t handleDeleteCommand(char** args, int argCount) {
+	if (argCount == 0) {
+		printf("\x1b[1;31mError: Usage is 'delete <file1> [file2]...'\x1b[0m\n");
+		return CMD_MISSING_ARGS;
+	}
+
+	for (int i = 0; i < argCount; i++) {
+		VFSStatus_t status = vfsDeleteFile(args[i]);
+		if (status == VFS_SUCCESS) {
+			printf(" -> \x1b[32m[DELETED]\x1b[0m '%s' removed from the virtual disk.\n", args[i]);
+			LOG_KERNEL(LOG_INFO, "File '%s' deleted via CLI (delete command)", args[i]);
+		} else if (status == VFS_ERR_NOT_MOUNTED) {
+			printf(" -> \x1b[1;31m[ERROR]\x1b[0m The catalog is not mounted; use 'format' first.\n");
+		} else {
+			printf(" -> \x1b[1;31m[ERROR]\x1b[0m File '%s' is not on the virtual disk.\n", args[i]);
+		}
+	}
+	printf("Free sectors: \x1b[33m%d\x1b[0m\n", vfsGetFreeSectors());
+	return CMD_SUCCESS;
+}
+
+
+static void printFragmentationRow(const char* label, const VFSFragmentation_t* stats) {
+	printf(" %-7s | %5d | %7d | %5d | %8d | %5d%% | %5d | %8d | %5d%%\n", label, stats->files, stats->extents, stats->splitFiles,
+	       stats->crossingFiles, stats->fileRatio, stats->freeRuns, stats->largestFreeRun, stats->freeRatio);
+}
+
+
+CommandStatus_t handleDefragCommand(void) {
+	VFSDefragReport_t report;
+	if (!osIsIdle()) {
+		printf("\x1b[1;31mError: Processes or DMA transfers are still using the disk; wait for them to finish.\x1b[0m\n");
+		loggerLogKernel(LOG_WARNING, "Refused 'defrag' command while the disk is in use");
+		return CMD_SUCCESS;
+	}
+	if (vfsDefragment(&report) == VFS_ERR_NOT_MOUNTED) {
+		printf("\x1b[1;31mError: The catalog is not mounted; use 'format' first.\x1b[0m\n");
+		return CMD_SUCCESS;
+	}
+
+	printf("\n\x1b[34m-------------------------- DISK DEFRAGMENTATION --------------------------\x1b[0m\n");
+	printf("         | Files | Extents | Split | Crossing | Frag.  | Holes | Largest  | Free\n");
+	printFragmentationRow("Before", &report.before);
+	printFragmentationRow("After", &report.after);
+	printf("--------------------------------------------------------------------------\n");
+	printf(" Moved %d files (%d sectors)%s\n\n", report.filesMoved, report.sectorsMoved,
+	       report.trackAligned ? "" : "; packed end to end, not enough room to align them to tracks");
+
+	loggerLogKernel(LOG_INFO, "User executed 'defrag' command");
+	return CMD_SUCCESS;
+}
+
+
+CommandStatus_t handleFormatCommand(void) {
+	int files = vfsGetCatalogCount();
+	vfsClearCatalog();
+	diskSync();
+	printf("Virtual disk formatted: \x1b[33m%d\x1b[0m files removed, \x1b[33m%d\x1b[0m sectors free.\n", files, vfsGetFreeSectors());
+	loggerLogKernel(LOG_INFO, "Virtual disk formatted via CLI (format command)");
+	return CMD_SUCCESS;
+}
+
+
 CommandStatus_t handleRestartCommand(void) {
 	cpuReset();
 	memoryReset();
@@ -618,6 +846,28 @@ ConsoleStatus_t consoleStart(void) {
 				continue;
 			}
 			output = handleRestartCommand();
+		} else if (strcmp(command, "loglevel") == 0) {
+			output = handleLogLevelCommand(argument, argCount);
+		} else if (strcmp(command, "clock") == 0) {
+			output = handleClockCommand(argument, argCount);
+		} else if (strcmp(command, "iosched") == 0) {
+			output = handleIoSchedCommand(argument, argCount);
+		} else if (strcmp(command, "delete") == 0) {
+			output = handleDeleteCommand(argument, argCount);
+		} else if (strcmp(command, "defrag") == 0) {
+			if (argCount > 0) {
+				printf("\x1b[1;31mError: The 'defrag' command does not accept arguments\x1b[0m\n");
+				loggerLogKernel(LOG_WARNING, "Too many arguments for 'defrag' command");
+				continue;
+			}
+			output = handleDefragCommand();
+		} else if (strcmp(command, "format") == 0) {
+			if (argCount > 0) {
+				printf("\x1b[1;31mError: The 'format' command does not accept arguments\x1b[0m\n");
+				loggerLogKernel(LOG_WARNING, "Too many arguments for 'format' command");
+				continue;
+			}
+			output = handleFormatCommand();
 		} else if (strcmp(command, "list") == 0) {
 			if (argCount > 0) {
 				printf("\x1b[1;31mError: The 'list' command does not accept arguments\x1b[0m\n");
@@ -3,16 +3,45 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "../../inc/logger.h"
 #include "../../inc/hardware/cpu.h"
 #include "../../inc/hardware/memory.h"
+#include "../../inc/hardware/dma.h"
 #include "../../inc/kernel/core.h"
 #include "../../inc/kernel/syscalls.h"
+#include "../../inc/kernel/vfs.h"
 
-static uint16_t interruptBitmap = 0;
+static _Atomic uint16_t interruptBitmap = 0;  // Pending interrupts, one bit per code
 static int64_t interruptValue = 0;
-static char logBuffer[LOG_BUFFER_SIZE];
+static Instruction_t fetchedInstruction;  // Predecoded form of the last fetched word
+static word fetchedWord = -1;             // Raw word fetchedInstruction belongs to (-1: none)
+static _Atomic uint64_t virtualCycles = 0;  // Machine clock, written by the CPU thread and read by devices
+
+#ifdef THREADED_DISPATCH
+static CPUDispatchMode_t dispatchMode = CPU_DISPATCH_THREADED;
+#else
+static CPUDispatchMode_t dispatchMode = CPU_DISPATCH_SWITCH;
+#endif
+
+#ifdef SUPERINSTRUCTIONS
+static bool fusionEnabled = true;
+#else
+static bool fusionEnabled = false;
+#endif
+
+/**
+ * @brief Guest instruction sequences executed as one fused host operation.
+ */
+typedef enum {
+	FUSE_NONE = 0,           /**< No sequence starts at the current instruction */
+	FUSE_LOAD_PSH,           /**< LOAD x; PSH */
+	FUSE_LOAD_ARITH_STR,     /**< LOAD x; SUM|RES y; STR z */
+	FUSE_COMP_JUMP           /**< COMP x; JMPE|JMPNE|JMPLT|JMPLGT y */
+} FusionPattern_t;
+
+#define FUSION_MAX_LENGTH 3
 
 static void updatePSWFlags(void) {
 	if (CPU.AC == 0) CPU.PSW.conditionCode = CC_ZERO;
@@ -33,8 +62,7 @@ static void internalPush(word value) {
 	MemoryStatus_t status = writeMemory(CPU.SP, value);
 	
 	if (status != MEM_SUCCESS) {
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to push context (SP=%d). Error: %d", CPU.SP, status);
-		loggerLogHardware(LOG_ERROR, logBuffer);
+		LOG_HARDWARE(LOG_ERROR, "Failed to push context (SP=%d). Error: %d", CPU.SP, status);
 	}
 }
 
@@ -45,8 +73,7 @@ static word internalPop(void) {
 	MemoryStatus_t status = readMemory(CPU.SP, &value);
 	
 	if (status != MEM_SUCCESS) {
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to pop context (SP=%d). Error: %d", CPU.SP, status);
-		loggerLogHardware(LOG_ERROR, logBuffer);
+		LOG_HARDWARE(LOG_ERROR, "Failed to pop context (SP=%d). Error: %d", CPU.SP, status);
 	}
 
 	CPU.SP += 1;
@@ -55,8 +82,7 @@ static word internalPop(void) {
 
 
 static void saveContext(void) {
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Saving context (SP=%d)", CPU.SP);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Saving context (SP=%d)", CPU.SP);
 
 	internalPush(CPU.RX);
 	internalPush(CPU.RL);
@@ -66,13 +92,11 @@ static void saveContext(void) {
 	internalPush(CPU.PSW.pc);
 	internalPush(CPU.AC);
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Context saved: PC=%03d, SP=%d, AC=%d", CPU.PSW.pc, CPU.SP, wordToInt(CPU.AC));
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_TRACE(TRACE_CONTEXT_SAVE, CPU.SP, wordToInt(CPU.AC), 0, "Context saved: PC=%03d, SP=%d, AC=%d", CPU.PSW.pc, CPU.SP, wordToInt(CPU.AC));
 }
 
 static void restoreContext(InterruptCode_t codeHandled) {
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Restoring context (SP=%d)", CPU.SP);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Restoring context (SP=%d)", CPU.SP);
 	word savedAC = internalPop();
 	
 	if (codeHandled != IC_OVERFLOW && codeHandled != IC_UNDERFLOW) {
@@ -86,46 +110,48 @@ static void restoreContext(InterruptCode_t codeHandled) {
 	CPU.RL                 = internalPop();
 	CPU.RX                 = internalPop();
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Context restored: Returning to PC=%03d, SP=%d", CPU.PSW.pc, CPU.SP);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_TRACE(TRACE_CONTEXT_RESTORE, CPU.SP, 0, 0, "Context restored: Returning to PC=%03d, SP=%d", CPU.PSW.pc, CPU.SP);
 }
 
 
 void raiseInterrupt(InterruptCode_t code) {
 	loggerLogInterrupt(code);
-	interruptBitmap |= (1 << code);
+	if (loggerTraceBinary) loggerTraceEvent(TRACE_INTERRUPT, cpuGetVirtualCycles(), CPU.PSW.pc, code, 0, 0);
+	atomic_fetch_or(&interruptBitmap, (uint16_t)(1 << code));
 }
 
 
 void raiseInterruptRelated(InterruptCode_t code, int64_t relatedValue) {
 	loggerLogInterrupt(code);
-	interruptBitmap |= (1 << code); 
+	if (loggerTraceBinary) loggerTraceEvent(TRACE_INTERRUPT, cpuGetVirtualCycles(), CPU.PSW.pc, code, (int32_t)relatedValue, 0);
 	interruptValue = relatedValue;
+	atomic_fetch_or(&interruptBitmap, (uint16_t)(1 << code));
 }
 
 
 bool checkInterrupts(void) {
-	if (interruptBitmap == 0 || CPU.PSW.interruptEnable == ITR_DISABLED) return true;
+	uint16_t pending = atomic_load(&interruptBitmap);
+	if (pending == 0 || CPU.PSW.interruptEnable == ITR_DISABLED) return true;
 
 	InterruptCode_t codeToHandle = -1;
 	bool status = false;
 
 	// Instruction ordered by priority
-	if (interruptBitmap & (1 << IC_INVALID_INSTR))         codeToHandle = IC_INVALID_INSTR;
-	else if (interruptBitmap & (1 << IC_INVALID_ADDR))     codeToHandle = IC_INVALID_ADDR;
-	else if (interruptBitmap & (1 << IC_OVERFLOW))         codeToHandle = IC_OVERFLOW;
-	else if (interruptBitmap & (1 << IC_UNDERFLOW))        codeToHandle = IC_UNDERFLOW;
-	else if (interruptBitmap & (1 << IC_SYSCALL))          codeToHandle = IC_SYSCALL;
-	else if (interruptBitmap & (1 << IC_TIMER))            codeToHandle = IC_TIMER;
-	else if (interruptBitmap & (1 << IC_IO_DONE))          codeToHandle = IC_IO_DONE;
-	else if (interruptBitmap & (1 << IC_INVALID_SYSCALL))  codeToHandle = IC_INVALID_SYSCALL;
+	if (pending & (1 << IC_INVALID_INSTR))         codeToHandle = IC_INVALID_INSTR;
+	else if (pending & (1 << IC_INVALID_ADDR))     codeToHandle = IC_INVALID_ADDR;
+	else if (pending & (1 << IC_OVERFLOW))         codeToHandle = IC_OVERFLOW;
+	else if (pending & (1 << IC_UNDERFLOW))        codeToHandle = IC_UNDERFLOW;
+	else if (pending & (1 << IC_SYSCALL))          codeToHandle = IC_SYSCALL;
+	else if (pending & (1 << IC_TIMER))            codeToHandle = IC_TIMER;
+	else if (pending & (1 << IC_IO_DONE))          codeToHandle = IC_IO_DONE;
+	else if (pending & (1 << IC_INVALID_SYSCALL))  codeToHandle = IC_INVALID_SYSCALL;
 	else                                                   codeToHandle = IC_INVALID_INT_CODE;
 
 	CPU.PSW.interruptEnable = ITR_DISABLED;
 	if (codeToHandle != (InterruptCode_t)-1) {
 		saveContext();
 		status = handleInterrupt(codeToHandle);
-		interruptBitmap &= ~(1 << codeToHandle);
+		atomic_fetch_and(&interruptBitmap, (uint16_t)~(1 << codeToHandle));
 		if (status == true) {
 			restoreContext(codeToHandle);
 		}
@@ -148,19 +174,18 @@ bool handleInterrupt(InterruptCode_t code) {
 			return false;
 		case IC_OVERFLOW:
 			CPU.AC = intToWord((interruptValue % (MAX_MAGNITUDE + 1)), &CPU.PSW);
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "Arithmetic Overflow: Previous %ld -> Adjusted to %d", interruptValue, wordToInt(CPU.AC));
-			loggerLogHardware(LOG_WARNING, logBuffer);
+			LOG_HARDWARE(LOG_WARNING, "Arithmetic Overflow: Previous %ld -> Adjusted to %d", interruptValue, wordToInt(CPU.AC));
 			return true;
 		case IC_UNDERFLOW:
 			CPU.AC = intToWord(0, &CPU.PSW);
 			loggerLogHardware(LOG_WARNING, "Arithmetic Underflow: Value clamped to 0");
 			return true;
 		case IC_TIMER:
-			loggerLogHardware(LOG_INFO, "Timer Interrupt: External clock tick received");
+			LOG_HARDWARE(LOG_INFO, "Timer Interrupt: External clock tick received");
 			osYield = true;
 			return true;
-		case IC_IO_DONE: // Simulate program resume after I/O completion
-			loggerLogHardware(LOG_INFO, "I/O Interrupt: Peripheral operation completed");
+		case IC_IO_DONE: // Not raised by the DMA thread: the scheduler reaps completions and wakes BLOCKED_DMA processes
+			LOG_HARDWARE(LOG_INFO, "I/O Interrupt: Peripheral operation completed");
 			return true;
 		case IC_SYSCALL: {
 			SyscallStatus_t sysStatus = handleSyscall();
@@ -271,8 +296,7 @@ InstructionStatus_t executeArithmetic(Instruction_t instruction) {
 			break;
 		case OP_DIVI:
 			if (operandIntValue == 0) {
-				snprintf(logBuffer, LOG_BUFFER_SIZE, "Arithmetic Error: Division by zero at PC %03d", CPU.PSW.pc);
-				loggerLogHardware(LOG_ERROR, logBuffer);
+				LOG_HARDWARE(LOG_ERROR, "Arithmetic Error: Division by zero at PC %03d", CPU.PSW.pc);
 				raiseInterrupt(IC_INVALID_INSTR);
 				CPU.PSW.conditionCode = CC_OVERFLOW;
 				return INSTR_EXEC_FAIL;
@@ -322,8 +346,10 @@ InstructionStatus_t executeDataMovement(Instruction_t instruction) {
 		case OP_LOAD: {
 			word data;
 			status = fetchOperand(instruction, &data);
-			CPU.AC = data;
-			updatePSWFlags();
+			if (status == INSTR_EXEC_SUCCESS) {
+				CPU.AC = data;
+				updatePSWFlags();
+			}
 			break;
 		}
 		case OP_STRRX: {
@@ -373,18 +399,15 @@ InstructionStatus_t executeDataMovement(Instruction_t instruction) {
 			break;
 	}
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Data Movement instruction executed: OpCode=%d", instruction.opCode);
-	loggerLogHardware(LOG_INFO, logBuffer);
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Return status: [%d], Status: [%d]", ret, status);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Data Movement instruction executed: OpCode=%d", instruction.opCode);
+	LOG_HARDWARE(LOG_INFO, "Return status: [%d], Status: [%d]", ret, status);
 
 	if (ret != MEM_SUCCESS || status == INSTR_EXEC_FAIL) {
 		raiseInterrupt(IC_INVALID_ADDR);
 		return INSTR_EXEC_FAIL;
 	}
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Data Movement executed. AC=%08d", CPU.AC);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Data Movement executed. AC=%08d", CPU.AC);
 
 	return INSTR_EXEC_SUCCESS;
 }
@@ -399,8 +422,7 @@ InstructionStatus_t executeBranching(Instruction_t instruction) {
 	word stackValue = 0;
 	MemoryStatus_t ret = readMemory(CPU.SP, &stackValue);
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Branching instruction executed: stackValue=%d", stackValue);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Branching instruction executed: stackValue=%d", stackValue);
 
 	if (ret != MEM_SUCCESS) {
 		raiseInterrupt(IC_INVALID_ADDR);
@@ -431,8 +453,7 @@ InstructionStatus_t executeBranching(Instruction_t instruction) {
 
 	if (shouldJump) {
 		CPU.PSW.pc = calculateEffectiveAddress(instruction);
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Branch taken to address %03d", CPU.PSW.pc);
-		loggerLogHardware(LOG_INFO, logBuffer);
+		LOG_TRACE(TRACE_BRANCH, CPU.PSW.pc, 0, 0, "Branch taken to address %03d", CPU.PSW.pc);
 	}
 
 	return INSTR_EXEC_SUCCESS;
@@ -461,6 +482,21 @@ InstructionStatus_t executeComparison(Instruction_t instruction) {
 }
 
 
+/**
+ * @brief Submits the programmed extent as a single-extent burst (BUS_LOCK held).
+ * @return The descriptor index, or -1 if the queue is full.
+ */
+static int submitDMARequest(const DMASegment_t* extent) {
+	DMARequest_t request = {
+		.ioDirection = DMA.ioDirection,
+		.segmentCount = 1,
+		.segments[0] = *extent,
+		.ownerPid = DMA.requesterPid,
+	};
+	return dmaEnqueueLocked(&request);
+}
+
+
 InstructionStatus_t executeDMAInstruction(Instruction_t instruction) {
 	word data;
 	InstructionStatus_t status = fetchOperand(instruction, &data);
@@ -505,8 +541,9 @@ InstructionStatus_t executeDMAInstruction(Instruction_t instruction) {
 			if (CPU.PSW.mode == MODE_KERNEL) {
 				physicalAddr = intData;
 			} else {
-				physicalAddr = CPU.RB + intData;
-				if (physicalAddr > CPU.RL) {
+				// DMA may not fill the shared text: only the private partition is a valid target
+				physicalAddr = CPU.RB + intData - CPU.TL;
+				if (intData < CPU.TL || physicalAddr > CPU.RL) {
 					raiseInterrupt(IC_INVALID_ADDR);
 					return INSTR_EXEC_FAIL;
 				}
@@ -520,16 +557,46 @@ InstructionStatus_t executeDMAInstruction(Instruction_t instruction) {
 			DMA.memAddr = physicalAddr;
 			break;
 		}
+		case OP_SDMAL: {
+			if (intData < 1 || intData > RAM_SIZE) {
+				raiseInterrupt(IC_INVALID_INSTR);
+				return INSTR_EXEC_FAIL;
+			}
+			DMA.length = intData;
+			break;
+		}
 		case OP_SDMAON: {
+			DMASegment_t extent = { DMA.track, DMA.cylinder, DMA.sector, DMA.memAddr, (DMA.length == 0) ? 1 : DMA.length };
+
+			// The whole RAM range must stay inside the caller's partition, not only its first word
+			if (CPU.PSW.mode != MODE_KERNEL && extent.memAddr + extent.length - 1 > CPU.RL) {
+				raiseInterrupt(IC_INVALID_ADDR);
+				return INSTR_EXEC_FAIL;
+			}
+			if (!dmaSegmentIsValid(&extent)) {
+				raiseInterrupt(IC_INVALID_INSTR);
+				return INSTR_EXEC_FAIL;
+			}
+			// The catalog of the VFS lives in the first sectors of the disk, out of reach of user code
+			if (CPU.PSW.mode != MODE_KERNEL && dmaSegmentStart(&extent) < VFS_RESERVED_SECTORS) {
+				raiseInterrupt(IC_INVALID_ADDR);
+				return INSTR_EXEC_FAIL;
+			}
+
 			pthread_mutex_lock(&BUS_LOCK);
-			DMA.pending = true;
-			pthread_cond_signal(&DMA_COND);
+			int slot = submitDMARequest(&extent);
 			pthread_mutex_unlock(&BUS_LOCK);
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "DMA Started: Track %d, Cyl %d, Sect %d -> RAM %d", DMA.track, DMA.cylinder, DMA.sector, DMA.memAddr);
-			loggerLogHardware(LOG_INFO, logBuffer);
-			while (DMA.pending) {
-				usleep(1000); // Simulates blocked program state until DMA completes
+
+			if (slot < 0) {
+				// Every descriptor is in use: issue SDMAON again once a slot is reaped
+				CPU.PSW.pc -= 1;
+				LOG_HARDWARE(LOG_INFO, "DMA queue full: SDMAON at %03d deferred", CPU.PSW.pc);
+			} else {
+				LOG_HARDWARE(LOG_INFO, "DMA Queued [%d]: Track %d, Cyl %d, Sect %d -> RAM %d, %d word(s) (PID %d)", slot, DMA.track, DMA.cylinder, DMA.sector, DMA.memAddr, extent.length, DMA.requesterPid);
 			}
+			// The caller waits blocked, the kernel runs other processes meanwhile
+			osDMAWait = true;
+			osYield = true;
 			break;
 		}
 		default:
@@ -557,7 +624,7 @@ InstructionStatus_t executeStackManipulation(Instruction_t instruction) {
 		CPU.SP -= 1;
 		ret = writeMemory(CPU.SP, CPU.AC);
 	} else if (instruction.opCode == OP_POP) {
-		if (CPU.SP + CPU.RB >= CPU.RL) {
+		if (CPU.SP - CPU.TL + CPU.RB >= CPU.RL) {
 			raiseInterrupt(IC_INVALID_ADDR);
 			return INSTR_EXEC_FAIL;
 		}
@@ -600,26 +667,28 @@ InstructionStatus_t executeReturn(void) {
 CPUStatus_t fetch(void) {
 	CPU.MAR = CPU.PSW.pc;
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Fetching instruction from address %03d", CPU.MAR);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Fetching instruction from address %03d", CPU.MAR);
 
-	if (readMemory(CPU.MAR, &CPU.MDR) != MEM_SUCCESS) {
+	if (fetchInstruction(CPU.MAR, &CPU.MDR, &fetchedInstruction) != MEM_SUCCESS) {
+		fetchedWord = -1;
 		loggerLogInterrupt(IC_INVALID_ADDR);
 		return CPU_STOP;
 	}
 	CPU.IR = CPU.MDR;
+	fetchedWord = CPU.IR;
 	CPU.PSW.pc += 1;
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Fetched instruction %08d from address %03d", CPU.IR, CPU.MAR);
-	loggerLogHardware(LOG_INFO, logBuffer);
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Updated PC to %03d", CPU.PSW.pc);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_TRACE(TRACE_FETCH, CPU.IR, CPU.MAR, 0, "Fetched instruction %08d from address %03d", CPU.IR, CPU.MAR);
+	LOG_HARDWARE(LOG_INFO, "Updated PC to %03d", CPU.PSW.pc);
 
 	return CPU_OK;
 }
 
 
 Instruction_t decode(void) {
+	// The fetch stage already holds the decoded form unless IR was modified since
+	if (CPU.IR == fetchedWord) return fetchedInstruction;
+
 	Instruction_t inst;
 	inst.opCode = GET_INSTRUCTION_OPCODE(CPU.IR);
 	inst.direction = GET_INSTRUCTION_MODE(CPU.IR);
@@ -666,8 +735,7 @@ CPUStatus_t execute(Instruction_t instruction) {
 		case OP_TTI:
 			if (fetchOperand(instruction, &interval) == INSTR_EXEC_SUCCESS) {
 				CPU.timerLimit = (uint64_t)wordToInt(interval);
-				snprintf(logBuffer, LOG_BUFFER_SIZE, "Timer interval set to %lu cycles", CPU.timerLimit);
-				loggerLogHardware(LOG_INFO, logBuffer);
+				LOG_HARDWARE(LOG_INFO, "Timer interval set to %lu cycles", CPU.timerLimit);
 				status = INSTR_EXEC_SUCCESS;
 			} else {
 				status = INSTR_EXEC_FAIL;
@@ -704,6 +772,7 @@ CPUStatus_t execute(Instruction_t instruction) {
 		case OP_SDMAIO:
 		case OP_SDMAM:
 		case OP_SDMAON:
+		case OP_SDMAL:
 			status = executeDMAInstruction(instruction);
 			return checkStatus(status);
 		default:
@@ -713,35 +782,518 @@ CPUStatus_t execute(Instruction_t instruction) {
 }
 
 
+#if defined(__GNUC__)
+// Operand fetch stubs of one OpCode: each addressing mode has its own entry point
+#define OPERAND_HANDLERS(op) { \
+	[ADDR_MODE_DIRECT]    = &&op##_DIRECT, \
+	[ADDR_MODE_IMMEDIATE] = &&op##_IMMEDIATE, \
+	[ADDR_MODE_INDEXED]   = &&op##_INDEXED, \
+	[3 ... 9]             = &&INVALID_MODE }
+
+#define MODE_HANDLERS(label) { [0 ... 9] = &&label }
+
+#define OPERAND_STUBS(op) \
+	op##_DIRECT: \
+		if (readMemory((address)instruction.value, &operand) != MEM_SUCCESS) goto OPERAND_FAULT; \
+		goto op##_EXECUTE; \
+	op##_IMMEDIATE: \
+		operand = intToWord(instruction.value, &CPU.PSW); \
+		goto op##_EXECUTE; \
+	op##_INDEXED: \
+		if (readMemory(instruction.value + wordToInt(CPU.AC), &operand) != MEM_SUCCESS) goto OPERAND_FAULT; \
+		goto op##_EXECUTE;
+#endif
+
+CPUStatus_t executeThreaded(Instruction_t instruction) {
+#if defined(__GNUC__)
+	static const void* const dispatchTable[OP_SDMAL + 1][10] = {
+		[OP_SUM]    = OPERAND_HANDLERS(SUM),
+		[OP_RES]    = OPERAND_HANDLERS(RES),
+		[OP_MULT]   = OPERAND_HANDLERS(MULT),
+		[OP_DIVI]   = OPERAND_HANDLERS(DIVI),
+		[OP_LOAD]   = { [ADDR_MODE_DIRECT] = &&LOAD_DIRECT, [ADDR_MODE_IMMEDIATE] = &&LOAD_IMMEDIATE, [ADDR_MODE_INDEXED] = &&LOAD_INDEXED, [3 ... 9] = &&LOAD_INVALID_MODE },
+		[OP_STR]    = { [ADDR_MODE_DIRECT] = &&STR_DIRECT, [ADDR_MODE_IMMEDIATE] = &&INVALID_INSTRUCTION, [ADDR_MODE_INDEXED] = &&STR_INDEXED, [3 ... 9] = &&STR_DIRECT },
+		[OP_LOADRX] = MODE_HANDLERS(LOADRX),
+		[OP_STRRX]  = MODE_HANDLERS(STRRX),
+		[OP_COMP]   = OPERAND_HANDLERS(COMP),
+		[OP_JMPE]   = MODE_HANDLERS(JMPE),
+		[OP_JMPNE]  = MODE_HANDLERS(JMPNE),
+		[OP_JMPLT]  = MODE_HANDLERS(JMPLT),
+		[OP_JMPLGT] = MODE_HANDLERS(JMPLGT),
+		[OP_SVC]    = MODE_HANDLERS(SVC),
+		[OP_RETRN]  = MODE_HANDLERS(RETRN),
+		[OP_HAB]    = MODE_HANDLERS(HAB),
+		[OP_DHAB]   = MODE_HANDLERS(DHAB),
+		[OP_TTI]    = OPERAND_HANDLERS(TTI),
+		[OP_CHMOD]  = MODE_HANDLERS(CHMOD),
+		[OP_LOADRB] = MODE_HANDLERS(LOADRB),
+		[OP_STRRB]  = MODE_HANDLERS(STRRB),
+		[OP_LOADRL] = MODE_HANDLERS(LOADRL),
+		[OP_STRRL]  = MODE_HANDLERS(STRRL),
+		[OP_LOADSP] = MODE_HANDLERS(LOADSP),
+		[OP_STRSP]  = MODE_HANDLERS(STRSP),
+		[OP_PSH]    = MODE_HANDLERS(PSH),
+		[OP_POP]    = MODE_HANDLERS(POP),
+		[OP_J]      = { [ADDR_MODE_DIRECT ... ADDR_MODE_IMMEDIATE] = &&J_DIRECT, [ADDR_MODE_INDEXED] = &&J_INDEXED, [3 ... 9] = &&J_DIRECT },
+		[OP_SDMAP]  = MODE_HANDLERS(DMA),
+		[OP_SDMAC]  = MODE_HANDLERS(DMA),
+		[OP_SDMAS]  = MODE_HANDLERS(DMA),
+		[OP_SDMAIO] = MODE_HANDLERS(DMA),
+		[OP_SDMAM]  = MODE_HANDLERS(DMA),
+		[OP_SDMAON] = MODE_HANDLERS(DMA),
+		[OP_SDMAL]  = MODE_HANDLERS(DMA),
+	};
+
+	word operand = 0;
+	word stackValue = 0;
+	int64_t result = 0;
+
+	if ((unsigned)instruction.opCode > OP_SDMAL || (unsigned)instruction.direction > 9) goto INVALID_INSTRUCTION;
+	goto *dispatchTable[instruction.opCode][instruction.direction];
+
+	// --- Arithmetic (same effects as executeArithmetic) ---
+	OPERAND_STUBS(SUM)
+	SUM_EXECUTE:
+		result = (int64_t)wordToInt(CPU.AC) + wordToInt(operand);
+		CPU.AC = intToWord(result, &CPU.PSW);
+		goto ARITHMETIC_DONE;
+
+	OPERAND_STUBS(RES)
+	RES_EXECUTE:
+		result = (int64_t)wordToInt(CPU.AC) - wordToInt(operand);
+		CPU.AC = intToWord(result, &CPU.PSW);
+		goto ARITHMETIC_DONE;
+
+	OPERAND_STUBS(MULT)
+	MULT_EXECUTE:
+		result = (int64_t)wordToInt(CPU.AC) * wordToInt(operand);
+		CPU.AC = intToWord(result % (MAX_MAGNITUDE + 1), &CPU.PSW);
+		if (result > MAX_MAGNITUDE || result < -MAX_MAGNITUDE) CPU.PSW.conditionCode = CC_OVERFLOW;
+		goto ARITHMETIC_DONE;
+
+	OPERAND_STUBS(DIVI)
+	DIVI_EXECUTE:
+		if (wordToInt(operand) == 0) {
+			LOG_HARDWARE(LOG_ERROR, "Arithmetic Error: Division by zero at PC %03d", CPU.PSW.pc);
+			raiseInterrupt(IC_INVALID_INSTR);
+			CPU.PSW.conditionCode = CC_OVERFLOW;
+			return CPU_STOP;
+		}
+		result = (int64_t)wordToInt(CPU.AC) / wordToInt(operand);
+		CPU.AC = intToWord(result, &CPU.PSW);
+		goto ARITHMETIC_DONE;
+
+	ARITHMETIC_DONE:
+		if (CPU.PSW.conditionCode == CC_OVERFLOW) raiseInterruptRelated(IC_OVERFLOW, result);
+		return CPU_OK;
+
+	// --- Data movement (same effects as executeDataMovement) ---
+	LOAD_DIRECT:
+		if (readMemory((address)instruction.value, &operand) != MEM_SUCCESS) goto OPERAND_FAULT;
+		CPU.AC = operand;
+		updatePSWFlags();
+		return CPU_OK;
+	LOAD_IMMEDIATE:
+		CPU.AC = intToWord(instruction.value, &CPU.PSW);
+		updatePSWFlags();
+		return CPU_OK;
+	LOAD_INDEXED:
+		if (readMemory(instruction.value + wordToInt(CPU.AC), &operand) != MEM_SUCCESS) goto OPERAND_FAULT;
+		CPU.AC = operand;
+		updatePSWFlags();
+		return CPU_OK;
+	LOAD_INVALID_MODE:
+		raiseInterrupt(IC_INVALID_INSTR);
+		raiseInterrupt(IC_INVALID_ADDR);
+		return CPU_STOP;
+
+	STR_DIRECT:
+		if (writeMemory((address)instruction.value, CPU.AC) != MEM_SUCCESS) goto OPERAND_FAULT;
+		return CPU_OK;
+	STR_INDEXED:
+		if (writeMemory(instruction.value + wordToInt(CPU.AC), CPU.AC) != MEM_SUCCESS) goto OPERAND_FAULT;
+		return CPU_OK;
+
+	LOADRX: CPU.AC = CPU.RX; updatePSWFlags(); return CPU_OK;
+	LOADRB: CPU.AC = CPU.RB; updatePSWFlags(); return CPU_OK;
+	LOADRL: CPU.AC = CPU.RL; updatePSWFlags(); return CPU_OK;
+	STRRX:  CPU.RX = CPU.AC; return CPU_OK;
+	STRRB:  CPU.RB = CPU.AC; return CPU_OK;
+	STRRL:  CPU.RL = CPU.AC; return CPU_OK;
+
+	LOADSP:
+		readMemory(CPU.SP, &CPU.AC);
+		updatePSWFlags();
+		return CPU_OK;
+	STRSP:
+		if (writeMemory(CPU.SP, CPU.AC) != MEM_SUCCESS) goto OPERAND_FAULT;
+		return CPU_OK;
+
+	// --- Comparison (same effects as executeComparison) ---
+	OPERAND_STUBS(COMP)
+	COMP_EXECUTE:
+		result = (int64_t)wordToInt(CPU.AC) - wordToInt(operand);
+		if (result > MAX_MAGNITUDE || result < -MAX_MAGNITUDE) CPU.PSW.conditionCode = CC_OVERFLOW;
+		else if (result == 0) CPU.PSW.conditionCode = CC_ZERO;
+		else if (result < 0) CPU.PSW.conditionCode = CC_NEG;
+		else CPU.PSW.conditionCode = CC_POS;
+		return CPU_OK;
+
+	// --- Branching (same effects as executeBranching) ---
+	JMPE:
+		if (readMemory(CPU.SP, &stackValue) != MEM_SUCCESS) goto OPERAND_FAULT;
+		if (wordToInt(CPU.AC) == wordToInt(stackValue)) CPU.PSW.pc = calculateEffectiveAddress(instruction);
+		return CPU_OK;
+	JMPNE:
+		if (readMemory(CPU.SP, &stackValue) != MEM_SUCCESS) goto OPERAND_FAULT;
+		if (wordToInt(CPU.AC) != wordToInt(stackValue)) CPU.PSW.pc = calculateEffectiveAddress(instruction);
+		return CPU_OK;
+	JMPLT:
+		if (readMemory(CPU.SP, &stackValue) != MEM_SUCCESS) goto OPERAND_FAULT;
+		if (wordToInt(CPU.AC) < wordToInt(stackValue)) CPU.PSW.pc = calculateEffectiveAddress(instruction);
+		return CPU_OK;
+	JMPLGT:
+		if (readMemory(CPU.SP, &stackValue) != MEM_SUCCESS) goto OPERAND_FAULT;
+		if (wordToInt(CPU.AC) > wordToInt(stackValue)) CPU.PSW.pc = calculateEffectiveAddress(instruction);
+		return CPU_OK;
+	J_DIRECT:
+		CPU.PSW.pc = instruction.value;
+		return CPU_OK;
+	J_INDEXED:
+		CPU.PSW.pc = instruction.value + wordToInt(CPU.AC);
+		return CPU_OK;
+
+	// --- System and control ---
+	SVC:
+		raiseInterrupt(IC_SYSCALL);
+		return CPU_OK;
+	RETRN:
+		if (readMemory(CPU.SP, &stackValue) != MEM_SUCCESS) goto OPERAND_FAULT;
+		CPU.PSW.pc = wordToInt(stackValue);
+		CPU.SP += 1;
+		return CPU_OK;
+	HAB:  CPU.PSW.interruptEnable = ITR_ENABLED; return CPU_OK;
+	DHAB: CPU.PSW.interruptEnable = ITR_DISABLED; return CPU_OK;
+
+	OPERAND_STUBS(TTI)
+	TTI_EXECUTE:
+		CPU.timerLimit = (uint64_t)wordToInt(operand);
+		LOG_HARDWARE(LOG_INFO, "Timer interval set to %lu cycles", CPU.timerLimit);
+		return CPU_OK;
+
+	CHMOD:
+		if (instruction.value == 0) CPU.PSW.mode = MODE_USER;
+		else if (instruction.value == 1) CPU.PSW.mode = MODE_KERNEL;
+		else goto INVALID_INSTRUCTION;
+		return CPU_OK;
+
+	// --- Stack (same effects as executeStackManipulation) ---
+	PSH:
+		if (CPU.SP - 1 < CPU.RX) goto OPERAND_FAULT;
+		CPU.SP -= 1;
+		if (writeMemory(CPU.SP, CPU.AC) != MEM_SUCCESS) goto OPERAND_FAULT;
+		return CPU_OK;
+	POP:
+		if (CPU.SP - CPU.TL + CPU.RB >= CPU.RL) goto OPERAND_FAULT;
+		readMemory(CPU.SP, &CPU.AC);
+		CPU.SP += 1;
+		updatePSWFlags();
+		return CPU_OK;
+
+	// --- DMA programming is I/O bound, it keeps the shared handler ---
+	DMA:
+		return checkStatus(executeDMAInstruction(instruction));
+
+	// --- Faults ---
+	OPERAND_FAULT:
+		raiseInterrupt(IC_INVALID_ADDR);
+		return CPU_STOP;
+	INVALID_MODE:
+	INVALID_INSTRUCTION:
+		raiseInterrupt(IC_INVALID_INSTR);
+		return CPU_STOP;
+#else
+	return execute(instruction);
+#endif
+}
+
+
+void cpuSetDispatchMode(CPUDispatchMode_t mode) {
+	dispatchMode = mode;
+	LOG_HARDWARE(LOG_INFO, "CPU dispatch core set to %s", (mode == CPU_DISPATCH_THREADED) ? "THREADED" : "SWITCH");
+}
+
+
+CPUDispatchMode_t cpuGetDispatchMode(void) {
+	return dispatchMode;
+}
+
+
+void cpuSetFusion(bool enabled) {
+	fusionEnabled = enabled;
+	LOG_HARDWARE(LOG_INFO, "Superinstruction fusion %s", enabled ? "enabled" : "disabled");
+}
+
+
+bool cpuGetFusion(void) {
+	return fusionEnabled;
+}
+
+
+uint64_t cpuGetVirtualCycles(void) {
+	return atomic_load_explicit(&virtualCycles, memory_order_relaxed);
+}
+
+
+void cpuAdvanceVirtualCycles(uint64_t target) {
+	uint64_t now = atomic_load_explicit(&virtualCycles, memory_order_relaxed);
+	while (now < target && !atomic_compare_exchange_weak(&virtualCycles, &now, target));
+}
+
+
+// Accounts one retired instruction against the timer and the virtual clock, exactly once per guest instruction
+static void retireInstruction(void) {
+	// Single writer: a relaxed load and store avoids a locked add on every instruction
+	atomic_store_explicit(&virtualCycles, atomic_load_explicit(&virtualCycles, memory_order_relaxed) + 1, memory_order_relaxed);
+	CPU.cyclesCounter++;
+	if ((CPU.cyclesCounter >= CPU.timerLimit) && (CPU.timerLimit > 0)) {
+		CPU.cyclesCounter = 0;
+		raiseInterrupt(IC_TIMER);
+	}
+}
+
+
+// Mirrors the fetch stage side effects for a word that was matched by lookahead
+static void advanceFetch(word raw, Instruction_t instruction) {
+	CPU.MAR = CPU.PSW.pc;
+	CPU.MDR = raw;
+	CPU.IR = raw;
+	fetchedWord = raw;
+	fetchedInstruction = instruction;
+	CPU.PSW.pc += 1;
+
+	if (loggerTraceBinary) loggerTraceEvent(TRACE_FETCH, cpuGetVirtualCycles(), CPU.PSW.pc, raw, CPU.MAR, 0);
+}
+
+
+static bool isSimpleOperandMode(Instruction_t instruction) {
+	return instruction.direction == ADDR_MODE_DIRECT || instruction.direction == ADDR_MODE_IMMEDIATE;
+}
+
+
+static FusionPattern_t matchFusion(Instruction_t head, word* nextWords, Instruction_t* next) {
+	if (head.opCode != OP_LOAD && head.opCode != OP_COMP) return FUSE_NONE;
+	if (!isSimpleOperandMode(head)) return FUSE_NONE;
+	if (peekInstruction(CPU.PSW.pc, &nextWords[0], &next[0]) != MEM_SUCCESS) return FUSE_NONE;
+
+	if (head.opCode == OP_COMP) {
+		if (next[0].opCode >= OP_JMPE && next[0].opCode <= OP_JMPLGT) return FUSE_COMP_JUMP;
+		return FUSE_NONE;
+	}
+
+	if (next[0].opCode == OP_PSH) return FUSE_LOAD_PSH;
+
+	if ((next[0].opCode == OP_SUM || next[0].opCode == OP_RES) && isSimpleOperandMode(next[0])) {
+		if (peekInstruction(CPU.PSW.pc + 1, &nextWords[1], &next[1]) != MEM_SUCCESS) return FUSE_NONE;
+		if (next[1].opCode == OP_STR && next[1].direction == ADDR_MODE_DIRECT) return FUSE_LOAD_ARITH_STR;
+	}
+
+	return FUSE_NONE;
+}
+
+
+// Operand of a DIRECT/IMMEDIATE instruction, BUS_LOCK must be held
+static MemoryStatus_t fusedOperand(Instruction_t instruction, word* outValue) {
+	if (instruction.direction == ADDR_MODE_IMMEDIATE) {
+		*outValue = intToWord(instruction.value, &CPU.PSW);
+		return MEM_SUCCESS;
+	}
+	return readMemoryLocked(instruction.value, outValue);
+}
+
+
+/*
+ * Retires one component of a fused sequence. Returns false when the sequence must stop
+ * here: the component faulted, or an interrupt (overflow, timer...) is now pending and
+ * has to be serviced before the next guest instruction, as in the unfused path.
+ */
+static bool fusedRetire(MemoryStatus_t ret, CPUStatus_t* status, int* retired) {
+	*retired += 1;
+	if (ret != MEM_SUCCESS) {
+		raiseInterrupt(IC_INVALID_ADDR);
+		*status = CPU_STOP;
+	}
+	retireInstruction();
+	return *status == CPU_OK && interruptBitmap == 0;
+}
+
+
+/*
+ * Executes the sequence starting at the instruction just decoded, if there is one.
+ * Every component keeps its architectural effects (AC, condition code, PC, SP, memory,
+ * interrupts and timer cycles); only dispatch and bus arbitration are shared.
+ * Returns the number of guest instructions retired, 0 (nothing executed) when no
+ * sequence matches.
+ */
+static int executeFused(Instruction_t head, CPUStatus_t* status) {
+	word nextWords[FUSION_MAX_LENGTH - 1];
+	Instruction_t next[FUSION_MAX_LENGTH - 1];
+	FusionPattern_t pattern = matchFusion(head, nextWords, next);
+	if (pattern == FUSE_NONE) return 0;
+
+	int retired = 0;
+	MemoryStatus_t ret;
+	word operand = 0;
+	int64_t result = 0;
+	*status = CPU_OK;
+
+	pthread_mutex_lock(&BUS_LOCK);
+
+	switch (pattern) {
+		case FUSE_LOAD_PSH:
+			ret = fusedOperand(head, &operand);
+			if (ret == MEM_SUCCESS) {
+				CPU.AC = operand;
+				updatePSWFlags();
+			}
+			if (!fusedRetire(ret, status, &retired)) break;
+
+			advanceFetch(nextWords[0], next[0]);
+			if (CPU.SP - 1 < CPU.RX) {
+				ret = MEM_ERR_PROTECTION;
+			} else {
+				CPU.SP -= 1;
+				ret = writeMemoryLocked(CPU.SP, CPU.AC);
+			}
+			fusedRetire(ret, status, &retired);
+			break;
+
+		case FUSE_LOAD_ARITH_STR:
+			ret = fusedOperand(head, &operand);
+			if (ret == MEM_SUCCESS) {
+				CPU.AC = operand;
+				updatePSWFlags();
+			}
+			if (!fusedRetire(ret, status, &retired)) break;
+
+			advanceFetch(nextWords[0], next[0]);
+			ret = fusedOperand(next[0], &operand);
+			if (ret == MEM_SUCCESS) {
+				if (next[0].opCode == OP_SUM) result = (int64_t)wordToInt(CPU.AC) + wordToInt(operand);
+				else result = (int64_t)wordToInt(CPU.AC) - wordToInt(operand);
+				CPU.AC = intToWord(result, &CPU.PSW);
+				if (CPU.PSW.conditionCode == CC_OVERFLOW) raiseInterruptRelated(IC_OVERFLOW, result);
+			}
+			if (!fusedRetire(ret, status, &retired)) break;
+
+			advanceFetch(nextWords[1], next[1]);
+			ret = writeMemoryLocked(next[1].value, CPU.AC);
+			fusedRetire(ret, status, &retired);
+			break;
+
+		case FUSE_COMP_JUMP:
+			ret = fusedOperand(head, &operand);
+			if (ret == MEM_SUCCESS) {
+				result = (int64_t)wordToInt(CPU.AC) - wordToInt(operand);
+				if (result > MAX_MAGNITUDE || result < -MAX_MAGNITUDE) CPU.PSW.conditionCode = CC_OVERFLOW;
+				else if (result == 0) CPU.PSW.conditionCode = CC_ZERO;
+				else if (result < 0) CPU.PSW.conditionCode = CC_NEG;
+				else CPU.PSW.conditionCode = CC_POS;
+			}
+			if (!fusedRetire(ret, status, &retired)) break;
+
+			advanceFetch(nextWords[0], next[0]);
+			ret = readMemoryLocked(CPU.SP, &operand);
+			if (ret == MEM_SUCCESS) {
+				int acInt = wordToInt(CPU.AC);
+				int stackInt = wordToInt(operand);
+				bool shouldJump = (next[0].opCode == OP_JMPE && acInt == stackInt)
+				               || (next[0].opCode == OP_JMPNE && acInt != stackInt)
+				               || (next[0].opCode == OP_JMPLT && acInt < stackInt)
+				               || (next[0].opCode == OP_JMPLGT && acInt > stackInt);
+				if (shouldJump) CPU.PSW.pc = calculateEffectiveAddress(next[0]);
+			}
+			fusedRetire(ret, status, &retired);
+			break;
+
+		case FUSE_NONE:
+			break;
+	}
+
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	LOG_HARDWARE(LOG_INFO, "Fused sequence %d executed. PC is now at %03d", pattern, CPU.PSW.pc);
+	return retired;
+}
+
+
+// Executes the decoded instruction (or a fused sequence that fits the budget), returns the instructions retired
+static int executeDecoded(Instruction_t instruction, CPUStatus_t* status, int budget) {
+	if (fusionEnabled && budget >= FUSION_MAX_LENGTH) {
+		int retired = executeFused(instruction, status);
+		if (retired > 0) return retired;
+	}
+
+	*status = (dispatchMode == CPU_DISPATCH_THREADED) ? executeThreaded(instruction) : execute(instruction);
+	retireInstruction();
+	return 1;
+}
+
+
 bool cpuStep(void) {
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Starting CPU step at PC:%03d", CPU.PSW.pc);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Starting CPU step at PC:%03d", CPU.PSW.pc);
 
 	if (fetch()) return false;
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Fetched instruction %08d into IR", CPU.IR);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Fetched instruction %08d into IR", CPU.IR);
 	
 	Instruction_t inst = decode();
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Decoded instruction - Opcode: %02d, Mode: %01d, Value: %04d", inst.opCode, inst.direction, inst.value);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_HARDWARE(LOG_INFO, "Decoded instruction - Opcode: %02d, Mode: %01d, Value: %04d", inst.opCode, inst.direction, inst.value);
 
-	if (execute(inst)) {
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Fatal error ocurred during execution stage");
-		loggerLogHardware(LOG_ERROR, logBuffer);
+	CPUStatus_t executeStatus;
+	executeDecoded(inst, &executeStatus, FUSION_MAX_LENGTH);
+
+	if (executeStatus) {
+		LOG_HARDWARE(LOG_ERROR, "Fatal error ocurred during execution stage");
 	} else {
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Completed CPU step. PC is now at %03d", CPU.PSW.pc);
-		loggerLogHardware(LOG_INFO, logBuffer);
+		LOG_HARDWARE(LOG_INFO, "Completed CPU step. PC is now at %03d", CPU.PSW.pc);
 	}
 
-	CPU.cyclesCounter++;
-	if ((CPU.cyclesCounter >= CPU.timerLimit) && (CPU.timerLimit > 0)) {
-		CPU.cyclesCounter = 0;
-		raiseInterrupt(IC_TIMER);
+	return checkInterrupts();
+}
+
+
+CPUSliceStatus_t cpuRunSlice(int maxInstructions, int* outExecuted) {
+	CPUSliceStatus_t sliceStatus = CPU_SLICE_EXHAUSTED;
+	CPUStatus_t executeStatus;
+	int executed = 0;
+
+	while (executed < maxInstructions) {
+		if (fetch()) {
+			sliceStatus = CPU_SLICE_HALT;
+			break;
+		}
+
+		executed += executeDecoded(decode(), &executeStatus, maxInstructions - executed);
+
+		// Fast path: nothing raised, no need to go through the interrupt controller
+		if (interruptBitmap == 0 && !osYield) continue;
+
+		if (!checkInterrupts()) {
+			sliceStatus = CPU_SLICE_HALT;
+			break;
+		}
+		if (osYield) {
+			sliceStatus = CPU_SLICE_YIELD;
+			break;
+		}
 	}
 
-	return checkInterrupts();
+	if (outExecuted != NULL) *outExecuted = executed;
+
+	LOG_HARDWARE(LOG_INFO, "CPU slice ended after %d instructions (Status: %d). PC is now at %03d", executed, sliceStatus, CPU.PSW.pc);
+	return sliceStatus;
 }
 
 
@@ -759,5 +1311,6 @@ void cpuReset(void) {
 	CPU = (CPU_t){0};
 	interruptBitmap = 0;
 	interruptValue = 0;
-	loggerLogHardware(LOG_INFO, "CPU Reset: All registers and flags cleared");
+	fetchedWord = -1;
+	LOG_HARDWARE(LOG_INFO, "CPU Reset: All registers and flags cleared");
 }
@@ -1,10 +1,25 @@
 #include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "../../inc/definitions.h"
 #include "../../inc/logger.h"
 #include "../../inc/hardware/disk.h"
 
-Sector_t DISK[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];
+static Sector_t volatileDisk[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];
+Sector_t (*DISK)[DISK_CYLINDERS][DISK_SECTORS] = volatileDisk;
+
+static void* imageMapping = NULL;  // Whole image file (header + sectors) while one is attached
+
+static DiskTiming_t timing = {
+	.settleCycles = DISK_SETTLE_CYCLES,
+	.trackCycles = DISK_TRACK_CYCLES,
+	.cylinderCycles = DISK_CYLINDER_CYCLES,
+	.sectorCycles = DISK_SECTOR_CYCLES,
+	.transferCycles = DISK_TRANSFER_CYCLES,
+};
 
 DiskStatus_t readSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_t* buffer){
 	if (track >= DISK_TRACKS || cylinder >= DISK_CYLINDERS || sector >= DISK_SECTORS) {
@@ -13,7 +28,7 @@ DiskStatus_t readSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_
 		return DISK_ERR_OUT_OF_BOUNDS;
 	}
 	*buffer = DISK[track][cylinder][sector];
-	loggerLogHardware(LOG_INFO, "Disk Read: Sector read successfully");
+	LOG_HARDWARE(LOG_INFO, "Disk Read: Sector read successfully");
 	return DISK_SUCCESS;
 }
 
@@ -24,6 +39,169 @@ DiskStatus_t writeSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector
 		return DISK_ERR_OUT_OF_BOUNDS;
 	}
 	DISK[track][cylinder][sector] = data;
-	loggerLogHardware(LOG_INFO, "Disk Write: Sector written successfully");
+	LOG_HARDWARE(LOG_INFO, "Disk Write: Sector written successfully");
 	return DISK_SUCCESS;
 }
+
+
+/**
+ * @brief First sector of a run as a pointer into DISK, or NULL if the run leaves the disk.
+ */
+static Sector_t* sectorRun(uint8_t track, uint8_t cylinder, uint8_t sector, int count) {
+	if (track >= DISK_TRACKS || cylinder >= DISK_CYLINDERS || sector >= DISK_SECTORS || count < 0) return NULL;
+
+	int linear = (track * DISK_CYLINDERS + cylinder) * DISK_SECTORS + sector;
+	if (linear + count > DISK_TRACKS * DISK_CYLINDERS * DISK_SECTORS) return NULL;
+	return &DISK[0][0][0] + linear;
+}
+
+
+DiskStatus_t readSectors(uint8_t track, uint8_t cylinder, uint8_t sector, word* buffer, int count) {
+	const Sector_t* run = sectorRun(track, cylinder, sector, count);
+	if (run == NULL) {
+		loggerLogHardware(LOG_ERROR, "Disk Read Error: Sector run out of bounds");
+		return DISK_ERR_OUT_OF_BOUNDS;
+	}
+	for (int i = 0; i < count; i++) buffer[i] = run[i].data;
+	LOG_HARDWARE(LOG_INFO, "Disk Read: %d sectors read from T:%d C:%d S:%d", count, track, cylinder, sector);
+	return DISK_SUCCESS;
+}
+
+
+DiskStatus_t writeSectors(uint8_t track, uint8_t cylinder, uint8_t sector, const word* data, int count) {
+	Sector_t* run = sectorRun(track, cylinder, sector, count);
+	if (run == NULL) {
+		loggerLogHardware(LOG_ERROR, "Disk Write Error: Sector run out of bounds");
+		return DISK_ERR_OUT_OF_BOUNDS;
+	}
+	for (int i = 0; i < count; i++) run[i].data = data[i];
+	LOG_HARDWARE(LOG_INFO, "Disk Write: %d sectors written from T:%d C:%d S:%d", count, track, cylinder, sector);
+	return DISK_SUCCESS;
+}
+
+
+void diskSetTiming(const DiskTiming_t* newTiming) {
+	timing = *newTiming;
+	if (timing.sectorCycles == 0) timing.sectorCycles = 1;
+	LOG_HARDWARE(LOG_INFO, "Disk timing set: settle %u, track %u, cylinder %u, sector %u, transfer %u cycles",
+		timing.settleCycles, timing.trackCycles, timing.cylinderCycles, timing.sectorCycles, timing.transferCycles);
+}
+
+
+void diskGetTiming(DiskTiming_t* outTiming) {
+	*outTiming = timing;
+}
+
+
+uint64_t diskSeekCycles(uint8_t fromTrack, uint8_t fromCylinder, uint8_t toTrack, uint8_t toCylinder) {
+	if (fromTrack == toTrack && fromCylinder == toCylinder) return 0;
+
+	uint64_t tracks = (fromTrack > toTrack) ? fromTrack - toTrack : toTrack - fromTrack;
+	uint64_t cylinders = (fromCylinder > toCylinder) ? fromCylinder - toCylinder : toCylinder - fromCylinder;
+	return timing.settleCycles + tracks * timing.trackCycles + cylinders * timing.cylinderCycles;
+}
+
+
+uint64_t diskRotationCycles(uint64_t now, uint8_t sector) {
+	uint64_t revolution = (uint64_t)DISK_SECTORS * timing.sectorCycles;
+	uint64_t target = (uint64_t)sector * timing.sectorCycles;
+	uint64_t angle = now % revolution;
+
+	return (target >= angle) ? target - angle : revolution - angle + target;
+}
+
+
+uint64_t diskExtentCycles(uint8_t headTrack, uint8_t headCylinder, const DMASegment_t* extent, uint64_t now) {
+	uint64_t seek = diskSeekCycles(headTrack, headCylinder, extent->track, extent->cylinder);
+	uint64_t rotation = diskRotationCycles(now + seek, extent->sector);
+	int cylinderSwitches = (extent->sector + extent->length - 1) / DISK_SECTORS;
+	int trackSwitches = (extent->cylinder * DISK_SECTORS + extent->sector + extent->length - 1) / (DISK_CYLINDERS * DISK_SECTORS);
+
+	// Onto the next track the head steps one track and back to cylinder 0, as diskSeekCycles() prices it
+	uint64_t trackSwitchCycles = timing.trackCycles + (uint64_t)(DISK_CYLINDERS - 1) * timing.cylinderCycles;
+	uint64_t switches = (uint64_t)(cylinderSwitches - trackSwitches) * timing.cylinderCycles + (uint64_t)trackSwitches * trackSwitchCycles;
+
+	return seek + rotation + (uint64_t)extent->length * timing.transferCycles + switches;
+}
+
+
+/**
+ * @brief Checks that an existing image was written with the current layout and geometry.
+ */
+static bool imageHeaderMatches(const DiskImageHeader_t* header) {
+	return memcmp(header->magic, DISK_IMAGE_MAGIC, sizeof(header->magic)) == 0 &&
+	       header->version == DISK_IMAGE_VERSION &&
+	       header->tracks == DISK_TRACKS && header->cylinders == DISK_CYLINDERS &&
+	       header->sectors == DISK_SECTORS && header->sectorSize == sizeof(Sector_t);
+}
+
+
+DiskStatus_t diskAttachImage(const char* path) {
+	if (imageMapping != NULL) diskDetachImage();
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		LOG_HARDWARE(LOG_ERROR, "Disk Image Error: Cannot open '%s'", path);
+		return DISK_ERR_IMAGE;
+	}
+
+	off_t size = lseek(fd, 0, SEEK_END);
+	bool fresh = (size == 0);
+	if (fresh && ftruncate(fd, DISK_IMAGE_SIZE) != 0) {
+		LOG_HARDWARE(LOG_ERROR, "Disk Image Error: Cannot size '%s'", path);
+		close(fd);
+		return DISK_ERR_IMAGE;
+	}
+	if (!fresh && size != DISK_IMAGE_SIZE) {
+		LOG_HARDWARE(LOG_ERROR, "Disk Image Error: '%s' has %lld bytes, expected %lld", path, (long long)size, (long long)DISK_IMAGE_SIZE);
+		close(fd);
+		return DISK_ERR_IMAGE;
+	}
+
+	void* mapping = mmap(NULL, DISK_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); // The mapping keeps the file referenced
+	if (mapping == MAP_FAILED) {
+		LOG_HARDWARE(LOG_ERROR, "Disk Image Error: Cannot map '%s'", path);
+		return DISK_ERR_IMAGE;
+	}
+
+	DiskImageHeader_t* header = (DiskImageHeader_t*)mapping;
+	if (fresh) {
+		*header = (DiskImageHeader_t){ .version = DISK_IMAGE_VERSION, .tracks = DISK_TRACKS, .cylinders = DISK_CYLINDERS,
+		                               .sectors = DISK_SECTORS, .sectorSize = sizeof(Sector_t) };
+		memcpy(header->magic, DISK_IMAGE_MAGIC, sizeof(header->magic));
+	} else if (!imageHeaderMatches(header)) {
+		LOG_HARDWARE(LOG_ERROR, "Disk Image Error: '%s' is not a version %d image of this geometry", path, DISK_IMAGE_VERSION);
+		munmap(mapping, DISK_IMAGE_SIZE);
+		return DISK_ERR_IMAGE;
+	}
+
+	imageMapping = mapping;
+	DISK = (Sector_t (*)[DISK_CYLINDERS][DISK_SECTORS])((char*)mapping + DISK_IMAGE_HEADER_SIZE);
+	LOG_HARDWARE(LOG_INFO, "Disk image '%s' attached (%s)", path, fresh ? "new" : "existing");
+	return DISK_SUCCESS;
+}
+
+
+void diskSync(void) {
+	if (imageMapping != NULL) msync(imageMapping, DISK_IMAGE_SIZE, MS_SYNC);
+}
+
+
+void diskDetachImage(void) {
+	if (imageMapping == NULL) return;
+
+	// Keep the contents in use, so the running system does not see the disk change under it
+	memcpy(volatileDisk, DISK, sizeof(volatileDisk));
+	DISK = volatileDisk;
+
+	msync(imageMapping, DISK_IMAGE_SIZE, MS_SYNC);
+	munmap(imageMapping, DISK_IMAGE_SIZE);
+	imageMapping = NULL;
+	LOG_HARDWARE(LOG_INFO, "Disk image detached");
+}
+
+
+bool diskIsPersistent(void) {
+	return imageMapping != NULL;
+}
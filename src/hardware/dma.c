@@ -2,70 +2,288 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <pthread.h>
-#include <time.h>
-#include <stdlib.h>
+#include <stdint.h>
 
 #include "../../inc/logger.h"
 #include "../../inc/hardware/dma.h"
+#include "../../inc/hardware/iosched.h"
+#include "../../inc/hardware/disk.h"
 #include "../../inc/hardware/cpu.h"
 #include "../../inc/hardware/memory.h"
 
 DMA_t DMA;
 pthread_cond_t DMA_COND;
-static char logBuffer[LOG_BUFFER_SIZE];
+
+static uint64_t trackWrites[DISK_TRACKS];  // Guarded by BUS_LOCK
+
+/**
+ * @brief Moves one word of an extent between disk and RAM.
+ * Takes BUS_LOCK per word so the CPU can use the bus between cycles. The
+ * trace record carries the PID that owns the transfer, not the running one.
+ */
+static MemoryStatus_t transferWord(uint8_t ioDirection, int sectorIndex, address memAddr, int ownerPid) {
+	Sector_t* sector = &DISK[sectorIndex / (DISK_CYLINDERS * DISK_SECTORS)][(sectorIndex / DISK_SECTORS) % DISK_CYLINDERS][sectorIndex % DISK_SECTORS];
+	MemoryStatus_t status;
+	word data;
+
+	if (ioDirection == 1) {
+		status = dmaReadMemory(memAddr, &data);
+		if (status == MEM_SUCCESS) {
+			LOG_TRACE_AS(TRACE_DMA_READ, ownerPid, 0, memAddr, data, 0, "DMA Phys-Read at [%d] = %08d", memAddr, data);
+			pthread_mutex_lock(&BUS_LOCK);
+			sector->data = data;
+			trackWrites[sectorIndex / (DISK_CYLINDERS * DISK_SECTORS)]++;
+			pthread_mutex_unlock(&BUS_LOCK);
+		}
+	} else {
+		pthread_mutex_lock(&BUS_LOCK);
+		data = sector->data;
+		pthread_mutex_unlock(&BUS_LOCK);
+		status = dmaWriteMemory(memAddr, data);
+		if (status == MEM_SUCCESS) {
+			LOG_TRACE_AS(TRACE_DMA_WRITE, ownerPid, 0, memAddr, data, 0, "DMA Phys-Write at [%d] = %08d", memAddr, data);
+		}
+	}
+
+	return status;
+}
+
+
+/**
+ * @brief Moves the words of every extent with the bus released.
+ * The first failure ends the burst.
+ *
+ * @return MEM_SUCCESS, or the status of the word that failed.
+ */
+static MemoryStatus_t transferBurst(int slot, const DMARequest_t* transfer) {
+	for (int s = 0; s < transfer->segmentCount; s++) {
+		const DMASegment_t* segment = &transfer->segments[s];
+		int first = dmaSegmentStart(segment);
+
+		for (int w = 0; w < segment->length; w++) {
+			MemoryStatus_t status = transferWord(transfer->ioDirection, first + w, segment->memAddr + w, transfer->ownerPid);
+			if (status != MEM_SUCCESS) {
+				LOG_HARDWARE(LOG_ERROR, "DMA Transfer failed [%d]: Invalid memory address 0x%04X", slot, segment->memAddr + w);
+				return status;
+			}
+		}
+	}
+
+	return MEM_SUCCESS;
+}
+
+
+/**
+ * @brief Prices a burst with the disk timing model and moves the head along.
+ * Extents are served back to back from the start cycle.
+ *
+ * @param outTravel Receives the head positions crossed by the burst.
+ * @return The virtual cycle at which the last extent is transferred.
+ */
+static uint64_t scheduleBurst(const DMARequest_t* transfer, uint64_t start, int* outTravel) {
+	DiskHead_t head;
+	ioschedGetHeadState(&head);
+
+	uint64_t now = start;
+	int position = head.position;
+	*outTravel = 0;
+
+	// A SCAN sweep to the edge of the disk is paid before the first seek
+	if (head.pendingTravel > 0) {
+		int origin = head.position + head.direction * head.pendingTravel;
+		now += diskSeekCycles(origin / DISK_CYLINDERS, origin % DISK_CYLINDERS, position / DISK_CYLINDERS, position % DISK_CYLINDERS);
+	}
+
+	for (int s = 0; s < transfer->segmentCount; s++) {
+		const DMASegment_t* segment = &transfer->segments[s];
+
+		now += diskExtentCycles(position / DISK_CYLINDERS, position % DISK_CYLINDERS, segment, now);
+		*outTravel += ioschedSeek(ioschedPosition(segment->track, segment->cylinder));
+
+		// The transfer carries the head along when the extent runs onto the next cylinders
+		position = (dmaSegmentStart(segment) + segment->length - 1) / DISK_SECTORS;
+		*outTravel += ioschedSeek(position);
+	}
+
+	return now;
+}
+
+
+/**
+ * @brief Picks the next descriptor among those submitted by the time the disk is free (BUS_LOCK held).
+ * If the disk went idle first, only the earliest submission is due. The choice then
+ * follows the virtual clock rather than the host timing of the worker thread.
+ *
+ * @return The descriptor index, or -1 if nothing is queued.
+ */
+static int nextDueRequest(IOSchedPolicy_t* outPolicy) {
+	DMARequest_t view[DMA_QUEUE_DEPTH];
+	uint64_t horizon = DMA.busyUntil;
+	uint64_t earliest = UINT64_MAX;
+
+	for (int i = 0; i < DMA_QUEUE_DEPTH; i++) {
+		if (DMA.queue[i].state == DMA_REQ_QUEUED && DMA.queue[i].submitCycle < earliest) earliest = DMA.queue[i].submitCycle;
+	}
+	if (earliest == UINT64_MAX) return -1;
+	if (earliest > horizon) horizon = earliest;
+
+	for (int i = 0; i < DMA_QUEUE_DEPTH; i++) {
+		view[i] = DMA.queue[i];
+		if (view[i].state == DMA_REQ_QUEUED && view[i].submitCycle > horizon) view[i].state = DMA_REQ_FREE;
+	}
+
+	return ioschedNextRequest(view, DMA_QUEUE_DEPTH, outPolicy);
+}
+
 
 void *dmaInit(void* tmp) {
-	srand(time(NULL));
 	pthread_cond_init(&DMA_COND, NULL);
-	loggerLogHardware(LOG_INFO, "DMA Controller initialized and worker thread started");
+	LOG_HARDWARE(LOG_INFO, "DMA Controller initialized and worker thread started");
 	dmaReset();
 
 	while (true) {
 		pthread_mutex_lock(&BUS_LOCK);
 
-		while (!DMA.pending) pthread_cond_wait(&DMA_COND, &BUS_LOCK);
+		int slot;
+		IOSchedPolicy_t policy;
+		while ((slot = nextDueRequest(&policy)) == -1) pthread_cond_wait(&DMA_COND, &BUS_LOCK);
 
-		DMA.status = 0;
-		DMA.active = true;
+		DMARequest_t* request = &DMA.queue[slot];
+		uint64_t start = (request->submitCycle > DMA.busyUntil) ? request->submitCycle : DMA.busyUntil;
+		int travel;
 
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "DMA Transfer started: %s | MemAddr: 0x%04X | Disk: [T:%d, C:%d, S:%d]",
-			(DMA.ioDirection == 1 ? "MEM_TO_DISK" : "DISK_TO_MEM"), DMA.memAddr, DMA.track, DMA.cylinder, DMA.sector);
-		loggerLogHardware(LOG_INFO, logBuffer);
+		LOG_HARDWARE(LOG_INFO, "DMA Transfer started [%d]: %s | MemAddr: 0x%04X | Disk: [T:%d, C:%d, S:%d] | Words: %d in %d extent(s) | Head %d (%s) | PID %d", slot,
+			(request->ioDirection == 1 ? "MEM_TO_DISK" : "DISK_TO_MEM"), request->segments[0].memAddr, request->segments[0].track, request->segments[0].cylinder,
+			request->segments[0].sector, dmaBurstWords(request), request->segmentCount, ioschedGetHead(), ioschedPolicyName(policy), request->ownerPid);
 
-		usleep(50000 + (rand() % 100000)); // Simulate search time
-		
-		word data;
-		MemoryStatus_t status;
+		request->state = DMA_REQ_ACTIVE;
+		request->completeCycle = scheduleBurst(request, start, &travel);
+		DMA.busyUntil = request->completeCycle;
+		DMA.active = true;
+		DMARequest_t transfer = *request;
 
-		if (DMA.ioDirection == 1) {
-			pthread_mutex_unlock(&BUS_LOCK);
-			status = dmaReadMemory(DMA.memAddr, &data);
-			pthread_mutex_lock(&BUS_LOCK);
-			if (status == MEM_SUCCESS) DISK[DMA.track][DMA.cylinder][DMA.sector].data = data;
-		} else {
-			data = DISK[DMA.track][DMA.cylinder][DMA.sector].data;
-			pthread_mutex_unlock(&BUS_LOCK);
-			status = dmaWriteMemory(DMA.memAddr, data);
-			pthread_mutex_lock(&BUS_LOCK);
-		}
+		// The CPU keeps running while the access takes place in virtual time
+		pthread_mutex_unlock(&BUS_LOCK);
+		while (cpuGetVirtualCycles() < transfer.completeCycle) usleep(DMA_CLOCK_POLL_US);
 
-		if (status != MEM_SUCCESS) {
-			DMA.status = 1;
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "DMA Transfer failed: Invalid memory address 0x%04X", DMA.memAddr);
-			loggerLogHardware(LOG_ERROR, logBuffer);
-			raiseInterrupt(IC_INVALID_ADDR);
-		} else {
-			loggerLogHardware(LOG_INFO, "DMA Transfer completed successfully");
-			raiseInterrupt(IC_IO_DONE);
-		}
+		// The data lands when the access ends; the bus stays free between words
+		MemoryStatus_t status = transferBurst(slot, &transfer);
 
+		pthread_mutex_lock(&BUS_LOCK);
+		ioschedRecordService(policy, transfer.completeCycle - transfer.submitCycle, travel);
+
+		// The requester is blocked, not running: the outcome is reported in the descriptor
+		request->status = (status == MEM_SUCCESS) ? 0 : 1;
+		request->state = DMA_REQ_DONE;
+		DMA.status = request->status;
+		DMA.outstanding--;
 		DMA.active = false;
-		DMA.pending = false;
+		DMA.pending = DMA.outstanding > 0;
+
+		if (status == MEM_SUCCESS) {
+			LOG_HARDWARE(LOG_INFO, "DMA Transfer completed successfully [%d] at cycle %llu (%llu cycles)", slot,
+				(unsigned long long)transfer.completeCycle, (unsigned long long)(transfer.completeCycle - transfer.submitCycle));
+		}
+		// The completion is reaped by the scheduler: no interrupt is injected into whichever process is running
 		pthread_mutex_unlock(&BUS_LOCK);
 	}
 }
 
 void dmaReset(void) {
 	DMA = (DMA_t){0};
-	loggerLogHardware(LOG_INFO, "DMA registers have been reset to default values");
+	ioschedResetHead();
+	LOG_HARDWARE(LOG_INFO, "DMA registers have been reset to default values");
+}
+
+DMAStatus_t dmaSubmitBurst(const DMASegment_t* segments, int count, uint8_t ioDirection, int ownerPid, int* outSlot) {
+	if (segments == NULL || count < 1 || count > DMA_MAX_SEGMENTS || ioDirection > 1) return DMA_ERR_INVALID_GEOM;
+
+	DMARequest_t request = { .ioDirection = ioDirection, .segmentCount = count, .ownerPid = ownerPid };
+	for (int i = 0; i < count; i++) {
+		if (!dmaSegmentIsValid(&segments[i])) {
+			LOG_HARDWARE(LOG_WARNING, "DMA burst rejected: extent %d is outside the disk or RAM", i);
+			return DMA_ERR_INVALID_GEOM;
+		}
+		request.segments[i] = segments[i];
+	}
+
+	pthread_mutex_lock(&BUS_LOCK);
+	int slot = dmaEnqueueLocked(&request);
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	if (slot < 0) return DMA_ERR_QUEUE_FULL;
+	if (outSlot != NULL) *outSlot = slot;
+
+	LOG_HARDWARE(LOG_INFO, "DMA Queued [%d]: burst of %d word(s) in %d extent(s) (PID %d)", slot, dmaBurstWords(&request), count, ownerPid);
+	return DMA_SUCCESS;
+}
+
+uint64_t dmaBusyUntil(void) {
+	pthread_mutex_lock(&BUS_LOCK);
+	uint64_t busyUntil = DMA.busyUntil;
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	return busyUntil;
+}
+
+bool dmaReapCompletion(DMARequest_t* outRequest) {
+	int selected = -1;
+
+	pthread_mutex_lock(&BUS_LOCK);
+	for (int i = 0; i < DMA_QUEUE_DEPTH; i++) {
+		if (DMA.queue[i].state != DMA_REQ_DONE) continue;
+		if (selected == -1 || DMA.queue[i].sequence < DMA.queue[selected].sequence) selected = i;
+	}
+	if (selected != -1) {
+		*outRequest = DMA.queue[selected];
+		DMA.queue[selected].state = DMA_REQ_FREE;
+	}
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	return selected != -1;
+}
+
+bool dmaHasRequest(int pid) {
+	bool found = false;
+
+	pthread_mutex_lock(&BUS_LOCK);
+	for (int i = 0; i < DMA_QUEUE_DEPTH && !found; i++) {
+		found = DMA.queue[i].state != DMA_REQ_FREE && DMA.queue[i].ownerPid == pid;
+	}
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	return found;
+}
+
+void dmaSaveRegisters(DMARequest_t* outRegisters) {
+	*outRegisters = (DMARequest_t){
+		.ioDirection = DMA.ioDirection,
+		.segmentCount = 1,
+		.segments[0] = {
+			.track = DMA.track,
+			.cylinder = DMA.cylinder,
+			.sector = DMA.sector,
+			.memAddr = DMA.memAddr,
+			.length = DMA.length,
+		},
+	};
+}
+
+void dmaLoadRegisters(const DMARequest_t* registers, int pid) {
+	DMA.track = registers->segments[0].track;
+	DMA.cylinder = registers->segments[0].cylinder;
+	DMA.sector = registers->segments[0].sector;
+	DMA.ioDirection = registers->ioDirection;
+	DMA.memAddr = registers->segments[0].memAddr;
+	DMA.length = registers->segments[0].length;
+	DMA.requesterPid = pid;
+}
+
+uint64_t dmaDiskWrites(uint8_t track) {
+	if (track >= DISK_TRACKS) return 0;
+
+	pthread_mutex_lock(&BUS_LOCK);
+	uint64_t writes = trackWrites[track];
+	pthread_mutex_unlock(&BUS_LOCK);
+	return writes;
 }
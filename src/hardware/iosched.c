@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../../inc/hardware/iosched.h"
+
+typedef struct {
+	unsigned long completed;
+	uint64_t totalCycles;
+	uint64_t maxCycles;
+	uint64_t headTravel;
+	uint64_t samples[IOSCHED_SAMPLE_WINDOW];  // Ring of the most recent service times
+} PolicyStats_t;
+
+static const char* POLICY_NAMES[IOSCHED_POLICY_COUNT] = {
+	[IOSCHED_FIFO]  = "fifo",
+	[IOSCHED_SSTF]  = "sstf",
+	[IOSCHED_SCAN]  = "scan",
+	[IOSCHED_CLOOK] = "clook",
+};
+
+static pthread_mutex_t IOSCHED_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static DiskHead_t head = { .position = 0, .direction = 1, .pendingTravel = 0 };
+static IOSchedPolicy_t activePolicy = IOSCHED_FIFO;
+static PolicyStats_t stats[IOSCHED_POLICY_COUNT];
+
+
+static int requestPosition(const DMARequest_t* request) {
+	return ioschedPosition(request->segments[0].track, request->segments[0].cylinder);
+}
+
+
+/**
+ * @brief Returns the closest QUEUED descriptor within [low, high], oldest first on ties.
+ */
+static int closestInRange(const DMARequest_t* queue, int depth, int from, int low, int high) {
+	int selected = -1;
+	int bestDistance = 0;
+
+	for (int i = 0; i < depth; i++) {
+		if (queue[i].state != DMA_REQ_QUEUED) continue;
+
+		int position = requestPosition(&queue[i]);
+		if (position < low || position > high) continue;
+
+		int distance = abs(position - from);
+		if (selected == -1 || distance < bestDistance ||
+		    (distance == bestDistance && queue[i].sequence < queue[selected].sequence)) {
+			selected = i;
+			bestDistance = distance;
+		}
+	}
+
+	return selected;
+}
+
+
+int ioschedPick(const DMARequest_t* queue, int depth, IOSchedPolicy_t policy, DiskHead_t* diskHead) {
+	int selected = -1;
+	int last = IOSCHED_POSITIONS - 1;
+
+	switch (policy) {
+		case IOSCHED_SSTF:
+			return closestInRange(queue, depth, diskHead->position, 0, last);
+
+		case IOSCHED_SCAN:
+			if (diskHead->direction > 0) selected = closestInRange(queue, depth, diskHead->position, diskHead->position, last);
+			else selected = closestInRange(queue, depth, diskHead->position, 0, diskHead->position);
+			if (selected != -1 || closestInRange(queue, depth, 0, 0, last) == -1) return selected;
+
+			// Nothing left ahead: finish the sweep at the edge and turn around
+			int edge = (diskHead->direction > 0) ? last : 0;
+			diskHead->pendingTravel += abs(edge - diskHead->position);
+			diskHead->position = edge;
+			diskHead->direction = -diskHead->direction;
+			return closestInRange(queue, depth, edge, 0, last);
+
+		case IOSCHED_CLOOK:
+			selected = closestInRange(queue, depth, diskHead->position, diskHead->position, last);
+			if (selected != -1) return selected;
+			return closestInRange(queue, depth, 0, 0, last);
+
+		case IOSCHED_FIFO:
+		default:
+			for (int i = 0; i < depth; i++) {
+				if (queue[i].state != DMA_REQ_QUEUED) continue;
+				if (selected == -1 || queue[i].sequence < queue[selected].sequence) selected = i;
+			}
+			return selected;
+	}
+}
+
+
+int ioschedNextRequest(const DMARequest_t* queue, int depth, IOSchedPolicy_t* outPolicy) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	IOSchedPolicy_t policy = activePolicy;
+	int selected = ioschedPick(queue, depth, policy, &head);
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+
+	if (outPolicy != NULL) *outPolicy = policy;
+	return selected;
+}
+
+
+int ioschedSeek(int position) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	int travel = head.pendingTravel + abs(position - head.position);
+	head.position = position;
+	head.pendingTravel = 0;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+
+	return travel;
+}
+
+
+void ioschedResetHead(void) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	head = (DiskHead_t){ .position = 0, .direction = 1, .pendingTravel = 0 };
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
+
+
+void ioschedGetHeadState(DiskHead_t* outHead) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	*outHead = head;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
+
+
+int ioschedGetHead(void) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	int position = head.position;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+
+	return position;
+}
+
+
+void ioschedSetPolicy(IOSchedPolicy_t policy) {
+	if (policy < 0 || policy >= IOSCHED_POLICY_COUNT) return;
+
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	activePolicy = policy;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
+
+
+IOSchedPolicy_t ioschedGetPolicy(void) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	IOSchedPolicy_t policy = activePolicy;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+
+	return policy;
+}
+
+
+const char* ioschedPolicyName(IOSchedPolicy_t policy) {
+	if (policy < 0 || policy >= IOSCHED_POLICY_COUNT) return "unknown";
+	return POLICY_NAMES[policy];
+}
+
+
+bool ioschedParsePolicy(const char* name, IOSchedPolicy_t* outPolicy) {
+	for (int i = 0; i < IOSCHED_POLICY_COUNT; i++) {
+		if (strcmp(name, POLICY_NAMES[i]) == 0) {
+			*outPolicy = (IOSchedPolicy_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void ioschedRecordService(IOSchedPolicy_t policy, uint64_t serviceCycles, int travel) {
+	if (policy < 0 || policy >= IOSCHED_POLICY_COUNT) return;
+
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	PolicyStats_t* entry = &stats[policy];
+	entry->samples[entry->completed % IOSCHED_SAMPLE_WINDOW] = serviceCycles;
+	entry->completed++;
+	entry->totalCycles += serviceCycles;
+	entry->headTravel += travel;
+	if (serviceCycles > entry->maxCycles) entry->maxCycles = serviceCycles;
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
+
+
+static int compareSamples(const void* a, const void* b) {
+	uint64_t left = *(const uint64_t*)a;
+	uint64_t right = *(const uint64_t*)b;
+	return (left > right) - (left < right);
+}
+
+
+/**
+ * @brief Nearest-rank percentile of an ascending sample array.
+ */
+static uint64_t percentile(const uint64_t* sorted, int count, int percent) {
+	int rank = (count * percent + 99) / 100;
+	return sorted[(rank > 0 ? rank : 1) - 1];
+}
+
+
+void ioschedGetReport(IOSchedPolicy_t policy, IOSchedReport_t* outReport) {
+	static uint64_t sorted[IOSCHED_SAMPLE_WINDOW];
+
+	*outReport = (IOSchedReport_t){0};
+	if (policy < 0 || policy >= IOSCHED_POLICY_COUNT) return;
+
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	const PolicyStats_t* entry = &stats[policy];
+	int count = (entry->completed < IOSCHED_SAMPLE_WINDOW) ? (int)entry->completed : IOSCHED_SAMPLE_WINDOW;
+
+	outReport->completed = entry->completed;
+	outReport->maxCycles = entry->maxCycles;
+	outReport->headTravel = entry->headTravel;
+	if (count > 0) {
+		outReport->meanCycles = entry->totalCycles / entry->completed;
+		memcpy(sorted, entry->samples, count * sizeof(uint64_t));
+		qsort(sorted, count, sizeof(uint64_t), compareSamples);
+		outReport->p95Cycles = percentile(sorted, count, 95);
+		outReport->p99Cycles = percentile(sorted, count, 99);
+	}
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
+
+
+void ioschedResetStats(void) {
+	pthread_mutex_lock(&IOSCHED_LOCK);
+	memset(stats, 0, sizeof(stats));
+	pthread_mutex_unlock(&IOSCHED_LOCK);
+}
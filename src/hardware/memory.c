@@ -8,11 +8,23 @@
 
 word RAM[RAM_SIZE];
 pthread_mutex_t BUS_LOCK;
-static char logBuffer[LOG_BUFFER_SIZE];
+
+/**
+ * @brief Predecoded form of a physical RAM word.
+ * Entries are filled by the instruction fetch path and discarded by any write to the word.
+ */
+typedef struct {
+	word raw;                   /**< Word the entry was decoded from */
+	Instruction_t instruction;  /**< Decoded OpCode, mode and value */
+	bool valid;                 /**< False until filled, and again after a write */
+} DecodeCacheEntry_t;
+
+static DecodeCacheEntry_t decodeCache[RAM_SIZE];
+static DecodeCacheStats_t decodeCacheStats;
 
 void memoryInit(void) {
 	pthread_mutex_init(&BUS_LOCK, NULL);
-	loggerLogHardware(LOG_INFO, "Memory Subsystem Initialized");
+	LOG_HARDWARE(LOG_INFO, "Memory Subsystem Initialized");
 }
 
 
@@ -31,16 +43,39 @@ static bool isProtectionViolation(int physAddr) {
 }
 
 
-static int getPhysicalAddress(address logicalAddr, MemoryStatus_t* status) {
-	int physAddr;
+static bool isSharedText(address logicalAddr) {
+	return CPU.PSW.mode != MODE_KERNEL && logicalAddr >= 0 && logicalAddr < CPU.TL;
+}
 
-	// Translate: Absolute addressing for Kernel, Relative for User
-	if (CPU.PSW.mode == MODE_KERNEL) physAddr = logicalAddr;
-	else physAddr = logicalAddr + CPU.RB;
 
-	if (isProtectionViolation(physAddr)) {
-		*status = MEM_ERR_PROTECTION;
-		return -1;
+// Must be called with BUS_LOCK held
+static void invalidateDecodedWord(int physAddr) {
+	if (decodeCache[physAddr].valid) {
+		decodeCache[physAddr].valid = false;
+		decodeCacheStats.invalidations++;
+	}
+}
+
+
+static int getPhysicalAddress(address logicalAddr, bool isWrite, MemoryStatus_t* status) {
+	int physAddr;
+
+	// Translate: Absolute addressing for Kernel, Relative for User.
+	// A User process with shared text sees it at [0, TL) and its partition from TL on.
+	if (CPU.PSW.mode == MODE_KERNEL) {
+		physAddr = logicalAddr;
+	} else if (isSharedText(logicalAddr)) {
+		if (isWrite) {
+			*status = MEM_ERR_PROTECTION;
+			return -1;
+		}
+		physAddr = CPU.TB + logicalAddr;
+	} else {
+		physAddr = logicalAddr - CPU.TL + CPU.RB;
+		if (isProtectionViolation(physAddr)) {
+			*status = MEM_ERR_PROTECTION;
+			return -1;
+		}
 	}
 
 	if (!isPhysicalAddressValid(physAddr)) {
@@ -53,81 +88,146 @@ static int getPhysicalAddress(address logicalAddr, MemoryStatus_t* status) {
 }
 
 
-MemoryStatus_t readMemory(address logicalAddr, word* outData) {
-	char logBuffer[LOG_BUFFER_SIZE];
-	
-	pthread_mutex_lock(&BUS_LOCK);
+static void logAccessFault(const char* operation, address logicalAddr, MemoryStatus_t status) {
+	if (status == MEM_ERR_PROTECTION && isSharedText(logicalAddr)) {
+		LOG_HARDWARE(LOG_ERROR, "Segmentation Fault (%s):", operation);
+		LOG_HARDWARE(LOG_ERROR, "Write to read-only shared text at LogicAddr [%d]. Text [TB:%d, TL:%d]", logicalAddr, CPU.TB, CPU.TL);
+	} else if (status == MEM_ERR_PROTECTION) {
+		LOG_HARDWARE(LOG_ERROR, "Segmentation Fault (%s):", operation);
+		LOG_HARDWARE(LOG_ERROR, "Access Violation at LogicAddr [%d]. Limits [RB:%d, RL:%d]", logicalAddr, CPU.RB, CPU.RL);
+	} else {
+		LOG_HARDWARE(LOG_ERROR, "Bus Error (%s): ", operation);
+		LOG_HARDWARE(LOG_ERROR, "Physical Address translation failed for LogicAddr [%d]", logicalAddr);
+	}
+}
+
 
+MemoryStatus_t readMemoryLocked(address logicalAddr, word* outData) {
 	MemoryStatus_t status;
-	int physAddr = getPhysicalAddress(logicalAddr, &status);
+	int physAddr = getPhysicalAddress(logicalAddr, false, &status);
 
 	if (status != MEM_SUCCESS) {
-		pthread_mutex_unlock(&BUS_LOCK);
-		
-		if (status == MEM_ERR_PROTECTION) {
-			loggerLogHardware(LOG_ERROR, "Segmentation Fault (READ):");
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "Access Violation at LogicAddr [%d]. Limits [RB:%d, RL:%d]", logicalAddr, CPU.RB, CPU.RL);
-			loggerLogHardware(LOG_ERROR, logBuffer);
-		} else {
-			loggerLogHardware(LOG_ERROR, "Bus Error (READ): ");
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "Physical Address translation failed for LogicAddr [%d]", logicalAddr);
-			loggerLogHardware(LOG_ERROR, logBuffer);
-		}
+		logAccessFault("READ", logicalAddr, status);
 		return status;
 	}
 
 	*outData = RAM[physAddr];
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "READ: Logical[%d] -> Physical[%d] = Value[%08d]", logicalAddr, physAddr, *outData);
-	loggerLogHardware(LOG_INFO, logBuffer);
+	LOG_TRACE(TRACE_MEM_READ, logicalAddr, physAddr, *outData, "READ: Logical[%d] -> Physical[%d] = Value[%08d]", logicalAddr, physAddr, *outData);
 
-	pthread_mutex_unlock(&BUS_LOCK);
 	return MEM_SUCCESS;
 }
 
 
-MemoryStatus_t writeMemory(address logicalAddr, word data) {
-	char logBuffer[LOG_BUFFER_SIZE];
-	
-	pthread_mutex_lock(&BUS_LOCK);
-
+MemoryStatus_t writeMemoryLocked(address logicalAddr, word data) {
 	// Validate data structure (Sign bit + 7 magnitude digits)
 	if (!IS_VALID_INSTRUCTION(data)) {
-		pthread_mutex_unlock(&BUS_LOCK);
 		loggerLogHardware(LOG_ERROR, "Memory Data Error: ");
-		snprintf(logBuffer, LOG_BUFFER_SIZE, "Attempted to write invalid word [%d]. Max magnitude is 7 digits.", data);
-		loggerLogHardware(LOG_ERROR, logBuffer);
+		LOG_HARDWARE(LOG_ERROR, "Attempted to write invalid word [%d]. Max magnitude is 7 digits.", data);
 		return MEM_ERR_INVALID_DATA;
 	}
 
 	MemoryStatus_t status;
-	int physAddr = getPhysicalAddress(logicalAddr, &status);
+	int physAddr = getPhysicalAddress(logicalAddr, true, &status);
 
 	if (status != MEM_SUCCESS) {
-		pthread_mutex_unlock(&BUS_LOCK);
-		
-		if (status == MEM_ERR_PROTECTION) {
-			loggerLogHardware(LOG_ERROR, "Segmentation Fault (WRITE): ");
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "Access Violation at LogicAddr [%d]. Limits [RB:%d, RL:%d]", logicalAddr, CPU.RB, CPU.RL);
-			loggerLogHardware(LOG_ERROR, logBuffer);
-		} else {
-			loggerLogHardware(LOG_ERROR, "Bus Error (WRITE): ");
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "Physical Address translation failed for LogicAddr [%d]", logicalAddr);
-			loggerLogHardware(LOG_ERROR, logBuffer);
-		}
+		logAccessFault("WRITE", logicalAddr, status);
 		return status;
 	}
 
 	RAM[physAddr] = data;
+	invalidateDecodedWord(physAddr);
+
+	LOG_TRACE(TRACE_MEM_WRITE, logicalAddr, physAddr, data, "WRITE: Logical[%d] -> Physical[%d] = Value[%08d]", logicalAddr, physAddr, data);
+
+	return MEM_SUCCESS;
+}
+
+
+MemoryStatus_t readMemory(address logicalAddr, word* outData) {
+	pthread_mutex_lock(&BUS_LOCK);
+	MemoryStatus_t status = readMemoryLocked(logicalAddr, outData);
+	pthread_mutex_unlock(&BUS_LOCK);
+	return status;
+}
+
+
+MemoryStatus_t writeMemory(address logicalAddr, word data) {
+	pthread_mutex_lock(&BUS_LOCK);
+	MemoryStatus_t status = writeMemoryLocked(logicalAddr, data);
+	pthread_mutex_unlock(&BUS_LOCK);
+	return status;
+}
+
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "WRITE: Logical[%d] -> Physical[%d] = Value[%08d]", logicalAddr, physAddr, data);
-	loggerLogHardware(LOG_INFO, logBuffer);
+MemoryStatus_t fetchInstruction(address logicalAddr, word* outData, Instruction_t* outInstruction) {
+	MemoryStatus_t status;
+	int physAddr = getPhysicalAddress(logicalAddr, false, &status);
+
+	// Hot path: the entry is only refilled by this (CPU) thread, other threads can just clear it
+	if (status == MEM_SUCCESS && decodeCache[physAddr].valid) {
+		*outData = decodeCache[physAddr].raw;
+		*outInstruction = decodeCache[physAddr].instruction;
+		decodeCacheStats.hits++;
+		return MEM_SUCCESS;
+	}
+
+	status = readMemory(logicalAddr, outData);
+	if (status != MEM_SUCCESS) return status;
 
+	outInstruction->opCode = GET_INSTRUCTION_OPCODE(*outData);
+	outInstruction->direction = GET_INSTRUCTION_MODE(*outData);
+	outInstruction->value = GET_INSTRUCTION_VALUE(*outData);
+
+	pthread_mutex_lock(&BUS_LOCK);
+	decodeCacheStats.misses++;
+	// Only cache the word if nobody (e.g. DMA) overwrote it after it was read
+	if (RAM[physAddr] == *outData) {
+		decodeCache[physAddr].raw = *outData;
+		decodeCache[physAddr].instruction = *outInstruction;
+		decodeCache[physAddr].valid = true;
+	}
 	pthread_mutex_unlock(&BUS_LOCK);
+
+	return MEM_SUCCESS;
+}
+
+
+MemoryStatus_t peekInstruction(address logicalAddr, word* outData, Instruction_t* outInstruction) {
+	MemoryStatus_t status;
+	int physAddr = getPhysicalAddress(logicalAddr, false, &status);
+	if (status != MEM_SUCCESS) return status;
+
+	// Lookahead must not skew the fetch counters, it only shares (and warms) the entries
+	if (!decodeCache[physAddr].valid) {
+		pthread_mutex_lock(&BUS_LOCK);
+		decodeCache[physAddr].raw = RAM[physAddr];
+		decodeCache[physAddr].instruction.opCode = GET_INSTRUCTION_OPCODE(RAM[physAddr]);
+		decodeCache[physAddr].instruction.direction = GET_INSTRUCTION_MODE(RAM[physAddr]);
+		decodeCache[physAddr].instruction.value = GET_INSTRUCTION_VALUE(RAM[physAddr]);
+		decodeCache[physAddr].valid = true;
+		pthread_mutex_unlock(&BUS_LOCK);
+	}
+
+	*outData = decodeCache[physAddr].raw;
+	*outInstruction = decodeCache[physAddr].instruction;
 	return MEM_SUCCESS;
 }
 
 
+void decodeCacheFlush(void) {
+	pthread_mutex_lock(&BUS_LOCK);
+	memset(decodeCache, 0, sizeof(decodeCache));
+	decodeCacheStats = (DecodeCacheStats_t){0};
+	pthread_mutex_unlock(&BUS_LOCK);
+}
+
+
+DecodeCacheStats_t decodeCacheGetStats(void) {
+	return decodeCacheStats;
+}
+
+
 MemoryStatus_t dmaReadMemory(address physAddr, word* outData) {
     pthread_mutex_lock(&BUS_LOCK);
 
@@ -138,9 +238,6 @@ MemoryStatus_t dmaReadMemory(address physAddr, word* outData) {
 
     *outData = RAM[physAddr];
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "DMA Phys-Read at [%d] = %08d", physAddr, *outData);
-	loggerLogHardware(LOG_INFO, logBuffer);
-
     pthread_mutex_unlock(&BUS_LOCK);
     return MEM_SUCCESS;
 }
@@ -154,15 +251,29 @@ MemoryStatus_t dmaWriteMemory(address physAddr, word data) {
     }
 
     RAM[physAddr] = data;
-
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "DMA Phys-Write at [%d] = %08d", physAddr, data);
-	loggerLogHardware(LOG_INFO, logBuffer);
+    invalidateDecodedWord(physAddr);
 
     pthread_mutex_unlock(&BUS_LOCK);
     return MEM_SUCCESS;
 }
 
+MemoryStatus_t dmaWriteBlock(address physAddr, const word* data, int count) {
+	if (count < 0 || !isPhysicalAddressValid(physAddr) || (count > 0 && !isPhysicalAddressValid(physAddr + count - 1))) {
+		return MEM_ERR_OUT_OF_BOUNDS;
+	}
+
+	pthread_mutex_lock(&BUS_LOCK);
+	memcpy(&RAM[physAddr], data, count * sizeof(word));
+	for (int i = 0; i < count; i++) invalidateDecodedWord(physAddr + i);
+	pthread_mutex_unlock(&BUS_LOCK);
+
+	LOG_HARDWARE(LOG_INFO, "DMA Block-Write: %d words at [%d..%d]", count, physAddr, physAddr + count - 1);
+	return MEM_SUCCESS;
+}
+
+
 void memoryReset(void) {
 	memset(RAM, 0, sizeof(RAM));
-	loggerLogHardware(LOG_INFO, "Memory Reset: All RAM positions cleared to 0");
+	decodeCacheFlush();
+	LOG_HARDWARE(LOG_INFO, "Memory Reset: All RAM positions cleared to 0");
 }
@@ -1,24 +1,79 @@
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <string.h>
 #include "../../inc/logger.h"
 #include "../../inc/hardware/disk.h"
 #include "../../inc/hardware/memory.h"
 #include "../../inc/hardware/cpu.h"
+#include "../../inc/hardware/dma.h"
 #include "../../inc/kernel/core.h"
 #include "../../inc/kernel/mmu.h"
 #include "../../inc/kernel/vfs.h"
+#include "../../inc/kernel/imagecache.h"
 #include "../../inc/kernel/scheduler.h"
 
 PCB_t PROCESS_TABLE[MAX_PROCESSES];
 int currentActiveProcess = -1;
 bool osYield = false;
+bool osDMAWait = false;
 
 static bool osRunning = false;
 static int nextPid = 1;
 static pthread_t cpuThread;
+static unsigned long clockRate = CPU_DEFAULT_CLOCK_IPS;
+
+
+/**
+ * @brief Instructions run between two pacing sleeps at the given rate.
+ */
+static int pacingBatchSize(unsigned long rate) {
+	if (rate == CPU_CLOCK_TURBO) return CPU_SLICE_MAX_INSTRUCTIONS;
+
+	unsigned long batch = rate / CPU_PACING_TICKS_PER_SEC;
+	if (batch < 1) return 1;
+	if (batch > CPU_SLICE_MAX_INSTRUCTIONS) return CPU_SLICE_MAX_INSTRUCTIONS;
+	return (int)batch;
+}
+
+
+static void addNanoseconds(struct timespec* t, long long ns) {
+	ns += t->tv_nsec;
+	t->tv_sec += ns / 1000000000LL;
+	t->tv_nsec = ns % 1000000000LL;
+}
+
+
+static long long elapsedNanoseconds(const struct timespec* from, const struct timespec* to) {
+	return (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+}
+
+
+/**
+ * @brief Sleeps until the executed instructions are due at the current clock rate.
+ * The deadline is absolute, so the time spent executing is not added on top of it.
+ */
+static void paceClock(struct timespec* deadline, int executed) {
+	unsigned long rate = clockRate;
+	if (rate == CPU_CLOCK_TURBO || executed == 0) return;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	addNanoseconds(deadline, (long long)executed * 1000000000LL / (long long)rate);
+
+	// Too far behind (Rate changed, process just dispatched): restart from now
+	if (elapsedNanoseconds(deadline, &now) > CPU_MAX_CLOCK_LAG_NS) {
+		*deadline = now;
+		return;
+	}
+
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+}
+
 
 void* cpuThreadWorker(void* arg) {
 	(void)arg;
@@ -26,27 +81,55 @@ void* cpuThreadWorker(void* arg) {
 
 	schedulerTick();
 
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	struct timespec idleTick = deadline;
+	bool idle = false;
+
 	while (osRunning) {
 		if (currentActiveProcess != -1) {
-			bool keepRunning = cpuStep();
+			idle = false;
+			int executed = 0;
+			CPUSliceStatus_t sliceStatus = cpuRunSlice(pacingBatchSize(clockRate), &executed);
 			
-			if (!keepRunning) {
+			if (sliceStatus == CPU_SLICE_HALT) {
 				char logBuffer[LOG_BUFFER_SIZE];
 				snprintf(logBuffer, LOG_BUFFER_SIZE, "Process PID [%d] terminated. Cleaning resources.", PROCESS_TABLE[currentActiveProcess].pid);
 				loggerLogKernel(LOG_INFO, logBuffer);
-				freeMemory(PROCESS_TABLE[currentActiveProcess].startBlock, PROCESS_TABLE[currentActiveProcess].blockCount);
+				freeMemory(PROCESS_TABLE[currentActiveProcess].memoryBase);
+				releaseSharedText(PROCESS_TABLE[currentActiveProcess].textSegment);
 				PROCESS_TABLE[currentActiveProcess].state = FINISHED;
 				osYield = false;
+				osDMAWait = false;
 				schedulerTick();
 			} else if (osYield) {
 				osYield = false;
+				if (osDMAWait) {
+					osDMAWait = false;
+					PROCESS_TABLE[currentActiveProcess].state = BLOCKED_DMA;
+					LOG_KERNEL(LOG_INFO, "Process PID [%d] BLOCKED_DMA waiting for transfer", PROCESS_TABLE[currentActiveProcess].pid);
+				}
 				schedulerTick();
 			}
-			
-			usleep(250000);
+
+			paceClock(&deadline, executed);
 		} else {
-			usleep(100000);
-			schedulerTick();
+			usleep(CPU_IDLE_POLL_US);
+			// No instructions will move the virtual clock: jump to the end of the disk access in flight
+			cpuAdvanceVirtualCycles(dmaBusyUntil());
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+			if (!idle) {
+				idle = true;
+				idleTick = deadline;
+			}
+
+			// Polls only look for work: sleepers age on the paced idle tick, as they do on timer ticks
+			if (elapsedNanoseconds(&idleTick, &deadline) >= CPU_IDLE_TICK_NS) {
+				addNanoseconds(&idleTick, CPU_IDLE_TICK_NS);
+				schedulerTick();
+			} else {
+				schedulerPoll();
+			}
 		}
 	}
 
@@ -75,13 +158,30 @@ OSStatus_t osStop(void) {
 }
 
 
+void osSetClockRate(unsigned long instructionsPerSecond) {
+	clockRate = instructionsPerSecond;
+	if (instructionsPerSecond == CPU_CLOCK_TURBO) {
+		loggerLogKernel(LOG_INFO, "Clock set to turbo mode (no throttling)");
+	} else {
+		LOG_KERNEL(LOG_INFO, "Clock set to %lu instructions per second", instructionsPerSecond);
+	}
+}
+
+
+unsigned long osGetClockRate(void) {
+	return clockRate;
+}
+
+
 OSStatus_t initOS(void) {
 	mmuInit();
+	vfsMount();
 	nextPid = 1;
 
 	for (int i = 0; i < MAX_PROCESSES; i++) {
 		PROCESS_TABLE[i].state = FINISHED;
 		PROCESS_TABLE[i].pid = -1;
+		PROCESS_TABLE[i].textSegment = -1;
 	}
 	
 	currentActiveProcess = -1;
@@ -101,7 +201,106 @@ int getFreePCBIndex(void) {
 }
 
 
-OSStatus_t createProcess(char* progName) {
+bool osIsIdle(void) {
+	for (int i = 0; i < MAX_PROCESSES; i++) {
+		if (PROCESS_TABLE[i].state != FINISHED) return false;
+	}
+
+	pthread_mutex_lock(&BUS_LOCK);
+	bool idle = DMA.outstanding == 0;
+	pthread_mutex_unlock(&BUS_LOCK);
+	return idle;
+}
+
+
+/**
+ * @brief Host-side parse of one program of a batch, filled by the load workers.
+ */
+typedef struct {
+	VFSProgram_t program;  /**< Parsed words, valid when parsed and status is VFS_SUCCESS */
+	VFSStatus_t status;    /**< Result of vfsParseProgram */
+	bool parsed;           /**< A worker handled this entry (false: already on the disk) */
+} LoadSlot_t;
+
+typedef struct {
+	char** progNames;
+	LoadSlot_t* slots;
+	int count;
+	atomic_int next;       /**< Next entry to claim */
+} LoadBatch_t;
+
+
+/**
+ * @brief Claims entries of the batch until none is left. Only reads host files.
+ */
+static void* parseWorker(void* arg) {
+	LoadBatch_t* batch = (LoadBatch_t*)arg;
+
+	for (int i = atomic_fetch_add(&batch->next, 1); i < batch->count; i = atomic_fetch_add(&batch->next, 1)) {
+		if (!batch->slots[i].parsed) continue;
+		batch->slots[i].status = vfsParseProgram(batch->progNames[i], &batch->slots[i].program);
+	}
+	return NULL;
+}
+
+
+/**
+ * @brief Lays out a program and builds its initial context for RB = 0 and TB = 0.
+ * createProcess relocates it by adding the block base to RB and the text base to TB,
+ * and sets RL and SP from the block it was given. When sharing the code takes a
+ * smaller private block, logical [0, TL) is the shared text and the private block
+ * only holds the rest of the program and the stack. A program too large for its
+ * text and private blocks to fit in RAM together keeps its code private.
+ */
+static CPU_t processContext(const FileMeta_t* meta, const word* words, int* outWords) {
+	int textWords = sharedTextLength(words, meta->wordCount);
+	int fullWords = calculateRequiredWords(meta->wordCount);
+	int privateWords = meta->wordCount - textWords + MIN_STACK_SIZE;
+	bool fitsShared = buddyBlockSize(textWords) + buddyBlockSize(privateWords) <= MMU_USER_WORDS;
+	if (textWords == 0 || !fitsShared || buddyBlockSize(privateWords) >= buddyBlockSize(fullWords)) {
+		textWords = 0;
+		privateWords = fullWords;
+	}
+
+	CPU_t ctx = {0};
+	ctx.RB = 0;
+	ctx.TB = 0;
+	ctx.TL = textWords;
+	ctx.RX = meta->wordCount;
+	ctx.PSW.pc = meta->startPC - 1;
+	ctx.PSW.mode = MODE_USER;
+	ctx.PSW.interruptEnable = ITR_ENABLED;
+	ctx.timerLimit = 2;
+
+	*outWords = privateWords;
+	return ctx;
+}
+
+
+/**
+ * @brief Words written by DMA to the tracks of a file, to tell whether a cached image is still current.
+ */
+static uint64_t fileWriteStamp(const FileMeta_t* meta) {
+	bool counted[DISK_TRACKS] = {false};
+	uint64_t stamp = 0;
+
+	for (int i = 0; i < meta->extentCount; i++) {
+		int first = meta->extents[i].track;
+		int last = (vfsLinearSector(meta->extents[i].track, meta->extents[i].cylinder, meta->extents[i].sector) + meta->extents[i].length - 1) / (DISK_CYLINDERS * DISK_SECTORS);
+		for (int track = first; track <= last && track < DISK_TRACKS; track++) {
+			if (counted[track]) continue;
+			counted[track] = true;
+			stamp += dmaDiskWrites(track);
+		}
+	}
+	return stamp;
+}
+
+
+/**
+ * @brief Creates a process, storing the program from slot when it is not on the disk yet.
+ */
+static OSStatus_t spawnProcess(char* progName, LoadSlot_t* slot) {
 	char logBuffer[LOG_BUFFER_SIZE];
 
 	int pcbIndex = getFreePCBIndex();
@@ -116,7 +315,12 @@ OSStatus_t createProcess(char* progName) {
 	loggerLogKernel(LOG_INFO, logBuffer);
 
 	if (!vfsFileExists(progName)) {
-		if (vfsLoadToDisk(progName) != VFS_SUCCESS) {
+		VFSStatus_t status;
+		if (slot == NULL || !slot->parsed) status = vfsLoadToDisk(progName);
+		else if (slot->status != VFS_SUCCESS) status = slot->status;
+		else status = vfsStoreProgram(progName, &slot->program);
+
+		if (status != VFS_SUCCESS) {
 			PROCESS_TABLE[pcbIndex].state = FINISHED;
 			snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process: Could not load '%s' to Virtual Disk", progName);
 			loggerLogKernel(LOG_ERROR, logBuffer);
@@ -133,60 +337,103 @@ OSStatus_t createProcess(char* progName) {
 		return OS_ERR_DISK;
 	}
 
-	int requiredBlocks = calculateRequiredBlocks(meta.wordCount);
-	int startBlock = allocateMemory(requiredBlocks);
+	// Checked before the read: the staging buffer only holds what RAM could
+	if (calculateRequiredWords(meta.wordCount) == 0) {
+		PROCESS_TABLE[pcbIndex].state = FINISHED;
+		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process '%s': %d words never fit in RAM", progName, meta.wordCount);
+		loggerLogKernel(LOG_ERROR, logBuffer);
+		return OS_ERR_MEMORY;
+	}
+
+	// A relaunch is served from the image cache: no sectors read, no layout or context rebuilt
+	uint64_t writeStamp = fileWriteStamp(&meta);
+	const CachedImage_t* cached = imageCacheLookup(&meta, writeStamp);
+
+	// Whole extents into a staging buffer, then single bus transactions into RAM
+	word image[RAM_SIZE];
+	const word* words = image;
+	CPU_t initialContext;
+	int requiredWords;
+	if (cached != NULL) {
+		words = cached->words;
+		initialContext = cached->context;
+		requiredWords = cached->requiredWords;
+	} else if (vfsReadFile(&meta, image) == VFS_SUCCESS) {
+		initialContext = processContext(&meta, image, &requiredWords);
+		imageCacheInsert(&meta, writeStamp, image, requiredWords, &initialContext);
+	} else {
+		PROCESS_TABLE[pcbIndex].state = FINISHED;
+		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process '%s': Could not read it from the Virtual Disk", progName);
+		loggerLogKernel(LOG_ERROR, logBuffer);
+		return OS_ERR_DISK;
+	}
+
+	// The code is placed once and mapped read-only by every process of the same file
+	int textWords = initialContext.TL;
+	int textSegment = -1;
+	int TB = 0;
+	if (textWords > 0) {
+		bool created;
+		textSegment = acquireSharedText(meta.fileId, writeStamp, textWords, &created);
+		if (textSegment == -1) {
+			PROCESS_TABLE[pcbIndex].state = FINISHED;
+			snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process '%s': Insufficient contiguous RAM for its shared text", progName);
+			loggerLogKernel(LOG_ERROR, logBuffer);
+			return OS_ERR_MEMORY;
+		}
+
+		TB = SHARED_TEXTS[textSegment].base;
+		if (created && dmaWriteBlock(TB, words, textWords) != MEM_SUCCESS) {
+			releaseSharedText(textSegment);
+			PROCESS_TABLE[pcbIndex].state = FINISHED;
+			return OS_ERR_DISK;
+		}
+		snprintf(logBuffer, LOG_BUFFER_SIZE, "%s %d words of shared text (Physical Base: %d, %d processes)", created ? "Placed" : "Mapped",
+		         textWords, TB, SHARED_TEXTS[textSegment].refCount);
+		loggerLogKernel(LOG_INFO, logBuffer);
+	}
+
+	int RB = (requiredWords > 0) ? allocateMemory(requiredWords) : -1;
 	
-	if (startBlock == -1) {
+	if (RB == -1) {
+		releaseSharedText(textSegment);
 		PROCESS_TABLE[pcbIndex].state = FINISHED;
 		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process '%s': Insufficient contiguous RAM", progName);
 		loggerLogKernel(LOG_ERROR, logBuffer);
 		return OS_ERR_MEMORY;
 	}
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Allocated %d blocks starting at block %d", requiredBlocks, startBlock);
+	int memorySize = allocatedSize(RB);
+	snprintf(logBuffer, LOG_BUFFER_SIZE, "Allocated a block of %d words for %d at %d", memorySize, requiredWords, RB);
 	loggerLogKernel(LOG_INFO, logBuffer);
 
-	int RB = GET_BASE_REGISTER(startBlock);
-	uint8_t track = meta.startTrack;
-	uint8_t cylinder = meta.startCylinder;
-	uint8_t sector = meta.startSector;
-
-	for (int i = 0; i < meta.wordCount; i++) {
-		Sector_t actualSector;
-		readSector(track, cylinder, sector, &actualSector);
-		dmaWriteMemory(RB + i, actualSector.data);
-		sector++;
-		if (sector >= DISK_SECTORS) {
-			sector = 0;
-			cylinder++;
-			if (cylinder >= DISK_CYLINDERS) {
-				cylinder = 0;
-				track++;
-			}
-		}
+	if (dmaWriteBlock(RB, words + textWords, meta.wordCount - textWords) != MEM_SUCCESS) {
+		freeMemory(RB);
+		releaseSharedText(textSegment);
+		PROCESS_TABLE[pcbIndex].state = FINISHED;
+		snprintf(logBuffer, LOG_BUFFER_SIZE, "Failed to create process '%s': Could not copy it from the Virtual Disk", progName);
+		loggerLogKernel(LOG_ERROR, logBuffer);
+		return OS_ERR_DISK;
 	}
 
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "Loaded %d words into RAM (Physical Base: %d)", meta.wordCount, RB);
+	snprintf(logBuffer, LOG_BUFFER_SIZE, "Loaded %d words into RAM (Physical Base: %d%s)", meta.wordCount - textWords, RB, (cached != NULL) ? ", image cache hit" : "");
 	loggerLogKernel(LOG_INFO, logBuffer);
 
 	PROCESS_TABLE[pcbIndex].pid = nextPid++;
 	strncpy(PROCESS_TABLE[pcbIndex].programName, meta.programName, 255);
 	PROCESS_TABLE[pcbIndex].programName[255] = '\0';
-	PROCESS_TABLE[pcbIndex].startBlock = startBlock;
-	PROCESS_TABLE[pcbIndex].blockCount = requiredBlocks;
+	PROCESS_TABLE[pcbIndex].memoryBase = RB;
+	PROCESS_TABLE[pcbIndex].memorySize = memorySize;
+	PROCESS_TABLE[pcbIndex].textSegment = textSegment;
 	PROCESS_TABLE[pcbIndex].sleepTics = 0;
+	PROCESS_TABLE[pcbIndex].dmaRegisters = (DMARequest_t){0};
 
 	CPU_t* ctx = &PROCESS_TABLE[pcbIndex].context;
-	*ctx = (CPU_t){0};
-
-	ctx->RB = RB;
-	ctx->RL = GET_LIMIT_REGISTER(RB, requiredBlocks);
-	ctx->RX = meta.wordCount;
-	ctx->SP = (requiredBlocks * PARTITION_SIZE) - 1;
-	ctx->PSW.pc = meta.startPC - 1;
-	ctx->PSW.mode = MODE_USER;
-	ctx->PSW.interruptEnable = ITR_ENABLED;
-	ctx->timerLimit = 2;
+	*ctx = initialContext;
+	ctx->RB += RB;
+	ctx->RL = RB + memorySize - 1;
+	ctx->SP = ctx->TL + memorySize - 1;
+	ctx->TB += TB;
 
 	snprintf(logBuffer, LOG_BUFFER_SIZE, "Context initialized (PC: %d, Mode: USER)", ctx->PSW.pc);
 	loggerLogKernel(LOG_INFO, logBuffer);
@@ -195,8 +442,70 @@ OSStatus_t createProcess(char* progName) {
 
 	snprintf(logBuffer, LOG_BUFFER_SIZE, "Process created successfully [PID %d] - '%s'", PROCESS_TABLE[pcbIndex].pid, meta.programName);
 	loggerLogKernel(LOG_INFO, logBuffer);
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "PID %d Info -  Blocks: %d, RB: %d, RL: %d", PROCESS_TABLE[pcbIndex].pid, requiredBlocks, ctx->RB, ctx->RL);
+	snprintf(logBuffer, LOG_BUFFER_SIZE, "PID %d Info -  Words: %d, RB: %d, RL: %d, TB: %d, TL: %d", PROCESS_TABLE[pcbIndex].pid, memorySize, ctx->RB, ctx->RL, ctx->TB, ctx->TL);
 	loggerLogKernel(LOG_INFO, logBuffer);
 
 	return OS_SUCCESS;
 }
+
+
+OSStatus_t createProcess(char* progName) {
+	return spawnProcess(progName, NULL);
+}
+
+
+OSStatus_t createProcesses(char** progNames, int count, OSStatus_t* results) {
+	if (count <= 0) return OS_SUCCESS;
+
+	LoadSlot_t* slots = calloc(count, sizeof(LoadSlot_t));
+	if (slots == NULL) {
+		// No room to stage the batch: fall back to loading one program at a time
+		OSStatus_t first = OS_SUCCESS;
+		for (int i = 0; i < count; i++) {
+			results[i] = spawnProcess(progNames[i], NULL);
+			if (first == OS_SUCCESS) first = results[i];
+		}
+		return first;
+	}
+
+	// Only files missing from the VFS (and not repeated earlier in the batch) need the host
+	int pending = 0;
+	for (int i = 0; i < count; i++) {
+		if (vfsFileExists(progNames[i])) continue;
+		bool repeated = false;
+		for (int j = 0; j < i && !repeated; j++) repeated = slots[j].parsed && strcmp(progNames[i], progNames[j]) == 0;
+		slots[i].parsed = !repeated;
+		if (!repeated) pending++;
+	}
+
+	LoadBatch_t batch = { .progNames = progNames, .slots = slots, .count = count };
+	atomic_init(&batch.next, 0);
+
+	// The calling thread is one of the workers
+	pthread_t workers[OS_LOAD_WORKERS];
+	int workerCount = 0;
+	int wanted = (pending < OS_LOAD_WORKERS ? pending : OS_LOAD_WORKERS) - 1;
+	for (int i = 0; i < wanted; i++) {
+		if (pthread_create(&workers[workerCount], NULL, parseWorker, &batch) != 0) break;
+		workerCount++;
+	}
+	parseWorker(&batch);
+	for (int i = 0; i < workerCount; i++) pthread_join(workers[i], NULL);
+
+	char logBuffer[LOG_BUFFER_SIZE];
+	snprintf(logBuffer, LOG_BUFFER_SIZE, "Parsed %d of %d programs on %d threads", pending, count, workerCount + 1);
+	loggerLogKernel(LOG_INFO, logBuffer);
+
+	// Disk placement, PCBs and RAM in argument order, exactly as serial calls would
+	OSStatus_t first = OS_SUCCESS;
+	for (int i = 0; i < count; i++) {
+		results[i] = spawnProcess(progNames[i], &slots[i]);
+		if (first == OS_SUCCESS) first = results[i];
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (slots[i].parsed && slots[i].status == VFS_SUCCESS) vfsReleaseProgram(&slots[i].program);
+	}
+	free(slots);
+	return first;
+}
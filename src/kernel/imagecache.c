@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../inc/kernel/imagecache.h"
+
+static CachedImage_t entries[IMAGE_CACHE_MAX_ENTRIES];
+static int entryCount = 0;
+static int usedWords = 0;
+static int budgetWords = IMAGE_CACHE_BUDGET_WORDS;
+static uint64_t useClock = 0;
+static ImageCacheStats_t counters;
+
+
+static int findEntry(uint32_t fileId) {
+	for (int i = 0; i < entryCount; i++) {
+		if (entries[i].fileId == fileId) return i;
+	}
+	return -1;
+}
+
+
+/**
+ * @brief Frees an entry and moves the last one into its slot.
+ */
+static void dropEntry(int index) {
+	usedWords -= entries[index].wordCount;
+	free(entries[index].words);
+	entries[index] = entries[--entryCount];
+	memset(&entries[entryCount], 0, sizeof(CachedImage_t));
+}
+
+
+static int leastRecentlyUsed(void) {
+	int oldest = 0;
+	for (int i = 1; i < entryCount; i++) {
+		if (entries[i].lastUse < entries[oldest].lastUse) oldest = i;
+	}
+	return oldest;
+}
+
+
+static bool sameExtents(const CachedImage_t* image, const FileMeta_t* meta) {
+	if (image->extentCount != meta->extentCount) return false;
+	for (int i = 0; i < meta->extentCount; i++) {
+		const VFSExtent_t* a = &image->extents[i];
+		const VFSExtent_t* b = &meta->extents[i];
+		if (a->track != b->track || a->cylinder != b->cylinder || a->sector != b->sector || a->length != b->length) return false;
+	}
+	return true;
+}
+
+
+const CachedImage_t* imageCacheLookup(const FileMeta_t* meta, uint64_t writeStamp) {
+	int index = findEntry(meta->fileId);
+	if (index != -1 && (!sameExtents(&entries[index], meta) || entries[index].writeStamp != writeStamp)) {
+		dropEntry(index);
+		counters.stale++;
+		index = -1;
+	}
+	if (index == -1) {
+		counters.misses++;
+		return NULL;
+	}
+
+	counters.hits++;
+	entries[index].lastUse = ++useClock;
+	return &entries[index];
+}
+
+
+bool imageCacheInsert(const FileMeta_t* meta, uint64_t writeStamp, const word* words, int requiredWords, const CPU_t* context) {
+	if (meta->wordCount > budgetWords) return false;
+
+	int index = findEntry(meta->fileId);
+	if (index != -1) dropEntry(index);
+
+	while (entryCount > 0 && (entryCount == IMAGE_CACHE_MAX_ENTRIES || usedWords + meta->wordCount > budgetWords)) {
+		dropEntry(leastRecentlyUsed());
+		counters.evictions++;
+	}
+
+	word* copy = malloc((meta->wordCount > 0 ? meta->wordCount : 1) * sizeof(word));
+	if (copy == NULL) return false;
+	memcpy(copy, words, meta->wordCount * sizeof(word));
+
+	CachedImage_t* image = &entries[entryCount++];
+	image->fileId = meta->fileId;
+	image->extentCount = meta->extentCount;
+	memcpy(image->extents, meta->extents, sizeof(image->extents));
+	image->writeStamp = writeStamp;
+	snprintf(image->programName, sizeof(image->programName), "%s", meta->programName);
+	image->wordCount = meta->wordCount;
+	image->requiredWords = requiredWords;
+	image->context = *context;
+	image->words = copy;
+	image->lastUse = ++useClock;
+	usedWords += meta->wordCount;
+	return true;
+}
+
+
+void imageCacheSetBudget(int newBudget) {
+	budgetWords = (newBudget > 0) ? newBudget : 0;
+	while (entryCount > 0 && usedWords > budgetWords) {
+		dropEntry(leastRecentlyUsed());
+		counters.evictions++;
+	}
+}
+
+
+void imageCacheClear(void) {
+	while (entryCount > 0) dropEntry(entryCount - 1);
+	useClock = 0;
+	counters = (ImageCacheStats_t){0};
+}
+
+
+ImageCacheStats_t imageCacheGetStats(void) {
+	ImageCacheStats_t stats = counters;
+	stats.entries = entryCount;
+	stats.usedWords = usedWords;
+	stats.budgetWords = budgetWords;
+	return stats;
+}
@@ -4,50 +4,368 @@
 
 #include "../../inc/kernel/mmu.h"
 
-bool FREE_PARTITIONS[MAX_PROCESSES]; // false = occupied, true = free
+SharedText_t SHARED_TEXTS[MAX_PROCESSES];
 
+// Processes are created by the console thread and released by the CPU thread
+static pthread_mutex_t TEXT_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t BUDDY_LOCK = PTHREAD_MUTEX_INITIALIZER;
 
-void mmuInit(void) {
-	memset(FREE_PARTITIONS, true, sizeof(FREE_PARTITIONS));
+// Blocks are indexed by their offset in the user region; order k holds minBlockSize << k words
+static int minBlockSize = MMU_MIN_BLOCK_SIZE;
+static int orderCount;
+static int8_t blockOrder[MMU_USER_WORDS];      // Order of the block starting here, -1 if no block starts here
+static bool blockUsed[MMU_USER_WORDS];
+static int requestedWords[MMU_USER_WORDS];     // Words asked for, for allocated blocks
+static int freeHead[MMU_MAX_ORDERS];           // Free lists, -1 terminated
+static int freeNext[MMU_USER_WORDS];
+static int freePrev[MMU_USER_WORDS];
+static int spanWords[MMU_USER_WORDS];         // Words of a span allocated here, 0 for a single block
+static int topOffset[MMU_MAX_ORDERS];         // Top-level blocks of the empty region, in address order
+static int topOrder[MMU_MAX_ORDERS];
+static int topCount;
+
+
+static int blockSize(int order) {
+	return minBlockSize << order;
 }
 
 
-int calculateRequiredBlocks(int wordCount) {
-	int total = wordCount + MIN_STACK_SIZE;
-	if (total <= MIN_STACK_SIZE || total > (PARTITION_SIZE * MAX_PROCESSES)) return 0;
-	int blocks = (total + PARTITION_SIZE - 1) / PARTITION_SIZE;
-	return blocks;
+// Words held by the block or span starting at an offset where blockOrder is set
+static int entrySize(int offset) {
+	return (spanWords[offset] != 0) ? spanWords[offset] : blockSize(blockOrder[offset]);
 }
 
 
-int allocateMemory(int requiredBlocks) {
-	if (requiredBlocks <= 0 || requiredBlocks > MAX_PROCESSES) return -1;
+static bool topBlockFree(int index) {
+	int offset = topOffset[index];
+	return blockOrder[offset] == topOrder[index] && !blockUsed[offset];
+}
 
-	int contiguousCount = 0;
-	for (int i = 0; i < MAX_PROCESSES; i++) {
-		if (FREE_PARTITIONS[i]) {
-			contiguousCount++;
-			if (contiguousCount == requiredBlocks) {
-				int startIndex = i - requiredBlocks + 1;
-				for (int j = startIndex; j <= i; j++) {
-					FREE_PARTITIONS[j] = false;
-				}
-				return startIndex;
-			}
-		} else {
-			contiguousCount = 0;
+
+static void pushFree(int offset, int order) {
+	blockOrder[offset] = (int8_t)order;
+	blockUsed[offset] = false;
+	requestedWords[offset] = 0;
+	freePrev[offset] = -1;
+	freeNext[offset] = freeHead[order];
+	if (freeHead[order] != -1) freePrev[freeHead[order]] = offset;
+	freeHead[order] = offset;
+}
+
+
+static void unlinkFree(int offset, int order) {
+	if (freePrev[offset] != -1) freeNext[freePrev[offset]] = freeNext[offset];
+	else freeHead[order] = freeNext[offset];
+	if (freeNext[offset] != -1) freePrev[freeNext[offset]] = freePrev[offset];
+}
+
+
+/**
+ * @brief Lays the empty region out as the largest aligned blocks that fit.
+ * Every top-level block starts at a multiple of twice its size, so the buddy
+ * of one of them always ends past the region and is never merged with.
+ */
+static void resetRegion(void) {
+	memset(blockOrder, -1, sizeof(blockOrder));
+	memset(blockUsed, false, sizeof(blockUsed));
+	memset(requestedWords, 0, sizeof(requestedWords));
+	memset(spanWords, 0, sizeof(spanWords));
+	for (int i = 0; i < MMU_MAX_ORDERS; i++) freeHead[i] = -1;
+
+	orderCount = 0;
+	while (orderCount < MMU_MAX_ORDERS && blockSize(orderCount) <= MMU_USER_WORDS) orderCount++;
+
+	int offset = 0;
+	topCount = 0;
+	for (int order = orderCount - 1; order >= 0; order--) {
+		if (offset + blockSize(order) <= MMU_USER_WORDS) {
+			pushFree(offset, order);
+			topOffset[topCount] = offset;
+			topOrder[topCount++] = order;
+			offset += blockSize(order);
 		}
 	}
+}
+
+
+/**
+ * @brief Finds the smallest run of adjacent top-level blocks that holds some words.
+ * @param onlyFree Only runs whose blocks are all free and unsplit.
+ * @return The index of the first block of the run, or -1; *outWords receives its size.
+ */
+static int findSpan(int words, bool onlyFree, int* outWords) {
+	int best = -1, bestWords = 0;
+	for (int first = 0; first < topCount; first++) {
+		int total = 0;
+		for (int last = first; last < topCount && total < words; last++) {
+			if (onlyFree && !topBlockFree(last)) break;
+			total += blockSize(topOrder[last]);
+		}
+		if (total >= words && (best == -1 || total < bestWords)) {
+			best = first;
+			bestWords = total;
+		}
+	}
+	*outWords = bestWords;
+	return best;
+}
+
+
+static int orderFor(int words) {
+	if (words <= 0) return -1;
+	for (int order = 0; order < orderCount; order++) {
+		if (blockSize(order) >= words) return order;
+	}
 	return -1;
 }
 
 
-OSStatus_t freeMemory(int startBlock, int blockCount) {
-	if (startBlock < 0 || startBlock >= MAX_PROCESSES || blockCount <= 0 || (startBlock + blockCount) > MAX_PROCESSES) {
+void mmuInit(void) {
+	pthread_mutex_lock(&BUDDY_LOCK);
+	resetRegion();
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	memset(SHARED_TEXTS, 0, sizeof(SHARED_TEXTS));
+}
+
+
+OSStatus_t mmuSetMinBlockSize(int words) {
+	if (words <= 0 || words > MMU_USER_WORDS || (words & (words - 1)) != 0) return OS_ERR_MEMORY;
+
+	pthread_mutex_lock(&BUDDY_LOCK);
+	for (int i = 0; i < MMU_USER_WORDS; i++) {
+		if (blockOrder[i] != -1 && blockUsed[i]) {
+			pthread_mutex_unlock(&BUDDY_LOCK);
+			return OS_ERR_MEMORY;
+		}
+	}
+	minBlockSize = words;
+	resetRegion();
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	return OS_SUCCESS;
+}
+
+
+int calculateRequiredWords(int wordCount) {
+	if (wordCount <= 0) return 0;
+	int total = wordCount + MIN_STACK_SIZE;
+	return (buddyBlockSize(total) == 0) ? 0 : total;
+}
+
+
+int buddyBlockSize(int requiredWords) {
+	int order = orderFor(requiredWords);
+	if (order != -1) return blockSize(order);
+
+	int words = 0;
+	if (requiredWords > 0) findSpan(requiredWords, false, &words);
+	return words;
+}
+
+
+/**
+ * @brief Takes a run of adjacent free top-level blocks as one allocation (BUDDY_LOCK held).
+ * It is listed and freed as a single block at the offset of its first one.
+ *
+ * @return The offset of the span, or -1 if no run of free blocks is large enough.
+ */
+static int allocateSpan(int requiredWords) {
+	int words;
+	int first = findSpan(requiredWords, true, &words);
+	if (first == -1) return -1;
+
+	int offset = topOffset[first];
+	for (int i = first; i < topCount && topOffset[i] < offset + words; i++) {
+		unlinkFree(topOffset[i], topOrder[i]);
+		blockOrder[topOffset[i]] = -1;
+	}
+	blockOrder[offset] = (int8_t)topOrder[first];
+	blockUsed[offset] = true;
+	requestedWords[offset] = requiredWords;
+	spanWords[offset] = words;
+	return offset;
+}
+
+
+int allocateMemory(int requiredWords) {
+	pthread_mutex_lock(&BUDDY_LOCK);
+	int order = orderFor(requiredWords);
+	int from = order;
+	while (from != -1 && from < orderCount && freeHead[from] == -1) from++;
+	if (order == -1 || from >= orderCount) {
+		// No single block holds it: adjacent free top-level blocks may
+		int offset = (requiredWords > 0) ? allocateSpan(requiredWords) : -1;
+		pthread_mutex_unlock(&BUDDY_LOCK);
+		return (offset == -1) ? -1 : OS_RESERVED_SIZE + offset;
+	}
+
+	// Lowest address first, so the region fills from the bottom
+	int offset = freeHead[from];
+	for (int i = freeNext[offset]; i != -1; i = freeNext[i]) {
+		if (i < offset) offset = i;
+	}
+	unlinkFree(offset, from);
+
+	while (from > order) {
+		from--;
+		pushFree(offset + blockSize(from), from);
+	}
+	blockOrder[offset] = (int8_t)order;
+	blockUsed[offset] = true;
+	requestedWords[offset] = requiredWords;
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	return OS_RESERVED_SIZE + offset;
+}
+
+
+int allocatedSize(int base) {
+	int offset = base - OS_RESERVED_SIZE;
+	if (offset < 0 || offset >= MMU_USER_WORDS) return 0;
+
+	pthread_mutex_lock(&BUDDY_LOCK);
+	int size = (blockOrder[offset] != -1 && blockUsed[offset]) ? entrySize(offset) : 0;
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	return size;
+}
+
+
+OSStatus_t freeMemory(int base) {
+	int offset = base - OS_RESERVED_SIZE;
+	if (offset < 0 || offset >= MMU_USER_WORDS) return OS_ERR_MEMORY;
+
+	pthread_mutex_lock(&BUDDY_LOCK);
+	if (blockOrder[offset] == -1 || !blockUsed[offset]) {
+		pthread_mutex_unlock(&BUDDY_LOCK);
 		return OS_ERR_MEMORY;
 	}
-	for (int i = startBlock; i < startBlock + blockCount; i++) {
-		FREE_PARTITIONS[i] = true;
+
+	if (spanWords[offset] != 0) {
+		int end = offset + spanWords[offset];
+		spanWords[offset] = 0;
+		for (int i = 0; i < topCount; i++) {
+			if (topOffset[i] >= offset && topOffset[i] < end) pushFree(topOffset[i], topOrder[i]);
+		}
+		pthread_mutex_unlock(&BUDDY_LOCK);
+		return OS_SUCCESS;
+	}
+
+	int order = blockOrder[offset];
+	blockOrder[offset] = -1;
+	blockUsed[offset] = false;
+	requestedWords[offset] = 0;
+
+	while (order < orderCount - 1) {
+		int buddy = offset ^ blockSize(order);
+		if (buddy + blockSize(order) > MMU_USER_WORDS || blockOrder[buddy] != order || blockUsed[buddy]) break;
+		unlinkFree(buddy, order);
+		blockOrder[buddy] = -1;
+		if (buddy < offset) offset = buddy;
+		order++;
 	}
+	pushFree(offset, order);
+	pthread_mutex_unlock(&BUDDY_LOCK);
 	return OS_SUCCESS;
 }
+
+
+MMUStats_t mmuGetStats(void) {
+	MMUStats_t stats = {0};
+
+	pthread_mutex_lock(&BUDDY_LOCK);
+	stats.minBlockSize = minBlockSize;
+	for (int i = 0; i < MMU_USER_WORDS; i++) {
+		if (blockOrder[i] == -1) continue;
+		int size = entrySize(i);
+		stats.totalWords += size;
+		if (blockUsed[i]) {
+			stats.usedWords += size;
+			stats.requestedWords += requestedWords[i];
+			stats.usedBlocks++;
+		} else {
+			stats.freeWords += size;
+			stats.freeBlocks++;
+			if (size > stats.largestFree) stats.largestFree = size;
+		}
+	}
+
+	// A run of free top-level blocks is taken as one span
+	for (int i = 0, run = 0; i < topCount; i++) {
+		run = topBlockFree(i) ? run + blockSize(topOrder[i]) : 0;
+		if (run > stats.largestFree) stats.largestFree = run;
+	}
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	return stats;
+}
+
+
+int mmuListBlocks(MMUBlock_t* blocks, int maxBlocks) {
+	int count = 0;
+
+	pthread_mutex_lock(&BUDDY_LOCK);
+	for (int i = 0; i < MMU_USER_WORDS && count < maxBlocks; i++) {
+		if (blockOrder[i] == -1) continue;
+		blocks[count++] = (MMUBlock_t){ .base = OS_RESERVED_SIZE + i, .size = entrySize(i),
+		                                .used = blockUsed[i], .requestedWords = requestedWords[i] };
+	}
+	pthread_mutex_unlock(&BUDDY_LOCK);
+	return count;
+}
+
+
+int sharedTextLength(const word* words, int wordCount) {
+	int textWords = wordCount;
+
+	for (int i = 0; i < wordCount; i++) {
+		int opCode = GET_INSTRUCTION_OPCODE(words[i]);
+		int mode = GET_INSTRUCTION_MODE(words[i]);
+		int value = GET_INSTRUCTION_VALUE(words[i]);
+
+		// An indexed STR adds the signed AC, and a direct or indexed SDMAM takes its target
+		// from memory: either could write anywhere, below its operand too
+		if (opCode == OP_STR && mode == ADDR_MODE_INDEXED) return 0;
+		if (opCode == OP_SDMAM && mode != ADDR_MODE_IMMEDIATE) return 0;
+		bool writes = (opCode == OP_STR && mode == ADDR_MODE_DIRECT) || opCode == OP_SDMAM;
+		if (writes && value < textWords) textWords = value;
+	}
+	return textWords;
+}
+
+
+int acquireSharedText(uint32_t fileId, uint64_t writeStamp, int length, bool* outCreated) {
+	*outCreated = false;
+	if (length <= 0) return -1;
+
+	pthread_mutex_lock(&TEXT_LOCK);
+	int freeSlot = -1;
+	for (int i = 0; i < MAX_PROCESSES; i++) {
+		SharedText_t* text = &SHARED_TEXTS[i];
+		if (!text->used) {
+			if (freeSlot == -1) freeSlot = i;
+		} else if (text->fileId == fileId && text->writeStamp == writeStamp && text->length == length) {
+			text->refCount++;
+			pthread_mutex_unlock(&TEXT_LOCK);
+			return i;
+		}
+	}
+
+	int base = (freeSlot == -1) ? -1 : allocateMemory(length);
+	if (base != -1) {
+		SHARED_TEXTS[freeSlot] = (SharedText_t){ .used = true, .fileId = fileId, .writeStamp = writeStamp, .length = length,
+		                                         .base = base, .size = allocatedSize(base), .refCount = 1 };
+		*outCreated = true;
+	}
+	pthread_mutex_unlock(&TEXT_LOCK);
+	return (base == -1) ? -1 : freeSlot;
+}
+
+
+void releaseSharedText(int index) {
+	if (index < 0 || index >= MAX_PROCESSES) return;
+
+	pthread_mutex_lock(&TEXT_LOCK);
+	SharedText_t* text = &SHARED_TEXTS[index];
+	if (text->used && --text->refCount == 0) {
+		freeMemory(text->base);
+		text->used = false;
+	}
+	pthread_mutex_unlock(&TEXT_LOCK);
+}
@@ -2,35 +2,59 @@
 #include <stdio.h>
 
 #include "../../inc/logger.h"
+#include "../../inc/hardware/dma.h"
 #include "../../inc/kernel/scheduler.h"
 #include "../../inc/kernel/core.h"
 
+static void schedule(bool clockTick);
+
+
 void schedulerTick(void) {
-	char logBuffer[LOG_BUFFER_SIZE];
+	schedule(true);
+}
 
-	for (int i = 0; i < MAX_PROCESSES; i++) {
+
+void schedulerPoll(void) {
+	schedule(false);
+}
+
+
+static void schedule(bool clockTick) {
+	for (int i = 0; i < MAX_PROCESSES && clockTick; i++) {
 		if (PROCESS_TABLE[i].state == BLOCKED && PROCESS_TABLE[i].sleepTics > 0) {
 			PROCESS_TABLE[i].sleepTics--;
 			if (PROCESS_TABLE[i].sleepTics == 0) {
 				PROCESS_TABLE[i].state = READY;
-				snprintf(logBuffer, LOG_BUFFER_SIZE, "[SCHEDULER] Process PID [%d] woke up and is now READY", PROCESS_TABLE[i].pid);
-				loggerLogKernel(LOG_INFO, logBuffer);
+				LOG_KERNEL(LOG_INFO, "[SCHEDULER] Process PID [%d] woke up and is now READY", PROCESS_TABLE[i].pid);
 			}
 		}
 	}
 
+	DMARequest_t completion;
+	while (dmaReapCompletion(&completion)) {
+		LOG_KERNEL((completion.status == 0) ? LOG_INFO : LOG_WARNING, "[SCHEDULER] DMA completion for PID [%d] (Status: %d, Words: %d)", completion.ownerPid, completion.status, dmaBurstWords(&completion));
+	}
+
+	// A process waits while it owns a descriptor; one deferred on a full queue retries once a slot is free
+	for (int i = 0; i < MAX_PROCESSES; i++) {
+		if (PROCESS_TABLE[i].state == BLOCKED_DMA && !dmaHasRequest(PROCESS_TABLE[i].pid) && DMA.outstanding < DMA_QUEUE_DEPTH) {
+			PROCESS_TABLE[i].state = READY;
+			LOG_KERNEL(LOG_INFO, "[SCHEDULER] Process PID [%d] unblocked by DMA completion", PROCESS_TABLE[i].pid);
+		}
+	}
+
 	if (OS_MONITOR_ACTIVE) {
 		for (int i = 0; i < MAX_PROCESSES; i++) {
 			if (PROCESS_TABLE[i].state == BLOCKED_IO) {
 				PROCESS_TABLE[i].state = READY;
-				snprintf(logBuffer, LOG_BUFFER_SIZE, "[SCHEDULER] Process PID [%d] unblocked because Monitor opened", PROCESS_TABLE[i].pid);
-				loggerLogKernel(LOG_INFO, logBuffer);
+				LOG_KERNEL(LOG_INFO, "[SCHEDULER] Process PID [%d] unblocked because Monitor opened", PROCESS_TABLE[i].pid);
 			}
 		}
 	}
 
 	if (currentActiveProcess != -1) {
 		PROCESS_TABLE[currentActiveProcess].context = CPU;
+		dmaSaveRegisters(&PROCESS_TABLE[currentActiveProcess].dmaRegisters);
 		if (PROCESS_TABLE[currentActiveProcess].state == EXECUTING) {
 			PROCESS_TABLE[currentActiveProcess].state = READY;
 		}
@@ -52,19 +76,21 @@ void schedulerTick(void) {
 	if (nextProcess != -1) {
 		if (currentActiveProcess != nextProcess) {
 			int oldPid = (currentActiveProcess != -1) ? PROCESS_TABLE[currentActiveProcess].pid : 0;
-			snprintf(logBuffer, LOG_BUFFER_SIZE, "[SCHEDULER] Context Switch: Out PID [%d], In PID [%d]", oldPid, PROCESS_TABLE[nextProcess].pid);
-			loggerLogKernel(LOG_INFO, logBuffer);
+			LOG_KERNEL(LOG_INFO, "[SCHEDULER] Context Switch: Out PID [%d], In PID [%d]", oldPid, PROCESS_TABLE[nextProcess].pid);
 		}
 
 		currentActiveProcess = nextProcess;
 		PROCESS_TABLE[currentActiveProcess].state = EXECUTING;
 		
 		CPU = PROCESS_TABLE[currentActiveProcess].context;
+		dmaLoadRegisters(&PROCESS_TABLE[currentActiveProcess].dmaRegisters, PROCESS_TABLE[currentActiveProcess].pid);
+		loggerSetTracePid(PROCESS_TABLE[currentActiveProcess].pid);
 
 	} else {
 		if (currentActiveProcess != -1) {
 			loggerLogKernel(LOG_INFO, "[SCHEDULER] No READY processes. System is now IDLE.");
 		}
 		currentActiveProcess = -1;
+		loggerSetTracePid(0);
 	}
 }
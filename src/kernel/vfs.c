@@ -1,24 +1,396 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "../../inc/logger.h"
 #include "../../inc/hardware/memory.h"
 #include "../../inc/hardware/disk.h"
 #include "../../inc/kernel/vfs.h"
 
-static FileMeta_t diskCatalog[MAX_PROCESSES];
+/**
+ * @brief Superblock at the start of each catalog copy, written after its records.
+ */
+typedef struct {
+	uint32_t magic;            /**< VFS_CATALOG_MAGIC */
+	uint16_t version;          /**< VFS_CATALOG_VERSION */
+	uint16_t count;            /**< Records in use */
+	uint32_t reservedSectors;  /**< VFS_RESERVED_SECTORS of the build that formatted the disk */
+	uint32_t generation;       /**< Commits so far: the valid copy with the highest one is mounted */
+	uint32_t checksum;         /**< FNV-1a over the fields above and the records in use */
+} Superblock_t;
+
+/**
+ * @brief On-disk form of an extent: linear first sector and length.
+ */
+typedef struct {
+	uint16_t start;
+	uint16_t length;
+} RecordExtent_t;
+
+/**
+ * @brief On-disk form of a FileMeta_t.
+ */
+typedef struct {
+	char filePath[VFS_DISK_PATH_SIZE];     /**< Path, cut to its prefix if longer */
+	char programName[VFS_DISK_NAME_SIZE];  /**< Program name, cut to its prefix if longer */
+	uint32_t pathHash;                     /**< FNV-1a of the full path */
+	uint32_t nameHash;                     /**< FNV-1a of the full program name */
+	int32_t wordCount;
+	int32_t startPC;
+	uint8_t extentCount;
+	uint8_t unused[3];
+	RecordExtent_t extents[VFS_MAX_EXTENTS];
+} CatalogRecord_t;
+
+_Static_assert(sizeof(Superblock_t) == VFS_SUPERBLOCK_SECTORS * sizeof(word), "Superblock does not match VFS_SUPERBLOCK_SECTORS");
+_Static_assert(sizeof(CatalogRecord_t) == VFS_RECORD_SECTORS * sizeof(word), "Catalog record does not match VFS_RECORD_SECTORS");
+_Static_assert(VFS_RESERVED_SECTORS < VFS_TOTAL_SECTORS, "The catalog does not fit on the disk");
+
+/**
+ * @brief Hash index slot: one key (path or program name) of a catalog entry.
+ */
+typedef struct {
+	uint32_t hash;  /**< Hash of the key, compared before the strings */
+	int entry;      /**< Catalog index plus one; 0 marks an empty slot */
+} IndexSlot_t;
+
+/**
+ * @brief Binary program image mapped from the host.
+ */
+typedef struct {
+	void* mapping;                        /**< Whole file, to unmap */
+	size_t size;                          /**< Bytes mapped */
+	const ProgramImageHeader_t* header;   /**< Start of the mapping */
+	const word* words;                    /**< Words right after the header */
+} MappedImage_t;
+
+/**
+ * @brief Free run of sectors found by the allocator.
+ */
+typedef struct {
+	int start;
+	int length;
+} FreeRun_t;
+
+static FileMeta_t diskCatalog[VFS_MAX_FILES];
 static int catalogCount = 0;
+static IndexSlot_t catalogIndex[VFS_INDEX_SLOTS];
+static uint64_t usedMap[(VFS_TOTAL_SECTORS + 63) / 64];  // One bit per sector, set while a file holds it
+static int freeSectors = VFS_TOTAL_SECTORS - VFS_RESERVED_SECTORS;
+static uint32_t nextFileId = 1;  // Not stored on disk: handed out again at every mount
+static bool mounted = true;      // False while a damaged catalog on a disk image waits for vfsClearCatalog()
+static int activeCopy = 0;       // Catalog copy that holds the last commit; the next one goes to the other
+static uint32_t generation = 0;  // Generation of the last commit
+
+
+static bool sectorUsed(int linear) {
+	return (usedMap[linear / 64] >> (linear % 64)) & 1;
+}
+
+
+/**
+ * @brief Marks a run of sectors as held or free; the catalog area is left alone.
+ * @return false if a sector to hold was already held (Overlapping files).
+ */
+static bool markRun(int start, int length, bool used) {
+	bool disjoint = true;
+	for (int linear = start; linear < start + length && linear < VFS_TOTAL_SECTORS; linear++) {
+		if (linear < VFS_RESERVED_SECTORS || sectorUsed(linear) == used) {
+			if (used && linear >= VFS_RESERVED_SECTORS) disjoint = false;
+			continue;
+		}
+		usedMap[linear / 64] ^= (uint64_t)1 << (linear % 64);
+		freeSectors += used ? -1 : 1;
+	}
+	return disjoint;
+}
+
+
+static bool markFile(const FileMeta_t* meta, bool used) {
+	bool disjoint = true;
+	for (int i = 0; i < meta->extentCount; i++) {
+		const VFSExtent_t* extent = &meta->extents[i];
+		disjoint &= markRun(vfsLinearSector(extent->track, extent->cylinder, extent->sector), extent->length, used);
+	}
+	return disjoint;
+}
+
+
+static void resetFreeSpace(void) {
+	memset(usedMap, 0, sizeof(usedMap));
+	freeSectors = VFS_TOTAL_SECTORS - VFS_RESERVED_SECTORS;
+}
+
+
+/**
+ * @brief Collects the free runs of the data area in disk order.
+ * @return The number of runs.
+ */
+static int collectFreeRuns(FreeRun_t* runs) {
+	int count = 0;
+	for (int linear = VFS_RESERVED_SECTORS; linear < VFS_TOTAL_SECTORS; linear++) {
+		if (sectorUsed(linear)) continue;
+		int start = linear;
+		while (linear < VFS_TOTAL_SECTORS && !sectorUsed(linear)) linear++;
+		runs[count++] = (FreeRun_t){ .start = start, .length = linear - start };
+	}
+	return count;
+}
+
+
+/**
+ * @brief Chooses where a file of some words goes, without claiming the sectors.
+ * Best fit: the smallest free run that holds the whole file, lowest address on
+ * ties. When no run is large enough, the largest runs are combined (At most
+ * VFS_MAX_EXTENTS of them), in disk order so the file is read in one sweep.
+ *
+ * @return The number of extents, or 0 if the file does not fit.
+ */
+static int allocateExtents(int words, VFSExtent_t* extents) {
+	static FreeRun_t runs[VFS_TOTAL_SECTORS / 2 + 1];
+	if (words <= 0 || words > freeSectors) return 0;
+
+	int runCount = collectFreeRuns(runs);
+	int best = -1;
+	for (int i = 0; i < runCount; i++) {
+		if (runs[i].length >= words && (best == -1 || runs[i].length < runs[best].length)) best = i;
+	}
+
+	int starts[VFS_MAX_EXTENTS], lengths[VFS_MAX_EXTENTS];
+	int count = 0;
+	if (best != -1) {
+		starts[0] = runs[best].start;
+		lengths[0] = words;
+		count = 1;
+	} else {
+		int remaining = words;
+		while (remaining > 0 && count < VFS_MAX_EXTENTS) {
+			int largest = -1;
+			for (int i = 0; i < runCount; i++) {
+				if (runs[i].length > 0 && (largest == -1 || runs[i].length > runs[largest].length)) largest = i;
+			}
+			if (largest == -1) break;
+
+			int length = (runs[largest].length < remaining) ? runs[largest].length : remaining;
+			starts[count] = runs[largest].start;
+			lengths[count] = length;
+			count++;
+			remaining -= length;
+			runs[largest].length = 0;
+		}
+		if (remaining > 0) return 0;
+
+		// Disk order, so the read sweeps the head in one direction
+		for (int i = 1; i < count; i++) {
+			for (int j = i; j > 0 && starts[j - 1] > starts[j]; j--) {
+				int start = starts[j]; starts[j] = starts[j - 1]; starts[j - 1] = start;
+				int length = lengths[j]; lengths[j] = lengths[j - 1]; lengths[j - 1] = length;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; i++) {
+		vfsSectorAddress(starts[i], &extents[i].track, &extents[i].cylinder, &extents[i].sector);
+		extents[i].length = lengths[i];
+	}
+	return count;
+}
+
+
+/**
+ * @brief Stores raw bytes one word per sector, from a linear sector onwards (One writeSectors() run).
+ */
+static void writeBytes(int firstSector, const void* data, size_t size) {
+	static word buffer[VFS_CATALOG_SECTORS];
+	uint8_t t, c, s;
+	if (size == 0) return;
+	memcpy(buffer, data, size);
+	vfsSectorAddress(firstSector, &t, &c, &s);
+	writeSectors(t, c, s, buffer, size / sizeof(word));
+}
+
+
+static void readBytes(int firstSector, void* data, size_t size) {
+	static word buffer[VFS_CATALOG_SECTORS];
+	uint8_t t, c, s;
+	if (size == 0) return;
+	vfsSectorAddress(firstSector, &t, &c, &s);
+	readSectors(t, c, s, buffer, size / sizeof(word));
+	memcpy(data, buffer, size);
+}
+
+
+static int copySector(int copy) {
+	return copy * VFS_CATALOG_SECTORS;
+}
+
+
+static int recordSector(int copy, int index) {
+	return copySector(copy) + VFS_SUPERBLOCK_SECTORS + index * VFS_RECORD_SECTORS;
+}
+
+
+static void toRecord(const FileMeta_t* meta, CatalogRecord_t* record) {
+	memset(record, 0, sizeof(*record));
+	memcpy(record->filePath, meta->filePath, strnlen(meta->filePath, VFS_DISK_PATH_SIZE - 1));
+	memcpy(record->programName, meta->programName, strnlen(meta->programName, VFS_DISK_NAME_SIZE - 1));
+	record->pathHash = meta->pathHash;
+	record->nameHash = meta->nameHash;
+	record->wordCount = meta->wordCount;
+	record->startPC = meta->startPC;
+	record->extentCount = meta->extentCount;
+	for (int i = 0; i < meta->extentCount; i++) {
+		const VFSExtent_t* extent = &meta->extents[i];
+		record->extents[i].start = vfsLinearSector(extent->track, extent->cylinder, extent->sector);
+		record->extents[i].length = extent->length;
+	}
+}
+
+
+/**
+ * @brief Rebuilds a FileMeta_t from its record.
+ * @return false if the extents are out of the data area or do not add up to the word count.
+ */
+static bool fromRecord(const CatalogRecord_t* record, FileMeta_t* meta) {
+	memset(meta, 0, sizeof(*meta));
+	memcpy(meta->filePath, record->filePath, VFS_DISK_PATH_SIZE);
+	meta->filePath[VFS_DISK_PATH_SIZE - 1] = '\0';
+	memcpy(meta->programName, record->programName, VFS_DISK_NAME_SIZE);
+	meta->programName[VFS_DISK_NAME_SIZE - 1] = '\0';
+	meta->pathHash = record->pathHash;
+	meta->nameHash = record->nameHash;
+	meta->wordCount = record->wordCount;
+	meta->startPC = record->startPC;
+
+	if (record->extentCount < 1 || record->extentCount > VFS_MAX_EXTENTS) return false;
+	meta->extentCount = record->extentCount;
+
+	int words = 0;
+	for (int i = 0; i < meta->extentCount; i++) {
+		const RecordExtent_t* extent = &record->extents[i];
+		if (extent->start < VFS_RESERVED_SECTORS || extent->start + extent->length > VFS_TOTAL_SECTORS) return false;
+		vfsSectorAddress(extent->start, &meta->extents[i].track, &meta->extents[i].cylinder, &meta->extents[i].sector);
+		meta->extents[i].length = extent->length;
+		words += extent->length;
+	}
+	meta->startTrack = meta->extents[0].track;
+	meta->startCylinder = meta->extents[0].cylinder;
+	meta->startSector = meta->extents[0].sector;
+	return words == meta->wordCount;
+}
+
+
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+static uint32_t catalogChecksum(const Superblock_t* superblock, const CatalogRecord_t* records) {
+	Superblock_t header = *superblock;
+	header.checksum = 0;
+	uint32_t hash = fnv1a(2166136261u, &header, sizeof(header));
+	return fnv1a(hash, records, superblock->count * sizeof(CatalogRecord_t));
+}
+
+
+/**
+ * @brief Writes the in-memory catalog to the copy not in use: every record, then
+ * its superblock with the next generation. Until that last write lands, vfsMount()
+ * still picks the other copy, so a commit cut short leaves the previous catalog.
+ */
+static void commitCatalog(void) {
+	static CatalogRecord_t records[VFS_MAX_FILES];
+	for (int i = 0; i < catalogCount; i++) toRecord(&diskCatalog[i], &records[i]);
+
+	int copy = 1 - activeCopy;
+	Superblock_t superblock = { .magic = VFS_CATALOG_MAGIC, .version = VFS_CATALOG_VERSION, .count = catalogCount,
+	                            .reservedSectors = VFS_RESERVED_SECTORS, .generation = generation + 1 };
+	superblock.checksum = catalogChecksum(&superblock, records);
+	writeBytes(recordSector(copy, 0), records, catalogCount * sizeof(CatalogRecord_t));
+	writeBytes(copySector(copy), &superblock, sizeof(superblock));
+
+	activeCopy = copy;
+	generation = superblock.generation;
+}
+
+
+static uint32_t hashKey(const char* key) {
+	return fnv1a(2166136261u, key, strlen(key));
+}
+
+
+static void indexInsert(uint32_t hash, int entry) {
+	int slot = hash % VFS_INDEX_SLOTS;
+	while (catalogIndex[slot].entry != 0) slot = (slot + 1) % VFS_INDEX_SLOTS;
+	catalogIndex[slot] = (IndexSlot_t){ .hash = hash, .entry = entry + 1 };
+}
+
+
+static void indexReset(void) {
+	memset(catalogIndex, 0, sizeof(catalogIndex));
+}
+
+
+static void indexAdd(int entry) {
+	indexInsert(diskCatalog[entry].pathHash, entry);
+	indexInsert(diskCatalog[entry].nameHash, entry);
+}
+
+
+/**
+ * @brief Compares a catalog key with an identifier. A key that fills its
+ * disk field may have been shortened at mount, so its prefix and the hash
+ * of the full key stand in for it.
+ */
+static bool keyMatches(const char* key, uint32_t keyHash, size_t diskSize, const char* identifier, uint32_t hash) {
+	if (strlen(key) != diskSize - 1) return strcmp(key, identifier) == 0;
+	return keyHash == hash && strncmp(key, identifier, diskSize - 1) == 0;
+}
+
+
+/**
+ * @brief Finds the catalog entry whose path or program name is the identifier.
+ * Walks the whole probe run and keeps the earliest entry, so a name shared by
+ * several files resolves to the first one registered, as a scan of the catalog would.
+ *
+ * @return The catalog index, or -1 if nothing matches.
+ */
+static int indexLookup(const char* identifier) {
+	uint32_t hash = hashKey(identifier);
+	int found = -1;
+
+	for (int slot = hash % VFS_INDEX_SLOTS; catalogIndex[slot].entry != 0; slot = (slot + 1) % VFS_INDEX_SLOTS) {
+		int entry = catalogIndex[slot].entry - 1;
+		if (catalogIndex[slot].hash != hash || (found != -1 && entry > found)) continue;
+		const FileMeta_t* meta = &diskCatalog[entry];
+		if (keyMatches(meta->filePath, meta->pathHash, VFS_DISK_PATH_SIZE, identifier, hash) ||
+		    keyMatches(meta->programName, meta->nameHash, VFS_DISK_NAME_SIZE, identifier, hash)) {
+			found = entry;
+		}
+	}
+
+	return found;
+}
 
-static uint8_t freeTrack = 0;
-static uint8_t freeCylinder = 0;
-static uint8_t freeSector = 0;
 
 int vfsGetCatalogCount(void) {
 	return catalogCount;
 }
 
 
+bool vfsIsMounted(void) {
+	return mounted;
+}
+
+
 VFSStatus_t vfsGetCatalogEntry(int index, FileMeta_t* outMeta) {
 	if (index < 0 || index >= catalogCount) return VFS_ERR_NOT_FOUND;
 	if (outMeta != NULL) {
@@ -29,66 +401,519 @@ VFSStatus_t vfsGetCatalogEntry(int index, FileMeta_t* outMeta) {
 
 
 bool vfsFileExists(const char* identifier) {
-	for (int i = 0; i < catalogCount; i++) {
-		if (strcmp(diskCatalog[i].filePath, identifier) == 0 || strcmp(diskCatalog[i].programName, identifier) == 0) {
+	return indexLookup(identifier) != -1;
+}
+
+
+VFSStatus_t vfsGetMetadata(const char* identifier, FileMeta_t* outMeta) {
+	int entry = indexLookup(identifier);
+	if (entry == -1) return VFS_ERR_NOT_FOUND;
+
+	if (outMeta != NULL) *outMeta = diskCatalog[entry];
+	return VFS_SUCCESS;
+}
+
+
+bool vfsWordAddress(const FileMeta_t* meta, int wordIndex, uint8_t* track, uint8_t* cylinder, uint8_t* sector) {
+	if (wordIndex < 0) return false;
+
+	for (int i = 0; i < meta->extentCount; i++) {
+		const VFSExtent_t* extent = &meta->extents[i];
+		if (wordIndex < extent->length) {
+			vfsSectorAddress(vfsLinearSector(extent->track, extent->cylinder, extent->sector) + wordIndex, track, cylinder, sector);
 			return true;
 		}
+		wordIndex -= extent->length;
 	}
 	return false;
 }
 
 
-VFSStatus_t vfsGetMetadata(const char* identifier, FileMeta_t* outMeta) {
-	for (int i = 0; i < catalogCount; i++) {
-		if (strcmp(diskCatalog[i].filePath, identifier) == 0 || strcmp(diskCatalog[i].programName, identifier) == 0) {
-			if (outMeta != NULL) *outMeta = diskCatalog[i];
-			return VFS_SUCCESS;
+VFSStatus_t vfsReadFile(const FileMeta_t* meta, word* buffer) {
+	int read = 0;
+	for (int i = 0; i < meta->extentCount; i++) {
+		const VFSExtent_t* extent = &meta->extents[i];
+		if (readSectors(extent->track, extent->cylinder, extent->sector, buffer + read, extent->length) != DISK_SUCCESS) {
+			return VFS_ERR_NOT_FOUND;
 		}
+		read += extent->length;
 	}
-	return VFS_ERR_NOT_FOUND;
+	return (read == meta->wordCount) ? VFS_SUCCESS : VFS_ERR_NOT_FOUND;
 }
 
 
-VFSStatus_t vfsRegisterFile(const char* filePath, const char* programName, uint8_t track, uint8_t cyl, uint8_t sec, int words, int startPC) {
-	if (catalogCount >= MAX_PROCESSES) {
+/**
+ * @brief Adds a file to the catalog, claims its sectors and commits it to disk.
+ */
+static VFSStatus_t registerExtents(const char* filePath, const char* programName, const VFSExtent_t* extents, int extentCount, int words, int startPC) {
+	if (!mounted) return VFS_ERR_NOT_MOUNTED;
+	if (catalogCount >= VFS_MAX_FILES) {
 		loggerLogKernel(LOG_WARNING, "VFS Error: Disk catalog is full.");
 		return VFS_ERR_DISK_FULL;
 	}
+	if (strlen(filePath) >= VFS_PATH_SIZE || strlen(programName) >= VFS_PATH_SIZE) {
+		LOG_KERNEL(LOG_WARNING, "VFS Error: '%s' (%s) is too long for the catalog.", filePath, programName);
+		return VFS_ERR_NAME_TOO_LONG;
+	}
 	
-	strncpy(diskCatalog[catalogCount].filePath, filePath, 255);
-	diskCatalog[catalogCount].filePath[255] = '\0';
-	strncpy(diskCatalog[catalogCount].programName, programName, 255);
-	diskCatalog[catalogCount].programName[255] = '\0';
-	diskCatalog[catalogCount].filePath[255] = '\0';
-	diskCatalog[catalogCount].startTrack = track;
-	diskCatalog[catalogCount].startCylinder = cyl;
-	diskCatalog[catalogCount].startSector = sec;
-	diskCatalog[catalogCount].wordCount = words;
-	diskCatalog[catalogCount].startPC = startPC;
-	
+	FileMeta_t* meta = &diskCatalog[catalogCount];
+	memset(meta, 0, sizeof(*meta));
+	strcpy(meta->filePath, filePath);
+	strcpy(meta->programName, programName);
+	meta->pathHash = hashKey(filePath);
+	meta->nameHash = hashKey(programName);
+	meta->startTrack = extents[0].track;
+	meta->startCylinder = extents[0].cylinder;
+	meta->startSector = extents[0].sector;
+	meta->wordCount = words;
+	meta->startPC = startPC;
+	meta->extentCount = extentCount;
+	memcpy(meta->extents, extents, extentCount * sizeof(VFSExtent_t));
+	meta->fileId = nextFileId++;
+	markFile(meta, true);
+
+	indexAdd(catalogCount);
 	catalogCount++;
+	commitCatalog();
 	
 	char logBuffer[LOG_BUFFER_SIZE];
-	snprintf(logBuffer, LOG_BUFFER_SIZE, "VFS: File '%s' registered in catalog at T:%d C:%d S:%d", filePath, track, cyl, sec);
+	snprintf(logBuffer, LOG_BUFFER_SIZE, "VFS: File '%s' registered in catalog at T:%d C:%d S:%d (%d extents)",
+		filePath, meta->startTrack, meta->startCylinder, meta->startSector, extentCount);
 	loggerLogKernel(LOG_INFO, logBuffer);
 	
 	return VFS_SUCCESS;
 }
 
 
+VFSStatus_t vfsRegisterFile(const char* filePath, const char* programName, uint8_t track, uint8_t cyl, uint8_t sec, int words, int startPC) {
+	VFSExtent_t extent = { .track = track, .cylinder = cyl, .sector = sec, .length = words };
+	return registerExtents(filePath, programName, &extent, 1, words, startPC);
+}
+
+
+VFSStatus_t vfsDeleteFile(const char* identifier) {
+	if (!mounted) return VFS_ERR_NOT_MOUNTED;
+	int entry = indexLookup(identifier);
+	if (entry == -1) return VFS_ERR_NOT_FOUND;
+
+	FileMeta_t removed = diskCatalog[entry];
+	markFile(&removed, false);
+
+	// Later entries move down one record, keeping the catalog order
+	memmove(&diskCatalog[entry], &diskCatalog[entry + 1], (catalogCount - entry - 1) * sizeof(FileMeta_t));
+	catalogCount--;
+	memset(&diskCatalog[catalogCount], 0, sizeof(FileMeta_t));
+	commitCatalog();
+
+	indexReset();
+	for (int i = 0; i < catalogCount; i++) indexAdd(i);
+
+	LOG_KERNEL(LOG_INFO, "VFS: File '%s' deleted, %d sectors freed.", removed.filePath, removed.wordCount);
+	return VFS_SUCCESS;
+}
+
+
+int vfsGetFreeSectors(void) {
+	return freeSectors;
+}
+
+
+static bool extentCrossesTrack(const VFSExtent_t* extent) {
+	int start = vfsLinearSector(extent->track, extent->cylinder, extent->sector);
+	return extent->length > 0 && start / VFS_TRACK_SECTORS != (start + extent->length - 1) / VFS_TRACK_SECTORS;
+}
+
+
+void vfsGetFragmentation(VFSFragmentation_t* outStats) {
+	static FreeRun_t runs[VFS_TOTAL_SECTORS / 2 + 1];
+	VFSFragmentation_t stats = { .files = catalogCount, .freeSectors = freeSectors };
+
+	for (int i = 0; i < catalogCount; i++) {
+		const FileMeta_t* meta = &diskCatalog[i];
+		stats.extents += meta->extentCount;
+		if (meta->extentCount > 1) stats.splitFiles++;
+		else if (meta->wordCount <= VFS_TRACK_SECTORS && extentCrossesTrack(&meta->extents[0])) stats.crossingFiles++;
+	}
+
+	stats.freeRuns = collectFreeRuns(runs);
+	for (int i = 0; i < stats.freeRuns; i++) {
+		if (runs[i].length > stats.largestFreeRun) stats.largestFreeRun = runs[i].length;
+	}
+
+	if (stats.files > 0) stats.fileRatio = (stats.splitFiles + stats.crossingFiles) * 100 / stats.files;
+	if (stats.freeSectors > 0) stats.freeRatio = (stats.freeSectors - stats.largestFreeRun) * 100 / stats.freeSectors;
+	*outStats = stats;
+}
+
+
+static int compareBySizeDescending(const void* a, const void* b) {
+	int left = *(const int*)a, right = *(const int*)b;
+	if (diskCatalog[left].wordCount != diskCatalog[right].wordCount) return diskCatalog[right].wordCount - diskCatalog[left].wordCount;
+	return left - right;
+}
+
+
+/**
+ * @brief Plans a track-aligned layout: largest file first, each into the first track with room.
+ * A file larger than a track starts a run of untouched tracks.
+ *
+ * @param targets Receives the linear first sector of each catalog entry.
+ * @return false if some file finds no place.
+ */
+static bool planTrackAligned(int* targets) {
+	int order[VFS_MAX_FILES];
+	int fill[DISK_TRACKS];
+
+	for (int t = 0; t < DISK_TRACKS; t++) {
+		int trackStart = t * VFS_TRACK_SECTORS;
+		fill[t] = (trackStart > VFS_RESERVED_SECTORS) ? trackStart : VFS_RESERVED_SECTORS;
+		if (fill[t] > trackStart + VFS_TRACK_SECTORS) fill[t] = trackStart + VFS_TRACK_SECTORS;
+	}
+	for (int i = 0; i < catalogCount; i++) order[i] = i;
+	qsort(order, catalogCount, sizeof(int), compareBySizeDescending);
+
+	for (int k = 0; k < catalogCount; k++) {
+		int entry = order[k];
+		int words = diskCatalog[entry].wordCount;
+		int placed = -1;
+
+		for (int t = 0; t < DISK_TRACKS && placed == -1; t++) {
+			int trackEnd = (t + 1) * VFS_TRACK_SECTORS;
+			if (words <= VFS_TRACK_SECTORS) {
+				if (trackEnd - fill[t] >= words) placed = fill[t];
+				continue;
+			}
+
+			// Spans tracks: needs this track and the following ones untouched
+			int start = fill[t];
+			bool untouched = (start == ((t * VFS_TRACK_SECTORS > VFS_RESERVED_SECTORS) ? t * VFS_TRACK_SECTORS : VFS_RESERVED_SECTORS));
+			for (int u = t + 1; untouched && u < DISK_TRACKS && start + words > u * VFS_TRACK_SECTORS; u++) {
+				untouched = (fill[u] == u * VFS_TRACK_SECTORS);
+			}
+			if (untouched && start + words <= VFS_TOTAL_SECTORS) placed = start;
+		}
+		if (placed == -1) return false;
+
+		targets[entry] = placed;
+		int end = placed + words;
+		for (int t = placed / VFS_TRACK_SECTORS; t < DISK_TRACKS && t * VFS_TRACK_SECTORS < end; t++) {
+			int trackEnd = (t + 1) * VFS_TRACK_SECTORS;
+			fill[t] = (end < trackEnd) ? end : trackEnd;
+		}
+	}
+	return true;
+}
+
+
+/**
+ * @brief Plans files end to end after the catalog area, in catalog order (Always fits).
+ */
+static void planPacked(int* targets) {
+	int next = VFS_RESERVED_SECTORS;
+	for (int i = 0; i < catalogCount; i++) {
+		targets[i] = next;
+		next += diskCatalog[i].wordCount;
+	}
+}
+
+
+static bool runIsFree(int start, int length) {
+	for (int linear = start; linear < start + length; linear++) {
+		if (linear >= VFS_TOTAL_SECTORS || sectorUsed(linear)) return false;
+	}
+	return true;
+}
+
+
+/**
+ * @brief Copies a file to free sectors and commits the catalog that points at them.
+ * The old sectors are given back only after the commit, so the catalog on disk
+ * always describes whole files.
+ *
+ * @return Sectors written.
+ */
+static int moveFile(int entry, const VFSExtent_t* extents, int extentCount) {
+	static word words[VFS_TOTAL_SECTORS];
+	FileMeta_t* meta = &diskCatalog[entry];
+	FileMeta_t old = *meta;
+	vfsReadFile(meta, words);
+
+	int written = 0;
+	for (int i = 0; i < extentCount; i++) {
+		writeSectors(extents[i].track, extents[i].cylinder, extents[i].sector, words + written, extents[i].length);
+		written += extents[i].length;
+	}
+	meta->extentCount = extentCount;
+	memcpy(meta->extents, extents, extentCount * sizeof(VFSExtent_t));
+	meta->startTrack = extents[0].track;
+	meta->startCylinder = extents[0].cylinder;
+	meta->startSector = extents[0].sector;
+	commitCatalog();
+
+	markFile(&old, false);
+	markFile(meta, true);
+	return written;
+}
+
+
+VFSStatus_t vfsDefragment(VFSDefragReport_t* outReport) {
+	static word staging[VFS_TOTAL_SECTORS];
+	int targets[VFS_MAX_FILES], offsets[VFS_MAX_FILES];
+	bool pending[VFS_MAX_FILES], parked[VFS_MAX_FILES];
+	VFSDefragReport_t report = {0};
+	if (!mounted) return VFS_ERR_NOT_MOUNTED;
+
+	vfsGetFragmentation(&report.before);
+	report.trackAligned = planTrackAligned(targets);
+	if (!report.trackAligned) planPacked(targets);
+
+	int remaining = 0;
+	for (int i = 0; i < catalogCount; i++) {
+		const FileMeta_t* meta = &diskCatalog[i];
+		pending[i] = meta->extentCount != 1 || vfsLinearSector(meta->extents[0].track, meta->extents[0].cylinder, meta->extents[0].sector) != targets[i];
+		parked[i] = false;
+		if (pending[i]) {
+			remaining++;
+			report.filesMoved++;
+		}
+	}
+
+	// A file goes to its new run once that run is free, one commit per move
+	while (remaining > 0) {
+		bool progress = false;
+		for (int i = 0; i < catalogCount; i++) {
+			if (!pending[i] || !runIsFree(targets[i], diskCatalog[i].wordCount)) continue;
+			VFSExtent_t target = { .length = diskCatalog[i].wordCount };
+			vfsSectorAddress(targets[i], &target.track, &target.cylinder, &target.sector);
+			report.sectorsMoved += moveFile(i, &target, 1);
+			pending[i] = false;
+			remaining--;
+			progress = true;
+		}
+		if (progress) continue;
+
+		// Every run left is held by a waiting file: park one of them in the free space to break the cycle
+		for (int i = 0; i < catalogCount && !progress; i++) {
+			VFSExtent_t extents[VFS_MAX_EXTENTS];
+			int extentCount = (pending[i] && !parked[i]) ? allocateExtents(diskCatalog[i].wordCount, extents) : 0;
+			if (extentCount == 0) continue;
+			report.sectorsMoved += moveFile(i, extents, extentCount);
+			parked[i] = true;
+			progress = true;
+		}
+		if (!progress) break;
+	}
+
+	// No room to park what is left: those files are rewritten over each other from a copy in
+	// host memory and committed together, the only step that an interruption can damage
+	if (remaining > 0) {
+		int staged = 0;
+		for (int i = 0; i < catalogCount; i++) {
+			if (!pending[i]) continue;
+			offsets[i] = staged;
+			vfsReadFile(&diskCatalog[i], staging + staged);
+			staged += diskCatalog[i].wordCount;
+		}
+		for (int i = 0; i < catalogCount; i++) {
+			if (!pending[i]) continue;
+			FileMeta_t* meta = &diskCatalog[i];
+			VFSExtent_t target = { .length = meta->wordCount };
+			vfsSectorAddress(targets[i], &target.track, &target.cylinder, &target.sector);
+			writeSectors(target.track, target.cylinder, target.sector, staging + offsets[i], meta->wordCount);
+			meta->extentCount = 1;
+			meta->extents[0] = target;
+			meta->startTrack = target.track;
+			meta->startCylinder = target.cylinder;
+			meta->startSector = target.sector;
+			report.sectorsMoved += meta->wordCount;
+		}
+		commitCatalog();
+		LOG_KERNEL(LOG_WARNING, "VFS: No free room to move %d files safely, they were rewritten in place.", remaining);
+	}
+	diskSync();
+
+	resetFreeSpace();
+	for (int i = 0; i < catalogCount; i++) markFile(&diskCatalog[i], true);
+	vfsGetFragmentation(&report.after);
+
+	LOG_KERNEL(LOG_INFO, "VFS: Defragmented %d files (%d sectors moved), fragmentation %d%% -> %d%%, free space %d%% -> %d%%.",
+		report.filesMoved, report.sectorsMoved, report.before.fileRatio, report.after.fileRatio, report.before.freeRatio, report.after.freeRatio);
+	if (outReport != NULL) *outReport = report;
+	return VFS_SUCCESS;
+}
+
+
 void vfsClearCatalog(void) {
+	mounted = true;
 	catalogCount = 0;
-	freeTrack = 0;
-	freeCylinder = 0;
-	freeSector = 0;
 	memset(diskCatalog, 0, sizeof(diskCatalog));
+	indexReset();
+	resetFreeSpace();
+	commitCatalog();
 }
 
 
-VFSStatus_t vfsLoadToDisk(const char* filePath) {
-	if (vfsFileExists(filePath)) {
-		return VFS_SUCCESS;
+/**
+ * @brief Reads one copy of the catalog and checks its superblock and checksum.
+ * @return false if the copy is blank, of another layout or damaged.
+ */
+static bool readCopy(int copy, Superblock_t* superblock, CatalogRecord_t* records) {
+	readBytes(copySector(copy), superblock, sizeof(*superblock));
+	bool valid = superblock->magic == VFS_CATALOG_MAGIC && superblock->version == VFS_CATALOG_VERSION &&
+	             superblock->reservedSectors == VFS_RESERVED_SECTORS && superblock->count <= VFS_MAX_FILES;
+	if (!valid) return false;
+
+	readBytes(recordSector(copy, 0), records, superblock->count * sizeof(CatalogRecord_t));
+	return catalogChecksum(superblock, records) == superblock->checksum;
+}
+
+
+/**
+ * @brief Rebuilds the catalog, the index and the free space from the records of a copy.
+ * @return false if a record is out of the data area or files overlap.
+ */
+static bool loadRecords(const Superblock_t* superblock, const CatalogRecord_t* records) {
+	memset(diskCatalog, 0, sizeof(diskCatalog));
+	indexReset();
+	resetFreeSpace();
+	bool valid = true;
+	for (int i = 0; valid && i < superblock->count; i++) {
+		valid = fromRecord(&records[i], &diskCatalog[i]) && markFile(&diskCatalog[i], true);
+		diskCatalog[i].fileId = nextFileId++;
+		indexAdd(i);
+	}
+	return valid;
+}
+
+
+int vfsMount(void) {
+	static CatalogRecord_t records[VFS_CATALOG_COPIES][VFS_MAX_FILES];
+	Superblock_t superblocks[VFS_CATALOG_COPIES];
+	bool valid[VFS_CATALOG_COPIES], blank = true;
+	for (int copy = 0; copy < VFS_CATALOG_COPIES; copy++) {
+		valid[copy] = readCopy(copy, &superblocks[copy], records[copy]);
+		blank &= superblocks[copy].magic == 0;
+	}
+
+	// The newest valid copy first; the other one holds the catalog before the last commit
+	int newest = (valid[1] && (!valid[0] || superblocks[1].generation > superblocks[0].generation)) ? 1 : 0;
+	int mountedCopy = -1;
+	for (int k = 0; k < VFS_CATALOG_COPIES && mountedCopy == -1; k++) {
+		int copy = (k == 0) ? newest : 1 - newest;
+		if (valid[copy] && loadRecords(&superblocks[copy], records[copy])) mountedCopy = copy;
+	}
+
+	// A damaged catalog on an image is kept as it is: formatting it would lose every file for good
+	if (mountedCopy == -1 && !blank && diskIsPersistent()) {
+		memset(diskCatalog, 0, sizeof(diskCatalog));
+		indexReset();
+		resetFreeSpace();
+		mounted = false;
+		loggerLogKernel(LOG_ERROR, "VFS: Stored catalog is damaged or outdated, the disk image is left untouched until it is formatted.");
+		return -1;
 	}
+	if (mountedCopy == -1) {
+		if (!blank) loggerLogKernel(LOG_WARNING, "VFS: Stored catalog is damaged or outdated, formatting.");
+		activeCopy = 0;
+		generation = 0;
+		vfsClearCatalog();
+		loggerLogKernel(LOG_INFO, "VFS: Formatted an empty catalog on the Virtual Disk.");
+		return 0;
+	}
+	const Superblock_t* other = &superblocks[1 - mountedCopy];
+	if (mountedCopy != newest || (!valid[1 - mountedCopy] && other->magic != 0)) {
+		LOG_KERNEL(LOG_WARNING, "VFS: The last catalog commit is incomplete, the previous one (generation %u) was restored.", superblocks[mountedCopy].generation);
+	}
+	catalogCount = superblocks[mountedCopy].count;
+	activeCopy = mountedCopy;
+	generation = superblocks[mountedCopy].generation;
+	mounted = true;
+
+	LOG_KERNEL(LOG_INFO, "VFS: Catalog restored from the Virtual Disk (%d files, %d free sectors).", catalogCount, freeSectors);
+	return catalogCount;
+}
+
+
+/**
+ * @brief Checks whether an open program file starts with the binary image magic (Rewinds it).
+ */
+static bool isProgramImage(FILE* file) {
+	char magic[sizeof(((ProgramImageHeader_t*)0)->magic)];
+	bool binary = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, VFS_IMAGE_MAGIC, sizeof(magic)) == 0;
+	rewind(file);
+	return binary;
+}
+
+
+/**
+ * @brief Maps a binary program image and validates its header, size and checksum.
+ * @return VFS_SUCCESS with the image mapped (Release it with unmapProgramImage), or VFS_ERR_BAD_IMAGE.
+ */
+static VFSStatus_t mapProgramImage(FILE* file, MappedImage_t* image) {
+	struct stat info;
+	if (fstat(fileno(file), &info) != 0 || (size_t)info.st_size < sizeof(ProgramImageHeader_t)) return VFS_ERR_BAD_IMAGE;
+
+	void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (mapping == MAP_FAILED) return VFS_ERR_BAD_IMAGE;
+
+	const ProgramImageHeader_t* header = mapping;
+	const word* words = (const word*)(header + 1);
+	bool valid = header->version == VFS_IMAGE_VERSION && header->wordCount >= 0 &&
+	             (size_t)info.st_size == sizeof(ProgramImageHeader_t) + (size_t)header->wordCount * sizeof(word) &&
+	             memchr(header->programName, '\0', VFS_IMAGE_NAME_SIZE) != NULL &&
+	             vfsImageChecksum(words, header->wordCount) == header->checksum;
+	if (!valid) {
+		munmap(mapping, info.st_size);
+		return VFS_ERR_BAD_IMAGE;
+	}
+
+	*image = (MappedImage_t){ .mapping = mapping, .size = info.st_size, .header = header, .words = words };
+	return VFS_SUCCESS;
+}
+
+
+static void unmapProgramImage(MappedImage_t* image) {
+	munmap(image->mapping, image->size);
+}
+
+
+/**
+ * @brief Places the words of a program on the disk and registers it.
+ */
+static VFSStatus_t storeProgram(const char* filePath, const char* programName, int startPC, const word* words, int wordCount) {
+	if (!mounted) {
+		loggerLogKernel(LOG_WARNING, "VFS Error: The catalog is not mounted, nothing is written until the disk is formatted.");
+		return VFS_ERR_NOT_MOUNTED;
+	}
+	if (catalogCount >= VFS_MAX_FILES) {
+		loggerLogKernel(LOG_WARNING, "VFS Error: Disk catalog is full.");
+		return VFS_ERR_DISK_FULL;
+	}
+	if (strlen(filePath) >= VFS_PATH_SIZE || strlen(programName) >= VFS_PATH_SIZE) {
+		LOG_KERNEL(LOG_WARNING, "VFS Error: '%s' (%s) is too long for the catalog.", filePath, programName);
+		return VFS_ERR_NAME_TOO_LONG;
+	}
+
+	VFSExtent_t extents[VFS_MAX_EXTENTS];
+	int extentCount = allocateExtents(wordCount, extents);
+	if (extentCount == 0) {
+		LOG_KERNEL(LOG_ERROR, "VFS Error: No room for %d words on Virtual Disk (%d sectors free).", wordCount, freeSectors);
+		return VFS_ERR_DISK_FULL;
+	}
+
+	int written = 0;
+	for (int i = 0; i < extentCount; i++) {
+		writeSectors(extents[i].track, extents[i].cylinder, extents[i].sector, words + written, extents[i].length);
+		written += extents[i].length;
+	}
+	loggerLogKernel(LOG_INFO, "VFS: Program fully written to Virtual Disk.");
+
+	return registerExtents(filePath, programName, extents, extentCount, wordCount, startPC);
+}
+
+
+VFSStatus_t vfsParseProgram(const char* filePath, VFSProgram_t* outProgram) {
+	*outProgram = (VFSProgram_t){0};
 
 	FILE* file = fopen(filePath, "r");
 	if (!file) {
@@ -96,47 +921,79 @@ VFSStatus_t vfsLoadToDisk(const char* filePath) {
 		return VFS_ERR_NOT_FOUND;
 	}
 
-	int startPC, wordCount;
-	char programName[256];
+	if (isProgramImage(file)) {
+		MappedImage_t image;
+		VFSStatus_t status = mapProgramImage(file, &image);
+		fclose(file); // The mapping stays valid
+		if (status != VFS_SUCCESS) {
+			LOG_KERNEL(LOG_ERROR, "VFS Error: '%s' is not a valid version %d program image.", filePath, VFS_IMAGE_VERSION);
+			return status;
+		}
+
+		// The words stay in the mapping until the program is stored
+		snprintf(outProgram->programName, sizeof(outProgram->programName), "%s", image.header->programName);
+		outProgram->startPC = image.header->startPC;
+		outProgram->wordCount = image.header->wordCount;
+		outProgram->words = image.words;
+		outProgram->mapping = image.mapping;
+		outProgram->mappingSize = image.size;
+		return VFS_SUCCESS;
+	}
+
+	int startPC = 0, wordCount = 0;
 	fscanf(file, "%*s %d", &startPC);
 	fscanf(file, "%*s %d", &wordCount);
-	fscanf(file, "%*s %s", programName);
+	fscanf(file, "%*s %255s", outProgram->programName);
+
+	if (wordCount < 0 || wordCount > VFS_TOTAL_SECTORS - VFS_RESERVED_SECTORS) {
+		LOG_KERNEL(LOG_ERROR, "VFS Error: '%s' declares %d words, more than the Virtual Disk holds.", filePath, wordCount);
+		fclose(file);
+		return VFS_ERR_DISK_FULL;
+	}
 
-	int totalDiskSectors = DISK_TRACKS * DISK_CYLINDERS * DISK_SECTORS;
-	int usedSectors = (freeTrack * DISK_CYLINDERS * DISK_SECTORS) + (freeCylinder * DISK_SECTORS) + freeSector;
-	if (wordCount > (totalDiskSectors - usedSectors)) {
-		loggerLogKernel(LOG_ERROR, "VFS Error: Not enough contiguous space on Virtual Disk.");
+	word* buffer = malloc((wordCount > 0 ? wordCount : 1) * sizeof(word));
+	if (buffer == NULL) {
 		fclose(file);
 		return VFS_ERR_DISK_FULL;
 	}
+	for (int i = 0; i < wordCount; i++) buffer[i] = readProgramWord(file);
+	fclose(file);
 
-	uint8_t startT = freeTrack;
-	uint8_t startC = freeCylinder;
-	uint8_t startS = freeSector;
+	outProgram->startPC = startPC;
+	outProgram->wordCount = wordCount;
+	outProgram->words = buffer;
+	outProgram->buffer = buffer;
+	return VFS_SUCCESS;
+}
 
-	for (int i = 0; i < wordCount; i++) {
-		word instruction = readProgramWord(file);
-		
-		Sector_t sectorData;
-		sectorData.data = instruction;
-		
-		writeSector(freeTrack, freeCylinder, freeSector, sectorData);
-
-		freeSector++;
-		if (freeSector >= DISK_SECTORS) {
-			freeSector = 0;
-			freeCylinder++;
-			if (freeCylinder >= DISK_CYLINDERS) {
-				freeCylinder = 0;
-				freeTrack++;
-			}
-		}
+
+VFSStatus_t vfsStoreProgram(const char* filePath, const VFSProgram_t* program) {
+	if (vfsFileExists(filePath)) {
+		return VFS_SUCCESS;
 	}
+	return storeProgram(filePath, program->programName, program->startPC, program->words, program->wordCount);
+}
 
-	fclose(file);
-	loggerLogKernel(LOG_INFO, "VFS: Program fully written to Virtual Disk.");
 
-	return vfsRegisterFile(filePath, programName, startT, startC, startS, wordCount, startPC);
+void vfsReleaseProgram(VFSProgram_t* program) {
+	if (program->mapping != NULL) munmap(program->mapping, program->mappingSize);
+	free(program->buffer);
+	*program = (VFSProgram_t){0};
+}
+
+
+VFSStatus_t vfsLoadToDisk(const char* filePath) {
+	if (vfsFileExists(filePath)) {
+		return VFS_SUCCESS;
+	}
+
+	VFSProgram_t program;
+	VFSStatus_t status = vfsParseProgram(filePath, &program);
+	if (status != VFS_SUCCESS) return status;
+
+	status = vfsStoreProgram(filePath, &program);
+	vfsReleaseProgram(&program);
+	return status;
 }
 
 
@@ -170,13 +1027,27 @@ ProgramInfo_t loadProgram(char* filePath) {
 	if (programFile) {
 		loggerLogHardware(LOG_INFO, "Loader: File opened successfully. Parsing metadata...");
 
-		fscanf(programFile, "%*s %d", &programInfo._start);
-		fscanf(programFile, "%*s %d", &programInfo.wordCount);
-		fscanf(programFile, "%*s %s", programInfo.programName);
+		MappedImage_t image = {0};
+		if (isProgramImage(programFile)) {
+			if (mapProgramImage(programFile, &image) != VFS_SUCCESS) {
+				fclose(programFile);
+				programInfo.status = LOAD_FILE_ERROR;
+				return programInfo;
+			}
+			programInfo._start = image.header->startPC;
+			programInfo.wordCount = image.header->wordCount;
+			strcpy(programInfo.programName, image.header->programName);
+		} else {
+			fscanf(programFile, "%*s %d", &programInfo._start);
+			fscanf(programFile, "%*s %d", &programInfo.wordCount);
+			fscanf(programFile, "%*s %255s", programInfo.programName);
+		}
 
 		CPU.PSW.mode = MODE_KERNEL;
 
 		if (OS_RESERVED_SIZE + MIN_STACK_SIZE + programInfo.wordCount > RAM_SIZE) {
+			if (image.mapping != NULL) unmapProgramImage(&image);
+			fclose(programFile);
 			programInfo.status = LOAD_FILE_ERROR;
 			return programInfo;
 		}
@@ -187,10 +1058,11 @@ ProgramInfo_t loadProgram(char* filePath) {
 		}
 
 		for (int i = 0 ; i < programInfo.wordCount; i++) {
-			word instruction = readProgramWord(programFile);
+			word instruction = (image.mapping != NULL) ? image.words[i] : readProgramWord(programFile);
 			MemoryStatus_t ret = writeMemory(OS_RESERVED_SIZE + i, instruction);
 			
 			if (ret != MEM_SUCCESS) {
+				if (image.mapping != NULL) unmapProgramImage(&image);
 				fclose(programFile);
 				programInfo.status = LOAD_MEMORY_ERROR;
 				return programInfo;
@@ -208,6 +1080,7 @@ ProgramInfo_t loadProgram(char* filePath) {
 		CPU.PSW.interruptEnable = ITR_ENABLED;
 		
 		programInfo.status = LOAD_SUCCESS;
+		if (image.mapping != NULL) unmapProgramImage(&image);
 		fclose(programFile);
 	} else {
 		programInfo.status = LOAD_FILE_ERROR;
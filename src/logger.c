@@ -3,38 +3,125 @@
 #include <pthread.h>
 #include <time.h>
 #include <string.h>
+#include <stdatomic.h>
 
 #include "../inc/logger.h"
 
 const char* HARDWARE_LOG_FILE_NAME = "logs_hardware.txt";
 const char* KERNEL_LOG_FILE_NAME = "logs_kernel.txt";
+const char* TRACE_LOG_FILE_NAME = "logs_trace.bin";
 
 FILE* hardwareLogFile = NULL;
 FILE* kernelLogFile = NULL;
+_Atomic(FILE*) traceLogFile = NULL;  // Published by openTraceFile() once set up: the writer thread reads it
 
-static pthread_mutex_t LOG_LOCK = PTHREAD_MUTEX_INITIALIZER;
+LogLevel_t loggerMinLevel[LOG_TYPE_COUNT] = { LOG_INFO, LOG_INFO };
+atomic_bool loggerTraceBinary = false;
 
-static void getCurrentTimeString(char* buffer, size_t size) {
-	time_t now = time(NULL);
-	struct tm *t = localtime(&now);
-	
-	if (t == NULL || strftime(buffer, size, "%y-%m-%d %H:%M:%S", t) == 0) {
+/**
+ * @brief One slot of the MPSC ring.
+ * `sequence` tells who owns the slot: it equals the ticket of the producer
+ * allowed to fill it, and ticket + 1 once the record is ready for the writer.
+ */
+typedef struct {
+	atomic_size_t sequence;
+	bool isTrace;  // Selects the active member of the union
+	time_t timestamp;
+	LogType_t type;
+	LogLevel_t level;
+	union {
+		char message[LOG_BUFFER_SIZE];
+		TraceRecord_t trace;
+	};
+} LogRecord_t;
+
+static LogRecord_t logRing[LOGGER_RING_SIZE];
+static atomic_size_t ringHead = 0;  // Next ticket handed to a producer
+static size_t ringTail = 0;         // Next record consumed (writer thread only)
+
+static atomic_bool loggerRunning = false;
+static atomic_ulong droppedRecords = 0;
+static atomic_int tracePid = 0;
+static pthread_t writerThread;
+static char hardwareFileBuffer[LOGGER_FILE_BUFFER_SIZE];
+static char kernelFileBuffer[LOGGER_FILE_BUFFER_SIZE];
+static char traceFileBuffer[LOGGER_FILE_BUFFER_SIZE];
+
+static void getCurrentTimeString(time_t now, char* buffer, size_t size) {
+	struct tm t;
+
+	if (localtime_r(&now, &t) == NULL || strftime(buffer, size, "%y-%m-%d %H:%M:%S", &t) == 0) {
 		strncpy(buffer, "UNKNOWN_TIME", size);
 	}
 }
 
 
+/**
+ * @brief Reserves the next ring slot for the calling producer.
+ * @return The slot (publish it with releaseSlot), or NULL when the ring is full.
+ */
+static LogRecord_t* claimSlot(size_t* outTicket) {
+	if (!atomic_load_explicit(&loggerRunning, memory_order_acquire)) return NULL;
+
+	size_t ticket = atomic_load_explicit(&ringHead, memory_order_relaxed);
+
+	for (;;) {
+		LogRecord_t* record = &logRing[ticket & (LOGGER_RING_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+
+		if (sequence == ticket) {
+			if (atomic_compare_exchange_weak_explicit(&ringHead, &ticket, ticket + 1, memory_order_relaxed, memory_order_relaxed)) {
+				*outTicket = ticket;
+				return record;
+			}
+		} else if (sequence < ticket) {
+			// The writer has not consumed this slot yet: never block the caller
+			atomic_fetch_add_explicit(&droppedRecords, 1, memory_order_relaxed);
+			return NULL;
+		} else {
+			ticket = atomic_load_explicit(&ringHead, memory_order_relaxed);
+		}
+	}
+}
+
+
+static void releaseSlot(LogRecord_t* record, size_t ticket) {
+	atomic_store_explicit(&record->sequence, ticket + 1, memory_order_release);
+}
+
+
 static void saveInLogFile(LogLevel_t level, const char* message, LogType_t logType) {
-	FILE* targetFile = (logType == KERNEL_LOG) ? kernelLogFile : hardwareLogFile;
+	if (!loggerIsEnabled(logType, level)) return;
+
+	size_t ticket;
+	LogRecord_t* record = claimSlot(&ticket);
+	if (record == NULL) return;
+
+	record->isTrace = false;
+	record->timestamp = time(NULL);
+	record->type = logType;
+	record->level = level;
+	strncpy(record->message, message, LOG_BUFFER_SIZE - 1);
+	record->message[LOG_BUFFER_SIZE - 1] = '\0';
+	releaseSlot(record, ticket);
+}
 
+
+static void writeRecord(const LogRecord_t* record) {
+	if (record->isTrace) {
+		FILE* traceFile = atomic_load_explicit(&traceLogFile, memory_order_acquire);
+		if (traceFile != NULL) fwrite(&record->trace, sizeof(TraceRecord_t), 1, traceFile);
+		return;
+	}
+
+	FILE* targetFile = (record->type == KERNEL_LOG) ? kernelLogFile : hardwareLogFile;
 	if (targetFile == NULL) return;
 
-	pthread_mutex_lock(&LOG_LOCK);
 	char timeBuffer[32];
-	getCurrentTimeString(timeBuffer, sizeof(timeBuffer));
+	getCurrentTimeString(record->timestamp, timeBuffer, sizeof(timeBuffer));
 	const char* prefix = ":";
 
-		switch (level) {
+		switch (record->level) {
 			case LOG_INFO:
 				prefix = ":";
 				break;
@@ -44,24 +131,104 @@ static void saveInLogFile(LogLevel_t level, const char* message, LogType_t logTy
 			case LOG_ERROR:
 				prefix = ": [ERROR]";
 				break;
+			case LOG_OFF:
+				break;
+		}
+
+	fprintf(targetFile, "[%s]%s %s\n", timeBuffer, prefix, record->message);
+}
+
+
+/**
+ * @brief Writes every ready record into the stdio buffers.
+ * @return The number of records consumed.
+ */
+static int drainRing(void) {
+	int written = 0;
+
+	for (;;) {
+		LogRecord_t* record = &logRing[ringTail & (LOGGER_RING_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+		if (sequence != ringTail + 1) break;
+
+		writeRecord(record);
+		atomic_store_explicit(&record->sequence, ringTail + LOGGER_RING_SIZE, memory_order_release);
+		ringTail++;
+		written++;
+	}
+
+	return written;
+}
+
+
+static void* loggerWriterThread(void* arg) {
+	(void)arg;
+	struct timespec idle = { 0, LOGGER_IDLE_SLEEP_NS };
+
+	while (atomic_load_explicit(&loggerRunning, memory_order_acquire)) {
+		if (drainRing() == 0) {
+			// Batch complete: one flush per burst instead of one per line
+			if (hardwareLogFile != NULL) fflush(hardwareLogFile);
+			if (kernelLogFile != NULL) fflush(kernelLogFile);
+			FILE* traceFile = atomic_load_explicit(&traceLogFile, memory_order_acquire);
+			if (traceFile != NULL) fflush(traceFile);
+			nanosleep(&idle, NULL);
 		}
+	}
 
-	fprintf(targetFile, "[%s]%s %s\n", timeBuffer, prefix, message);
-	fflush(targetFile);
-	pthread_mutex_unlock(&LOG_LOCK);
+	drainRing();
+	return NULL;
+}
+
+
+/**
+ * @brief Opens the trace file and writes its header, then hands it to the writer thread.
+ * The stream is set up through a local pointer: the writer may flush traceLogFile at any time.
+ */
+static void openTraceFile(void) {
+	FILE* file = fopen(TRACE_LOG_FILE_NAME, "ab");
+	if (file == NULL) return;
+
+	setvbuf(file, traceFileBuffer, _IOFBF, LOGGER_FILE_BUFFER_SIZE);
+	fseek(file, 0, SEEK_END);
+	if (ftell(file) == 0) {
+		TraceFileHeader_t header = { .version = TRACE_FILE_VERSION, .recordSize = sizeof(TraceRecord_t) };
+		memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+		fwrite(&header, sizeof(header), 1, file);
+	}
+	atomic_store_explicit(&traceLogFile, file, memory_order_release);
 }
 
 
 void loggerInit(void) {
-	pthread_mutex_lock(&LOG_LOCK);
+	if (atomic_load(&loggerRunning)) return;
+
 	hardwareLogFile = fopen(HARDWARE_LOG_FILE_NAME, "a");
 	kernelLogFile = fopen(KERNEL_LOG_FILE_NAME, "a");
-	pthread_mutex_unlock(&LOG_LOCK);
+	if (hardwareLogFile != NULL) setvbuf(hardwareLogFile, hardwareFileBuffer, _IOFBF, LOGGER_FILE_BUFFER_SIZE);
+	if (kernelLogFile != NULL) setvbuf(kernelLogFile, kernelFileBuffer, _IOFBF, LOGGER_FILE_BUFFER_SIZE);
+	if (loggerTraceBinary) openTraceFile();
+
+	for (size_t i = 0; i < LOGGER_RING_SIZE; i++) {
+		atomic_store_explicit(&logRing[i].sequence, i, memory_order_relaxed);
+	}
+	atomic_store(&ringHead, 0);
+	ringTail = 0;
+	atomic_store(&droppedRecords, 0);
+
+	atomic_store_explicit(&loggerRunning, true, memory_order_release);
+	if (pthread_create(&writerThread, NULL, loggerWriterThread, NULL) != 0) {
+		atomic_store(&loggerRunning, false);
+	}
 }
 
 
 void loggerClose(void) {
-	pthread_mutex_lock(&LOG_LOCK);
+	if (!atomic_exchange(&loggerRunning, false)) return;
+
+	// The writer drains whatever is left before exiting
+	pthread_join(writerThread, NULL);
+
 	if (hardwareLogFile != NULL) {
 		fclose(hardwareLogFile);
 		hardwareLogFile = NULL;
@@ -70,7 +237,57 @@ void loggerClose(void) {
 		fclose(kernelLogFile);
 		kernelLogFile = NULL;
 	}
-	pthread_mutex_unlock(&LOG_LOCK);
+	FILE* traceFile = atomic_exchange(&traceLogFile, NULL);
+	if (traceFile != NULL) fclose(traceFile);
+}
+
+
+void loggerSetTraceBinary(bool enabled) {
+	// The file is published before the flag, so the writer never sees trace records without it
+	if (enabled && atomic_load(&traceLogFile) == NULL && atomic_load(&loggerRunning)) openTraceFile();
+	atomic_store(&loggerTraceBinary, enabled);
+}
+
+
+void loggerSetTracePid(int pid) {
+	atomic_store_explicit(&tracePid, pid, memory_order_relaxed);
+}
+
+
+void loggerTraceEvent(TraceEvent_t event, uint64_t cycle, uint32_t pc, int32_t op0, int32_t op1, int32_t op2) {
+	loggerTraceEventAs(event, cycle, atomic_load_explicit(&tracePid, memory_order_relaxed), pc, op0, op1, op2);
+}
+
+
+void loggerTraceEventAs(TraceEvent_t event, uint64_t cycle, int pid, uint32_t pc, int32_t op0, int32_t op1, int32_t op2) {
+	size_t ticket;
+	LogRecord_t* record = claimSlot(&ticket);
+	if (record == NULL) return;
+
+	record->isTrace = true;
+	record->trace = (TraceRecord_t){
+		.event = (uint16_t)event,
+		.pid = (int16_t)pid,
+		.pc = pc,
+		.cycle = cycle,
+		.operands = { op0, op1, op2 },
+	};
+	releaseSlot(record, ticket);
+}
+
+
+unsigned long loggerGetDroppedCount(void) {
+	return atomic_load_explicit(&droppedRecords, memory_order_relaxed);
+}
+
+
+void loggerSetLevel(LogType_t type, LogLevel_t minLevel) {
+	loggerMinLevel[type] = minLevel;
+}
+
+
+LogLevel_t loggerGetLevel(LogType_t type) {
+	return loggerMinLevel[type];
 }
 
 
@@ -112,6 +329,4 @@ void loggerLogInterrupt(InterruptCode_t code) {
 
 	if (isError) loggerLogHardware(LOG_ERROR, message);
 	else loggerLogHardware(LOG_WARNING, message);
-
-	fflush(hardwareLogFile);
 }
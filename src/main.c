@@ -1,19 +1,39 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "../inc/definitions.h"
 #include "../inc/logger.h"
 #include "../inc/console.h"
+#include "../inc/hardware/disk.h"
 #include "../inc/hardware/dma.h"
 #include "../inc/hardware/memory.h"
 #include "../inc/kernel/core.h"
 
 CPU_t CPU;
 
-int main() {
+int main(int argc, char** argv) {
+	const char* diskImage = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:")) != -1) {
+		if (opt == 'd') {
+			diskImage = optarg;
+		} else {
+			fprintf(stderr, "Usage: %s [-d disk-image]\n", argv[0]);
+			return 1;
+		}
+	}
+
 	loggerInit();
 	memoryInit();
 
+	if (diskImage != NULL && diskAttachImage(diskImage) != DISK_SUCCESS) {
+		printf("\x1b[1;31mCRITICAL ERROR: Could not attach disk image '%s'.\x1b[0m\n", diskImage);
+		loggerClose();
+		return 1;
+	}
+
 	pthread_t dmaThread;
 	pthread_create(&dmaThread, NULL, &dmaInit, NULL);
 	pthread_detach(dmaThread);
@@ -39,6 +59,7 @@ int main() {
 	}
 
 	osStop();
+	diskDetachImage();
 
 	loggerClose();
 	pthread_mutex_destroy(&BUS_LOCK);
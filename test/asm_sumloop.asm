@@ -0,0 +1,31 @@
+; Adds LIMIT, LIMIT - 1, ..., 1 and exits with the total as the exit code.
+; Assemble with: ./bin/lucasm -O test/asm_sumloop.asm -o sumloop.txt
+.name   SumLoop
+.start  main
+.equ    LIMIT 10
+.equ    STEP  1
+.equ    EXIT  1
+
+main:   LOAD #0
+        PSH                 // M[SP] = 0, compared by JMPNE
+        STR total
+        LOAD #LIMIT
+        MULT #STEP          // Identity, dropped by -O
+        STR counter
+loop:   LOAD counter
+        SUM total
+        STR total
+        LOAD total          // Already in AC, dropped by -O
+        LOAD counter
+        RES #STEP
+        STR counter
+        JMPNE again         // Threaded by -O straight to loop
+        J done
+again:  J loop
+done:   LOAD total
+        PSH
+        LOAD #EXIT
+        SVC
+
+total:   .word 0
+counter: .word 0
@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../lib/utest.h"
+#include "../tools/assembler.h"
+
+UTEST_MAIN();
+
+#define MAX_TEST_WORDS 64
+
+// Assembles a source string, optionally optimized; returns the status of the first failing step
+static AsmStatus_t assemble(const char* source, bool optimize, word* words, int* count, int* startPC, AsmOptimizeReport_t* report) {
+	FILE* file = fmemopen((void*)source, strlen(source), "r");
+	AsmProgram_t program;
+	AsmStatus_t status = asmParse(file, &program);
+	fclose(file);
+
+	if (status == ASM_SUCCESS && optimize) asmOptimize(&program, report);
+	if (status == ASM_SUCCESS) status = asmEncode(&program, words, count, startPC);
+	asmFree(&program);
+	return status;
+}
+
+UTEST(Assembler, EncodesModesLabelsAndConstants) {
+	const char* source =
+		".name Demo\n"
+		".equ TEN 10\n"
+		".start main\n"
+		"        .word -5          ; data before the code\n"
+		"main:   LOAD #TEN\n"
+		"        SUM value\n"
+		"        LOAD table[AC]    // indexed\n"
+		"        JMPNE main\n"
+		"        sdmam #table + 1\n"
+		"        PSH\n"
+		"value:  .word TEN - 7\n"
+		"table:\n";
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+
+	ASSERT_EQ(assemble(source, false, words, &count, &startPC, NULL), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(count, 8);
+	ASSERT_EQ(startPC, 2);
+	ASSERT_EQ(words[0], SIGN_BIT + 5);
+	ASSERT_EQ(words[1], 4100010);
+	ASSERT_EQ(words[2], 7);
+	ASSERT_EQ(words[3], 4200008);
+	ASSERT_EQ(words[4], 10000001);
+	ASSERT_EQ(words[5], 32100009);
+	ASSERT_EQ(words[6], 25000000);
+	ASSERT_EQ(words[7], 3);
+}
+
+UTEST(Assembler, ReportsErrors) {
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+
+	ASSERT_EQ(assemble("FOO 1\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYNTAX);
+	ASSERT_EQ(assemble("J nowhere\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYMBOL);
+	ASSERT_EQ(assemble("STR #1\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYNTAX);
+	ASSERT_EQ(assemble("PSH 1\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYNTAX);
+	ASSERT_EQ(assemble("a: PSH\na: POP\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYMBOL);
+	ASSERT_EQ(assemble("LOAD #2 * 3\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_SYNTAX);
+	ASSERT_EQ(assemble("LOAD #100000\n", false, words, &count, &startPC, NULL), (unsigned)ASM_ERR_RANGE);
+}
+
+UTEST(Optimizer, ThreadsJumps) {
+	const char* source =
+		"start:  LOAD x\n"
+		"        JMPE hop1\n"
+		"        J next\n"
+		"next:   PSH\n"
+		"hop1:   J hop2\n"
+		"hop2:   J start\n"
+		"x:      .word 0\n";
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+	AsmOptimizeReport_t report;
+
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(report.jumpsRemoved, 1);   // J next
+	ASSERT_GE(report.jumpsThreaded, 2);  // JMPE and J hop2 go straight to start
+	ASSERT_EQ(count, 6);
+	ASSERT_EQ(words[0], 4000005);        // x moved from 6 to 5
+	ASSERT_EQ(words[1], 9000000);
+	ASSERT_EQ(words[2], 25000000);
+	ASSERT_EQ(words[3], 27000000);
+	ASSERT_EQ(words[4], 27000000);
+}
+
+UTEST(Optimizer, DropsRedundantLoadsAndStores) {
+	const char* source =
+		"        LOAD #1\n"
+		"        LOAD x\n"       // Overwrites the LOAD #1
+		"        STR y\n"
+		"        LOAD y\n"       // AC already holds y
+		"        STR y\n"        // y already holds AC
+		"back:   LOAD y\n"       // A label: control may arrive with another AC
+		"        PSH\n"
+		"        J back\n"
+		"x:      .word 4\n"
+		"y:      .word 0\n";
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+	AsmOptimizeReport_t report;
+
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(report.loadsStores, 3);
+	ASSERT_EQ(count, 7);
+	ASSERT_EQ(words[0], 4000005);
+	ASSERT_EQ(words[1], 5000006);
+	ASSERT_EQ(words[2], 4000006);
+	ASSERT_EQ(words[4], 27000002);
+}
+
+UTEST(Optimizer, LabelOnDroppedLoadMovesToNext) {
+	const char* source =
+		"        STR v\n"
+		"again:  LOAD #1\n"      // Dropped, so the label lands on LOAD v
+		"        LOAD v\n"       // Must stay: a jump to again reaches it with any AC
+		"        PSH\n"
+		"        J again\n"
+		"v:      .word 0\n";
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+	AsmOptimizeReport_t report;
+
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(count, 5);
+	ASSERT_EQ(words[1], 4000004);
+	ASSERT_EQ(words[3], 27000001);
+}
+
+UTEST(Optimizer, FoldsImmediates) {
+	const char* source =
+		".equ N 6\n"
+		"        LOAD #N\n"
+		"        MULT #7\n"
+		"        SUM #0\n"
+		"        RES #2\n"
+		"        DIVI #4\n"       // (6 * 7 - 2) / 4
+		"        PSH\n"
+		"        SUM #3\n"
+		"        SUM #4\n"
+		"        DIVI #0\n"       // Left alone
+		"        LOAD #99999\n"
+		"        SUM #1\n";       // Would not fit in 5 digits
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+	AsmOptimizeReport_t report;
+
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(count, 6);
+	ASSERT_EQ(words[0], 4100010);
+	ASSERT_EQ(words[1], 25000000);
+	ASSERT_EQ(words[2], 100007);
+	ASSERT_EQ(words[3], 3100000);
+	ASSERT_EQ(words[4], 4199999);
+	ASSERT_EQ(words[5], 100001);
+}
+
+UTEST(Optimizer, KeepsProgramsWithNumericAddresses) {
+	const char* source =
+		"        LOAD #1\n"
+		"        LOAD #2\n"
+		"        STR 3\n"         // Would point elsewhere once a word is dropped
+		"        .word 0\n";
+	word words[MAX_TEST_WORDS];
+	int count, startPC;
+	AsmOptimizeReport_t report;
+
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(report.fixedAddressLine, 3);
+	ASSERT_EQ(count, 4);
+
+	// Past the end of the program the address does not move
+	source = "LOAD #1\nLOAD #2\nSTR 500\n";
+	ASSERT_EQ(assemble(source, true, words, &count, &startPC, &report), (unsigned)ASM_SUCCESS);
+	ASSERT_EQ(report.fixedAddressLine, 0);
+	ASSERT_EQ(count, 2);
+}
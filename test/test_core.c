@@ -0,0 +1,71 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../lib/utest.h"
+#include "../inc/kernel/core.h"
+#include "../inc/kernel/mmu.h"
+#include "../inc/hardware/dma.h"
+#include "../inc/kernel/vfs.h"
+
+// Global defined by main.c in the full build
+CPU_t CPU;
+
+UTEST_MAIN();
+
+// Writes a program of the given size made of LOAD #5 words
+static void createProgramFile(const char* path, const char* name, int words) {
+	FILE* f = fopen(path, "w");
+	if (f) {
+		fprintf(f, "_start 1\n.NumeroPalabras %d\n.NombreProg %s\n", words, name);
+		for (int i = 0; i < words; i++) fprintf(f, "04100005\n");
+		fclose(f);
+	}
+}
+
+// A program larger than RAM is refused before it is read from the disk
+UTEST(Loader, OversizedProgramRefused) {
+	initOS();
+	createProgramFile("core_big.txt", "Big", 6000);
+	createProgramFile("core_small.txt", "Small", 10);
+
+	ASSERT_EQ(createProcess("core_big.txt"), (unsigned)OS_ERR_MEMORY);
+	ASSERT_EQ(getFreePCBIndex(), 0);  // The PCB was given back
+	ASSERT_EQ(mmuGetStats().usedWords, 0);
+
+	ASSERT_EQ(createProcess("core_small.txt"), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(PROCESS_TABLE[0].state, (unsigned)READY);
+
+	remove("core_big.txt");
+	remove("core_small.txt");
+}
+
+// The disk may only be rewritten in place once no process and no DMA transfer can touch it
+UTEST(Kernel, IdleOnlyWithoutProcesses) {
+	initOS();
+	ASSERT_TRUE(osIsIdle());
+
+	createProgramFile("core_small.txt", "Small", 10);
+	ASSERT_EQ(createProcess("core_small.txt"), (unsigned)OS_SUCCESS);
+	ASSERT_FALSE(osIsIdle());
+
+	PROCESS_TABLE[0].state = FINISHED;
+	DMA.outstanding = 1;
+	ASSERT_FALSE(osIsIdle());
+	DMA.outstanding = 0;
+	ASSERT_TRUE(osIsIdle());
+
+	remove("core_small.txt");
+}
+
+// Programs larger than the largest buddy block still load, as with the old fixed partitions
+UTEST(Loader, LargeProgramSpansBlocks) {
+	initOS();
+	vfsClearCatalog();  // Disk room left by the oversized program of the other test
+	createProgramFile("core_large.txt", "Large", 1600);
+
+	ASSERT_EQ(createProcess("core_large.txt"), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(PROCESS_TABLE[0].state, (unsigned)READY);
+	ASSERT_GE(mmuGetStats().usedWords, 1600 + MIN_STACK_SIZE);
+
+	remove("core_large.txt");
+}
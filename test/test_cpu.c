@@ -1,8 +1,11 @@
 #include <stdbool.h>
+#include <string.h>
 
 #include "../lib/utest.h"
 #include "../inc/hardware/cpu.h"
 #include "../inc/hardware/memory.h"
+#include "../inc/kernel/syscalls.h"
+#include "../inc/kernel/vfs.h"
 
 CPU_t CPU;
 DMA_t DMA;
@@ -30,12 +33,88 @@ MemoryStatus_t readMemory(address addr, word* outData) {
 	return MEM_ERR_OUT_OF_BOUNDS;
 }
 
+// Mock for the predecoded fetch path (No cache, decodes on every call)
+MemoryStatus_t fetchInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	MemoryStatus_t status = readMemory(addr, outData);
+	outInstruction->opCode = GET_INSTRUCTION_OPCODE(*outData);
+	outInstruction->direction = GET_INSTRUCTION_MODE(*outData);
+	outInstruction->value = GET_INSTRUCTION_VALUE(*outData);
+	return status;
+}
+
+// Mocks for the BUS_LOCK-held variants (The plain mocks never take the lock)
+MemoryStatus_t readMemoryLocked(address addr, word* outData) {
+	return readMemory(addr, outData);
+}
+
+MemoryStatus_t writeMemoryLocked(address addr, word data) {
+	return writeMemory(addr, data);
+}
+
+// Mock for the silent lookahead (Same view of RAM as fetchInstruction)
+MemoryStatus_t peekInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	return fetchInstruction(addr, outData, outInstruction);
+}
+
+bool osYield = false;
+bool osDMAWait = false;
+
+// Mock for the kernel syscall router (AC = 0 requests EXIT)
+SyscallStatus_t handleSyscall(void) {
+	return (CPU.AC == 0) ? SYSCALL_HALT : SYSCALL_SUCCESS;
+}
+
 // Auxiliary function for CPU setting
 static void cpuSetup(void) {
 	cpuReset();
 	CPU.PSW.interruptEnable = ITR_ENABLED;
 }
 
+// Auxiliary function to run a single instruction on one dispatch core from a fixed state
+static bool runOnCore(CPUDispatchMode_t mode, word instructionWord, word initialAC, CPUStatus_t* status) {
+	cpuSetup();
+	memset(RAM, 0, sizeof(RAM));
+	RAM[1500] = 10;
+	RAM[1505] = 4100005;
+	CPU.AC = initialAC;
+	CPU.SP = 1500;
+	CPU.RX = 1400;
+	CPU.RL = RAM_SIZE - 1;
+	CPU.PSW.pc = 400;
+	CPU.PSW.mode = MODE_KERNEL;
+	CPU.IR = instructionWord;
+
+	Instruction_t inst = decode();
+	*status = (mode == CPU_DISPATCH_THREADED) ? executeThreaded(inst) : execute(inst);
+	return checkInterrupts();
+}
+
+// Auxiliary function to load a program at address 400 with its data and stack
+static void loadSliceProgram(const word* program, int length, uint64_t timerLimit) {
+	cpuSetup();
+	memset(RAM, 0, sizeof(RAM));
+	for (int i = 0; i < length; i++) RAM[400 + i] = program[i];
+	RAM[460] = 9999999;
+	RAM[461] = 19999999;
+	CPU.SP = 1500;
+	CPU.RX = 1400;
+	CPU.RL = RAM_SIZE - 1;
+	CPU.PSW.pc = 400;
+	CPU.PSW.mode = MODE_KERNEL;
+	CPU.timerLimit = timerLimit;
+	osYield = false;
+}
+
+// Auxiliary function to run a program from address 400 until the CPU halts
+static int runProgram(bool fusion, const word* program, int length, uint64_t timerLimit) {
+	loadSliceProgram(program, length, timerLimit);
+	cpuSetFusion(fusion);
+	int steps = 0;
+	while (steps < 500 && cpuStep()) steps++;
+	cpuSetFusion(false);
+	return steps;
+}
+
 UTEST_MAIN();
 
 // Verify that the fetch stage correctly loads instruction into IR
@@ -91,10 +170,10 @@ UTEST(CPU, ExecuteStage) {
 // Verify that the execute stage correctly handles an invalid instruction
 UTEST(CPU, ExecuteStageDefault) {
 	cpuSetup();
-	CPU.IR = 34100005; // Invalid OpCode (0-33 are valid)
+	CPU.IR = 35100005; // Invalid OpCode (0-34 are valid)
 	Instruction_t inst;
 	inst = decode();
-	ASSERT_EQ(inst.opCode, (unsigned)34);
+	ASSERT_EQ(inst.opCode, (unsigned)35);
 	ASSERT_EQ(inst.direction, (unsigned)ADDR_MODE_IMMEDIATE);
 	ASSERT_EQ(inst.value, (unsigned)5);
 	CPUStatus_t status = execute(inst);
@@ -179,7 +258,7 @@ UTEST(CPU, CheckPendingInterrupts) {
 	ASSERT_FALSE(result);
 
 	cpuSetup();
-	CPU.IR = 34100005; // Invalid instruction
+	CPU.IR = 35100005; // Invalid instruction
 	instruction = decode();
 	result = execute(instruction);
 	ASSERT_EQ(result, CPU_STOP);
@@ -282,3 +361,265 @@ UTEST(CPU, CheckPendingInterrupts) {
 	result = checkInterrupts();
 	ASSERT_TRUE(result);
 }
+
+// Verify that the threaded core has the same architectural effects as the switch core
+UTEST(CPU, ThreadedDispatchMatchesSwitch) {
+	const word values[] = {0, 1, 5, 1500, 1505, 99999};
+	const word accumulators[] = {0, 10, SIGN_BIT + 7, MAX_MAGNITUDE};
+	static word referenceRAM[RAM_SIZE];
+
+	for (int op = OP_SUM; op <= OP_J; op++) {
+		for (int mode = 0; mode <= 3; mode++) {
+			for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+				for (size_t a = 0; a < sizeof(accumulators) / sizeof(accumulators[0]); a++) {
+					word instructionWord = (op * 1000000) + (mode * 100000) + values[v];
+					CPUStatus_t referenceStatus, threadedStatus;
+
+					bool referenceContinue = runOnCore(CPU_DISPATCH_SWITCH, instructionWord, accumulators[a], &referenceStatus);
+					CPU_t reference = CPU;
+					memcpy(referenceRAM, RAM, sizeof(RAM));
+
+					bool threadedContinue = runOnCore(CPU_DISPATCH_THREADED, instructionWord, accumulators[a], &threadedStatus);
+
+					ASSERT_EQ(referenceStatus, threadedStatus);
+					ASSERT_EQ(referenceContinue, threadedContinue);
+					ASSERT_EQ(reference.AC, CPU.AC);
+					ASSERT_EQ(reference.SP, CPU.SP);
+					ASSERT_EQ(reference.RX, CPU.RX);
+					ASSERT_EQ(reference.RB, CPU.RB);
+					ASSERT_EQ(reference.RL, CPU.RL);
+					ASSERT_EQ(reference.PSW.pc, CPU.PSW.pc);
+					ASSERT_EQ(reference.PSW.conditionCode, CPU.PSW.conditionCode);
+					ASSERT_EQ(reference.PSW.mode, CPU.PSW.mode);
+					ASSERT_EQ(reference.PSW.interruptEnable, CPU.PSW.interruptEnable);
+					ASSERT_EQ(reference.timerLimit, CPU.timerLimit);
+					ASSERT_EQ(0, memcmp(referenceRAM, RAM, sizeof(RAM)));
+				}
+			}
+		}
+	}
+}
+
+// Verify that cpuStep runs programs through the selected dispatch core
+UTEST(CPU, InstructionCycleThreadedDispatch) {
+	cpuSetup();
+	cpuSetDispatchMode(CPU_DISPATCH_THREADED);
+	ASSERT_EQ((unsigned)CPU_DISPATCH_THREADED, cpuGetDispatchMode());
+
+	writeMemory(400, 4100007);  // LOAD Immediate 7
+	writeMemory(401, 2100003);  // MULT Immediate 3
+	writeMemory(402, 5000450);  // STR Direct 450
+	CPU.PSW.pc = 400;
+
+	ASSERT_TRUE(cpuStep());
+	ASSERT_TRUE(cpuStep());
+	ASSERT_TRUE(cpuStep());
+	ASSERT_EQ(21, CPU.AC);
+	ASSERT_EQ(21, RAM[450]);
+	ASSERT_EQ(403, CPU.PSW.pc);
+
+	cpuSetDispatchMode(CPU_DISPATCH_SWITCH);
+}
+
+
+// Verify that fused sequences have the same architectural effects as stepping one by one
+UTEST(CPU, FusedSequencesMatchUnfused) {
+	// Programs pop a whole context frame before the final SVC, so earlier interrupt frames stay visible in RAM
+	#define HALT_SEQUENCE 26000000, 26000000, 26000000, 26000000, 26000000, 26000000, 26000000, 4100000, 13000000
+	const word loop[]     = { 4100005, 25000000, 4100000, 5000450, 4000450, 100001, 5000450, 8100003, 11000404, HALT_SEQUENCE };
+	const word overflow[] = { 4000460, 460, 5000470, 4000461, 1000460, 5000471, 4000460, 1100001, 5000472, HALT_SEQUENCE };
+	const word fault[]    = { 4100005, 100001, 5000010, HALT_SEQUENCE };
+	const word stack[]    = { 4101500, 7000000, 4100005, 25000000, HALT_SEQUENCE };
+	const word branch[]   = { 4100009, 25000000, 8000460, 9000413, HALT_SEQUENCE, 4100007, 8100001, 11000404 };
+	const struct { const word* words; int length; } programs[] = {
+		{ loop, 18 }, { overflow, 18 }, { fault, 12 }, { stack, 13 }, { branch, 16 }
+	};
+	static word referenceRAM[RAM_SIZE];
+
+	for (int p = 0; p < 5; p++) {
+		for (uint64_t timerLimit = 0; timerLimit <= 4; timerLimit++) {
+			runProgram(false, programs[p].words, programs[p].length, timerLimit);
+			CPU_t reference = CPU;
+			bool referenceYield = osYield;
+			memcpy(referenceRAM, RAM, sizeof(RAM));
+
+			runProgram(true, programs[p].words, programs[p].length, timerLimit);
+
+			ASSERT_EQ(reference.AC, CPU.AC);
+			ASSERT_EQ(reference.IR, CPU.IR);
+			ASSERT_EQ(reference.MAR, CPU.MAR);
+			ASSERT_EQ(reference.MDR, CPU.MDR);
+			ASSERT_EQ(reference.SP, CPU.SP);
+			ASSERT_EQ(reference.RX, CPU.RX);
+			ASSERT_EQ(reference.PSW.pc, CPU.PSW.pc);
+			ASSERT_EQ(reference.PSW.conditionCode, CPU.PSW.conditionCode);
+			ASSERT_EQ(reference.cyclesCounter, CPU.cyclesCounter);
+			ASSERT_EQ(referenceYield, osYield);
+			ASSERT_EQ(0, memcmp(referenceRAM, RAM, sizeof(RAM)));
+		}
+	}
+}
+
+// Verify that a fused sequence retires in one step and stops early on a pending interrupt
+UTEST(CPU, InstructionCycleFusedSequence) {
+	const word program[] = { 4100007, 100003, 5000450 };  // LOAD 7; SUM 3; STR 450
+
+	cpuSetup();
+	for (int i = 0; i < 3; i++) writeMemory(400 + i, program[i]);
+	CPU.PSW.pc = 400;
+	cpuSetFusion(true);
+	ASSERT_TRUE(cpuGetFusion());
+
+	ASSERT_TRUE(cpuStep());
+	ASSERT_EQ(10, CPU.AC);
+	ASSERT_EQ(10, RAM[450]);
+	ASSERT_EQ(403, CPU.PSW.pc);
+	ASSERT_EQ(3u, CPU.cyclesCounter);
+
+	// The timer expires after the LOAD: the rest of the sequence waits for the next step
+	cpuSetup();
+	RAM[450] = 0;
+	CPU.PSW.pc = 400;
+	CPU.timerLimit = 1;
+	CPU.SP = 1500;
+	CPU.PSW.mode = MODE_KERNEL;
+	ASSERT_TRUE(cpuStep());
+	ASSERT_EQ(401, CPU.PSW.pc);
+	ASSERT_EQ(0, RAM[450]);
+
+	cpuSetFusion(false);
+}
+
+// Verify that a slice stops exactly when the timer expires and hands the CPU back
+UTEST(CPU, RunSliceStopsOnTimer) {
+	const word program[] = { 4100000, 100001, 100001, 100001, 100001, 100001, 100001, 100001 };  // LOAD 0; SUM 1 ...
+	int executed = 0;
+
+	cpuSetup();
+	for (int i = 0; i < 8; i++) writeMemory(400 + i, program[i]);
+	CPU.PSW.pc = 400;
+	CPU.SP = 1500;
+	CPU.PSW.mode = MODE_KERNEL;
+	CPU.timerLimit = 3;
+	osYield = false;
+
+	ASSERT_EQ((unsigned)CPU_SLICE_YIELD, cpuRunSlice(64, &executed));
+	ASSERT_EQ(3, executed);
+	ASSERT_EQ(2, CPU.AC);
+	ASSERT_EQ(403, CPU.PSW.pc);
+	ASSERT_TRUE(osYield);
+
+	// Without a timer the budget ends the slice
+	osYield = false;
+	CPU.timerLimit = 0;
+	ASSERT_EQ((unsigned)CPU_SLICE_EXHAUSTED, cpuRunSlice(2, &executed));
+	ASSERT_EQ(2, executed);
+	ASSERT_EQ(4, CPU.AC);
+	ASSERT_FALSE(osYield);
+}
+
+// Verify that user code cannot reach the VFS catalog at the start of the disk through SDMAON
+UTEST(CPU, SDMAONProtectsCatalog) {
+	Instruction_t sdmaon = { .opCode = OP_SDMAON };
+
+	cpuSetup();
+	CPU.PSW.mode = MODE_USER;
+	CPU.RB = 300;
+	CPU.RL = 499;
+	DMA = (DMA_t){0};
+	DMA.ioDirection = 1;
+	DMA.memAddr = 300;
+	DMA.length = 4;
+	osYield = false;
+	osDMAWait = false;
+
+	// T0 C0 S0 holds the superblock
+	ASSERT_EQ((unsigned)INSTR_EXEC_FAIL, executeDMAInstruction(sdmaon));
+	ASSERT_FALSE(checkInterrupts());
+	ASSERT_EQ(0, DMA.outstanding);
+
+	// An extent that runs into the data area from the last catalog sector is refused too
+	int last = VFS_RESERVED_SECTORS - 1;
+	DMA.track = (uint8_t)(last / (DISK_CYLINDERS * DISK_SECTORS));
+	DMA.cylinder = (uint8_t)((last / DISK_SECTORS) % DISK_CYLINDERS);
+	DMA.sector = (uint8_t)(last % DISK_SECTORS);
+	ASSERT_EQ((unsigned)INSTR_EXEC_FAIL, executeDMAInstruction(sdmaon));
+	ASSERT_FALSE(checkInterrupts());
+
+	// The first data sector is allowed
+	DMA.track = (uint8_t)(VFS_RESERVED_SECTORS / (DISK_CYLINDERS * DISK_SECTORS));
+	DMA.cylinder = (uint8_t)((VFS_RESERVED_SECTORS / DISK_SECTORS) % DISK_CYLINDERS);
+	DMA.sector = (uint8_t)(VFS_RESERVED_SECTORS % DISK_SECTORS);
+	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, executeDMAInstruction(sdmaon));
+	ASSERT_EQ(1, DMA.outstanding);
+
+	DMA = (DMA_t){0};
+	osYield = false;
+	osDMAWait = false;
+}
+
+// Verify that SDMAON ends the slice right away so the kernel can block the process
+UTEST(CPU, RunSliceYieldsOnDMAStart) {
+	const word program[] = { 4100001, 33000000, 100001, 100001 };  // LOAD 1; SDMAON; SUM 1; SUM 1
+	int executed = 0;
+
+	cpuSetup();
+	for (int i = 0; i < 4; i++) writeMemory(400 + i, program[i]);
+	CPU.PSW.pc = 400;
+	CPU.SP = 1500;
+	CPU.PSW.mode = MODE_KERNEL;
+	DMA = (DMA_t){0};
+	osYield = false;
+	osDMAWait = false;
+
+	ASSERT_EQ((unsigned)CPU_SLICE_YIELD, cpuRunSlice(64, &executed));
+	ASSERT_EQ(2, executed);
+	ASSERT_EQ(402, CPU.PSW.pc);
+	ASSERT_TRUE(DMA.pending);
+	ASSERT_TRUE(osDMAWait);
+
+	// Further requests queue up until every descriptor is in use
+	for (int i = 1; i < DMA_QUEUE_DEPTH; i++) {
+		CPU.PSW.pc = 401;
+		ASSERT_EQ((unsigned)CPU_SLICE_YIELD, cpuRunSlice(64, &executed));
+		ASSERT_EQ(402, CPU.PSW.pc);
+	}
+	ASSERT_EQ(DMA_QUEUE_DEPTH, DMA.outstanding);
+
+	// With the queue full SDMAON is deferred, not lost
+	osYield = false;
+	osDMAWait = false;
+	CPU.PSW.pc = 401;
+	ASSERT_EQ((unsigned)CPU_SLICE_YIELD, cpuRunSlice(64, &executed));
+	ASSERT_EQ(401, CPU.PSW.pc);
+	ASSERT_TRUE(osDMAWait);
+
+	DMA = (DMA_t){0};
+	osYield = false;
+	osDMAWait = false;
+}
+
+// Verify that a slice leaves the same state as single steps and reports the halt
+UTEST(CPU, RunSliceMatchesSteps) {
+	const word program[] = { 4100005, 25000000, 4100000, 5000450, 4000450, 100001, 5000450, 8100003, 11000404, 4100000, 13000000 };
+	static word referenceRAM[RAM_SIZE];
+
+	for (int fusion = 0; fusion <= 1; fusion++) {
+		runProgram(false, program, 11, 0);
+		CPU_t reference = CPU;
+		memcpy(referenceRAM, RAM, sizeof(RAM));
+
+		loadSliceProgram(program, 11, 0);
+		cpuSetFusion(fusion);
+		int executed = 0;
+		ASSERT_EQ((unsigned)CPU_SLICE_HALT, cpuRunSlice(500, &executed));
+		cpuSetFusion(false);
+
+		ASSERT_EQ(31, executed);  // 4 setup + 5 iterations of 5 + LOAD 0; SVC
+		ASSERT_EQ(reference.AC, CPU.AC);
+		ASSERT_EQ(reference.SP, CPU.SP);
+		ASSERT_EQ(reference.PSW.pc, CPU.PSW.pc);
+		ASSERT_EQ(reference.PSW.conditionCode, CPU.PSW.conditionCode);
+		ASSERT_EQ(0, memcmp(referenceRAM, RAM, sizeof(RAM)));
+	}
+}
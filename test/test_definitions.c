@@ -67,6 +67,7 @@ UTEST(Definitions, OpCodeBoundaries) {
 	ASSERT_EQ(0, OP_SUM);
 	ASSERT_EQ(13, OP_SVC);
 	ASSERT_EQ(33, OP_SDMAON);
+	ASSERT_EQ(34, OP_SDMAL);
 }
 
 // Verifies Disk Geometry dimensions.
@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "../lib/utest.h"
 #include "../inc/hardware/disk.h"
@@ -59,3 +61,143 @@ UTEST(Disk, WriteOutOfBoundsSector) {
     EXPECT_EQ(writeSector(track, cylinder, sector, testData), (unsigned)DISK_ERR_OUT_OF_BOUNDS); // Check error code
 }
 
+
+// Verify that the seek cost grows with the track and cylinder distance, and is free in place.
+UTEST(Disk, SeekCycles) {
+    DiskTiming_t timing = { .settleCycles = 2, .trackCycles = 5, .cylinderCycles = 1, .sectorCycles = 1, .transferCycles = 1 };
+    diskSetTiming(&timing);
+
+    EXPECT_EQ(diskSeekCycles(3, 4, 3, 4), (uint64_t)0);
+    EXPECT_EQ(diskSeekCycles(0, 0, 0, 1), (uint64_t)(2 + 1));
+    EXPECT_EQ(diskSeekCycles(0, 9, 2, 0), (uint64_t)(2 + 2 * 5 + 9));
+    EXPECT_EQ(diskSeekCycles(2, 0, 0, 9), diskSeekCycles(0, 9, 2, 0));
+}
+
+// Verify that the rotational delay follows the platter angle given by the virtual clock.
+UTEST(Disk, RotationCycles) {
+    DiskTiming_t timing = { .settleCycles = 2, .trackCycles = 5, .cylinderCycles = 1, .sectorCycles = 3, .transferCycles = 3 };
+    diskSetTiming(&timing);
+    uint64_t revolution = DISK_SECTORS * 3;
+
+    EXPECT_EQ(diskRotationCycles(0, 0), (uint64_t)0);
+    EXPECT_EQ(diskRotationCycles(0, 10), (uint64_t)30);
+    EXPECT_EQ(diskRotationCycles(31, 10), revolution - 1);          // Just missed it: one full turn
+    EXPECT_EQ(diskRotationCycles(revolution * 7 + 6, 4), (uint64_t)6);
+}
+
+// Verify that one sequential extent is cheaper than the same sectors read one by one.
+UTEST(Disk, SequentialCheaperThanScattered) {
+    DiskTiming_t defaults = { DISK_SETTLE_CYCLES, DISK_TRACK_CYCLES, DISK_CYLINDER_CYCLES, DISK_SECTOR_CYCLES, DISK_TRANSFER_CYCLES };
+    diskSetTiming(&defaults);
+
+    DMASegment_t extent = { .track = 1, .cylinder = 2, .sector = 90, .memAddr = 0, .length = 20 };
+    uint64_t now = 0;
+    uint64_t sequential = diskExtentCycles(0, 0, &extent, now);
+
+    // Seek, wait for sector 90, 20 transfers and one cylinder switch onto sector 0 of the next cylinder
+    uint64_t seek = diskSeekCycles(0, 0, 1, 2);
+    EXPECT_EQ(sequential, seek + diskRotationCycles(seek, 90) + 20 * DISK_TRANSFER_CYCLES + DISK_CYLINDER_CYCLES);
+
+    uint64_t scattered = 0;
+    for (int i = 0; i < 20; i++) {
+        DMASegment_t single = { .track = (uint8_t)(i % DISK_TRACKS), .cylinder = (uint8_t)((i * 3) % DISK_CYLINDERS), .sector = (uint8_t)((i * 37) % DISK_SECTORS), .memAddr = i, .length = 1 };
+        scattered += diskExtentCycles(i == 0 ? 0 : (uint8_t)((i - 1) % DISK_TRACKS), i == 0 ? 0 : (uint8_t)(((i - 1) * 3) % DISK_CYLINDERS), &single, now + scattered);
+    }
+    EXPECT_LT(sequential, scattered);
+
+    // Same inputs, same cost: the model has no randomness
+    EXPECT_EQ(diskExtentCycles(0, 0, &extent, now), sequential);
+}
+
+// Verify that a transfer running onto the next track pays a track step and the return to cylinder 0.
+UTEST(Disk, TrackSwitchCost) {
+    DiskTiming_t defaults = { DISK_SETTLE_CYCLES, DISK_TRACK_CYCLES, DISK_CYLINDER_CYCLES, DISK_SECTOR_CYCLES, DISK_TRANSFER_CYCLES };
+    diskSetTiming(&defaults);
+
+    DMASegment_t withinTrack = { .track = 3, .cylinder = DISK_CYLINDERS - 2, .sector = 90, .memAddr = 0, .length = 20 };
+    DMASegment_t acrossTrack = { .track = 3, .cylinder = DISK_CYLINDERS - 1, .sector = 90, .memAddr = 0, .length = 20 };
+    uint64_t base = diskRotationCycles(0, 90) + 20 * DISK_TRANSFER_CYCLES;
+
+    EXPECT_EQ(diskExtentCycles(3, DISK_CYLINDERS - 2, &withinTrack, 0), base + DISK_CYLINDER_CYCLES);
+    EXPECT_EQ(diskExtentCycles(3, DISK_CYLINDERS - 1, &acrossTrack, 0), base + DISK_TRACK_CYCLES + (DISK_CYLINDERS - 1) * DISK_CYLINDER_CYCLES);
+}
+
+// Verify that the platter cannot be stopped through the timing parameters.
+UTEST(Disk, TimingConfiguration) {
+    DiskTiming_t timing = { .settleCycles = 7, .trackCycles = 0, .cylinderCycles = 0, .sectorCycles = 0, .transferCycles = 4 };
+    DiskTiming_t current;
+
+    diskSetTiming(&timing);
+    diskGetTiming(&current);
+    EXPECT_EQ(current.settleCycles, (uint32_t)7);
+    EXPECT_EQ(current.sectorCycles, (uint32_t)1);
+    EXPECT_EQ(current.transferCycles, (uint32_t)4);
+
+    DiskTiming_t defaults = { DISK_SETTLE_CYCLES, DISK_TRACK_CYCLES, DISK_CYLINDER_CYCLES, DISK_SECTOR_CYCLES, DISK_TRANSFER_CYCLES };
+    diskSetTiming(&defaults);
+}
+
+// Verify that sectors written through an attached image are still there after re-attaching it.
+UTEST(Disk, ImagePersistsAcrossAttach) {
+    const char* path = "test_disk_image.img";
+    remove(path);
+
+    ASSERT_EQ(diskAttachImage(path), (unsigned)DISK_SUCCESS);
+    EXPECT_TRUE(diskIsPersistent());
+    testData.data = 7654321;
+    writeSector(4, 5, 6, testData);
+    diskDetachImage();
+    EXPECT_FALSE(diskIsPersistent());
+
+    writeSector(4, 5, 6, (Sector_t){0}); // Only the in-memory copy changes
+    ASSERT_EQ(diskAttachImage(path), (unsigned)DISK_SUCCESS);
+    readSector(4, 5, 6, &buffer);
+    EXPECT_EQ(buffer.data, 7654321);
+    diskDetachImage();
+
+    readSector(4, 5, 6, &buffer); // Detaching keeps the image contents in use
+    EXPECT_EQ(buffer.data, 7654321);
+    remove(path);
+}
+
+// Verify that an image with another layout is rejected and the current backing is kept.
+UTEST(Disk, ImageRejectsForeignFile) {
+    const char* path = "test_disk_foreign.img";
+    FILE* f = fopen(path, "wb");
+    ASSERT_TRUE(f != NULL);
+    for (size_t i = 0; i < DISK_IMAGE_SIZE; i++) fputc('x', f);
+    fclose(f);
+
+    EXPECT_EQ(diskAttachImage(path), (unsigned)DISK_ERR_IMAGE);
+    EXPECT_FALSE(diskIsPersistent());
+
+    f = fopen(path, "wb");
+    ASSERT_TRUE(f != NULL);
+    fputs("short", f);
+    fclose(f);
+    EXPECT_EQ(diskAttachImage(path), (unsigned)DISK_ERR_IMAGE);
+    remove(path);
+}
+
+// Verify that a run of sectors crosses cylinder and track boundaries in disk order.
+UTEST(Disk, SectorRuns) {
+    word data[250], back[250];
+    for (int i = 0; i < 250; i++) data[i] = 1000 + i;
+
+    EXPECT_EQ(writeSectors(3, 9, 50, data, 250), (unsigned)DISK_SUCCESS);
+    readSector(3, 9, 99, &buffer);
+    EXPECT_EQ(buffer.data, 1049);
+    readSector(4, 0, 0, &buffer);  // After the last cylinder of track 3 comes track 4
+    EXPECT_EQ(buffer.data, 1050);
+
+    EXPECT_EQ(readSectors(3, 9, 50, back, 250), (unsigned)DISK_SUCCESS);
+    EXPECT_EQ(memcmp(data, back, sizeof(data)), 0);
+
+    // Runs that leave the disk are refused whole
+    readSector(DISK_TRACKS - 1, DISK_CYLINDERS - 1, DISK_SECTORS - 1, &buffer);
+    word last = buffer.data;
+    EXPECT_EQ(writeSectors(DISK_TRACKS - 1, DISK_CYLINDERS - 1, DISK_SECTORS - 1, data, 2), (unsigned)DISK_ERR_OUT_OF_BOUNDS);
+    readSector(DISK_TRACKS - 1, DISK_CYLINDERS - 1, DISK_SECTORS - 1, &buffer);
+    EXPECT_EQ(buffer.data, last);
+    EXPECT_EQ(readSectors(DISK_TRACKS, 0, 0, back, 1), (unsigned)DISK_ERR_OUT_OF_BOUNDS);
+}
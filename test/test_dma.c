@@ -3,12 +3,14 @@
 
 #include "../lib/utest.h"
 #include "../inc/hardware/dma.h"
+#include "../inc/hardware/disk.h"
+#include "../inc/hardware/iosched.h"
 #include "../inc/hardware/cpu.h"
 #include "../inc/hardware/memory.h"
+#include "../inc/kernel/syscalls.h"
 
 CPU_t CPU;
 word RAM[RAM_SIZE];
-Sector_t DISK[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];
 pthread_mutex_t BUS_LOCK = PTHREAD_MUTEX_INITIALIZER;
 
 static bool mockMemoryFailProtection = false;
@@ -72,8 +74,70 @@ MemoryStatus_t dmaReadMemory(address addr, word* outData) {
 	return MEM_ERR_OUT_OF_BOUNDS;
 }
 
+// Mock for the predecoded fetch path (No cache, decodes on every call)
+MemoryStatus_t fetchInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	MemoryStatus_t status = readMemory(addr, outData);
+	outInstruction->opCode = GET_INSTRUCTION_OPCODE(*outData);
+	outInstruction->direction = GET_INSTRUCTION_MODE(*outData);
+	outInstruction->value = GET_INSTRUCTION_VALUE(*outData);
+	return status;
+}
+
+// Mocks for the BUS_LOCK-held variants (Same behaviour as the mocks above, without locking)
+MemoryStatus_t readMemoryLocked(address addr, word* outData) {
+	if (addr >= 0 && addr < RAM_SIZE) {
+		*outData = RAM[addr];
+		return MEM_SUCCESS;
+	}
+	*outData = 0;
+	return MEM_ERR_OUT_OF_BOUNDS;
+}
+
+MemoryStatus_t writeMemoryLocked(address addr, word data) {
+	if (mockMemoryFailProtection) return MEM_ERR_PROTECTION;
+	if (addr >= 0 && addr < RAM_SIZE) {
+		RAM[addr] = data;
+		return MEM_SUCCESS;
+	}
+	return MEM_ERR_OUT_OF_BOUNDS;
+}
+
+// Mock for the silent lookahead (Same view of RAM as fetchInstruction)
+MemoryStatus_t peekInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	return fetchInstruction(addr, outData, outInstruction);
+}
+
+bool osYield = false;
+bool osDMAWait = false;
+
+// Mock for the kernel syscall router (AC = 0 requests EXIT)
+SyscallStatus_t handleSyscall(void) {
+	return (CPU.AC == 0) ? SYSCALL_HALT : SYSCALL_SUCCESS;
+}
+
 UTEST_MAIN();
 
+// Starts the DMA worker once: every test shares the same controller and queue
+static void startDMAThread(void) {
+	static bool started = false;
+	if (started) return;
+
+	pthread_t dmaThread;
+	pthread_create(&dmaThread, NULL, &dmaInit, NULL);
+	usleep(100000); // Allow DMA thread to initialize
+	started = true;
+}
+
+// Waits for the transfer like the idle kernel does: nothing else runs, so the virtual clock jumps ahead
+static void waitForDMA(void) {
+	while (DMA.pending) {
+		cpuAdvanceVirtualCycles(dmaBusyUntil());
+		usleep(1000);
+	}
+	osDMAWait = false;
+	osYield = false;
+}
+
 UTEST(DMA, ExecuteSDMAOperations) {
 	InstructionStatus_t ret;
 	Instruction_t instruction;
@@ -82,17 +146,14 @@ UTEST(DMA, ExecuteSDMAOperations) {
 	
 	dmaWriteMemory(456, 1234567); // Preload memory directly
 	
-	pthread_t dmaThread;
-	pthread_create(&dmaThread, NULL, &dmaInit, NULL);
-
-	usleep(100000); // Allow DMA thread to initialize
+	startDMAThread();
 
 	// Test for set platter (SDMAP)
 	cpuReset();
-	CPU.IR = 28100001; // SDMAP Inmediate with value 1
+	CPU.IR = 28100005; // SDMAP Inmediate with value 5 (Past the VFS catalog)
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
-	ASSERT_EQ(DMA.track, 1);
+	ASSERT_EQ(DMA.track, 5);
 	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, ret);
 	
 	// Test for set cylinder (SDMAC)
@@ -135,19 +196,22 @@ UTEST(DMA, ExecuteSDMAOperations) {
 	ASSERT_EQ(DMA.memAddr, 456);
 	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, ret);
 
-	// Test for set operation on (SDMAON)
+	// Test for set operation on (SDMAON): returns at once and asks the kernel to block the caller
 	cpuReset();
+	CPU.RL = RAM_SIZE;
 	CPU.IR = 33100001; // SDMAON Inmediate 1
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
 	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, ret);
+	ASSERT_TRUE(osDMAWait);
+	ASSERT_TRUE(osYield);
 
-	usleep(50000); // Allow some time for DMA operation to complete
+	waitForDMA();
 
 	ASSERT_FALSE(DMA.pending);
 	ASSERT_FALSE(DMA.active);
 	ASSERT_EQ(DMA.status, 0);
-	ASSERT_EQ((word)1234567, DISK[1][2][3].data);
+	ASSERT_EQ((word)1234567, DISK[5][2][3].data);
 }
 
 UTEST(DMA, ExecuteInvalidSDMAOperations) {
@@ -243,14 +307,11 @@ UTEST(DMA, ExecuteSDMAONWhenActive) {
 	dmaWriteMemory(456, 1234567);
 	dmaWriteMemory(789, 7654321);
 	
-	pthread_t dmaThread;
-	pthread_create(&dmaThread, NULL, &dmaInit, NULL);
-
-	usleep(100000); // Allow DMA thread to initialize
+	startDMAThread();
 
 	// Set up DMA parameters
 	cpuReset();
-	CPU.IR = 28100001;
+	CPU.IR = 28100005;
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
 
@@ -277,12 +338,14 @@ cpuReset();
 
 	// Start DMA operation
 	cpuReset();
+	CPU.RL = RAM_SIZE;
 	CPU.IR = 33100000;
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
 	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, ret);
+	ASSERT_TRUE(DMA.pending);
 
-	// Attempt to set I/O direction again while DMA is active
+	// Reprogram the registers while the first transfer is in flight: it keeps its own descriptor
 	cpuReset();
 	CPU.IR = 31100000;
 	instruction = decode();
@@ -294,38 +357,52 @@ cpuReset();
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
 
-	// Attempt to start DMA operation again while it's active
+	// Start a second transfer while the first one is active: queued behind it
+	DMA.requesterPid = 2;
 	cpuReset();
+	CPU.RL = RAM_SIZE;
 	CPU.IR = 33100000;
 	instruction = decode();
 	ret = executeDMAInstruction(instruction);
 	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, ret);
-
-	usleep(50000); // Allow some time for DMA operation to complete
+	ASSERT_TRUE(osDMAWait);
+
+	waitForDMA();
+
+	// Completions are reaped in submission order, tagged with their owner
+	DMARequest_t completion;
+	ASSERT_TRUE(dmaReapCompletion(&completion));
+	ASSERT_EQ(0, completion.ownerPid);
+	ASSERT_EQ(1, completion.ioDirection);
+	ASSERT_TRUE(dmaReapCompletion(&completion));
+	ASSERT_EQ(2, completion.ownerPid);
+	ASSERT_EQ(789, completion.segments[0].memAddr);
+	ASSERT_EQ(1, completion.segments[0].length);
+	ASSERT_EQ(0, completion.status);
+	ASSERT_FALSE(dmaReapCompletion(&completion));
+	ASSERT_FALSE(dmaHasRequest(2));
 
 	ASSERT_FALSE(DMA.pending);
 	ASSERT_FALSE(DMA.active);
 	ASSERT_EQ(DMA.status, 0);
-	ASSERT_EQ((word)1234567, DISK[1][2][3].data);
+	ASSERT_EQ((word)1234567, DISK[5][2][3].data);
 	ASSERT_EQ((word)1234567, RAM[789]);
 }
 
-// Tests CPU stops at mutex when DMA is actively transferring data
-UTEST(DMA, CPUWaitsWhenDMAActive) {
+// Tests that the CPU keeps executing while the DMA seeks, and sees the data once it completes
+UTEST(DMA, CPURunsWhileDMASeeks) {
 	Instruction_t instruction;
 
 	dmaReset();
 
-	DISK[1][2][3].data = 7654321; // Preload disk sector with data
+	DISK[5][2][3].data = 7654321; // Preload disk sector with data
+	RAM[456] = 0;
 	
-	pthread_t dmaThread;
-	pthread_create(&dmaThread, NULL, &dmaInit, NULL);
-
-	usleep(100000); // Allow DMA thread to initialize
+	startDMAThread();
 
 	// Set up DMA parameters
 	cpuReset();
-	CPU.IR = 28100001; // SDMAP Inmediate with value 1
+	CPU.IR = 28100005; // SDMAP Inmediate with value 5 (Past the VFS catalog)
 	instruction = decode();
 	executeDMAInstruction(instruction);
 
@@ -351,12 +428,15 @@ UTEST(DMA, CPUWaitsWhenDMAActive) {
 	executeDMAInstruction(instruction);
 
 	// Start DMA operation
-	pthread_mutex_lock(&BUS_LOCK);
-	DMA.pending = true;
-	pthread_cond_signal(&DMA_COND);
-	pthread_mutex_unlock(&BUS_LOCK);
+	cpuReset();
+	CPU.RL = RAM_SIZE;
+	CPU.IR = 33000000; // SDMAON
+	instruction = decode();
+	executeDMAInstruction(instruction);
+	osDMAWait = false;
+	osYield = false;
 	
-	// Prepare memory related instruction that should wait for DMA to complete
+	// Prepare memory related instruction that runs during the transfer
 	// Usamos acceso directo al array para simular carga previa
 	RAM[300] = 4000456; // Preload memory with LOAD instruction
 	CPU.PSW.pc = 300;
@@ -366,14 +446,149 @@ UTEST(DMA, CPUWaitsWhenDMAActive) {
 		usleep(1000);
 	}
 	
-	// Execute instruction while DMA is active
+	// Execute instruction while DMA is active: the bus is free during the seek
 	ASSERT_TRUE(DMA.pending);
 	ASSERT_TRUE(DMA.active);
-	cpuStep(); // This should wait until DMA is done
+	cpuStep();
+	ASSERT_TRUE(DMA.active);
+	ASSERT_EQ((word)0, CPU.AC);
+
+	waitForDMA();
 
 	ASSERT_FALSE(DMA.pending);
 	ASSERT_FALSE(DMA.active);
 	ASSERT_EQ(DMA.status, 0);
 	ASSERT_EQ((word)7654321, RAM[456]);
+
+	CPU.PSW.pc = 300;
+	cpuStep();
 	ASSERT_EQ((word)7654321, CPU.AC);
 }
+
+// Tests that SDMAL turns SDMAON into a burst across a cylinder boundary with a single completion
+UTEST(DMA, SDMALBurstTransfer) {
+	Instruction_t instruction;
+
+	dmaReset();
+	DISK[5][0][98].data = 11;
+	DISK[5][0][99].data = 22;
+	DISK[5][1][0].data = 33;
+	RAM[500] = RAM[501] = RAM[502] = 0;
+
+	startDMAThread();
+
+	const word program[] = { 28100005, 29100000, 30100098, 31100000, 32100500, 34100003 }; // T5 C0 S98, Read, RAM 500, 3 words
+	for (int i = 0; i < 6; i++) {
+		cpuReset();
+		CPU.RL = RAM_SIZE;
+		CPU.IR = program[i];
+		instruction = decode();
+		ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, executeDMAInstruction(instruction));
+	}
+	ASSERT_EQ(3, DMA.length);
+
+	// A burst that would leave the partition is refused before it is queued
+	cpuReset();
+	CPU.RL = 501;
+	CPU.IR = 33000000;
+	instruction = decode();
+	ASSERT_EQ((unsigned)INSTR_EXEC_FAIL, executeDMAInstruction(instruction));
+	ASSERT_FALSE(DMA.pending);
+
+	cpuReset();
+	CPU.RL = RAM_SIZE;
+	CPU.IR = 33000000;
+	instruction = decode();
+	ASSERT_EQ((unsigned)INSTR_EXEC_SUCCESS, executeDMAInstruction(instruction));
+	waitForDMA();
+
+	DMARequest_t completion;
+	ASSERT_TRUE(dmaReapCompletion(&completion));
+	ASSERT_EQ(1, completion.segmentCount);
+	ASSERT_EQ(3, completion.segments[0].length);
+	ASSERT_EQ(0, completion.status);
+	ASSERT_FALSE(dmaReapCompletion(&completion));
+
+	ASSERT_EQ((word)11, RAM[500]);
+	ASSERT_EQ((word)22, RAM[501]);
+	ASSERT_EQ((word)33, RAM[502]);
+
+	// Zero and oversized lengths are invalid
+	cpuReset();
+	CPU.IR = 34100000;
+	instruction = decode();
+	ASSERT_EQ((unsigned)INSTR_EXEC_FAIL, executeDMAInstruction(instruction));
+	ASSERT_EQ(3, DMA.length);
+}
+
+// Tests the kernel-side scatter-gather API: several extents, one tagged completion
+UTEST(DMA, ScatterGatherBurst) {
+	dmaReset();
+	for (int i = 0; i < 4; i++) RAM[600 + i] = 100 + i;
+	RAM[700] = 200;
+
+	startDMAThread();
+
+	const DMASegment_t segments[] = {
+		{ .track = 2, .cylinder = 3, .sector = 10, .memAddr = 600, .length = 4 },
+		{ .track = 9, .cylinder = 9, .sector = 99, .memAddr = 700, .length = 1 },
+	};
+	int slot = -1;
+	ASSERT_EQ((unsigned)DMA_SUCCESS, dmaSubmitBurst(segments, 2, 1, 7, &slot));
+	ASSERT_TRUE(slot >= 0 && slot < DMA_QUEUE_DEPTH);
+	ASSERT_TRUE(dmaHasRequest(7));
+	waitForDMA();
+
+	DMARequest_t completion;
+	ASSERT_TRUE(dmaReapCompletion(&completion));
+	ASSERT_EQ(7, completion.ownerPid);
+	ASSERT_EQ(2, completion.segmentCount);
+	ASSERT_EQ(5, dmaBurstWords(&completion));
+	ASSERT_EQ(0, completion.status);
+	ASSERT_FALSE(dmaReapCompletion(&completion));
+
+	for (int i = 0; i < 4; i++) ASSERT_EQ((word)(100 + i), DISK[2][3][10 + i].data);
+	ASSERT_EQ((word)200, DISK[9][9][99].data);
+
+	// Extents past the end of the disk or RAM, empty extents and oversized lists are rejected
+	const DMASegment_t pastDisk = { .track = 9, .cylinder = 9, .sector = 99, .memAddr = 0, .length = 2 };
+	const DMASegment_t pastRam = { .track = 0, .cylinder = 0, .sector = 0, .memAddr = RAM_SIZE - 1, .length = 2 };
+	const DMASegment_t empty = { .track = 0, .cylinder = 0, .sector = 0, .memAddr = 0, .length = 0 };
+	ASSERT_EQ((unsigned)DMA_ERR_INVALID_GEOM, dmaSubmitBurst(&pastDisk, 1, 0, 7, NULL));
+	ASSERT_EQ((unsigned)DMA_ERR_INVALID_GEOM, dmaSubmitBurst(&pastRam, 1, 0, 7, NULL));
+	ASSERT_EQ((unsigned)DMA_ERR_INVALID_GEOM, dmaSubmitBurst(&empty, 1, 0, 7, NULL));
+	ASSERT_EQ((unsigned)DMA_ERR_INVALID_GEOM, dmaSubmitBurst(segments, DMA_MAX_SEGMENTS + 1, 0, 7, NULL));
+	ASSERT_FALSE(DMA.pending);
+}
+
+// Tests that a burst completes when the virtual clock reaches the cost given by the disk model
+UTEST(DMA, VirtualClockGatesCompletion) {
+	startDMAThread();
+	waitForDMA();
+	dmaReset();
+
+	DMASegment_t extent = { .track = 4, .cylinder = 5, .sector = 60, .memAddr = 800, .length = 50 };
+	uint64_t submitted = cpuGetVirtualCycles();
+	uint64_t expected = diskExtentCycles(0, 0, &extent, submitted);
+
+	ASSERT_EQ((unsigned)DMA_SUCCESS, dmaSubmitBurst(&extent, 1, 0, 3, NULL));
+	while (!DMA.active) usleep(1000);
+	ASSERT_EQ(submitted + expected, dmaBusyUntil());
+
+	// No instructions retire, so the access does not end however long the host waits
+	usleep(20000);
+	ASSERT_TRUE(DMA.pending);
+
+	cpuAdvanceVirtualCycles(submitted + expected - 1);
+	usleep(20000);
+	ASSERT_TRUE(DMA.pending);
+
+	cpuAdvanceVirtualCycles(submitted + expected);
+	while (DMA.pending) usleep(1000);
+
+	DMARequest_t completion;
+	ASSERT_TRUE(dmaReapCompletion(&completion));
+	ASSERT_EQ(submitted, completion.submitCycle);
+	ASSERT_EQ(submitted + expected, completion.completeCycle);
+	ASSERT_EQ(4 * DISK_CYLINDERS + 5 + 1, ioschedGetHead()); // Carried onto the next cylinder
+}
@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "../lib/utest.h"
+#include "../inc/kernel/imagecache.h"
+
+UTEST_MAIN();
+
+// Metadata of a one-extent file of the given size
+static FileMeta_t makeMeta(uint32_t fileId, const char* name, int words) {
+	FileMeta_t meta = {0};
+	meta.fileId = fileId;
+	strcpy(meta.programName, name);
+	meta.wordCount = words;
+	meta.startPC = 1;
+	meta.extentCount = 1;
+	meta.extents[0] = (VFSExtent_t){ .track = 1, .cylinder = 4, .sector = (uint8_t)fileId, .length = words };
+	return meta;
+}
+
+static bool insertImage(const FileMeta_t* meta, word firstValue) {
+	static word words[RAM_SIZE];
+	for (int i = 0; i < meta->wordCount; i++) words[i] = firstValue + i;
+	CPU_t context = { .RL = 84, .SP = 84, .PSW = { .pc = meta->startPC - 1 } };
+	return imageCacheInsert(meta, 0, words, meta->wordCount + MIN_STACK_SIZE, &context);
+}
+
+UTEST(ImageCache, HitReturnsImageAndContext) {
+	imageCacheClear();
+	imageCacheSetBudget(IMAGE_CACHE_BUDGET_WORDS);
+	FileMeta_t meta = makeMeta(7, "Prog", 20);
+
+	ASSERT_TRUE(imageCacheLookup(&meta, 0) == NULL);
+	ASSERT_TRUE(insertImage(&meta, 1000));
+
+	const CachedImage_t* image = imageCacheLookup(&meta, 0);
+	ASSERT_TRUE(image != NULL);
+	ASSERT_EQ(image->wordCount, 20);
+	ASSERT_EQ(image->requiredWords, 20 + MIN_STACK_SIZE);
+	ASSERT_EQ(image->context.RL, 84);
+	ASSERT_STREQ(image->programName, "Prog");
+	for (int i = 0; i < 20; i++) ASSERT_EQ(image->words[i], 1000 + i);
+
+	ImageCacheStats_t stats = imageCacheGetStats();
+	ASSERT_EQ(stats.hits, 1u);
+	ASSERT_EQ(stats.misses, 1u);
+	ASSERT_EQ(stats.entries, 1);
+	ASSERT_EQ(stats.usedWords, 20);
+}
+
+UTEST(ImageCache, EvictsLeastRecentlyUsed) {
+	imageCacheClear();
+	imageCacheSetBudget(100);
+	FileMeta_t a = makeMeta(1, "A", 40);
+	FileMeta_t b = makeMeta(2, "B", 40);
+	FileMeta_t c = makeMeta(3, "C", 40);
+
+	ASSERT_TRUE(insertImage(&a, 1000));
+	ASSERT_TRUE(insertImage(&b, 2000));
+	ASSERT_TRUE(imageCacheLookup(&a, 0) != NULL);  // B is now the oldest
+	ASSERT_TRUE(insertImage(&c, 3000));
+
+	ASSERT_TRUE(imageCacheLookup(&b, 0) == NULL);
+	ASSERT_TRUE(imageCacheLookup(&a, 0) != NULL);
+	ASSERT_TRUE(imageCacheLookup(&c, 0) != NULL);
+	ImageCacheStats_t stats = imageCacheGetStats();
+	ASSERT_EQ(stats.evictions, 1u);
+	ASSERT_EQ(stats.usedWords, 80);
+
+	// Larger than the whole budget: not cached, nothing evicted
+	FileMeta_t big = makeMeta(4, "Big", 101);
+	ASSERT_FALSE(insertImage(&big, 0));
+	ASSERT_EQ(imageCacheGetStats().entries, 2);
+
+	// A smaller budget evicts down to it
+	imageCacheSetBudget(50);
+	stats = imageCacheGetStats();
+	ASSERT_EQ(stats.entries, 1);
+	ASSERT_EQ(stats.usedWords, 40);
+	ASSERT_TRUE(imageCacheLookup(&c, 0) != NULL);
+}
+
+UTEST(ImageCache, DropsStaleImages) {
+	imageCacheClear();
+	imageCacheSetBudget(IMAGE_CACHE_BUDGET_WORDS);
+	FileMeta_t meta = makeMeta(5, "Prog", 30);
+	ASSERT_TRUE(insertImage(&meta, 1000));
+
+	// Written by DMA since it was cached
+	ASSERT_TRUE(imageCacheLookup(&meta, 1) == NULL);
+	ASSERT_EQ(imageCacheGetStats().stale, 1u);
+	ASSERT_EQ(imageCacheGetStats().entries, 0);
+
+	// Moved by the defragmenter
+	ASSERT_TRUE(insertImage(&meta, 1000));
+	meta.extents[0].cylinder = 6;
+	ASSERT_TRUE(imageCacheLookup(&meta, 0) == NULL);
+
+	// Deleted and loaded again: a new catalog entry never matches the old image
+	FileMeta_t reloaded = makeMeta(6, "Prog", 30);
+	ASSERT_TRUE(insertImage(&meta, 1000));
+	ASSERT_TRUE(imageCacheLookup(&reloaded, 0) == NULL);
+	ASSERT_TRUE(imageCacheLookup(&meta, 0) != NULL);
+}
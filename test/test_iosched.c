@@ -0,0 +1,163 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../lib/utest.h"
+#include "../inc/hardware/iosched.h"
+
+UTEST_MAIN();
+
+// Queues one descriptor per head position, in the order given
+static void fillQueue(DMARequest_t* queue, const int* positions, int count) {
+	for (int i = 0; i < DMA_QUEUE_DEPTH; i++) queue[i] = (DMARequest_t){ .state = DMA_REQ_FREE };
+	for (int i = 0; i < count; i++) {
+		queue[i].state = DMA_REQ_QUEUED;
+		queue[i].sequence = i;
+		queue[i].segmentCount = 1;
+		queue[i].segments[0].track = positions[i] / DISK_CYLINDERS;
+		queue[i].segments[0].cylinder = positions[i] % DISK_CYLINDERS;
+		queue[i].segments[0].length = 1;
+	}
+}
+
+// Serves the whole queue and records the head positions visited and the total travel
+static int serveAll(DMARequest_t* queue, IOSchedPolicy_t policy, DiskHead_t* head, int* order) {
+	int travel = 0;
+	int served = 0;
+	int slot;
+
+	while ((slot = ioschedPick(queue, DMA_QUEUE_DEPTH, policy, head)) != -1) {
+		int position = ioschedPosition(queue[slot].segments[0].track, queue[slot].segments[0].cylinder);
+		travel += head->pendingTravel + abs(position - head->position);
+		head->pendingTravel = 0;
+		head->position = position;
+		queue[slot].state = DMA_REQ_DONE;
+		order[served++] = position;
+	}
+	return travel;
+}
+
+// The classic textbook queue, head at 53 sweeping upwards
+static const int WORKLOAD[] = { 98, 83, 37, 22, 14, 24, 65, 67 };
+
+UTEST(IOSched, PositionFollowsDiskLayout) {
+	ASSERT_EQ(0, ioschedPosition(0, 0));
+	ASSERT_EQ(9, ioschedPosition(0, 9));
+	ASSERT_EQ(10, ioschedPosition(1, 0));
+	ASSERT_EQ(IOSCHED_POSITIONS - 1, ioschedPosition(DISK_TRACKS - 1, DISK_CYLINDERS - 1));
+}
+
+UTEST(IOSched, FifoKeepsSubmissionOrder) {
+	DMARequest_t queue[DMA_QUEUE_DEPTH];
+	DiskHead_t head = { .position = 53, .direction = 1 };
+	int order[DMA_QUEUE_DEPTH];
+
+	fillQueue(queue, WORKLOAD, 8);
+	int travel = serveAll(queue, IOSCHED_FIFO, &head, order);
+	for (int i = 0; i < 8; i++) ASSERT_EQ(WORKLOAD[i], order[i]);
+	ASSERT_EQ(45 + 15 + 46 + 15 + 8 + 10 + 41 + 2, travel);
+}
+
+UTEST(IOSched, SstfServesClosestFirst) {
+	DMARequest_t queue[DMA_QUEUE_DEPTH];
+	DiskHead_t head = { .position = 53, .direction = 1 };
+	int order[DMA_QUEUE_DEPTH];
+	const int expected[] = { 65, 67, 83, 98, 37, 24, 22, 14 };
+
+	fillQueue(queue, WORKLOAD, 8);
+	int travel = serveAll(queue, IOSCHED_SSTF, &head, order);
+	for (int i = 0; i < 8; i++) ASSERT_EQ(expected[i], order[i]);
+	ASSERT_EQ(45 + 84, travel);
+}
+
+UTEST(IOSched, ScanSweepsToTheEdge) {
+	DMARequest_t queue[DMA_QUEUE_DEPTH];
+	DiskHead_t head = { .position = 53, .direction = 1 };
+	int order[DMA_QUEUE_DEPTH];
+	const int expected[] = { 65, 67, 83, 98, 37, 24, 22, 14 };
+
+	fillQueue(queue, WORKLOAD, 8);
+	int travel = serveAll(queue, IOSCHED_SCAN, &head, order);
+	for (int i = 0; i < 8; i++) ASSERT_EQ(expected[i], order[i]);
+	ASSERT_EQ((99 - 53) + (99 - 14), travel);
+	ASSERT_EQ(-1, head.direction);
+}
+
+UTEST(IOSched, CLookWrapsToLowestRequest) {
+	DMARequest_t queue[DMA_QUEUE_DEPTH];
+	DiskHead_t head = { .position = 53, .direction = 1 };
+	int order[DMA_QUEUE_DEPTH];
+	const int expected[] = { 65, 67, 83, 98, 14, 22, 24, 37 };
+
+	fillQueue(queue, WORKLOAD, 8);
+	int travel = serveAll(queue, IOSCHED_CLOOK, &head, order);
+	for (int i = 0; i < 8; i++) ASSERT_EQ(expected[i], order[i]);
+	ASSERT_EQ((98 - 53) + (98 - 14) + (37 - 14), travel);
+}
+
+// Only QUEUED descriptors are candidates, and equal distances go to the oldest
+UTEST(IOSched, SkipsBusySlotsAndBreaksTiesBySequence) {
+	DMARequest_t queue[DMA_QUEUE_DEPTH];
+	DiskHead_t head = { .position = 50, .direction = 1 };
+	const int positions[] = { 50, 40, 60 };
+
+	fillQueue(queue, positions, 3);
+	queue[0].state = DMA_REQ_ACTIVE;
+	queue[1].sequence = 5;
+	ASSERT_EQ(2, ioschedPick(queue, DMA_QUEUE_DEPTH, IOSCHED_SSTF, &head));
+
+	for (int i = 0; i < 3; i++) queue[i].state = DMA_REQ_DONE;
+	ASSERT_EQ(-1, ioschedPick(queue, DMA_QUEUE_DEPTH, IOSCHED_SCAN, &head));
+	ASSERT_EQ(50, head.position);
+	ASSERT_EQ(0, head.pendingTravel);
+}
+
+UTEST(IOSched, PolicyNames) {
+	IOSchedPolicy_t policy;
+
+	for (int i = 0; i < IOSCHED_POLICY_COUNT; i++) {
+		ASSERT_TRUE(ioschedParsePolicy(ioschedPolicyName((IOSchedPolicy_t)i), &policy));
+		ASSERT_EQ(i, (int)policy);
+	}
+	ASSERT_FALSE(ioschedParsePolicy("elevator", &policy));
+
+	ioschedSetPolicy(IOSCHED_CLOOK);
+	ASSERT_EQ((unsigned)IOSCHED_CLOOK, ioschedGetPolicy());
+	ioschedSetPolicy(IOSCHED_POLICY_COUNT);
+	ASSERT_EQ((unsigned)IOSCHED_CLOOK, ioschedGetPolicy());
+	ioschedSetPolicy(IOSCHED_FIFO);
+}
+
+// Mean over every sample, nearest-rank percentiles over the window, per policy
+UTEST(IOSched, ServiceTimeReport) {
+	IOSchedReport_t report;
+
+	ioschedResetStats();
+	for (int i = 1; i <= 100; i++) ioschedRecordService(IOSCHED_SSTF, i * 1000, 2);
+
+	ioschedGetReport(IOSCHED_SSTF, &report);
+	ASSERT_EQ(100ul, report.completed);
+	ASSERT_EQ((uint64_t)50500, report.meanCycles);
+	ASSERT_EQ((uint64_t)95000, report.p95Cycles);
+	ASSERT_EQ((uint64_t)99000, report.p99Cycles);
+	ASSERT_EQ((uint64_t)100000, report.maxCycles);
+	ASSERT_EQ((uint64_t)200, report.headTravel);
+
+	ioschedGetReport(IOSCHED_SCAN, &report);
+	ASSERT_EQ(0ul, report.completed);
+	ASSERT_EQ((uint64_t)0, report.p99Cycles);
+
+	ioschedResetStats();
+	ioschedGetReport(IOSCHED_SSTF, &report);
+	ASSERT_EQ(0ul, report.completed);
+}
+
+// The controller head used by the DMA worker
+UTEST(IOSched, ControllerHead) {
+	ioschedResetHead();
+	ASSERT_EQ(0, ioschedGetHead());
+	ASSERT_EQ(40, ioschedSeek(40));
+	ASSERT_EQ(15, ioschedSeek(25));
+	ASSERT_EQ(25, ioschedGetHead());
+	ioschedResetHead();
+	ASSERT_EQ(0, ioschedGetHead());
+}
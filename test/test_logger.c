@@ -105,3 +105,107 @@ UTEST(Logger, ThreadSafety) {
 	// But if 50 lines are missing, your logger is useless for the project.
 	ASSERT_TRUE(lines >= 200);
 }
+
+// Verify that messages below the category threshold are neither formatted nor written
+UTEST(Logger, LevelFilter) {
+	int formatted = 0;
+
+	remove("logs_kernel.txt");
+	loggerInit();
+	loggerSetLevel(KERNEL_LOG, LOG_WARNING);
+	ASSERT_EQ((unsigned)LOG_WARNING, loggerGetLevel(KERNEL_LOG));
+	ASSERT_FALSE(loggerIsEnabled(KERNEL_LOG, LOG_INFO));
+	ASSERT_TRUE(loggerIsEnabled(HARDWARE_LOG, LOG_INFO));
+
+	LOG_KERNEL(LOG_INFO, "Filtered message %d", ++formatted);
+	loggerLogKernel(LOG_INFO, "Filtered direct message");
+	LOG_KERNEL(LOG_ERROR, "Recorded message %d", ++formatted);
+	loggerSetLevel(KERNEL_LOG, LOG_OFF);
+	LOG_KERNEL(LOG_ERROR, "Silenced message %d", ++formatted);
+	loggerSetLevel(KERNEL_LOG, LOG_INFO);
+	loggerClose();
+
+	// Filtered calls must not even evaluate their arguments
+	ASSERT_EQ(1, formatted);
+
+	FILE *f = fopen("logs_kernel.txt", "r");
+	ASSERT_TRUE(f != NULL);
+
+	char buffer[256];
+	int lines = 0;
+	bool found = false;
+	while (fgets(buffer, (int)sizeof(buffer), f)) {
+		lines++;
+		if (strstr(buffer, ": [ERROR] Recorded message 1") != NULL) found = true;
+	}
+	fclose(f);
+	ASSERT_EQ(1, lines);
+	ASSERT_TRUE(found);
+}
+
+// Verify that a burst is either written or counted as dropped, and drained on close
+UTEST(Logger, AsyncDrainAndDropCount) {
+	const int burst = 3 * LOGGER_RING_SIZE;
+
+	remove("logs_kernel.txt");
+	loggerInit();
+	ASSERT_EQ(0ul, loggerGetDroppedCount());
+	for (int i = 0; i < burst; i++) {
+		loggerLogKernel(LOG_INFO, "Burst message");
+	}
+	loggerClose();
+	unsigned long dropped = loggerGetDroppedCount();
+
+	// Logging after close is ignored and must not crash
+	loggerLogKernel(LOG_ERROR, "Burst message");
+
+	FILE *f = fopen("logs_kernel.txt", "r");
+	ASSERT_TRUE(f != NULL);
+
+	char buffer[256];
+	int lines = 0;
+	while (fgets(buffer, (int)sizeof(buffer), f)) {
+		if (strstr(buffer, ": Burst message") != NULL) lines++;
+	}
+	fclose(f);
+
+	ASSERT_TRUE(lines > 0);
+	ASSERT_EQ((unsigned long)burst, (unsigned long)lines + dropped);
+}
+
+// Verify that binary trace mode writes a header and fixed-size records instead of text lines
+UTEST(Logger, BinaryTraceRecords) {
+	remove("logs_trace.bin");
+	loggerSetTraceBinary(true);
+	loggerInit();
+	loggerSetTracePid(7);
+	loggerTraceEvent(TRACE_FETCH, 12, 301, 4100005, 300, 0);
+	loggerTraceEvent(TRACE_MEM_WRITE, 13, 302, 5, 305, -42);
+	loggerTraceEventAs(TRACE_DMA_WRITE, 14, 3, 0, 700, 99, 0);  // From the DMA thread, for PID 3
+	loggerClose();
+	loggerSetTraceBinary(false);
+
+	FILE *f = fopen("logs_trace.bin", "rb");
+	ASSERT_TRUE(f != NULL);
+
+	TraceFileHeader_t header;
+	ASSERT_EQ(1u, (unsigned)fread(&header, sizeof(header), 1, f));
+	ASSERT_EQ(0, memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)));
+	ASSERT_EQ((uint32_t)sizeof(TraceRecord_t), header.recordSize);
+
+	TraceRecord_t records[4];
+	size_t count = fread(records, sizeof(TraceRecord_t), 4, f);
+	fclose(f);
+
+	ASSERT_EQ(3u, (unsigned)count);
+	ASSERT_EQ(TRACE_FETCH, records[0].event);
+	ASSERT_EQ(7, records[0].pid);
+	ASSERT_EQ(12u, (unsigned)records[0].cycle);
+	ASSERT_EQ(4100005, records[0].operands[0]);
+	ASSERT_EQ(TRACE_MEM_WRITE, records[1].event);
+	ASSERT_EQ(302u, records[1].pc);
+	ASSERT_EQ(-42, records[1].operands[2]);
+	ASSERT_EQ(3, records[2].pid);
+	ASSERT_EQ(0u, records[2].pc);
+	ASSERT_EQ(14u, (unsigned)records[2].cycle);
+}
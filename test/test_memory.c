@@ -6,6 +6,11 @@
 // Global mock CPU instance
 CPU_t CPU;
 
+// Mock virtual clock for the trace records
+uint64_t cpuGetVirtualCycles(void) {
+	return 0;
+}
+
 UTEST_MAIN();
 
 // Auxiliary function for thread
@@ -142,3 +147,165 @@ UTEST(Memory, MemoryResetFunction) {
 		EXPECT_EQ(0, out);
 	}
 }
+
+// Verify that a fetched word is decoded once and then served from the predecoded cache.
+UTEST(Memory, DecodeCacheHitAfterMiss) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_KERNEL;
+
+	writeMemory(600, 4100005); // LOAD Immediate 5
+
+	word raw = 0;
+	Instruction_t inst;
+
+	EXPECT_EQ((unsigned)MEM_SUCCESS, fetchInstruction(600, &raw, &inst));
+	EXPECT_EQ((unsigned)MEM_SUCCESS, fetchInstruction(600, &raw, &inst));
+
+	EXPECT_EQ(4100005, raw);
+	EXPECT_EQ((unsigned)OP_LOAD, inst.opCode);
+	EXPECT_EQ((unsigned)ADDR_MODE_IMMEDIATE, inst.direction);
+	EXPECT_EQ((unsigned)5, inst.value);
+
+	DecodeCacheStats_t stats = decodeCacheGetStats();
+	EXPECT_EQ((uint64_t)1, stats.misses);
+	EXPECT_EQ((uint64_t)1, stats.hits);
+}
+
+// Verify that CPU and DMA writes invalidate the predecoded entry of the written word.
+UTEST(Memory, DecodeCacheInvalidatedByWrites) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_KERNEL;
+
+	word raw = 0;
+	Instruction_t inst;
+
+	writeMemory(700, 100001); // SUM Immediate 1
+	fetchInstruction(700, &raw, &inst);
+
+	writeMemory(700, 1100002); // RES Immediate 2
+	fetchInstruction(700, &raw, &inst);
+	EXPECT_EQ(1100002, raw);
+	EXPECT_EQ((unsigned)OP_RES, inst.opCode);
+
+	dmaWriteMemory(700, 27000010); // J 10
+	fetchInstruction(700, &raw, &inst);
+	EXPECT_EQ(27000010, raw);
+	EXPECT_EQ((unsigned)OP_J, inst.opCode);
+	EXPECT_EQ((unsigned)10, inst.value);
+
+	DecodeCacheStats_t stats = decodeCacheGetStats();
+	EXPECT_EQ((uint64_t)3, stats.misses);
+	EXPECT_EQ((uint64_t)0, stats.hits);
+	EXPECT_EQ((uint64_t)2, stats.invalidations);
+}
+
+// Verify that the fetch path keeps the User Mode protection of readMemory.
+UTEST(Memory, DecodeCacheKeepsProtection) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_USER;
+	CPU.RB = 300;
+	CPU.RL = 340;
+
+	word raw = 0;
+	Instruction_t inst;
+
+	EXPECT_EQ((unsigned)MEM_SUCCESS, fetchInstruction(10, &raw, &inst));
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, fetchInstruction(50, &raw, &inst));
+
+	// The cached entry of physical 310 must not leak to a process with another base
+	CPU.RB = 500;
+	CPU.RL = 505;
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, fetchInstruction(10, &raw, &inst));
+}
+
+// Verify that lookahead and BUS_LOCK-held accesses share the cache without skewing it.
+UTEST(Memory, PeekAndLockedAccess) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_USER;
+	CPU.RB = 300;
+	CPU.RL = 340;
+
+	word raw = 0;
+	Instruction_t inst;
+
+	pthread_mutex_lock(&BUS_LOCK);
+	EXPECT_EQ((unsigned)MEM_SUCCESS, writeMemoryLocked(20, 25000000)); // PSH
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, writeMemoryLocked(60, 1));
+	EXPECT_EQ((unsigned)MEM_SUCCESS, readMemoryLocked(20, &raw));
+	pthread_mutex_unlock(&BUS_LOCK);
+	EXPECT_EQ(25000000, raw);
+
+	EXPECT_EQ((unsigned)MEM_SUCCESS, peekInstruction(20, &raw, &inst));
+	EXPECT_EQ((unsigned)OP_PSH, inst.opCode);
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, peekInstruction(41, &raw, &inst));
+
+	// The peek warmed the entry, the fetch is a hit
+	EXPECT_EQ((unsigned)MEM_SUCCESS, fetchInstruction(20, &raw, &inst));
+	DecodeCacheStats_t stats = decodeCacheGetStats();
+	EXPECT_EQ((uint64_t)0, stats.misses);
+	EXPECT_EQ((uint64_t)1, stats.hits);
+}
+
+// Verify that a block write copies the whole run, invalidates its decoded words and refuses runs outside RAM.
+UTEST(Memory, DmaWriteBlock) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_KERNEL;
+
+	word raw = 0;
+	Instruction_t inst;
+	writeMemory(701, 100001); // SUM Immediate 1
+	fetchInstruction(701, &raw, &inst);
+
+	const word block[] = { 4100005, 27000010, 13000000 };
+	EXPECT_EQ((unsigned)MEM_SUCCESS, dmaWriteBlock(700, block, 3));
+	EXPECT_EQ(4100005, RAM[700]);
+	EXPECT_EQ(13000000, RAM[702]);
+
+	fetchInstruction(701, &raw, &inst);
+	EXPECT_EQ((unsigned)OP_J, inst.opCode);
+	EXPECT_EQ((uint64_t)1, decodeCacheGetStats().invalidations);
+
+	EXPECT_EQ((unsigned)MEM_ERR_OUT_OF_BOUNDS, dmaWriteBlock(RAM_SIZE - 2, block, 3));
+	EXPECT_EQ(0, RAM[RAM_SIZE - 2]);
+}
+
+// Verify that shared text is mapped at logical 0, readable and executable but not writable.
+UTEST(Memory, SharedTextIsReadOnly) {
+	memoryInit();
+	memoryReset();
+	CPU.PSW.mode = MODE_KERNEL;
+	writeMemory(500, 4100007);  // Shared code: LOAD #7
+	writeMemory(800, 1234);     // First private word
+
+	CPU.PSW.mode = MODE_USER;
+	CPU.TB = 500;
+	CPU.TL = 10;
+	CPU.RB = 800;
+	CPU.RL = 884;
+
+	word out = 0;
+	Instruction_t inst;
+	EXPECT_EQ((unsigned)MEM_SUCCESS, readMemory(0, &out));
+	EXPECT_EQ(4100007, out);
+	EXPECT_EQ((unsigned)MEM_SUCCESS, fetchInstruction(0, &out, &inst));
+	EXPECT_EQ((unsigned)OP_LOAD, inst.opCode);
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, writeMemory(0, 1));
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, writeMemory(9, 1));
+
+	// Logical TL onwards is the private partition starting at RB
+	EXPECT_EQ((unsigned)MEM_SUCCESS, readMemory(10, &out));
+	EXPECT_EQ(1234, out);
+	EXPECT_EQ((unsigned)MEM_SUCCESS, writeMemory(94, 5));
+	EXPECT_EQ(5, RAM[884]);
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, writeMemory(95, 5));
+	EXPECT_EQ((unsigned)MEM_ERR_PROTECTION, readMemory(-1, &out));
+	EXPECT_EQ(4100007, RAM[500]);
+
+	CPU.TB = 0;
+	CPU.TL = 0;
+}
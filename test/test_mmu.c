@@ -6,125 +6,245 @@
 // Global mock RAM and partition tracking for testing
 word mockRAM[RAM_SIZE];
 
-// Auxiliary function to peek into the freePartitions array for testing
-bool isPartitionFree(int index) {
-	extern bool FREE_PARTITIONS[MAX_PROCESSES];
-	return FREE_PARTITIONS[index];
-}
+// Blocks of the empty region with 16-word minimum blocks: 1024 + 512 + 128 + 32
+#define EMPTY_REGION_WORDS 1696
 
 UTEST_MAIN();
 
-// Verify that the MMU initializes all partitions as free
+// Verify that the MMU initializes the whole user region as free
 UTEST(mmu, initialization) {
 	mmuInit();
-	for (int i = 0; i < MAX_PROCESSES; i++) {
-		ASSERT_TRUE(isPartitionFree(i));
-	}
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+	MMUStats_t stats = mmuGetStats();
+	ASSERT_EQ(stats.totalWords, EMPTY_REGION_WORDS);
+	ASSERT_EQ(stats.freeWords, EMPTY_REGION_WORDS);
+	ASSERT_EQ(stats.usedWords, 0);
+	ASSERT_EQ(stats.freeBlocks, 4);
+	ASSERT_EQ(stats.largestFree, EMPTY_REGION_WORDS);  // Every top-level block taken as one span
+
+	MMUBlock_t blocks[8];
+	ASSERT_EQ(mmuListBlocks(blocks, 8), 4);
+	ASSERT_EQ(blocks[0].base, OS_RESERVED_SIZE);
+	ASSERT_EQ(blocks[0].size, 1024);
+	ASSERT_EQ(blocks[3].base, OS_RESERVED_SIZE + 1664);
+	ASSERT_EQ(blocks[3].size, 32);
+	ASSERT_FALSE(blocks[3].used);
 }
 
 // Threshold tests
-UTEST(mmu, calculateRequiredBlocks) {
-	// Test with 0 words (should not be allocated any blocks)
-	ASSERT_EQ(calculateRequiredBlocks(0), 0);
-	
-	// Test with exactly one partition's worth of words (minus stack)
-	int wordsForOneBlock = PARTITION_SIZE - MIN_STACK_SIZE;
-	ASSERT_EQ(calculateRequiredBlocks(wordsForOneBlock), 1);
-	
-	// Test with just over one block's worth of words
-	ASSERT_EQ(calculateRequiredBlocks(wordsForOneBlock + 1), 2);
-	
-	// Test with multiple blocks
-	int wordsForTwoBlocks = (PARTITION_SIZE * 2) - MIN_STACK_SIZE;
-	ASSERT_EQ(calculateRequiredBlocks(wordsForTwoBlocks), 2);
-	
-	// Test with just over two blocks
-	ASSERT_EQ(calculateRequiredBlocks(wordsForTwoBlocks + 1), 3);
-
-	// Test with a large number of words
-	int wordsForTenBlocks = (PARTITION_SIZE * (MAX_PROCESSES/2)) - MIN_STACK_SIZE;
-	ASSERT_EQ(calculateRequiredBlocks(wordsForTenBlocks), MAX_PROCESSES/2);
-
-	//Test with just under maximum blocks (should return maximum number of blocks)
-	int wordsForMaxBlocks = (PARTITION_SIZE * MAX_PROCESSES) - MIN_STACK_SIZE;
-	ASSERT_EQ(calculateRequiredBlocks(wordsForMaxBlocks), MAX_PROCESSES);
-
-	// Test with just over maximum blocks (should return maximum number of blocks)
-	int wordsForTooManyBlocks = (PARTITION_SIZE * (MAX_PROCESSES + 1)) - MIN_STACK_SIZE;
-	ASSERT_EQ(calculateRequiredBlocks(wordsForTooManyBlocks), 0); // Assuming we dont allocate for requests that exceed total partitions
+UTEST(mmu, calculateRequiredWords) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+
+	// Test with 0 words (should not be allocated anything)
+	ASSERT_EQ(calculateRequiredWords(0), 0);
+
+	// The stack is added to the program
+	ASSERT_EQ(calculateRequiredWords(10), 10 + MIN_STACK_SIZE);
+
+	// Blocks are powers of two, never below the minimum
+	ASSERT_EQ(buddyBlockSize(1), 16);
+	ASSERT_EQ(buddyBlockSize(16), 16);
+	ASSERT_EQ(buddyBlockSize(17), 32);
+	ASSERT_EQ(buddyBlockSize(10 + MIN_STACK_SIZE), 64);
+	ASSERT_EQ(buddyBlockSize(1024), 1024);
+
+	// Larger than the largest block: the smallest span of top-level blocks
+	ASSERT_EQ(buddyBlockSize(1025), 1024 + 512);
+	ASSERT_EQ(buddyBlockSize(1537), 1024 + 512 + 128);
+	ASSERT_EQ(buddyBlockSize(EMPTY_REGION_WORDS), EMPTY_REGION_WORDS);
+	ASSERT_EQ(buddyBlockSize(0), 0);
+
+	// The largest program fills the whole region with its stack; one word more never fits
+	ASSERT_EQ(calculateRequiredWords(1025 - MIN_STACK_SIZE), 1025);
+	ASSERT_EQ(calculateRequiredWords(EMPTY_REGION_WORDS - MIN_STACK_SIZE), EMPTY_REGION_WORDS);
+	ASSERT_EQ(calculateRequiredWords(EMPTY_REGION_WORDS - MIN_STACK_SIZE + 1), 0);
+	ASSERT_EQ(buddyBlockSize(EMPTY_REGION_WORDS + 1), 0);
 }
 
-// Contiguous block allocation tests
+// Blocks are split from the smallest free block that fits, keeping the large ones whole
 UTEST(mmu, allocateMemory) {
-	mmuInit(); // Reset state before test
-
-	// Allocate 1 block
-	int blockIndex = allocateMemory(1);
-	ASSERT_EQ(blockIndex, 0);
-	ASSERT_FALSE(isPartitionFree(0));
-
-	// Allocate another block
-	blockIndex = allocateMemory(1);
-	ASSERT_EQ(blockIndex, 1);
-	ASSERT_FALSE(isPartitionFree(1));
-
-	// Allocate 2 blocks
-	blockIndex = allocateMemory(2);
-	ASSERT_EQ(blockIndex, 2);
-	ASSERT_FALSE(isPartitionFree(2));
-	ASSERT_FALSE(isPartitionFree(3));
-
-	// Attempt to allocate more blocks than available
-	blockIndex = allocateMemory(MAX_PROCESSES); // Request more blocks than total
-	ASSERT_EQ(blockIndex, -1); // Should fail
-
-	// Attempt to allocate remaining blocks
-	blockIndex = allocateMemory(MAX_PROCESSES - 4); // Request remaining blocks
-	ASSERT_EQ(blockIndex, 4); // Should get the next free block
-	for (int i = 4; i < MAX_PROCESSES; i++) {
-		ASSERT_FALSE(isPartitionFree(i));
-	}
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+
+	// The 128-word block is split in two 64-word buddies
+	int first = allocateMemory(60);
+	ASSERT_EQ(first, OS_RESERVED_SIZE + 1536);
+	ASSERT_EQ(allocatedSize(first), 64);
+
+	int second = allocateMemory(60);
+	ASSERT_EQ(second, OS_RESERVED_SIZE + 1600);
+
+	// Only the 32-word block is smaller than the 512-word one
+	int third = allocateMemory(100);
+	ASSERT_EQ(third, OS_RESERVED_SIZE + 1024);
+	ASSERT_EQ(allocatedSize(third), 128);
+
+	// Left of the 512-word block: 128 and 256 words, so the 1024-word block is split
+	int fourth = allocateMemory(300);
+	ASSERT_EQ(fourth, OS_RESERVED_SIZE);
+
+	MMUStats_t stats = mmuGetStats();
+	ASSERT_EQ(stats.usedWords, 64 + 64 + 128 + 512);
+	ASSERT_EQ(stats.requestedWords, 60 + 60 + 100 + 300);
+	ASSERT_EQ(stats.largestFree, 512);
+
+	// Too large for any free block
+	ASSERT_EQ(allocateMemory(600), -1);
+	ASSERT_EQ(allocateMemory(0), -1);
+	ASSERT_EQ(allocatedSize(OS_RESERVED_SIZE + 1), 0);
+}
 
-	// Free the first two blocks
-	freeMemory(0, 3);
-	ASSERT_TRUE(isPartitionFree(0));
-	ASSERT_TRUE(isPartitionFree(1));
-	ASSERT_TRUE(isPartitionFree(2));
-
-	// Allocate 3 blocks (should reuse freed blocks)
-	blockIndex = allocateMemory(3);
-	ASSERT_EQ(blockIndex, 0); // Should get the first free block
-	for (int i = 0; i < 3; i++) {
-		ASSERT_FALSE(isPartitionFree(i));
-	}
+// More small programs fit than there used to be fixed partitions
+UTEST(mmu, smallProgramsFit) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
 
-	// Free two separate ranges of blocks
-	freeMemory(0, 2); // Free first blocks 0 and 1
-	freeMemory(4, MAX_PROCESSES - 4);
-	for (int i = 0; i < 2; i++) {
-		ASSERT_TRUE(isPartitionFree(i));
-	}
-	for (int i = 4; i < MAX_PROCESSES; i++) {
-		ASSERT_TRUE(isPartitionFree(i));
+	int required = calculateRequiredWords(10);
+	int placed = 0;
+	while (allocateMemory(required) != -1) placed++;
+	ASSERT_EQ(placed, EMPTY_REGION_WORDS / 64);
+	ASSERT_GT(placed, MAX_PROCESSES);
+}
+
+// Freed blocks merge with their free buddies back into the initial layout
+UTEST(mmu, freeMemoryCoalesces) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+
+	int blocks[6];
+	int sizes[6] = {20, 60, 16, 200, 40, 700};
+	for (int i = 0; i < 6; i++) {
+		blocks[i] = allocateMemory(sizes[i]);
+		ASSERT_NE(blocks[i], -1);
 	}
 
-	// Attempt to allocate more blocks than available in first contiguous range
-	blockIndex = allocateMemory(3); // Request 3 blocks but only 2 are free at the start
-	ASSERT_EQ(blockIndex, 4); // Should allocate from the next available range of free blocks
-	for (int i = 4; i < 7; i++) {
-		ASSERT_FALSE(isPartitionFree(i));
+	ASSERT_EQ(freeMemory(blocks[2]), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(freeMemory(blocks[2]), (unsigned)OS_ERR_MEMORY);  // Already free
+	ASSERT_EQ(freeMemory(blocks[2] + 1), (unsigned)OS_ERR_MEMORY);  // Not a block
+	ASSERT_EQ(freeMemory(RAM_SIZE), (unsigned)OS_ERR_MEMORY);
+
+	int order[5] = {4, 0, 5, 1, 3};
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(freeMemory(blocks[order[i]]), (unsigned)OS_SUCCESS);
 	}
+
+	MMUStats_t stats = mmuGetStats();
+	ASSERT_EQ(stats.freeWords, EMPTY_REGION_WORDS);
+	ASSERT_EQ(stats.freeBlocks, 4);
+	ASSERT_EQ(stats.largestFree, EMPTY_REGION_WORDS);
+}
+
+// Programs larger than the largest block span adjacent free top-level blocks
+UTEST(mmu, largeProgramsSpanBlocks) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+
+	// 1650 words used to fit in the old 20 x 85 partitions
+	int large = allocateMemory(1650);
+	ASSERT_EQ(large, OS_RESERVED_SIZE);
+	ASSERT_EQ(allocatedSize(large), 1024 + 512 + 128);
+	ASSERT_EQ(allocatedSize(OS_RESERVED_SIZE + 1024), 0);  // Inside the span, not a block of its own
+
+	MMUStats_t stats = mmuGetStats();
+	ASSERT_EQ(stats.usedBlocks, 1);
+	ASSERT_EQ(stats.usedWords, 1664);
+	ASSERT_EQ(stats.largestFree, 32);
+	MMUBlock_t blocks[8];
+	ASSERT_EQ(mmuListBlocks(blocks, 8), 2);
+	ASSERT_EQ(blocks[0].size, 1664);
+	ASSERT_TRUE(blocks[0].used);
+
+	ASSERT_EQ(allocateMemory(100), -1);
+	ASSERT_EQ(freeMemory(OS_RESERVED_SIZE + 1024), (unsigned)OS_ERR_MEMORY);
+	ASSERT_EQ(freeMemory(large), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(mmuGetStats().freeBlocks, 4);
+
+	// A span needs whole free blocks: a split 512-word block breaks the run
+	int small = allocateMemory(60);
+	ASSERT_EQ(small, OS_RESERVED_SIZE + 1536);
+	ASSERT_EQ(allocateMemory(1650), -1);
+	int medium = allocateMemory(1100);
+	ASSERT_EQ(medium, OS_RESERVED_SIZE);
+	ASSERT_EQ(allocatedSize(medium), 1536);
+	ASSERT_EQ(freeMemory(medium), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(freeMemory(small), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(mmuGetStats().freeWords, EMPTY_REGION_WORDS);
+}
+
+// The minimum block size can only change while nothing is allocated
+UTEST(mmu, minBlockSize) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(48), (unsigned)OS_ERR_MEMORY);
+	ASSERT_EQ(mmuSetMinBlockSize(0), (unsigned)OS_ERR_MEMORY);
+
+	ASSERT_EQ(mmuSetMinBlockSize(1), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(mmuGetStats().totalWords, RAM_SIZE - OS_RESERVED_SIZE);
+	ASSERT_EQ(buddyBlockSize(3), 4);
+
+	ASSERT_EQ(mmuSetMinBlockSize(128), (unsigned)OS_SUCCESS);
+	int base = allocateMemory(10);
+	ASSERT_EQ(allocatedSize(base), 128);
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_ERR_MEMORY);
+
+	ASSERT_EQ(freeMemory(base), (unsigned)OS_SUCCESS);
+	ASSERT_EQ(mmuSetMinBlockSize(MMU_MIN_BLOCK_SIZE), (unsigned)OS_SUCCESS);
+}
+
+// Shared text segments are placed once and freed with their last process
+UTEST(mmu, sharedText) {
+	mmuInit();
+	ASSERT_EQ(mmuSetMinBlockSize(16), (unsigned)OS_SUCCESS);
+	bool created;
+
+	int text = acquireSharedText(7, 0, 100, &created);
+	ASSERT_EQ(text, 0);
+	ASSERT_TRUE(created);
+	ASSERT_EQ(SHARED_TEXTS[text].base, OS_RESERVED_SIZE + 1536);
+	ASSERT_EQ(SHARED_TEXTS[text].size, 128);
+
+	// Same file: mapped again, no new block
+	ASSERT_EQ(acquireSharedText(7, 0, 100, &created), text);
+	ASSERT_FALSE(created);
+	ASSERT_EQ(SHARED_TEXTS[text].refCount, 2);
+	ASSERT_EQ(mmuGetStats().usedBlocks, 1);
+
+	// Written since, or another file: a segment of its own
+	int rewritten = acquireSharedText(7, 1, 100, &created);
+	ASSERT_NE(rewritten, text);
+	ASSERT_TRUE(created);
+	ASSERT_EQ(SHARED_TEXTS[rewritten].base, OS_RESERVED_SIZE + 1024);
+
+	releaseSharedText(text);
+	ASSERT_EQ(allocatedSize(OS_RESERVED_SIZE + 1536), 128);
+	releaseSharedText(text);
+	ASSERT_EQ(allocatedSize(OS_RESERVED_SIZE + 1536), 0);
+	ASSERT_FALSE(SHARED_TEXTS[text].used);
+
+	releaseSharedText(rewritten);
+	releaseSharedText(-1);  // Processes without shared text
+	ASSERT_EQ(mmuGetStats().freeWords, EMPTY_REGION_WORDS);
+	ASSERT_EQ(acquireSharedText(8, 0, RAM_SIZE, &created), -1);
+	ASSERT_FALSE(created);
 }
 
-// Base and limit register calculation tests
-UTEST(mmu, baseAndLimitRegisters) {
-	// Test base register calculation
-	int startBlockIndex = 3;
-	address expectedBase = OS_RESERVED_SIZE + (startBlockIndex * PARTITION_SIZE);
-	ASSERT_EQ(GET_BASE_REGISTER(startBlockIndex), expectedBase);
-
-	// Test limit register calculation
-	int endBlockIndex = 5;
-	address expectedLimit = expectedBase + (endBlockIndex * PARTITION_SIZE) - 1;
-	ASSERT_EQ(GET_LIMIT_REGISTER(expectedBase, endBlockIndex), expectedLimit);
+// Only direct stores and immediate DMA targets bound the text
+UTEST(mmu, sharedTextLength) {
+	word program[12] = {
+		4100003,   // LOAD #3
+		5000009,   // STR 9
+		32100010,  // SDMAM #10
+		25000000,  // PSH
+	};
+	ASSERT_EQ(sharedTextLength(program, 4), 4);
+	ASSERT_EQ(sharedTextLength(program, 12), 9);
+
+	// LOAD -3 then STR 10[AC] writes logical 7: an indexed store can reach below its operand
+	word negativeIndex[12] = { 4000011, 5200010, 25000000 };
+	negativeIndex[11] = SIGN_BIT + 3;
+	ASSERT_EQ(sharedTextLength(negativeIndex, 12), 0);
+
+	// A DMA target read from memory could be anywhere
+	word directTarget[3] = { 4100001, 32000002, 0 };  // LOAD #1, SDMAM 2
+	ASSERT_EQ(sharedTextLength(directTarget, 3), 0);
 }
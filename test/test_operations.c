@@ -3,6 +3,7 @@
 #include "../lib/utest.h"
 #include "../inc/hardware/cpu.h"
 #include "../inc/hardware/memory.h"
+#include "../inc/kernel/syscalls.h"
 
 CPU_t CPU;
 DMA_t DMA;
@@ -39,6 +40,37 @@ MemoryStatus_t readMemory(address addr, word* outData) {
 	return MEM_ERR_OUT_OF_BOUNDS;
 }
 
+// Mock for the predecoded fetch path (No cache, decodes on every call)
+MemoryStatus_t fetchInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	MemoryStatus_t status = readMemory(addr, outData);
+	outInstruction->opCode = GET_INSTRUCTION_OPCODE(*outData);
+	outInstruction->direction = GET_INSTRUCTION_MODE(*outData);
+	outInstruction->value = GET_INSTRUCTION_VALUE(*outData);
+	return status;
+}
+
+// Mocks for the BUS_LOCK-held variants (The plain mocks never take the lock)
+MemoryStatus_t readMemoryLocked(address addr, word* outData) {
+	return readMemory(addr, outData);
+}
+
+MemoryStatus_t writeMemoryLocked(address addr, word data) {
+	return writeMemory(addr, data);
+}
+
+// Mock for the silent lookahead (Same view of RAM as fetchInstruction)
+MemoryStatus_t peekInstruction(address addr, word* outData, Instruction_t* outInstruction) {
+	return fetchInstruction(addr, outData, outInstruction);
+}
+
+bool osYield = false;
+bool osDMAWait = false;
+
+// Mock for the kernel syscall router (AC = 0 requests EXIT)
+SyscallStatus_t handleSyscall(void) {
+	return (CPU.AC == 0) ? SYSCALL_HALT : SYSCALL_SUCCESS;
+}
+
 // Helper function to get a clean PSW
 static PSW_t setupCleanPSW(void) {
 	PSW_t psw;
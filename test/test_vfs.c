@@ -1,5 +1,8 @@
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "../lib/utest.h"
 #include "../inc/hardware/memory.h"
@@ -8,16 +11,67 @@
 
 CPU_t CPU;
 word RAM[RAM_SIZE];
-Sector_t DISK[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];
+static Sector_t diskStorage[DISK_TRACKS][DISK_CYLINDERS][DISK_SECTORS];
+Sector_t (*DISK)[DISK_CYLINDERS][DISK_SECTORS] = diskStorage;
 
 UTEST_MAIN();
 
-// Mock function for reading from disk
+// Mock function for writing to disk
 DiskStatus_t writeSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_t data) {
 	DISK[track][cylinder][sector] = data;
 	return DISK_SUCCESS;
 }
 
+// Mock function for reading from disk
+DiskStatus_t readSector(uint8_t track, uint8_t cylinder, uint8_t sector, Sector_t* buffer) {
+	*buffer = DISK[track][cylinder][sector];
+	return DISK_SUCCESS;
+}
+
+// Mock function for writing a run of sectors
+DiskStatus_t writeSectors(uint8_t track, uint8_t cylinder, uint8_t sector, const word* data, int count) {
+	Sector_t* run = &DISK[track][cylinder][sector];
+	for (int i = 0; i < count; i++) run[i].data = data[i];
+	return DISK_SUCCESS;
+}
+
+// Mock function for reading a run of sectors
+DiskStatus_t readSectors(uint8_t track, uint8_t cylinder, uint8_t sector, word* buffer, int count) {
+	const Sector_t* run = &DISK[track][cylinder][sector];
+	for (int i = 0; i < count; i++) buffer[i] = run[i].data;
+	return DISK_SUCCESS;
+}
+
+// Mock function for flushing the disk image
+void diskSync(void) {
+}
+
+// Mock image attachment: tests switch it on to act as a disk image
+static bool persistentDisk = false;
+bool diskIsPersistent(void) {
+	return persistentDisk;
+}
+
+// First sector available to files, after the catalog area
+#define DATA_TRACK     (VFS_RESERVED_SECTORS / (DISK_CYLINDERS * DISK_SECTORS))
+#define DATA_CYLINDER  ((VFS_RESERVED_SECTORS / DISK_SECTORS) % DISK_CYLINDERS)
+
+// Flips a bit of a catalog sector, given by its linear number
+static void damageSector(int linear) {
+	uint8_t t, c, s;
+	vfsSectorAddress(linear, &t, &c, &s);
+	DISK[t][c][s].data ^= 1;
+}
+
+// Undoes the superblock write of the last commit, given the catalog area before it:
+// the records reached the disk, the superblock that makes them visible did not
+static void cutCommitShort(const Sector_t* before) {
+	int changed = 0;
+	while (memcmp(&before[changed], &DISK[0][0][changed], sizeof(Sector_t)) == 0) changed++;
+	int copyStart = changed / VFS_CATALOG_SECTORS * VFS_CATALOG_SECTORS;
+	memcpy(&DISK[0][0][copyStart], &before[copyStart], VFS_SUPERBLOCK_SECTORS * sizeof(Sector_t));
+}
+
 // Mock function for writing in memory
 MemoryStatus_t writeMemory(address addr, word value) {
 	if (addr >= OS_RESERVED_SIZE && addr < RAM_SIZE) {
@@ -58,6 +112,37 @@ void createLargeTestInputFile(void) {
 	}
 }
 
+// Writes a program whose words are firstValue, firstValue + 1, ...
+void createProgramFile(const char* path, const char* name, int words, int firstValue) {
+	FILE* f = fopen(path, "w");
+	if (f) {
+		fprintf(f, "_start 1\n.NumeroPalabras %d\n.NombreProg %s\n", words, name);
+		for (int i = 0; i < words; i++) fprintf(f, "%08d\n", firstValue + i);
+		fclose(f);
+	}
+}
+
+// Binary image of the same program, with the checksum optionally damaged
+void createProgramImage(const char* path, const char* name, int words, int firstValue, bool corrupt) {
+	static word programWords[RAM_SIZE];
+	ProgramImageHeader_t header = { .magic = VFS_IMAGE_MAGIC, .version = VFS_IMAGE_VERSION, .startPC = 1, .wordCount = words };
+	strncpy(header.programName, name, VFS_IMAGE_NAME_SIZE - 1);
+	for (int i = 0; i < words; i++) programWords[i] = firstValue + i;
+	header.checksum = vfsImageChecksum(programWords, words) + (corrupt ? 1 : 0);
+
+	FILE* f = fopen(path, "wb");
+	if (f) {
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(programWords, sizeof(word), words, f);
+		fclose(f);
+	}
+}
+
+void removeProgramFiles(void) {
+	const char* paths[] = { "vfs_a.txt", "vfs_b.txt", "vfs_c.txt", "vfs_d.txt", "vfs_e.txt", "vfs_a.lbin", "vfs_b.lbin" };
+	for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) remove(paths[i]);
+}
+
 UTEST(Loader, FileCreation) {
 	createTestInputFile();
 	FILE* f = fopen("test_program.txt", "r");
@@ -119,20 +204,21 @@ UTEST(VFS, FileExists_WhenEmpty) {
 
 UTEST(VFS, RegisterAndExists) {
 	vfsClearCatalog();
-	ASSERT_EQ(vfsRegisterFile("programa1.txt", 0, 1, 5, 20, 1), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsRegisterFile("programa1.txt", "Prog1", 0, 1, 5, 20, 1), (unsigned)VFS_SUCCESS);
 	ASSERT_TRUE(vfsFileExists("programa1.txt"));
 	ASSERT_FALSE(vfsFileExists("programa2.txt"));
 }
 
 UTEST(VFS, GetMetadata_Success) {
 	vfsClearCatalog();
-	vfsRegisterFile("calc.txt", 2, 4, 10, 85, 1);
+	vfsRegisterFile("calc.txt", "Calc", 5, 4, 10, 85, 1);
 	
 	FileMeta_t meta;
 	ASSERT_EQ(vfsGetMetadata("calc.txt", &meta), (unsigned)VFS_SUCCESS);
 	
-	ASSERT_STREQ(meta.fileName, "calc.txt");
-	ASSERT_EQ(meta.startTrack, 2);
+	ASSERT_STREQ(meta.filePath, "calc.txt");
+	ASSERT_STREQ(meta.programName, "Calc");
+	ASSERT_EQ(meta.startTrack, 5);
 	ASSERT_EQ(meta.startCylinder, 4);
 	ASSERT_EQ(meta.startSector, 10);
 	ASSERT_EQ(meta.wordCount, 85);
@@ -146,12 +232,12 @@ UTEST(VFS, GetMetadata_NotFound) {
 
 UTEST(VFS, Catalog_DiskFull) {
 	vfsClearCatalog();
-	for (int i = 0; i < MAX_PROCESSES; i++) {
+	for (int i = 0; i < VFS_MAX_FILES; i++) {
 		char tempName[32];
 		sprintf(tempName, "file%d.txt", i);
-		ASSERT_EQ(vfsRegisterFile(tempName, 0, 0, 0, 10, 1), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(vfsRegisterFile(tempName, tempName, 0, 0, 0, 10, 1), (unsigned)VFS_SUCCESS);
 	}
-	ASSERT_EQ(vfsRegisterFile("overflow.txt", 0, 0, 0, 10, 1), (unsigned)VFS_ERR_DISK_FULL);
+	ASSERT_EQ(vfsRegisterFile("overflow.txt", "Overflow", 0, 0, 0, 10, 1), (unsigned)VFS_ERR_DISK_FULL);
 }
 
 UTEST(VFS, LoadToDisk_Success) {
@@ -163,14 +249,14 @@ UTEST(VFS, LoadToDisk_Success) {
 	
 	FileMeta_t meta;
 	ASSERT_EQ(vfsGetMetadata("test_program.txt", &meta), (unsigned)VFS_SUCCESS);
-	ASSERT_EQ(meta.startTrack, 0);
-	ASSERT_EQ(meta.startCylinder, 0);
+	ASSERT_EQ(meta.startTrack, DATA_TRACK);
+	ASSERT_EQ(meta.startCylinder, DATA_CYLINDER);
 	ASSERT_EQ(meta.startSector, 0);
 	ASSERT_EQ(meta.wordCount, 7);
 	ASSERT_EQ(meta.startPC, 1);
 	
-	ASSERT_EQ(DISK[0][0][0].data, 4100005);
-	ASSERT_EQ(DISK[0][0][1].data, 100005);
+	ASSERT_EQ(DISK[DATA_TRACK][DATA_CYLINDER][0].data, 4100005);
+	ASSERT_EQ(DISK[DATA_TRACK][DATA_CYLINDER][1].data, 100005);
 }
 
 UTEST(VFS, LoadToDisk_NotFound) {
@@ -197,7 +283,484 @@ UTEST(VFS, DiskGeometryWrapAround) {
 	FileMeta_t meta2;
 	ASSERT_EQ(vfsGetMetadata("test_program.txt", &meta2), (unsigned)VFS_SUCCESS);
 	
-	ASSERT_EQ(meta2.startTrack, 0);
-	ASSERT_EQ(meta2.startCylinder, 1);
+	ASSERT_EQ(meta2.startTrack, DATA_TRACK);
+	ASSERT_EQ(meta2.startCylinder, DATA_CYLINDER + 1);
 	ASSERT_EQ(meta2.startSector, 5);
 }
+
+UTEST(VFS, MountRestoresCatalog) {
+	vfsClearCatalog();
+	createTestInputFile();
+	ASSERT_EQ(vfsLoadToDisk("test_program.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsRegisterFile("calc.txt", "Calc", 5, 4, 10, 85, 3), (unsigned)VFS_SUCCESS);
+
+	// A restart only keeps the disk: the catalog and the free pointer come back from it
+	ASSERT_EQ(vfsMount(), 2);
+	ASSERT_TRUE(vfsFileExists("5mas5"));
+
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata("calc.txt", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_STREQ(meta.programName, "Calc");
+	ASSERT_EQ(meta.startTrack, 5);
+	ASSERT_EQ(meta.startCylinder, 4);
+	ASSERT_EQ(meta.startSector, 10);
+	ASSERT_EQ(meta.wordCount, 85);
+	ASSERT_EQ(meta.startPC, 3);
+
+	FILE* f = fopen("geom_test.txt", "w");
+	fprintf(f, "_start 1\n.NumeroPalabras 1\n.NombreProg Next\n99999999\n");
+	fclose(f);
+	ASSERT_EQ(vfsLoadToDisk("geom_test.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsGetMetadata("Next", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.startSector, 7); // Right after test_program.txt
+}
+
+UTEST(VFS, MountFormatsDamagedCatalog) {
+	vfsClearCatalog();
+	ASSERT_EQ(vfsRegisterFile("calc.txt", "Calc", 5, 4, 10, 85, 1), (unsigned)VFS_SUCCESS);
+
+	damageSector(VFS_SUPERBLOCK_SECTORS);                            // First record of the copy in use
+	damageSector(VFS_CATALOG_SECTORS + VFS_SUPERBLOCK_SECTORS - 1);  // Checksum of the other copy
+	ASSERT_EQ(vfsMount(), 0);
+	ASSERT_FALSE(vfsFileExists("calc.txt"));
+	ASSERT_EQ(vfsMount(), 0); // The formatted superblock is valid
+}
+
+UTEST(VFS, MountKeepsDamagedImage) {
+	vfsClearCatalog();
+	ASSERT_EQ(vfsRegisterFile("calc.txt", "Calc", 5, 4, 10, 85, 1), (unsigned)VFS_SUCCESS);
+	static Sector_t catalog[VFS_RESERVED_SECTORS];
+	damageSector(VFS_SUPERBLOCK_SECTORS);
+	damageSector(VFS_CATALOG_SECTORS + VFS_SUPERBLOCK_SECTORS - 1);
+	memcpy(catalog, DISK[0][0], sizeof(catalog));
+
+	// On an image the damaged catalog is not formatted, and nothing can be written
+	persistentDisk = true;
+	ASSERT_EQ(vfsMount(), -1);
+	ASSERT_FALSE(vfsIsMounted());
+	ASSERT_FALSE(vfsFileExists("calc.txt"));
+	ASSERT_EQ(vfsRegisterFile("calc.txt", "Calc", 5, 4, 10, 85, 1), (unsigned)VFS_ERR_NOT_MOUNTED);
+	ASSERT_EQ(vfsDeleteFile("calc.txt"), (unsigned)VFS_ERR_NOT_MOUNTED);
+	ASSERT_EQ(vfsDefragment(NULL), (unsigned)VFS_ERR_NOT_MOUNTED);
+	ASSERT_EQ(memcmp(catalog, DISK[0][0], sizeof(catalog)), 0);
+
+	// Only an explicit format reuses the disk
+	vfsClearCatalog();
+	ASSERT_TRUE(vfsIsMounted());
+	ASSERT_EQ(vfsMount(), 0);
+	persistentDisk = false;
+}
+
+UTEST(VFS, MountFallsBackToPreviousCommit) {
+	static Sector_t before[VFS_RESERVED_SECTORS];
+	vfsClearCatalog();
+	ASSERT_EQ(vfsRegisterFile("a.txt", "ProgA", 5, 0, 0, 10, 1), (unsigned)VFS_SUCCESS);
+	memcpy(before, DISK[0][0], sizeof(before));
+	ASSERT_EQ(vfsRegisterFile("b.txt", "ProgB", 5, 1, 0, 10, 1), (unsigned)VFS_SUCCESS);
+
+	cutCommitShort(before);
+
+	persistentDisk = true;
+	ASSERT_EQ(vfsMount(), 1);
+	ASSERT_TRUE(vfsIsMounted());
+	ASSERT_TRUE(vfsFileExists("a.txt"));
+	ASSERT_FALSE(vfsFileExists("b.txt"));
+	persistentDisk = false;
+
+	// The next commit goes to the copy that was cut short
+	ASSERT_EQ(vfsRegisterFile("c.txt", "ProgC", 5, 2, 0, 10, 1), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsMount(), 2);
+	ASSERT_TRUE(vfsFileExists("c.txt"));
+}
+
+UTEST(VFS, RegisterNameTooLong) {
+	vfsClearCatalog();
+	char longPath[VFS_PATH_SIZE + 1];
+	memset(longPath, 'a', VFS_PATH_SIZE);
+	longPath[VFS_PATH_SIZE] = '\0';
+
+	ASSERT_EQ(vfsRegisterFile(longPath, "Short", 0, 0, 0, 1, 1), (unsigned)VFS_ERR_NAME_TOO_LONG);
+	ASSERT_EQ(vfsGetCatalogCount(), 0);
+	removeProgramFiles();
+}
+
+UTEST(VFS, LongKeysSurviveMount) {
+	vfsClearCatalog();
+	char longPath[101], otherPath[101];
+	memset(longPath, 'a', 100);
+	longPath[100] = '\0';
+	strcpy(otherPath, longPath);
+	otherPath[99] = 'b';  // Same disk prefix, another file
+
+	ASSERT_EQ(vfsRegisterFile(longPath, "AProgramNameLonger", 5, 4, 10, 1, 1), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsMount(), 1);
+
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata(longPath, &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(strlen(meta.filePath), (size_t)VFS_DISK_PATH_SIZE - 1);
+	ASSERT_EQ(vfsGetMetadata("AProgramNameLonger", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_STREQ(meta.programName, "AProgramNameLon");
+	ASSERT_FALSE(vfsFileExists(otherPath));
+	ASSERT_FALSE(vfsFileExists("AProgramNameLon"));
+	removeProgramFiles();
+}
+
+UTEST(VFS, IndexFindsEveryEntry) {
+	vfsClearCatalog();
+	char path[32], name[16];
+	for (int i = 0; i < VFS_MAX_FILES; i++) {
+		sprintf(path, "dir/file%d.txt", i);
+		sprintf(name, "Prog%d", i);
+		ASSERT_EQ(vfsRegisterFile(path, name, 0, 0, 0, i + 1, 1), (unsigned)VFS_SUCCESS);
+	}
+
+	FileMeta_t meta;
+	for (int i = 0; i < VFS_MAX_FILES; i++) {
+		sprintf(path, "dir/file%d.txt", i);
+		sprintf(name, "Prog%d", i);
+		ASSERT_EQ(vfsGetMetadata(path, &meta), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(meta.wordCount, i + 1);
+		ASSERT_EQ(vfsGetMetadata(name, &meta), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(meta.wordCount, i + 1);
+	}
+	ASSERT_FALSE(vfsFileExists("Prog"));
+	ASSERT_FALSE(vfsFileExists("dir/file.txt"));
+	ASSERT_FALSE(vfsFileExists(""));
+}
+
+UTEST(VFS, IndexFirstRegisteredWins) {
+	vfsClearCatalog();
+	ASSERT_EQ(vfsRegisterFile("a.txt", "Shared", 0, 0, 0, 1, 1), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsRegisterFile("Shared", "Other", 0, 0, 0, 2, 1), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsRegisterFile("b.txt", "Shared", 0, 0, 0, 3, 1), (unsigned)VFS_SUCCESS);
+
+	// Same answer as a scan in catalog order, whichever key matches
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata("Shared", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.wordCount, 1);
+	ASSERT_EQ(vfsGetMetadata("b.txt", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.wordCount, 3);
+}
+
+UTEST(VFS, DeleteFreesSectors) {
+	vfsClearCatalog();
+	int initiallyFree = vfsGetFreeSectors();
+	createProgramFile("vfs_a.txt", "ProgA", 50, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 30, 2000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsGetFreeSectors(), initiallyFree - 80);
+
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsGetFreeSectors(), initiallyFree - 30);
+	ASSERT_FALSE(vfsFileExists("vfs_a.txt"));
+	ASSERT_TRUE(vfsFileExists("ProgB"));
+	ASSERT_EQ(vfsGetCatalogCount(), 1);
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_ERR_NOT_FOUND);
+
+	// The deletion is on disk too
+	ASSERT_EQ(vfsMount(), 1);
+	ASSERT_EQ(vfsGetFreeSectors(), initiallyFree - 30);
+	ASSERT_TRUE(vfsFileExists("vfs_b.txt"));
+	removeProgramFiles();
+}
+
+UTEST(VFS, DeleteCutShortKeepsCatalog) {
+	static Sector_t before[VFS_RESERVED_SECTORS];
+	vfsClearCatalog();
+	createProgramFile("vfs_a.txt", "ProgA", 50, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 30, 2000);
+	createProgramFile("vfs_c.txt", "ProgC", 20, 3000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+
+	// The later records move down in the copy not in use; the one in use is left whole
+	memcpy(before, DISK[0][0], sizeof(before));
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	cutCommitShort(before);
+
+	ASSERT_EQ(vfsMount(), 3);
+	const char* names[] = { "ProgA", "ProgB", "ProgC" };
+	for (int i = 0; i < 3; i++) {
+		FileMeta_t meta;
+		ASSERT_EQ(vfsGetCatalogEntry(i, &meta), (unsigned)VFS_SUCCESS);
+		ASSERT_STREQ(meta.programName, names[i]);
+	}
+	removeProgramFiles();
+}
+
+UTEST(VFS, BestFitPrefersSmallestHole) {
+	vfsClearCatalog();
+	createProgramFile("vfs_a.txt", "ProgA", 40, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 10, 1000);
+	createProgramFile("vfs_c.txt", "ProgC", 15, 1000);
+	createProgramFile("vfs_d.txt", "ProgD", 10, 1000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_d.txt"), (unsigned)VFS_SUCCESS);
+
+	// Holes of 40 and 15 sectors: a 12-word file goes in the 15-sector one
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgC"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_e.txt", "ProgE", 12, 1000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_e.txt"), (unsigned)VFS_SUCCESS);
+
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata("ProgE", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.extentCount, 1);
+	ASSERT_EQ(vfsLinearSector(meta.startTrack, meta.startCylinder, meta.startSector), VFS_RESERVED_SECTORS + 50);
+	removeProgramFiles();
+}
+
+UTEST(VFS, SplitsFileWhenNoRunFits) {
+	vfsClearCatalog();
+	int dataSectors = vfsGetFreeSectors();
+	createProgramFile("vfs_a.txt", "ProgA", 100, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 100, 1000);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 200, 1000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsGetFreeSectors(), 0);
+
+	// Two separate 100-sector holes and a 150-word file
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgC"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 300, 1000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_d.txt", "ProgD", 150, 5000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_d.txt"), (unsigned)VFS_SUCCESS);
+
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata("ProgD", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.extentCount, 2);
+	ASSERT_EQ(meta.extents[0].length + meta.extents[1].length, 150);
+	for (int i = 0; i < 150; i++) {
+		uint8_t t, c, sec;
+		ASSERT_TRUE(vfsWordAddress(&meta, i, &t, &c, &sec));
+		ASSERT_EQ(DISK[t][c][sec].data, 5000 + i);
+	}
+
+	createProgramFile("vfs_e.txt", "ProgE", 100, 1000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_e.txt"), (unsigned)VFS_ERR_DISK_FULL);
+	removeProgramFiles();
+}
+
+UTEST(VFS, CyclingFilesReclaimsSpace) {
+	vfsClearCatalog();
+	int half = vfsGetFreeSectors() / 2 + 1;
+	createProgramFile("vfs_a.txt", "ProgA", half, 1000);
+
+	// Each load takes over half the disk; without reclaiming, the second one would fail
+	for (int round = 0; round < 5; round++) {
+		ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(vfsDeleteFile("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	}
+	ASSERT_EQ(vfsGetCatalogCount(), 0);
+	removeProgramFiles();
+}
+
+UTEST(VFS, DefragMakesFilesContiguous) {
+	vfsClearCatalog();
+	int dataSectors = vfsGetFreeSectors();
+	createProgramFile("vfs_a.txt", "ProgA", 100, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 100, 2000);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 200, 3000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgC"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 300, 3000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_d.txt", "ProgD", 150, 4000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_d.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgB"), (unsigned)VFS_SUCCESS); // Leaves a hole between the pieces of ProgD
+
+	VFSDefragReport_t report;
+	ASSERT_EQ(vfsDefragment(&report), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(report.before.splitFiles, 1);
+	ASSERT_GT(report.before.fileRatio, 0);
+	ASSERT_GT(report.before.freeRatio, 0);
+	ASSERT_EQ(report.after.splitFiles, 0);
+	ASSERT_EQ(report.after.fileRatio, 0);
+	ASSERT_EQ(report.after.freeRatio, 0);
+	ASSERT_EQ(report.after.freeRuns, 1);
+	ASSERT_GT(report.filesMoved, 0);
+
+	// Same words, now in one run each, and the layout survives a mount
+	ASSERT_EQ(vfsMount(), 2);
+	const char* names[] = { "ProgC", "ProgD" };
+	const int firstValues[] = { 3000, 4000 };
+	for (int f = 0; f < 2; f++) {
+		FileMeta_t meta;
+		ASSERT_EQ(vfsGetMetadata(names[f], &meta), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(meta.extentCount, 1);
+		for (int i = 0; i < meta.wordCount; i++) {
+			uint8_t t, c, sec;
+			ASSERT_TRUE(vfsWordAddress(&meta, i, &t, &c, &sec));
+			ASSERT_EQ(DISK[t][c][sec].data, firstValues[f] + i);
+		}
+	}
+	removeProgramFiles();
+}
+
+UTEST(VFS, DefragAlignsToTracks) {
+	vfsClearCatalog();
+	int firstTrackRoom = VFS_TRACK_SECTORS - VFS_RESERVED_SECTORS % VFS_TRACK_SECTORS;
+	createProgramFile("vfs_a.txt", "ProgA", firstTrackRoom - 100, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 300, 2000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+
+	VFSFragmentation_t stats;
+	vfsGetFragmentation(&stats);
+	ASSERT_EQ(stats.crossingFiles, 1); // ProgB runs over the end of the first data track
+
+	VFSDefragReport_t report;
+	ASSERT_EQ(vfsDefragment(&report), (unsigned)VFS_SUCCESS);
+	ASSERT_TRUE(report.trackAligned);
+	ASSERT_EQ(report.after.crossingFiles, 0);
+	ASSERT_EQ(report.filesMoved, 1);
+	ASSERT_EQ(report.sectorsMoved, 600); // The new run overlaps the old one: parked in the free space first
+
+	FileMeta_t meta;
+	ASSERT_EQ(vfsGetMetadata("ProgB", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLinearSector(meta.startTrack, meta.startCylinder, meta.startSector) % VFS_TRACK_SECTORS, 0);
+	ASSERT_EQ(DISK[meta.startTrack][meta.startCylinder][meta.startSector].data, 2000);
+
+	// Already in place: nothing moves
+	ASSERT_EQ(vfsDefragment(&report), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(report.filesMoved, 0);
+	removeProgramFiles();
+}
+
+UTEST(VFS, LoadBinaryImageMatchesText) {
+	vfsClearCatalog();
+	createProgramFile("vfs_a.txt", "ProgA", 120, 1000);
+	createProgramImage("vfs_a.lbin", "ProgBin", 120, 1000, false);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.lbin"), (unsigned)VFS_SUCCESS);
+
+	FileMeta_t text, binary;
+	ASSERT_EQ(vfsGetMetadata("ProgA", &text), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsGetMetadata("ProgBin", &binary), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(binary.wordCount, 120);
+	ASSERT_EQ(binary.startPC, 1);
+	for (int i = 0; i < 120; i++) {
+		uint8_t t1, c1, s1, t2, c2, s2;
+		ASSERT_TRUE(vfsWordAddress(&text, i, &t1, &c1, &s1));
+		ASSERT_TRUE(vfsWordAddress(&binary, i, &t2, &c2, &s2));
+		ASSERT_EQ(DISK[t2][c2][s2].data, DISK[t1][c1][s1].data);
+	}
+	removeProgramFiles();
+}
+
+UTEST(VFS, LoadBinaryImageRejectsDamage) {
+	vfsClearCatalog();
+	createProgramImage("vfs_a.lbin", "ProgBin", 50, 1000, true);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.lbin"), (unsigned)VFS_ERR_BAD_IMAGE);
+
+	// Truncated: the header promises more words than the file holds
+	createProgramImage("vfs_b.lbin", "ProgBin", 50, 1000, false);
+	FILE* f = fopen("vfs_b.lbin", "r+b");
+	ASSERT_TRUE(f != NULL);
+	ASSERT_EQ(ftruncate(fileno(f), sizeof(ProgramImageHeader_t) + 10 * sizeof(word)), 0);
+	fclose(f);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.lbin"), (unsigned)VFS_ERR_BAD_IMAGE);
+
+	ASSERT_FALSE(vfsFileExists("vfs_a.lbin"));
+	ASSERT_FALSE(vfsFileExists("vfs_b.lbin"));
+	removeProgramFiles();
+}
+
+UTEST(Loader, LoadProgramBinaryImage) {
+	createProgramImage("vfs_a.lbin", "ProgBin", 7, 4100005, false);
+	ProgramInfo_t programInfo = loadProgram("vfs_a.lbin");
+	ASSERT_EQ(programInfo.status, (unsigned)LOAD_SUCCESS);
+	ASSERT_EQ(programInfo.wordCount, 7);
+	ASSERT_STREQ(programInfo.programName, "ProgBin");
+	ASSERT_EQ(RAM[OS_RESERVED_SIZE], 4100005);
+	ASSERT_EQ(RAM[OS_RESERVED_SIZE + 6], 4100011);
+	removeProgramFiles();
+}
+
+UTEST(VFS, ReadFileFollowsExtents) {
+	vfsClearCatalog();
+	int dataSectors = VFS_TOTAL_SECTORS - VFS_RESERVED_SECTORS;
+	createProgramFile("vfs_a.txt", "ProgA", 100, 1000);
+	createProgramFile("vfs_b.txt", "ProgB", 100, 2000);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 200, 3000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_a.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_b.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgA"), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsDeleteFile("ProgC"), (unsigned)VFS_SUCCESS);
+	createProgramFile("vfs_c.txt", "ProgC", dataSectors - 300, 3000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_c.txt"), (unsigned)VFS_SUCCESS);
+
+	// Two holes of 100 sectors left: the file is split across both
+	createProgramFile("vfs_d.txt", "ProgD", 150, 5000);
+	ASSERT_EQ(vfsLoadToDisk("vfs_d.txt"), (unsigned)VFS_SUCCESS);
+
+	FileMeta_t meta;
+	word words[150];
+	ASSERT_EQ(vfsGetMetadata("ProgD", &meta), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(meta.extentCount, 2);
+	ASSERT_EQ(vfsReadFile(&meta, words), (unsigned)VFS_SUCCESS);
+	for (int i = 0; i < 150; i++) ASSERT_EQ(words[i], 5000 + i);
+	removeProgramFiles();
+}
+
+typedef struct {
+	const char* path;
+	VFSProgram_t program;
+	VFSStatus_t status;
+} ParseJob_t;
+
+static void* parseJob(void* arg) {
+	ParseJob_t* job = (ParseJob_t*)arg;
+	job->status = vfsParseProgram(job->path, &job->program);
+	return NULL;
+}
+
+UTEST(VFS, ParseInParallelStoreInOrder) {
+	vfsClearCatalog();
+	createProgramFile("vfs_a.txt", "ProgA", 300, 1000);
+	createProgramImage("vfs_b.lbin", "ProgB", 200, 2000, false);
+	createProgramFile("vfs_c.txt", "ProgC", 100, 3000);
+	ParseJob_t jobs[] = { { .path = "vfs_a.txt" }, { .path = "vfs_b.lbin" }, { .path = "vfs_c.txt" }, { .path = "vfs_missing.txt" } };
+	int jobCount = sizeof(jobs) / sizeof(jobs[0]);
+
+	pthread_t threads[4];
+	for (int i = 0; i < jobCount; i++) ASSERT_EQ(pthread_create(&threads[i], NULL, parseJob, &jobs[i]), 0);
+	for (int i = 0; i < jobCount; i++) pthread_join(threads[i], NULL);
+
+	// Parsing alone leaves the catalog untouched
+	ASSERT_EQ(jobs[3].status, (unsigned)VFS_ERR_NOT_FOUND);
+	for (int i = 0; i < 3; i++) ASSERT_EQ(jobs[i].status, (unsigned)VFS_SUCCESS);
+	ASSERT_FALSE(vfsFileExists("ProgA"));
+
+	for (int i = 0; i < 3; i++) ASSERT_EQ(vfsStoreProgram(jobs[i].path, &jobs[i].program), (unsigned)VFS_SUCCESS);
+	ASSERT_EQ(vfsStoreProgram(jobs[0].path, &jobs[0].program), (unsigned)VFS_SUCCESS);  // Already stored
+	for (int i = 0; i < 3; i++) vfsReleaseProgram(&jobs[i].program);
+
+	// Stored in call order, so each file starts where the previous one ended
+	const char* names[] = { "ProgA", "ProgB", "ProgC" };
+	int sizes[] = { 300, 200, 100 };
+	int nextSector = VFS_RESERVED_SECTORS;
+	for (int i = 0; i < 3; i++) {
+		FileMeta_t meta;
+		word words[300];
+		ASSERT_EQ(vfsGetMetadata(names[i], &meta), (unsigned)VFS_SUCCESS);
+		ASSERT_EQ(meta.wordCount, sizes[i]);
+		ASSERT_EQ(meta.extentCount, 1);
+		ASSERT_EQ((meta.extents[0].track * DISK_CYLINDERS + meta.extents[0].cylinder) * DISK_SECTORS + meta.extents[0].sector, nextSector);
+		ASSERT_EQ(vfsReadFile(&meta, words), (unsigned)VFS_SUCCESS);
+		for (int w = 0; w < sizes[i]; w++) ASSERT_EQ(words[w], (i + 1) * 1000 + w);
+		nextSector += sizes[i];
+	}
+	removeProgramFiles();
+}
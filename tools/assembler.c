@@ -0,0 +1,654 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+
+#include "assembler.h"
+
+#define ASM_LINE_SIZE 512
+
+static const struct {
+	const char* name;
+	OpCode_t opCode;
+	bool hasOperand;
+} MNEMONICS[] = {
+	{ "SUM",    OP_SUM,    true  }, { "RES",    OP_RES,    true  }, { "MULT",   OP_MULT,   true  },
+	{ "DIVI",   OP_DIVI,   true  }, { "LOAD",   OP_LOAD,   true  }, { "STR",    OP_STR,    true  },
+	{ "LOADRX", OP_LOADRX, false }, { "STRRX",  OP_STRRX,  false }, { "COMP",   OP_COMP,   true  },
+	{ "JMPE",   OP_JMPE,   true  }, { "JMPNE",  OP_JMPNE,  true  }, { "JMPLT",  OP_JMPLT,  true  },
+	{ "JMPLGT", OP_JMPLGT, true  }, { "SVC",    OP_SVC,    false }, { "RETRN",  OP_RETRN,  false },
+	{ "HAB",    OP_HAB,    false }, { "DHAB",   OP_DHAB,   false }, { "TTI",    OP_TTI,    true  },
+	{ "CHMOD",  OP_CHMOD,  true  }, { "LOADRB", OP_LOADRB, false }, { "STRRB",  OP_STRRB,  false },
+	{ "LOADRL", OP_LOADRL, false }, { "STRRL",  OP_STRRL,  false }, { "LOADSP", OP_LOADSP, false },
+	{ "STRSP",  OP_STRSP,  false }, { "PSH",    OP_PSH,    false }, { "POP",    OP_POP,    false },
+	{ "J",      OP_J,      true  }, { "SDMAP",  OP_SDMAP,  true  }, { "SDMAC",  OP_SDMAC,  true  },
+	{ "SDMAS",  OP_SDMAS,  true  }, { "SDMAIO", OP_SDMAIO, true  }, { "SDMAM",  OP_SDMAM,  true  },
+	{ "SDMAON", OP_SDMAON, false }, { "SDMAL",  OP_SDMAL,  true  },
+};
+
+#define MNEMONIC_COUNT ((int)(sizeof(MNEMONICS) / sizeof(MNEMONICS[0])))
+
+
+static void setError(AsmProgram_t* program, int line, const char* format, ...) {
+	if (program->error[0] != '\0') return; // Keep the first one
+
+	int length = snprintf(program->error, ASM_ERROR_SIZE, "line %d: ", line);
+	va_list args;
+	va_start(args, format);
+	vsnprintf(program->error + length, ASM_ERROR_SIZE - length, format, args);
+	va_end(args);
+}
+
+
+static char* trim(char* text) {
+	while (isspace((unsigned char)*text)) text++;
+	char* end = text + strlen(text);
+	while (end > text && isspace((unsigned char)end[-1])) end--;
+	*end = '\0';
+	return text;
+}
+
+
+static bool isIdentifier(const char* text) {
+	if (!isalpha((unsigned char)*text) && *text != '_') return false;
+	for (text++; *text != '\0'; text++) {
+		if (!isalnum((unsigned char)*text) && *text != '_') return false;
+	}
+	return true;
+}
+
+
+static AsmSymbol_t* findSymbol(AsmProgram_t* program, const char* name) {
+	for (int i = 0; i < program->symbolCount; i++) {
+		if (strcmp(program->symbols[i].name, name) == 0) return &program->symbols[i];
+	}
+	return NULL;
+}
+
+
+static AsmStatus_t addSymbol(AsmProgram_t* program, const char* name, bool isLabel, int value, int line) {
+	if (!isIdentifier(name) || strlen(name) >= ASM_SYMBOL_SIZE) {
+		setError(program, line, "invalid symbol name '%s'", name);
+		return ASM_ERR_SYNTAX;
+	}
+	if (findSymbol(program, name) != NULL) {
+		setError(program, line, "'%s' is already defined", name);
+		return ASM_ERR_SYMBOL;
+	}
+
+	if (program->symbolCount == program->symbolCapacity) {
+		int capacity = program->symbolCapacity ? program->symbolCapacity * 2 : 32;
+		AsmSymbol_t* symbols = realloc(program->symbols, capacity * sizeof(AsmSymbol_t));
+		if (symbols == NULL) return ASM_ERR_MEMORY;
+		program->symbols = symbols;
+		program->symbolCapacity = capacity;
+	}
+
+	AsmSymbol_t* symbol = &program->symbols[program->symbolCount++];
+	snprintf(symbol->name, ASM_SYMBOL_SIZE, "%s", name);
+	symbol->isLabel = isLabel;
+	symbol->value = value;
+	return ASM_SUCCESS;
+}
+
+
+static AsmStatement_t* addStatement(AsmProgram_t* program, int line) {
+	if (program->count == program->capacity) {
+		int capacity = program->capacity ? program->capacity * 2 : 64;
+		AsmStatement_t* statements = realloc(program->statements, capacity * sizeof(AsmStatement_t));
+		if (statements == NULL) return NULL;
+		program->statements = statements;
+		program->capacity = capacity;
+	}
+
+	AsmStatement_t* statement = &program->statements[program->count++];
+	*statement = (AsmStatement_t){ .target = -1, .line = line };
+	return statement;
+}
+
+
+/**
+ * @brief Evaluates "term (+|- term)*", where a term is a number, a constant or a label.
+ * A label may appear once and only added; its statement goes to target, the rest to value.
+ */
+static AsmStatus_t evaluate(AsmProgram_t* program, const char* text, int line, bool allowLabel, int* target, int* value) {
+	char name[ASM_SYMBOL_SIZE];
+	const char* cursor = text;
+	long total = 0;
+	bool first = true;
+
+	*target = -1;
+	for (;;) {
+		int sign = 1;
+		while (isspace((unsigned char)*cursor)) cursor++;
+		if (*cursor == '\0' && !first) break;
+		if (*cursor == '+' || *cursor == '-') {
+			sign = (*cursor == '-') ? -1 : 1;
+			cursor++;
+			while (isspace((unsigned char)*cursor)) cursor++;
+		} else if (!first) {
+			setError(program, line, "malformed expression '%s'", text);
+			return ASM_ERR_SYNTAX;
+		}
+
+		if (isdigit((unsigned char)*cursor)) {
+			char* end;
+			total += sign * strtol(cursor, &end, 10);
+			cursor = end;
+		} else if (isalpha((unsigned char)*cursor) || *cursor == '_') {
+			size_t length = 0;
+			while (isalnum((unsigned char)cursor[length]) || cursor[length] == '_') length++;
+			if (length >= ASM_SYMBOL_SIZE) {
+				setError(program, line, "symbol too long in '%s'", text);
+				return ASM_ERR_SYNTAX;
+			}
+			memcpy(name, cursor, length);
+			name[length] = '\0';
+			cursor += length;
+
+			const AsmSymbol_t* symbol = findSymbol(program, name);
+			if (symbol == NULL) {
+				setError(program, line, "undefined symbol '%s'", name);
+				return ASM_ERR_SYMBOL;
+			}
+			if (!symbol->isLabel) {
+				total += sign * symbol->value;
+			} else if (allowLabel && *target == -1 && sign > 0) {
+				*target = symbol->value;
+			} else {
+				setError(program, line, "label '%s' can only be added once to a number here", name);
+				return ASM_ERR_SYNTAX;
+			}
+		} else {
+			setError(program, line, "malformed expression '%s'", text);
+			return ASM_ERR_SYNTAX;
+		}
+
+		if (total > MAX_MAGNITUDE || total < -MAX_MAGNITUDE) {
+			setError(program, line, "value out of range in '%s'", text);
+			return ASM_ERR_RANGE;
+		}
+		first = false;
+	}
+
+	*value = (int)total;
+	return ASM_SUCCESS;
+}
+
+
+static AsmStatus_t parseInstruction(AsmProgram_t* program, AsmStatement_t* statement, const char* mnemonic, char* operand) {
+	int index = 0;
+	while (index < MNEMONIC_COUNT && strcasecmp(MNEMONICS[index].name, mnemonic) != 0) index++;
+	if (index == MNEMONIC_COUNT) {
+		setError(program, statement->line, "unknown mnemonic '%s'", mnemonic);
+		return ASM_ERR_SYNTAX;
+	}
+
+	statement->opCode = MNEMONICS[index].opCode;
+	statement->hasOperand = MNEMONICS[index].hasOperand;
+	statement->mode = ADDR_MODE_DIRECT;
+
+	if (!statement->hasOperand) {
+		if (*operand != '\0') {
+			setError(program, statement->line, "%s takes no operand", MNEMONICS[index].name);
+			return ASM_ERR_SYNTAX;
+		}
+		return ASM_SUCCESS;
+	}
+	if (*operand == '\0') {
+		setError(program, statement->line, "%s needs an operand", MNEMONICS[index].name);
+		return ASM_ERR_SYNTAX;
+	}
+
+	size_t length = strlen(operand);
+	if (operand[0] == '#') {
+		statement->mode = ADDR_MODE_IMMEDIATE;
+		operand = trim(operand + 1);
+	} else if (length > 4 && strcasecmp(operand + length - 4, "[AC]") == 0) {
+		statement->mode = ADDR_MODE_INDEXED;
+		operand[length - 4] = '\0';
+		operand = trim(operand);
+	}
+
+	if (statement->opCode == OP_STR && statement->mode == ADDR_MODE_IMMEDIATE) {
+		setError(program, statement->line, "STR needs a direct or indexed operand");
+		return ASM_ERR_SYNTAX;
+	}
+	if (strlen(operand) >= ASM_EXPRESSION_SIZE) {
+		setError(program, statement->line, "operand too long");
+		return ASM_ERR_SYNTAX;
+	}
+	strcpy(statement->expression, operand);
+	return ASM_SUCCESS;
+}
+
+
+static AsmStatus_t parseDirective(AsmProgram_t* program, const char* directive, char* operand, int line, char* startLabel) {
+	if (strcasecmp(directive, ".name") == 0) {
+		if (!isIdentifier(operand) || strlen(operand) >= VFS_IMAGE_NAME_SIZE) {
+			setError(program, line, ".name needs an identifier of up to %d characters", VFS_IMAGE_NAME_SIZE - 1);
+			return ASM_ERR_SYNTAX;
+		}
+		strcpy(program->programName, operand);
+		return ASM_SUCCESS;
+	}
+
+	if (strcasecmp(directive, ".start") == 0) {
+		if (!isIdentifier(operand) || strlen(operand) >= ASM_SYMBOL_SIZE) {
+			setError(program, line, ".start needs a label");
+			return ASM_ERR_SYNTAX;
+		}
+		strcpy(startLabel, operand);
+		return ASM_SUCCESS;
+	}
+
+	if (strcasecmp(directive, ".equ") == 0) {
+		char* expression = operand + strcspn(operand, " \t");
+		if (*expression != '\0') *expression++ = '\0';
+
+		int target, value;
+		AsmStatus_t status = evaluate(program, trim(expression), line, false, &target, &value);
+		if (status != ASM_SUCCESS) return status;
+		return addSymbol(program, operand, false, value, line);
+	}
+
+	if (strcasecmp(directive, ".word") == 0) {
+		AsmStatement_t* statement = addStatement(program, line);
+		if (statement == NULL) return ASM_ERR_MEMORY;
+		if (*operand == '\0' || strlen(operand) >= ASM_EXPRESSION_SIZE) {
+			setError(program, line, ".word needs a value");
+			return ASM_ERR_SYNTAX;
+		}
+		statement->isData = true;
+		strcpy(statement->expression, operand);
+		return ASM_SUCCESS;
+	}
+
+	setError(program, line, "unknown directive '%s'", directive);
+	return ASM_ERR_SYNTAX;
+}
+
+
+AsmStatus_t asmParse(FILE* source, AsmProgram_t* program) {
+	char buffer[ASM_LINE_SIZE];
+	char startLabel[ASM_SYMBOL_SIZE] = "";
+	bool leader = false;
+	int line = 0;
+	AsmStatus_t status = ASM_SUCCESS;
+
+	*program = (AsmProgram_t){0};
+	strcpy(program->programName, "Program");
+
+	while (status == ASM_SUCCESS && fgets(buffer, sizeof(buffer), source) != NULL) {
+		line++;
+		buffer[strcspn(buffer, ";")] = '\0';
+		char* comment = strstr(buffer, "//");
+		if (comment) *comment = '\0';
+
+		char* text = trim(buffer);
+		char* colon = strchr(text, ':');
+		if (colon != NULL) {
+			*colon = '\0';
+			status = addSymbol(program, trim(text), true, program->count, line);
+			leader = true;
+			text = trim(colon + 1);
+		}
+		if (status != ASM_SUCCESS || *text == '\0') continue;
+
+		char* operand = text + strcspn(text, " \t");
+		if (*operand != '\0') *operand++ = '\0';
+		operand = trim(operand);
+
+		int before = program->count;
+		if (text[0] == '.') {
+			status = parseDirective(program, text, operand, line, startLabel);
+		} else {
+			AsmStatement_t* statement = addStatement(program, line);
+			status = (statement == NULL) ? ASM_ERR_MEMORY : parseInstruction(program, statement, text, operand);
+		}
+
+		if (program->count > before) {
+			program->statements[before].leader = leader;
+			leader = false;
+		}
+	}
+	if (status != ASM_SUCCESS) {
+		if (status == ASM_ERR_MEMORY) setError(program, line, "out of memory");
+		return status;
+	}
+
+	// Every symbol is known now: resolve the operands
+	for (int i = 0; i < program->count; i++) {
+		AsmStatement_t* statement = &program->statements[i];
+		if (!statement->isData && !statement->hasOperand) continue;
+
+		status = evaluate(program, statement->expression, statement->line, true, &statement->target, &statement->value);
+		if (status != ASM_SUCCESS) return status;
+	}
+
+	if (startLabel[0] != '\0') {
+		const AsmSymbol_t* symbol = findSymbol(program, startLabel);
+		if (symbol == NULL || !symbol->isLabel) {
+			setError(program, line, ".start label '%s' is not defined", startLabel);
+			return ASM_ERR_SYMBOL;
+		}
+		program->startTarget = symbol->value;
+	}
+
+	return ASM_SUCCESS;
+}
+
+
+static int nextLive(const AsmProgram_t* program, int index) {
+	for (index++; index < program->count && program->statements[index].removed; index++);
+	return index;
+}
+
+
+/**
+ * @brief Statement a label lands on once removed statements are skipped.
+ */
+static int liveTarget(const AsmProgram_t* program, int target) {
+	while (target < program->count && program->statements[target].removed) target++;
+	return target;
+}
+
+
+static void removeStatement(AsmProgram_t* program, int index) {
+	AsmStatement_t* statement = &program->statements[index];
+	statement->removed = true;
+
+	// Labels now land on the next statement, which can be reached from elsewhere too
+	int next = nextLive(program, index);
+	if (statement->leader && next < program->count) program->statements[next].leader = true;
+}
+
+
+static bool isJump(const AsmStatement_t* statement) {
+	if (statement->isData) return false;
+	switch (statement->opCode) {
+		case OP_J:
+		case OP_JMPE:
+		case OP_JMPNE:
+		case OP_JMPLT:
+		case OP_JMPLGT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+static bool isInstruction(const AsmStatement_t* statement, OpCode_t opCode, AddressingMode_t mode) {
+	return !statement->isData && statement->opCode == opCode && statement->mode == mode;
+}
+
+
+static bool isPlainImmediate(const AsmStatement_t* statement, OpCode_t opCode) {
+	return isInstruction(statement, opCode, ADDR_MODE_IMMEDIATE) && statement->target == -1;
+}
+
+
+/**
+ * @brief A jump that lands on a fixed statement (a label, not a number or an index).
+ */
+static bool isLabelJump(const AsmStatement_t* statement) {
+	return isJump(statement) && statement->mode != ADDR_MODE_INDEXED && statement->target != -1 && statement->value == 0;
+}
+
+
+static bool sameOperand(const AsmProgram_t* program, const AsmStatement_t* a, const AsmStatement_t* b) {
+	if (a->mode != b->mode || a->value != b->value) return false;
+	if (a->target == -1 || b->target == -1) return a->target == b->target;
+	return liveTarget(program, a->target) == liveTarget(program, b->target);
+}
+
+
+/**
+ * @brief First line whose operand is a number addressing the program itself, 0 if none.
+ */
+static int fixedAddressLine(const AsmProgram_t* program) {
+	for (int i = 0; i < program->count; i++) {
+		const AsmStatement_t* statement = &program->statements[i];
+		if (statement->isData || !statement->hasOperand || statement->target != -1) continue;
+
+		// CHMOD uses its field as is; any other direct or indexed operand is read from memory
+		bool isAddress = isJump(statement) || statement->opCode == OP_SDMAM || statement->mode != ADDR_MODE_IMMEDIATE;
+		if (statement->opCode == OP_CHMOD) isAddress = false;
+		if (isAddress && statement->value >= 0 && statement->value < program->count) return statement->line;
+	}
+	return 0;
+}
+
+
+static bool threadJumps(AsmProgram_t* program, AsmOptimizeReport_t* report) {
+	bool changed = false;
+
+	for (int i = 0; i < program->count; i++) {
+		AsmStatement_t* statement = &program->statements[i];
+		if (statement->removed || !isLabelJump(statement)) continue;
+
+		int destination = liveTarget(program, statement->target);
+		for (int steps = 0; destination < program->count && steps < program->count; steps++) {
+			const AsmStatement_t* hop = &program->statements[destination];
+			if (hop->opCode != OP_J || !isLabelJump(hop)) break;
+
+			int next = liveTarget(program, hop->target);
+			if (next == destination) break;
+			destination = next;
+		}
+		if (destination != liveTarget(program, statement->target)) {
+			statement->target = destination;
+			report->jumpsThreaded++;
+			changed = true;
+		}
+
+		if (statement->opCode == OP_J && destination == nextLive(program, i)) {
+			removeStatement(program, i);
+			report->jumpsRemoved++;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+
+static bool loadsAC(const AsmStatement_t* statement) {
+	if (statement->isData) return false;
+	switch (statement->opCode) {
+		case OP_LOAD:
+			return statement->mode != ADDR_MODE_INDEXED; // Indexed reads depend on AC
+		case OP_LOADRX:
+		case OP_LOADRB:
+		case OP_LOADRL:
+		case OP_LOADSP:
+		case OP_POP:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+static bool dropLoadsAndStores(AsmProgram_t* program, AsmOptimizeReport_t* report) {
+	bool changed = false;
+
+	for (int i = 0; i < program->count; i++) {
+		AsmStatement_t* first = &program->statements[i];
+		int j = nextLive(program, i);
+		if (first->removed || first->isData || j >= program->count) continue;
+		AsmStatement_t* second = &program->statements[j];
+
+		// AC and x hold the same value after the first one
+		bool sameCell = (isInstruction(first, OP_STR, ADDR_MODE_DIRECT) || isInstruction(first, OP_LOAD, ADDR_MODE_DIRECT)) &&
+		                (isInstruction(second, OP_STR, ADDR_MODE_DIRECT) || isInstruction(second, OP_LOAD, ADDR_MODE_DIRECT)) &&
+		                !(first->opCode == OP_LOAD && second->opCode == OP_LOAD) && sameOperand(program, first, second);
+		if (sameCell && !second->leader) {
+			removeStatement(program, j);
+			report->loadsStores++;
+			changed = true;
+			continue;
+		}
+
+		// AC is overwritten before anything reads it
+		if (!first->isData && first->opCode == OP_LOAD && first->mode != ADDR_MODE_INDEXED && loadsAC(second)) {
+			removeStatement(program, i);
+			report->loadsStores++;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+
+static bool foldImmediates(AsmProgram_t* program, AsmOptimizeReport_t* report) {
+	bool changed = false;
+
+	for (int i = 0; i < program->count; i++) {
+		AsmStatement_t* first = &program->statements[i];
+		if (first->removed) continue;
+
+		// Operations that leave AC as it is
+		if ((isPlainImmediate(first, OP_SUM) || isPlainImmediate(first, OP_RES)) && first->value == 0) {
+			removeStatement(program, i);
+			report->folded++;
+			changed = true;
+			continue;
+		}
+		if ((isPlainImmediate(first, OP_MULT) || isPlainImmediate(first, OP_DIVI)) && first->value == 1) {
+			removeStatement(program, i);
+			report->folded++;
+			changed = true;
+			continue;
+		}
+
+		int j = nextLive(program, i);
+		if (j >= program->count || program->statements[j].leader) continue;
+		AsmStatement_t* second = &program->statements[j];
+
+		bool arithmetic = isPlainImmediate(second, OP_SUM) || isPlainImmediate(second, OP_RES) ||
+		                  isPlainImmediate(second, OP_MULT) || isPlainImmediate(second, OP_DIVI);
+		long a = first->value, b = second->value, result = -1;
+
+		if (arithmetic && isPlainImmediate(first, OP_LOAD)) {
+			switch (second->opCode) {
+				case OP_SUM:  result = a + b; break;
+				case OP_RES:  result = a - b; break;
+				case OP_MULT: result = a * b; break;
+				case OP_DIVI: result = (b != 0) ? a / b : -1; break;
+				default: break;
+			}
+		} else if (arithmetic && isPlainImmediate(first, second->opCode)) {
+			// Same direction, so the merged step overflows whenever one of the two did
+			if (second->opCode == OP_SUM || second->opCode == OP_RES) result = a + b;
+			else if (second->opCode == OP_MULT && a >= 1 && b >= 1) result = a * b;
+		}
+
+		if (result >= 0 && result <= ASM_MAX_VALUE) {
+			first->value = (int)result;
+			removeStatement(program, j);
+			report->folded++;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+
+static int liveCount(const AsmProgram_t* program) {
+	int count = 0;
+	for (int i = 0; i < program->count; i++) {
+		if (!program->statements[i].removed) count++;
+	}
+	return count;
+}
+
+
+void asmOptimize(AsmProgram_t* program, AsmOptimizeReport_t* report) {
+	AsmOptimizeReport_t local;
+	if (report == NULL) report = &local;
+
+	*report = (AsmOptimizeReport_t){0};
+	report->wordsBefore = liveCount(program);
+	report->fixedAddressLine = fixedAddressLine(program);
+
+	if (report->fixedAddressLine == 0) {
+		bool changed;
+		do {
+			changed = threadJumps(program, report);
+			changed |= dropLoadsAndStores(program, report);
+			changed |= foldImmediates(program, report);
+		} while (changed);
+	}
+
+	report->wordsAfter = liveCount(program);
+}
+
+
+AsmStatus_t asmEncode(AsmProgram_t* program, word* words, int* wordCount, int* startPC) {
+	int* address = malloc((program->count + 1) * sizeof(int));
+	if (address == NULL) return ASM_ERR_MEMORY;
+
+	int count = 0;
+	for (int i = 0; i < program->count; i++) {
+		address[i] = count;
+		if (!program->statements[i].removed) count++;
+	}
+	address[program->count] = count;
+
+	count = 0;
+	for (int i = 0; i < program->count; i++) {
+		const AsmStatement_t* statement = &program->statements[i];
+		if (statement->removed) continue;
+
+		int operand = statement->value + ((statement->target != -1) ? address[statement->target] : 0);
+		if (statement->isData) {
+			words[count++] = (operand < 0) ? SIGN_BIT - operand : operand;
+			continue;
+		}
+		if (operand < 0 || operand > ASM_MAX_VALUE) {
+			setError(program, statement->line, "operand %d does not fit in 5 digits", operand);
+			free(address);
+			return ASM_ERR_RANGE;
+		}
+		words[count++] = statement->opCode * 1000000 + statement->mode * 100000 + (statement->hasOperand ? operand : 0);
+	}
+
+	*wordCount = count;
+	*startPC = address[program->startTarget] + 1;
+	free(address);
+	return ASM_SUCCESS;
+}
+
+
+void asmDisassemble(word value, bool isData, char* buffer, size_t size) {
+	if (isData) {
+		snprintf(buffer, size, ".word %d", IS_NEGATIVE(value) ? -(int)GET_MAGNITUDE(value) : (int)value);
+		return;
+	}
+
+	int opCode = GET_INSTRUCTION_OPCODE(value);
+	int mode = GET_INSTRUCTION_MODE(value);
+	int operand = GET_INSTRUCTION_VALUE(value);
+	for (int i = 0; i < MNEMONIC_COUNT; i++) {
+		if ((int)MNEMONICS[i].opCode != opCode) continue;
+
+		if (!MNEMONICS[i].hasOperand) snprintf(buffer, size, "%s", MNEMONICS[i].name);
+		else if (mode == ADDR_MODE_IMMEDIATE) snprintf(buffer, size, "%s #%d", MNEMONICS[i].name, operand);
+		else if (mode == ADDR_MODE_INDEXED) snprintf(buffer, size, "%s %d[AC]", MNEMONICS[i].name, operand);
+		else snprintf(buffer, size, "%s %d", MNEMONICS[i].name, operand);
+		return;
+	}
+	snprintf(buffer, size, "%08d", value);
+}
+
+
+void asmFree(AsmProgram_t* program) {
+	free(program->statements);
+	free(program->symbols);
+	program->statements = NULL;
+	program->symbols = NULL;
+	program->count = program->capacity = 0;
+	program->symbolCount = program->symbolCapacity = 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file assembler.h
+ * @brief Mnemonic assembler and peephole optimizer for Lucario programs.
+ *
+ * Turns source written with the mnemonics of docs/ARCHITECTURE.md into the
+ * 8-digit words loaded by the VFS. A source line holds an optional label, a
+ * mnemonic or directive and its operand; comments start with "//" or ";".
+ *
+ * - Operands: "#expr" is immediate, "expr" direct and "expr[AC]" indexed.
+ * - Expressions add and subtract numbers, constants and at most one label.
+ * - Directives: ".name NAME", ".start label", ".equ NAME expr", ".word expr".
+ *
+ * Labels are kept symbolic until encoding, so the optimizer can delete
+ * statements and every address operand that names a label follows the move.
+ *
+ * @version 1.0
+ */
+
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "../inc/definitions.h"
+#include "../inc/kernel/vfs.h"
+
+#define ASM_MAX_VALUE       99999  /** Largest operand that fits the VVVVV field. */
+#define ASM_SYMBOL_SIZE     32     /** Bytes for a label or constant name, terminator included. */
+#define ASM_EXPRESSION_SIZE 64     /** Bytes kept for an operand expression until it is resolved. */
+#define ASM_ERROR_SIZE      256    /** Bytes for the message of the first error. */
+
+/**
+ * @brief Assembler Status Codes.
+ */
+typedef enum {
+	ASM_SUCCESS      = 0,  /**< Operation completed successfully */
+	ASM_ERR_SYNTAX   = 1,  /**< Unknown mnemonic, directive or malformed operand */
+	ASM_ERR_SYMBOL   = 2,  /**< Undefined or duplicated label or constant */
+	ASM_ERR_RANGE    = 3,  /**< Operand or data word does not fit its field */
+	ASM_ERR_MEMORY   = 4   /**< Host allocation failed */
+} AsmStatus_t;
+
+/**
+ * @brief One instruction or data word of the source.
+ */
+typedef struct {
+	bool isData;                            /**< .word rather than an instruction */
+	bool hasOperand;                        /**< The mnemonic takes an operand */
+	bool leader;                            /**< A label points here, so control may arrive from elsewhere */
+	bool removed;                           /**< Deleted by the optimizer */
+	OpCode_t opCode;                        /**< Operation, for instructions */
+	AddressingMode_t mode;                  /**< Addressing mode, for instructions */
+	int target;                             /**< Statement a label operand points to, -1 for a plain number */
+	int value;                              /**< The number, or the offset from the target */
+	int line;                               /**< Source line, for messages */
+	char expression[ASM_EXPRESSION_SIZE];   /**< Operand text until it is resolved */
+} AsmStatement_t;
+
+/**
+ * @brief Label (statement index) or constant (value) defined by the source.
+ */
+typedef struct {
+	char name[ASM_SYMBOL_SIZE];
+	bool isLabel;
+	int value;
+} AsmSymbol_t;
+
+/**
+ * @brief A parsed program.
+ */
+typedef struct {
+	AsmStatement_t* statements;
+	int count;
+	int capacity;
+	AsmSymbol_t* symbols;
+	int symbolCount;
+	int symbolCapacity;
+	int startTarget;                          /**< Statement named by .start (0 by default) */
+	char programName[VFS_IMAGE_NAME_SIZE];    /**< Set by .name */
+	char error[ASM_ERROR_SIZE];               /**< First error, as "line N: message" */
+} AsmProgram_t;
+
+/**
+ * @brief Statements removed or rewritten by each optimizer pass.
+ */
+typedef struct {
+	int wordsBefore;       /**< Words before optimizing */
+	int wordsAfter;        /**< Words after optimizing */
+	int jumpsThreaded;     /**< Jumps retargeted past a chain of J */
+	int jumpsRemoved;      /**< J to the very next statement */
+	int loadsStores;       /**< Redundant LOAD and STR removed */
+	int folded;            /**< Immediate arithmetic folded or dropped */
+	int fixedAddressLine;  /**< Line of a numeric address that pins the layout, 0 if none */
+} AsmOptimizeReport_t;
+
+/**
+ * @brief Parses a source file and resolves its labels and constants.
+ *
+ * @param source Source text.
+ * @param program Receives the statements; release it with asmFree even on failure.
+ * @return ASM_SUCCESS, or the first error with program->error set.
+ */
+AsmStatus_t asmParse(FILE* source, AsmProgram_t* program);
+
+/**
+ * @brief Runs the peephole passes until none of them applies.
+ *
+ * - Jump threading: a jump to a J goes straight to its destination, and a J
+ *   to the next statement is dropped.
+ * - Redundant loads and stores: "STR x; LOAD x", "LOAD x; STR x" and
+ *   "STR x; STR x" keep the first instruction only; a LOAD overwritten by the
+ *   next load into AC is dropped.
+ * - Immediate folding: "LOAD #a; SUM #b" becomes "LOAD #(a+b)" (also RES, MULT
+ *   and DIVI), two immediate SUM, RES or MULT merge, and SUM #0, RES #0,
+ *   MULT #1 and DIVI #1 are dropped.
+ *
+ * A pair is only merged when no label points at its second statement. A
+ * program with a direct, indexed or jump operand written as a number inside
+ * the program would break if statements moved, so it is left untouched and
+ * the line is reported in fixedAddressLine.
+ *
+ * @param program Parsed program, updated in place.
+ * @param report Receives the figures of the run (may be NULL).
+ */
+void asmOptimize(AsmProgram_t* program, AsmOptimizeReport_t* report);
+
+/**
+ * @brief Encodes the statements that survived the optimizer.
+ *
+ * @param program Parsed program.
+ * @param words Receives the words; must hold program->count entries.
+ * @param wordCount Receives the number of words.
+ * @param startPC Receives the 1-based start PC, as in the "_start" line.
+ * @return ASM_SUCCESS, or ASM_ERR_RANGE with program->error set.
+ */
+AsmStatus_t asmEncode(AsmProgram_t* program, word* words, int* wordCount, int* startPC);
+
+/**
+ * @brief Renders an encoded word of a statement as source text (e.g. "LOAD #5").
+ */
+void asmDisassemble(word value, bool isData, char* buffer, size_t size);
+
+/**
+ * @brief Releases the memory of a program.
+ */
+void asmFree(AsmProgram_t* program);
+
+#endif // ASSEMBLER_H
@@ -0,0 +1,159 @@
+/**
+ * @file lucasm.c
+ * @brief Command line front end of the Lucario assembler.
+ *
+ * Assembles a mnemonic source file (see assembler.h for the syntax) into the
+ * text program format read by the loader, or into the binary image format
+ * with -b. With -O the peephole optimizer runs before encoding.
+ *
+ * Usage: lucasm [-O] [-b] [-o output] input.asm
+ *
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "assembler.h"
+
+typedef struct {
+	bool optimize;        /**< Run the peephole passes */
+	bool binary;          /**< Write a binary image instead of text */
+	const char* input;    /**< Source file */
+	char output[512];     /**< Program file to write */
+} AsmOptions_t;
+
+
+static void printUsage(const char* program) {
+	fprintf(stderr, "Usage: %s [-O] [-b] [-o output] input.asm\n", program);
+	fprintf(stderr, "  -O  Run the peephole optimizer\n");
+	fprintf(stderr, "  -b  Write a binary image (%s) instead of a text program (.txt)\n", VFS_IMAGE_EXTENSION);
+	fprintf(stderr, "  -o  Output file (default: the input with the extension replaced)\n");
+}
+
+
+static void defaultOutputPath(const char* input, const char* extension, char* output, size_t size) {
+	snprintf(output, size, "%s", input);
+	char* dot = strrchr(output, '.');
+	char* slash = strrchr(output, '/');
+	if (dot != NULL && (slash == NULL || dot > slash)) *dot = '\0';
+	strncat(output, extension, size - strlen(output) - 1);
+}
+
+
+static int writeText(const char* path, const AsmProgram_t* program, const word* words, int wordCount, int startPC) {
+	FILE* file = fopen(path, "w");
+	if (file == NULL) return 1;
+
+	fprintf(file, "_start %d\n", startPC);
+	fprintf(file, ".NumeroPalabras %d\n", wordCount);
+	fprintf(file, ".NombreProg %s\n", program->programName);
+
+	int index = 0;
+	for (int i = 0; i < program->count; i++) {
+		if (program->statements[i].removed) continue;
+
+		char text[64];
+		asmDisassemble(words[index], program->statements[i].isData, text, sizeof(text));
+		fprintf(file, "%08d   // %02d. %s\n", words[index], index, text);
+		index++;
+	}
+
+	return fclose(file) != 0;
+}
+
+
+static int writeBinary(const char* path, const AsmProgram_t* program, const word* words, int wordCount, int startPC) {
+	ProgramImageHeader_t header = { .magic = VFS_IMAGE_MAGIC, .version = VFS_IMAGE_VERSION, .startPC = startPC, .wordCount = wordCount };
+	strcpy(header.programName, program->programName);
+	header.checksum = vfsImageChecksum(words, wordCount);
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return 1;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(words, sizeof(word), wordCount, file) == (size_t)wordCount;
+	return (fclose(file) != 0 || !written);
+}
+
+
+int main(int argc, char** argv) {
+	AsmOptions_t options = {0};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "Obo:h")) != -1) {
+		switch (opt) {
+			case 'O':
+				options.optimize = true;
+				break;
+			case 'b':
+				options.binary = true;
+				break;
+			case 'o':
+				snprintf(options.output, sizeof(options.output), "%s", optarg);
+				break;
+			default:
+				printUsage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	options.input = argv[optind];
+	if (options.output[0] == '\0') {
+		defaultOutputPath(options.input, options.binary ? VFS_IMAGE_EXTENSION : ".txt", options.output, sizeof(options.output));
+	}
+	if (strcmp(options.input, options.output) == 0) {
+		fprintf(stderr, "%s: the output would overwrite the source, use -o\n", options.input);
+		return 1;
+	}
+
+	FILE* source = fopen(options.input, "r");
+	if (source == NULL) {
+		perror(options.input);
+		return 1;
+	}
+
+	AsmProgram_t program;
+	AsmStatus_t status = asmParse(source, &program);
+	fclose(source);
+
+	AsmOptimizeReport_t report = {0};
+	if (status == ASM_SUCCESS && options.optimize) {
+		asmOptimize(&program, &report);
+		if (report.fixedAddressLine != 0) {
+			fprintf(stderr, "%s: warning: line %d addresses the program with a number, so it was not optimized\n",
+			        options.input, report.fixedAddressLine);
+		}
+	}
+
+	word* words = calloc(program.count > 0 ? program.count : 1, sizeof(word));
+	int wordCount = 0, startPC = 1;
+	if (status == ASM_SUCCESS) status = (words == NULL) ? ASM_ERR_MEMORY : asmEncode(&program, words, &wordCount, &startPC);
+	if (status != ASM_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", options.input, program.error[0] ? program.error : "out of memory");
+		free(words);
+		asmFree(&program);
+		return 1;
+	}
+
+	int result = options.binary ? writeBinary(options.output, &program, words, wordCount, startPC)
+	                            : writeText(options.output, &program, words, wordCount, startPC);
+	if (result != 0) {
+		perror(options.output);
+	} else {
+		printf("%s -> %s (%s, %d words, start %d)\n", options.input, options.output, program.programName, wordCount, startPC);
+		if (options.optimize && report.fixedAddressLine == 0) {
+			printf("Optimizer: %d -> %d words (%d jumps threaded, %d removed, %d loads/stores dropped, %d immediates folded)\n",
+			       report.wordsBefore, report.wordsAfter, report.jumpsThreaded, report.jumpsRemoved, report.loadsStores, report.folded);
+		}
+	}
+
+	free(words);
+	asmFree(&program);
+	return result;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file progconv.c
+ * @brief Converts a text program into the pre-assembled binary image format.
+ *
+ * Reads the "_start", ".NumeroPalabras" and ".NombreProg" header lines and the
+ * words of a text program (comments allowed) and writes a ProgramImageHeader_t
+ * followed by the raw words, which the loader maps and copies in one pass.
+ *
+ * Usage: progconv input.txt [output.lbin]
+ *
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/kernel/vfs.h"
+
+
+static void printUsage(const char* program) {
+	fprintf(stderr, "Usage: %s input.txt [output%s]\n", program, VFS_IMAGE_EXTENSION);
+	fprintf(stderr, "The default output replaces the input extension with %s\n", VFS_IMAGE_EXTENSION);
+}
+
+
+/**
+ * @brief Next word of the program body, skipping comments and blank lines.
+ * @return 1 when a word was read, 0 at the end of the file.
+ */
+static int readWord(FILE* file, word* value) {
+	char line[512];
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char* comment = strstr(line, "//");
+		if (comment) *comment = '\0';
+		if (sscanf(line, "%d", value) == 1) return 1;
+	}
+	return 0;
+}
+
+
+static void defaultOutputPath(const char* input, char* output, size_t size) {
+	snprintf(output, size, "%s", input);
+	char* dot = strrchr(output, '.');
+	char* slash = strrchr(output, '/');
+	if (dot != NULL && (slash == NULL || dot > slash)) *dot = '\0';
+	strncat(output, VFS_IMAGE_EXTENSION, size - strlen(output) - 1);
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 2 || argc > 3 || strcmp(argv[1], "-h") == 0) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	char outputPath[512];
+	if (argc == 3) snprintf(outputPath, sizeof(outputPath), "%s", argv[2]);
+	else defaultOutputPath(argv[1], outputPath, sizeof(outputPath));
+
+	FILE* input = fopen(argv[1], "r");
+	if (input == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	ProgramImageHeader_t header = { .magic = VFS_IMAGE_MAGIC, .version = VFS_IMAGE_VERSION };
+	char programName[256];
+	if (fscanf(input, "%*s %d", &header.startPC) != 1 || fscanf(input, "%*s %d", &header.wordCount) != 1 ||
+	    fscanf(input, "%*s %255s", programName) != 1 || header.wordCount < 0) {
+		fprintf(stderr, "%s: missing or invalid program header\n", argv[1]);
+		fclose(input);
+		return 1;
+	}
+	if (strlen(programName) >= VFS_IMAGE_NAME_SIZE) {
+		fprintf(stderr, "%s: program name '%s' is longer than %d characters\n", argv[1], programName, VFS_IMAGE_NAME_SIZE - 1);
+		fclose(input);
+		return 1;
+	}
+	strcpy(header.programName, programName);
+
+	word* words = calloc(header.wordCount > 0 ? header.wordCount : 1, sizeof(word));
+	if (words == NULL) {
+		perror("calloc");
+		fclose(input);
+		return 1;
+	}
+	for (int i = 0; i < header.wordCount; i++) {
+		if (!readWord(input, &words[i])) {
+			fprintf(stderr, "%s: declares %d words but holds only %d\n", argv[1], header.wordCount, i);
+			free(words);
+			fclose(input);
+			return 1;
+		}
+	}
+	fclose(input);
+	header.checksum = vfsImageChecksum(words, header.wordCount);
+
+	FILE* output = fopen(outputPath, "wb");
+	int result = 0;
+	if (output == NULL || fwrite(&header, sizeof(header), 1, output) != 1 ||
+	    fwrite(words, sizeof(word), header.wordCount, output) != (size_t)header.wordCount) {
+		perror(outputPath);
+		result = 1;
+	} else {
+		printf("%s -> %s (%s, %d words, start %d)\n", argv[1], outputPath, header.programName, header.wordCount, header.startPC);
+	}
+
+	if (output != NULL) fclose(output);
+	free(words);
+	return result;
+}
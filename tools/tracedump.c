@@ -0,0 +1,198 @@
+/**
+ * @file tracedump.c
+ * @brief Offline decoder for the binary hardware trace (logs_trace.bin).
+ *
+ * Turns the fixed-size TraceRecord_t entries back into the text lines the
+ * hardware log would have contained, optionally filtered by PID or event,
+ * or prints a per-event and per-PID summary of the run.
+ *
+ * Usage: tracedump [-p pid] [-e event] [-s] [file]
+ *
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "../inc/logger.h"
+
+#define TRACE_MAX_PIDS 32768  /** Distinct PIDs counted by the summary (int16_t range). */
+
+static const char* EVENT_NAMES[TRACE_EVENT_COUNT] = {
+	[TRACE_FETCH]           = "fetch",
+	[TRACE_MEM_READ]        = "read",
+	[TRACE_MEM_WRITE]       = "write",
+	[TRACE_DMA_READ]        = "dmaread",
+	[TRACE_DMA_WRITE]       = "dmawrite",
+	[TRACE_BRANCH]          = "branch",
+	[TRACE_CONTEXT_SAVE]    = "save",
+	[TRACE_CONTEXT_RESTORE] = "restore",
+	[TRACE_INTERRUPT]       = "interrupt",
+};
+
+static const char* INTERRUPT_NAMES[] = {
+	"Invalid system call", "Invalid interrupt code", "System call", "Timer", "I/O completion",
+	"Invalid instruction", "Invalid memory address", "Arithmetic underflow", "Arithmetic overflow",
+};
+
+typedef struct {
+	int pidFilter;       /**< -1 for every PID */
+	int eventFilter;     /**< -1 for every event */
+	bool summary;        /**< Print counters instead of lines */
+	const char* path;    /**< Trace file to decode */
+} DumpOptions_t;
+
+
+static int parseEventName(const char* name) {
+	for (int i = 0; i < TRACE_EVENT_COUNT; i++) {
+		if (strcmp(name, EVENT_NAMES[i]) == 0) return i;
+	}
+	return -1;
+}
+
+
+static void printUsage(const char* program) {
+	fprintf(stderr, "Usage: %s [-p pid] [-e event] [-s] [file]\n", program);
+	fprintf(stderr, "Events:");
+	for (int i = 0; i < TRACE_EVENT_COUNT; i++) fprintf(stderr, " %s", EVENT_NAMES[i]);
+	fprintf(stderr, "\nThe default file is logs_trace.bin\n");
+}
+
+
+/**
+ * @brief Prints a record with the same wording as the text hardware log.
+ */
+static void printRecord(const TraceRecord_t* record) {
+	const int32_t* op = record->operands;
+
+	printf("[C:%08" PRIu64 " P:%d]: ", record->cycle, record->pid);
+
+	switch (record->event) {
+		case TRACE_FETCH:
+			printf("Fetched instruction %08d from address %03d\n", op[0], op[1]);
+			break;
+		case TRACE_MEM_READ:
+			printf("READ: Logical[%d] -> Physical[%d] = Value[%08d]\n", op[0], op[1], op[2]);
+			break;
+		case TRACE_MEM_WRITE:
+			printf("WRITE: Logical[%d] -> Physical[%d] = Value[%08d]\n", op[0], op[1], op[2]);
+			break;
+		case TRACE_DMA_READ:
+			printf("DMA Phys-Read at [%d] = %08d\n", op[0], op[1]);
+			break;
+		case TRACE_DMA_WRITE:
+			printf("DMA Phys-Write at [%d] = %08d\n", op[0], op[1]);
+			break;
+		case TRACE_BRANCH:
+			printf("Branch taken to address %03d\n", op[0]);
+			break;
+		case TRACE_CONTEXT_SAVE:
+			printf("Context saved: PC=%03" PRIu32 ", SP=%d, AC=%d\n", record->pc, op[0], op[1]);
+			break;
+		case TRACE_CONTEXT_RESTORE:
+			printf("Context restored: Returning to PC=%03" PRIu32 ", SP=%d\n", record->pc, op[0]);
+			break;
+		case TRACE_INTERRUPT:
+			if (op[0] >= 0 && op[0] < (int32_t)(sizeof(INTERRUPT_NAMES) / sizeof(INTERRUPT_NAMES[0]))) {
+				printf("[INT] %s interrupt (Value: %d)\n", INTERRUPT_NAMES[op[0]], op[1]);
+			} else {
+				printf("[INT] Unknown interrupt code %d\n", op[0]);
+			}
+			break;
+		default:
+			printf("Unknown event %u\n", record->event);
+			break;
+	}
+}
+
+
+static int dumpTrace(FILE* file, const DumpOptions_t* options) {
+	static unsigned long pidCounts[TRACE_MAX_PIDS];
+	unsigned long eventCounts[TRACE_EVENT_COUNT] = {0};
+	unsigned long total = 0, matched = 0;
+	uint64_t maxCycle = 0;
+	TraceRecord_t record;
+
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		total++;
+		if (options->pidFilter >= 0 && record.pid != options->pidFilter) continue;
+		if (options->eventFilter >= 0 && record.event != options->eventFilter) continue;
+		matched++;
+
+		if (!options->summary) {
+			printRecord(&record);
+			continue;
+		}
+
+		if (record.event < TRACE_EVENT_COUNT) eventCounts[record.event]++;
+		if (record.pid >= 0) pidCounts[record.pid]++;
+		if (record.cycle > maxCycle) maxCycle = record.cycle;
+	}
+
+	if (options->summary) {
+		printf("Records: %lu (%lu matching)\n", total, matched);
+		printf("Highest virtual cycle: %" PRIu64 "\n", maxCycle);
+		printf("\nPer event:\n");
+		for (int i = 0; i < TRACE_EVENT_COUNT; i++) {
+			if (eventCounts[i] > 0) printf("  %-10s %10lu\n", EVENT_NAMES[i], eventCounts[i]);
+		}
+		printf("\nPer PID:\n");
+		for (int i = 0; i < TRACE_MAX_PIDS; i++) {
+			if (pidCounts[i] > 0) printf("  %-10d %10lu\n", i, pidCounts[i]);
+		}
+	}
+
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	DumpOptions_t options = { .pidFilter = -1, .eventFilter = -1, .summary = false, .path = "logs_trace.bin" };
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:e:sh")) != -1) {
+		switch (opt) {
+			case 'p':
+				options.pidFilter = atoi(optarg);
+				break;
+			case 'e':
+				options.eventFilter = parseEventName(optarg);
+				if (options.eventFilter < 0) {
+					fprintf(stderr, "Unknown event '%s'\n", optarg);
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 's':
+				options.summary = true;
+				break;
+			default:
+				printUsage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind < argc) options.path = argv[optind];
+
+	FILE* file = fopen(options.path, "rb");
+	if (file == NULL) {
+		perror(options.path);
+		return 1;
+	}
+
+	TraceFileHeader_t header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != TRACE_FILE_VERSION || header.recordSize != sizeof(TraceRecord_t)) {
+		fprintf(stderr, "%s: not a version %d trace file\n", options.path, TRACE_FILE_VERSION);
+		fclose(file);
+		return 1;
+	}
+
+	int result = dumpTrace(file, &options);
+	fclose(file);
+	return result;
+}